@@ -0,0 +1,256 @@
+#include "bench.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static bool KeyEqual(const char *const arg, const size_t length,
+                     const char *const key) {
+  return (strlen(key) == length) && (strncmp(arg, key, length) == 0);
+}
+
+bool BenchParseParams(BenchParams *const params, const int argc,
+                      char *argv[]) {
+  params->rows = 10000;
+  params->columns = 8;
+  params->key_width = 2;
+  params->change_rate = 0.01;
+  params->chain_length = 10;
+  params->tables = 1;
+  params->seed = 1;
+
+  for (int i = 0; i < argc; i++) {
+    const char *const arg = argv[i];
+    const char *const value = strchr(arg, '=');
+    if (value == NULL || value[1] == '\0') {
+      fprintf(stderr, "Bad benchmark parameter '%s': Expected KEY=VALUE\n",
+              arg);
+      return false;
+    }
+
+    const size_t key_length = (size_t)(value - arg);
+    char *end;
+    if (KeyEqual(arg, key_length, "rows")) {
+      params->rows = strtoull(value + 1, &end, 10);
+    } else if (KeyEqual(arg, key_length, "columns")) {
+      params->columns = strtoull(value + 1, &end, 10);
+    } else if (KeyEqual(arg, key_length, "key_width")) {
+      params->key_width = strtoull(value + 1, &end, 10);
+    } else if (KeyEqual(arg, key_length, "change_rate")) {
+      params->change_rate = strtod(value + 1, &end);
+    } else if (KeyEqual(arg, key_length, "chain_length")) {
+      params->chain_length = strtoull(value + 1, &end, 10);
+    } else if (KeyEqual(arg, key_length, "tables")) {
+      params->tables = strtoull(value + 1, &end, 10);
+    } else if (KeyEqual(arg, key_length, "seed")) {
+      params->seed = strtoull(value + 1, &end, 10);
+    } else {
+      fprintf(stderr, "Unknown benchmark parameter '%.*s'\n", (int)key_length,
+              arg);
+      return false;
+    }
+
+    if (*end != '\0') {
+      fprintf(stderr, "Bad value for benchmark parameter '%s'\n", arg);
+      return false;
+    }
+  }
+
+  if (params->key_width < 1 || params->key_width >= params->columns) {
+    fprintf(stderr,
+            "Bad benchmark parameters: Expected 0 < key_width < columns\n");
+    return false;
+  }
+  if (params->change_rate < 0.0 || params->change_rate > 1.0) {
+    fprintf(stderr,
+            "Bad benchmark parameters: Expected 0 <= change_rate <= 1\n");
+    return false;
+  }
+  if (params->rows < 1 || params->chain_length < 1 || params->tables < 1) {
+    fprintf(stderr,
+            "Bad benchmark parameters: Expected rows, chain_length and tables "
+            "> 0\n");
+    return false;
+  }
+
+  return true;
+}
+
+double BenchNow(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + ((double)ts.tv_nsec / 1e9);
+}
+
+void BenchReport(const BenchParams *const params, const char *const benchmark,
+                 const size_t iterations, const size_t bytes,
+                 const double seconds) {
+  printf(
+      "{\"benchmark\": \"%s\", \"rows\": %zu, \"columns\": %zu, "
+      "\"key_width\": %zu, \"change_rate\": %g, \"chain_length\": %zu, "
+      "\"tables\": %zu, \"iterations\": %zu, \"seconds\": %.6f, "
+      "\"ns_per_op\": %.1f",
+      benchmark, params->rows, params->columns, params->key_width,
+      params->change_rate, params->chain_length, params->tables, iterations,
+      seconds,
+      (iterations > 0) ? (seconds * 1e9) / (double)iterations : 0.0);
+  if (bytes > 0) {
+    printf(", \"bytes\": %zu, \"mib_per_second\": %.2f", bytes,
+           ((double)bytes / (1024.0 * 1024.0)) / seconds);
+  }
+  printf("}\n");
+  fflush(stdout);
+}
+
+/**
+ * SplitMix64. Good enough for test data, and the same seed always yields the
+ * same tables.
+ */
+static uint64_t Random(uint64_t *const state) {
+  uint64_t z = (*state += UINT64_C(0x9E3779B97F4A7C15));
+  z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+  z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+  return z ^ (z >> 31);
+}
+
+static double RandomFraction(uint64_t *const state) {
+  return (double)(Random(state) >> 11) / (double)(UINT64_C(1) << 53);
+}
+
+static LCH_List *FieldNames(const size_t from, const size_t to) {
+  LCH_List *const list = LCH_ListCreate();
+  if (list == NULL) {
+    return NULL;
+  }
+
+  for (size_t i = from; i < to; i++) {
+    LCH_Buffer *const name = LCH_BufferCreate();
+    if (name == NULL) {
+      LCH_ListDestroy(list);
+      return NULL;
+    }
+
+    if (!LCH_BufferPrintFormat(name, "field%zu", i) ||
+        !LCH_ListAppend(list, name, LCH_BufferDestroy)) {
+      LCH_BufferDestroy(name);
+      LCH_ListDestroy(list);
+      return NULL;
+    }
+  }
+
+  return list;
+}
+
+LCH_List *BenchPrimaryFields(const BenchParams *const params) {
+  return FieldNames(0, params->key_width);
+}
+
+LCH_List *BenchSubsidiaryFields(const BenchParams *const params) {
+  return FieldNames(params->key_width, params->columns);
+}
+
+/**
+ * Formats a random subsidiary value of 16 hexadecimal digits into field and
+ * returns its length.
+ */
+static size_t RandomField(uint64_t *const state, char *const field,
+                          const size_t size) {
+  const int length = snprintf(field, size, "%016" PRIx64, Random(state));
+  return (size_t)length;
+}
+
+static bool AppendRecord(const BenchParams *const params,
+                         LCH_Table *const table, uint64_t *const state,
+                         const size_t id) {
+  for (size_t i = 0; i < params->key_width; i++) {
+    char field[64];
+    const int length = snprintf(field, sizeof(field), "key%zu-%zu", id, i);
+    if (!LCH_TableAppendField(table, field, (size_t)length)) {
+      return false;
+    }
+  }
+
+  for (size_t i = params->key_width; i < params->columns; i++) {
+    char field[32];
+    const size_t length = RandomField(state, field, sizeof(field));
+    if (!LCH_TableAppendField(table, field, length)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+LCH_Table *BenchGenerateTable(const BenchParams *const params,
+                              uint64_t *const state, size_t *const next_id) {
+  LCH_Table *const table = LCH_TableCreate(params->columns);
+  if (table == NULL) {
+    return NULL;
+  }
+
+  /* Each record is made up of short keys and 16 byte values */
+  if (!LCH_TableReserve(table, params->rows + 1,
+                        (params->rows + 1) * params->columns * 24)) {
+    LCH_TableDestroy(table);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < params->columns; i++) {
+    char field[32];
+    const int length = snprintf(field, sizeof(field), "field%zu", i);
+    if (!LCH_TableAppendField(table, field, (size_t)length)) {
+      LCH_TableDestroy(table);
+      return NULL;
+    }
+  }
+
+  for (size_t i = 0; i < params->rows; i++) {
+    if (!AppendRecord(params, table, state, *next_id)) {
+      LCH_TableDestroy(table);
+      return NULL;
+    }
+    *next_id += 1;
+  }
+
+  return table;
+}
+
+bool BenchMutateTable(const BenchParams *const params, LCH_Table *const table,
+                      uint64_t *const state, size_t *const next_id) {
+  size_t num_deletes = 0;
+
+  /* Iterate backwards, so that removing a record does not shift the records
+   * we have yet to visit. Row zero is the header. */
+  for (size_t row = LCH_TableGetNumRows(table) - 1; row > 0; row--) {
+    if (RandomFraction(state) >= params->change_rate) {
+      continue;
+    }
+
+    if (Random(state) % 10 < 8) {
+      const size_t num_subsidiary = params->columns - params->key_width;
+      const size_t column =
+          params->key_width + (size_t)(Random(state) % num_subsidiary);
+      char field[32];
+      const size_t length = RandomField(state, field, sizeof(field));
+      if (!LCH_TableSetField(table, row, column, field, length)) {
+        return false;
+      }
+    } else {
+      LCH_TableRemoveRow(table, row);
+      num_deletes += 1;
+    }
+  }
+
+  LCH_TableCompact(table);
+
+  for (size_t i = 0; i < num_deletes; i++) {
+    if (!AppendRecord(params, table, state, *next_id)) {
+      return false;
+    }
+    *next_id += 1;
+  }
+
+  return true;
+}
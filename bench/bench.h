@@ -0,0 +1,93 @@
+#ifndef _LEECH_BENCH_H
+#define _LEECH_BENCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../lib/columnar.h"
+#include "../lib/leech.h"
+
+/**
+ * @brief Parameters of the synthetic tables used by the benchmarks
+ */
+typedef struct {
+  size_t rows;          // Number of records (excluding the header)
+  size_t columns;       // Total number of fields in a record
+  size_t key_width;     // Number of primary fields
+  double change_rate;   // Fraction of the records changed between versions
+  size_t chain_length;  // Number of table versions (i.e., commits)
+  size_t tables;        // Number of tables (only used by bench_merge)
+  uint64_t seed;        // Seed of the pseudo random generator
+} BenchParams;
+
+/**
+ * @brief Parse benchmark parameters
+ * @param params The parameters, initialized with the defaults
+ * @param argc Number of arguments
+ * @param argv Arguments on the form KEY=VALUE (e.g., "rows=1000"). Unknown keys
+ *             are rejected.
+ * @return False in case of failure
+ */
+bool BenchParseParams(BenchParams *params, int argc, char *argv[]);
+
+/**
+ * @brief Get the current time from a monotonic clock
+ * @return Time in seconds
+ */
+double BenchNow(void);
+
+/**
+ * @brief Print the result of a benchmark as a JSON object on a single line
+ * @param params The parameters of the benchmark
+ * @param benchmark The name of the benchmark
+ * @param iterations Number of operations measured
+ * @param bytes Number of bytes processed or produced, or zero if not
+ *              applicable
+ * @param seconds Total time spent on the operations
+ */
+void BenchReport(const BenchParams *params, const char *benchmark,
+                 size_t iterations, size_t bytes, double seconds);
+
+/**
+ * @brief Get the names of the primary fields of the synthetic table
+ * @param params The parameters of the table
+ * @return List of buffers or NULL in case of failure
+ */
+LCH_List *BenchPrimaryFields(const BenchParams *params);
+
+/**
+ * @brief Get the names of the subsidiary fields of the synthetic table
+ * @param params The parameters of the table
+ * @return List of buffers or NULL in case of failure
+ */
+LCH_List *BenchSubsidiaryFields(const BenchParams *params);
+
+/**
+ * @brief Generate the first version of a synthetic table
+ * @param params The parameters of the table
+ * @param state State of the pseudo random generator
+ * @param next_id Identifier of the next record to be inserted
+ * @return The table including a header or NULL in case of failure
+ * @note The first key_width fields are the primary fields. Their values are
+ *       derived from the record identifier, hence they never collide.
+ */
+LCH_Table *BenchGenerateTable(const BenchParams *params, uint64_t *state,
+                              size_t *next_id);
+
+/**
+ * @brief Generate the next version of a synthetic table
+ * @param params The parameters of the table
+ * @param table The table to modify
+ * @param state State of the pseudo random generator
+ * @param next_id Identifier of the next record to be inserted
+ * @return False in case of failure
+ * @note Each record is changed with a probability equal to the change rate.
+ *       Eight out of ten changes update a subsidiary field, the rest delete
+ *       the record. Every delete is matched by an insert, so the number of
+ *       records stays the same.
+ */
+bool BenchMutateTable(const BenchParams *params, LCH_Table *table,
+                      uint64_t *state, size_t *next_id);
+
+#endif  // _LEECH_BENCH_H
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../lib/buffer.h"
+#include "../lib/csv.h"
+#include "../lib/definitions.h"
+#include "bench.h"
+
+/**
+ * Measures the throughput of the CSV parsers. Usage:
+ *
+ *   bench_csv [SIZE_MIB [LIST_SIZE_MIB]]
+ *
+ * The columnar parser is used by the CSV module and parses the whole input
+ * (1 GiB by default). The row-based parser allocates one buffer per field, and
+ * is hence only run on a prefix of the input (8 MiB by default). Results are
+ * printed as one JSON object per line.
+ */
+
+/**
+ * Generates a table with a mix of short and long, unquoted and quoted fields.
+ */
+static LCH_Buffer *GenerateTable(const size_t size) {
+  LCH_Buffer *const csv = LCH_BufferCreate();
+  if (csv == NULL) {
+    return NULL;
+  }
+
+  if (!LCH_BufferPrintFormat(
+          csv, "id,firstname,lastname,born,city,email,address,comment\r\n")) {
+    LCH_BufferDestroy(csv);
+    return NULL;
+  }
+
+  static const char *const names[] = {"Paul", "Ringo", "John", "George"};
+  static const char *const cities[] = {"Liverpool", "London", "Hamburg",
+                                       "New York"};
+  for (size_t i = 0; LCH_BufferLength(csv) < size; i++) {
+    const char *const name = names[i % LCH_LENGTH(names)];
+    const char *const city = cities[(i / 7) % LCH_LENGTH(cities)];
+    if (!LCH_BufferPrintFormat(
+            csv,
+            "%zu,%s,Surname%zu,%zu,%s,%s.%zu@example.com,"
+            "\"%zu Penny Lane, %s\",%s\r\n",
+            i, name, i % 1000, 1940 + (i % 60), city, name, i, i % 100, city,
+            (i % 10 == 0) ? "\"He said \"\"hello\"\"\"" : "nothing to add")) {
+      LCH_BufferDestroy(csv);
+      return NULL;
+    }
+  }
+
+  return csv;
+}
+
+static void PrintResult(const char *const parser, const size_t bytes,
+                        const size_t rows, const double seconds) {
+  printf(
+      "{\"benchmark\": \"csv_parse\", \"parser\": \"%s\", \"bytes\": %zu, "
+      "\"rows\": %zu, \"seconds\": %.6f, \"mib_per_second\": %.2f}\n",
+      parser, bytes, rows, seconds,
+      ((double)bytes / (1024.0 * 1024.0)) / seconds);
+  fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+  const size_t size =
+      (size_t)((argc > 1) ? strtoull(argv[1], NULL, 10) : 1024) * 1024 * 1024;
+  const size_t list_size =
+      (size_t)((argc > 2) ? strtoull(argv[2], NULL, 10) : 8) * 1024 * 1024;
+
+  LCH_Buffer *const csv = GenerateTable(size);
+  if (csv == NULL) {
+    return EXIT_FAILURE;
+  }
+  const char *const data = LCH_BufferData(csv);
+  const size_t length = LCH_BufferLength(csv);
+
+  {
+    const double start = BenchNow();
+    LCH_Table *const table = LCH_CSVParseTableColumnar(data, length);
+    const double seconds = BenchNow() - start;
+    if (table == NULL) {
+      LCH_BufferDestroy(csv);
+      return EXIT_FAILURE;
+    }
+    PrintResult("columnar", length, LCH_TableGetNumRows(table), seconds);
+    LCH_TableDestroy(table);
+  }
+
+  /* Cut the prefix at the end of a record */
+  size_t prefix = LCH_MIN(list_size, length);
+  while (prefix < length && data[prefix - 1] != '\n') {
+    prefix -= 1;
+  }
+
+  {
+    const double start = BenchNow();
+    LCH_List *const table = LCH_CSVParseTable(data, prefix);
+    const double seconds = BenchNow() - start;
+    if (table == NULL) {
+      LCH_BufferDestroy(csv);
+      return EXIT_FAILURE;
+    }
+    PrintResult("list", prefix, LCH_ListLength(table), seconds);
+    LCH_ListDestroy(table);
+  }
+
+  LCH_BufferDestroy(csv);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,204 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../lib/csv.h"
+#include "../lib/files.h"
+#include "bench.h"
+
+/**
+ * Measures the main interface on synthetic tables using the CSV module.
+ * Usage:
+ *
+ *   bench_e2e MODULE [KEY=VALUE ...]
+ *
+ * MODULE is the path to the CSV module (i.e., leech_csv.so). See
+ * BenchParseParams() for the parameters. A commit is made for each version of
+ * the table in a temporary working directory. The resulting chain is then
+ * diffed from the genesis block, patched into the destination table, queried
+ * for the history of a record, and purged. Results are printed as one JSON
+ * object per line.
+ */
+
+static bool WriteConfig(const BenchParams *const params,
+                        const char *const work_dir, const char *const module) {
+  LCH_Buffer *const config = LCH_BufferCreate();
+  if (config == NULL) {
+    return false;
+  }
+
+  /* Purge half of the chain */
+  const size_t preferred_chain_length =
+      (params->chain_length > 1) ? params->chain_length / 2 : 1;
+  bool success = LCH_BufferPrintFormat(
+      config,
+      "{\"version\": \"" PACKAGE_VERSION "\", \"chain_length\": %zu, "
+      "\"tables\": {\"BCH\": {\"primary_fields\": [",
+      preferred_chain_length);
+  for (size_t i = 0; success && i < params->columns; i++) {
+    if (i == params->key_width) {
+      success = LCH_BufferPrintFormat(config, "], \"subsidiary_fields\": [");
+    }
+    if (success) {
+      success = LCH_BufferPrintFormat(
+          config, "%s\"field%zu\"",
+          (i == 0 || i == params->key_width) ? "" : ", ", i);
+    }
+  }
+  if (success) {
+    success = LCH_BufferPrintFormat(
+        config,
+        "], "
+        "\"source\": {\"params\": \"%s/src.csv\", \"schema\": \"bench\", "
+        "\"table_name\": \"src\", \"callbacks\": \"%s\"}, "
+        "\"destination\": {\"params\": \"%s/dst.csv\", \"schema\": \"bench\", "
+        "\"table_name\": \"dst\", \"callbacks\": \"%s\"}}}}",
+        work_dir, module, work_dir, module);
+  }
+
+  char path[PATH_MAX];
+  if (success) {
+    success = LCH_FilePathJoin(path, sizeof(path), 2, work_dir, "leech.json") &&
+              LCH_BufferWriteFile(config, path);
+  }
+
+  LCH_BufferDestroy(config);
+  return success;
+}
+
+static bool BenchCommit(const BenchParams *const params,
+                        const char *const work_dir) {
+  char path[PATH_MAX];
+  if (!LCH_FilePathJoin(path, sizeof(path), 2, work_dir, "src.csv")) {
+    return false;
+  }
+
+  uint64_t state = params->seed;
+  size_t next_id = 0;
+  LCH_Table *const table = BenchGenerateTable(params, &state, &next_id);
+  if (table == NULL) {
+    return false;
+  }
+
+  /* Writing the table is not part of the measurement */
+  double seconds = 0.0;
+  for (size_t i = 0; i < params->chain_length; i++) {
+    if ((i > 0 && !BenchMutateTable(params, table, &state, &next_id)) ||
+        !LCH_CSVComposeFileColumnar(table, path)) {
+      LCH_TableDestroy(table);
+      return false;
+    }
+
+    const double start = BenchNow();
+    if (!LCH_Commit(work_dir)) {
+      LCH_TableDestroy(table);
+      return false;
+    }
+    seconds += BenchNow() - start;
+  }
+  BenchReport(params, "commit", params->chain_length, 0, seconds);
+
+  LCH_TableDestroy(table);
+  return true;
+}
+
+static bool BenchDiffAndPatch(const BenchParams *const params,
+                              const char *const work_dir) {
+  double start = BenchNow();
+  LCH_Buffer *const patch =
+      LCH_Diff(work_dir, "0000000000000000000000000000000000000000");
+  if (patch == NULL) {
+    return false;
+  }
+  const size_t length = LCH_BufferLength(patch);
+  BenchReport(params, "diff", 1, length, BenchNow() - start);
+
+  start = BenchNow();
+  const bool success = LCH_Patch(work_dir, "host_id", "SHA=bench",
+                                 LCH_BufferData(patch), length);
+  if (success) {
+    BenchReport(params, "patch", 1, length, BenchNow() - start);
+  }
+
+  LCH_BufferDestroy(patch);
+  return success;
+}
+
+static bool BenchHistory(const BenchParams *const params,
+                         const char *const work_dir) {
+  /* The first record of the first version, which is changed in the later
+   * versions with a probability equal to the change rate */
+  LCH_List *const primary = LCH_ListCreate();
+  if (primary == NULL) {
+    return false;
+  }
+  for (size_t i = 0; i < params->key_width; i++) {
+    LCH_Buffer *const value = LCH_BufferCreate();
+    if (value == NULL) {
+      LCH_ListDestroy(primary);
+      return false;
+    }
+    if (!LCH_BufferPrintFormat(value, "key0-%zu", i) ||
+        !LCH_ListAppend(primary, value, LCH_BufferDestroy)) {
+      LCH_BufferDestroy(value);
+      LCH_ListDestroy(primary);
+      return false;
+    }
+  }
+
+  const double start = BenchNow();
+  LCH_Buffer *const history =
+      LCH_History(work_dir, "BCH", primary, 0.0, (double)time(NULL));
+  const double seconds = BenchNow() - start;
+  LCH_ListDestroy(primary);
+  if (history == NULL) {
+    return false;
+  }
+  BenchReport(params, "history", 1, 0, seconds);
+
+  LCH_BufferDestroy(history);
+  return true;
+}
+
+static bool BenchPurge(const BenchParams *const params,
+                       const char *const work_dir) {
+  const double start = BenchNow();
+  if (!LCH_Purge(work_dir)) {
+    return false;
+  }
+  BenchReport(params, "purge", 1, 0, BenchNow() - start);
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s MODULE [KEY=VALUE ...]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  const char *const module = argv[1];
+
+  BenchParams params;
+  if (!BenchParseParams(&params, argc - 2, argv + 2)) {
+    return EXIT_FAILURE;
+  }
+
+  /* Keep informational messages out of the results */
+  LCH_LoggerSeveritySet(LCH_LOGGER_MESSAGE_TYPE_WARNING_BIT |
+                        LCH_LOGGER_MESSAGE_TYPE_ERROR_BIT);
+
+  char work_dir[] = "/tmp/leech-bench-XXXXXX";
+  if (mkdtemp(work_dir) == NULL) {
+    perror("mkdtemp(3)");
+    return EXIT_FAILURE;
+  }
+
+  const bool success = WriteConfig(&params, work_dir, module) &&
+                       BenchCommit(&params, work_dir) &&
+                       BenchDiffAndPatch(&params, work_dir) &&
+                       BenchHistory(&params, work_dir) &&
+                       BenchPurge(&params, work_dir);
+
+  LCH_FileDelete(work_dir);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,238 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../lib/block.h"
+#include "../lib/delta.h"
+#include "../lib/files.h"
+#include "../lib/head.h"
+#include "../lib/instance.h"
+#include "../lib/json.h"
+#include "../lib/utils.h"
+#include "bench.h"
+
+/**
+ * Measures merging of blocks with deltas for many tables during a diff.
+ * Usage:
+ *
+ *   bench_merge [KEY=VALUE ...]
+ *
+ * See BenchParseParams() for the parameters. A chain of blocks, each with a
+ * delta for every table, is stored in a temporary working directory and then
+ * diffed from the genesis block. The blocks are composed directly from the
+ * synthetic tables, as the table modules are not needed for a diff. Results
+ * are printed as one JSON object per line.
+ */
+
+static bool WriteConfig(const BenchParams *const params,
+                        const char *const work_dir) {
+  LCH_Buffer *const config = LCH_BufferCreate();
+  if (config == NULL) {
+    return false;
+  }
+
+  bool success = LCH_BufferPrintFormat(
+      config, "{\"version\": \"" PACKAGE_VERSION "\", \"tables\": {");
+  for (size_t i = 0; success && i < params->tables; i++) {
+    success = LCH_BufferPrintFormat(config, "%s\"BCH%zu\": {",
+                                    (i > 0) ? ", " : "", i);
+    for (size_t j = 0; success && j < params->columns; j++) {
+      if (j == 0) {
+        success = LCH_BufferPrintFormat(config, "\"primary_fields\": [");
+      } else if (j == params->key_width) {
+        success = LCH_BufferPrintFormat(config, "], \"subsidiary_fields\": [");
+      }
+      if (success) {
+        success = LCH_BufferPrintFormat(
+            config, "%s\"field%zu\"",
+            (j == 0 || j == params->key_width) ? "" : ", ", j);
+      }
+    }
+    /* The modules are never loaded, hence they need not exist */
+    if (success) {
+      success = LCH_BufferPrintFormat(
+          config,
+          "], "
+          "\"source\": {\"params\": \"src%zu.csv\", \"schema\": \"bench\", "
+          "\"table_name\": \"src%zu\", \"callbacks\": \"leech_csv.so\"}, "
+          "\"destination\": {\"params\": \"dst%zu.csv\", \"schema\": "
+          "\"bench\", \"table_name\": \"dst%zu\", \"callbacks\": "
+          "\"leech_csv.so\"}}",
+          i, i, i, i);
+    }
+  }
+  if (success) {
+    success = LCH_BufferPrintFormat(config, "}}");
+  }
+
+  char path[PATH_MAX];
+  if (success) {
+    success = LCH_FilePathJoin(path, sizeof(path), 2, work_dir, "leech.json") &&
+              LCH_BufferWriteFile(config, path);
+  }
+
+  LCH_BufferDestroy(config);
+  return success;
+}
+
+/**
+ * Compose the next block from the next version of each table, and store it at
+ * the head of the chain.
+ */
+static bool StoreBlock(const BenchParams *const params,
+                       const LCH_Instance *const instance,
+                       LCH_Table *const *const tables, LCH_Json **const states,
+                       const LCH_List *const primary_fields,
+                       const LCH_List *const subsidiary_fields,
+                       uint64_t *const state, size_t *const next_id) {
+  LCH_Json *const payload = LCH_JsonArrayCreate();
+  if (payload == NULL) {
+    return false;
+  }
+
+  for (size_t i = 0; i < params->tables; i++) {
+    if (!BenchMutateTable(params, tables[i], state, next_id)) {
+      LCH_JsonDestroy(payload);
+      return false;
+    }
+
+    LCH_Json *const new_state =
+        LCH_TableToJsonObject(tables[i], primary_fields, subsidiary_fields);
+    if (new_state == NULL) {
+      LCH_JsonDestroy(payload);
+      return false;
+    }
+
+    char table_id[32];
+    snprintf(table_id, sizeof(table_id), "BCH%zu", i);
+    LCH_Json *const delta =
+        LCH_DeltaCreate(table_id, "delta", new_state, states[i]);
+    LCH_JsonDestroy(states[i]);
+    states[i] = new_state;
+    if (delta == NULL) {
+      LCH_JsonDestroy(payload);
+      return false;
+    }
+
+    if (!LCH_JsonArrayAppend(payload, delta)) {
+      LCH_JsonDestroy(delta);
+      LCH_JsonDestroy(payload);
+      return false;
+    }
+  }
+
+  const char *const work_dir = LCH_InstanceGetWorkDirectory(instance);
+  char *const parent_id = LCH_HeadGet("HEAD", work_dir);
+  if (parent_id == NULL) {
+    LCH_JsonDestroy(payload);
+    return false;
+  }
+
+  LCH_Json *const block =
+      LCH_BlockCreate(parent_id, payload, LCH_ENCODING_JSON);
+  free(parent_id);
+  if (block == NULL) {
+    LCH_JsonDestroy(payload);
+    return false;
+  }
+
+  const bool success = LCH_BlockStore(instance, block);
+  LCH_JsonDestroy(block);
+  return success;
+}
+
+static bool StoreChain(const BenchParams *const params,
+                       const char *const work_dir) {
+  LCH_Instance *const instance = LCH_InstanceLoad(work_dir);
+  if (instance == NULL) {
+    return false;
+  }
+
+  LCH_List *const primary_fields = BenchPrimaryFields(params);
+  LCH_List *const subsidiary_fields = BenchSubsidiaryFields(params);
+  LCH_Table **const tables =
+      (LCH_Table **)calloc(params->tables, sizeof(LCH_Table *));
+  LCH_Json **const states =
+      (LCH_Json **)calloc(params->tables, sizeof(LCH_Json *));
+
+  bool success = (primary_fields != NULL) && (subsidiary_fields != NULL) &&
+                 (tables != NULL) && (states != NULL);
+
+  uint64_t state = params->seed;
+  size_t next_id = 0;
+  for (size_t i = 0; success && i < params->tables; i++) {
+    tables[i] = BenchGenerateTable(params, &state, &next_id);
+    success = (tables[i] != NULL);
+    if (success) {
+      states[i] =
+          LCH_TableToJsonObject(tables[i], primary_fields, subsidiary_fields);
+      success = (states[i] != NULL);
+    }
+  }
+
+  for (size_t i = 0; success && i < params->chain_length; i++) {
+    success = StoreBlock(params, instance, tables, states, primary_fields,
+                         subsidiary_fields, &state, &next_id);
+  }
+
+  for (size_t i = 0; i < params->tables; i++) {
+    if (tables != NULL) {
+      LCH_TableDestroy(tables[i]);
+    }
+    if (states != NULL) {
+      LCH_JsonDestroy(states[i]);
+    }
+  }
+  free(states);
+  free(tables);
+  LCH_ListDestroy(subsidiary_fields);
+  LCH_ListDestroy(primary_fields);
+  LCH_InstanceDestroy(instance);
+  return success;
+}
+
+static bool BenchDiff(const BenchParams *const params,
+                      const char *const work_dir) {
+  LCH_MetricsReset();
+  const double start = BenchNow();
+  LCH_Buffer *const patch =
+      LCH_Diff(work_dir, "0000000000000000000000000000000000000000");
+  const double seconds = BenchNow() - start;
+  if (patch == NULL) {
+    return false;
+  }
+  const size_t length = LCH_BufferLength(patch);
+  LCH_BufferDestroy(patch);
+  BenchReport(params, "diff", params->chain_length, length, seconds);
+
+  /* Time spent merging the deltas of each table, excluding the lookups */
+  LCH_Metrics metrics;
+  LCH_MetricsGet(&metrics);
+  BenchReport(params, "merge", (params->chain_length - 1) * params->tables,
+              0, metrics.seconds[LCH_METRICS_PHASE_MERGE]);
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  BenchParams params;
+  if (!BenchParseParams(&params, argc - 1, argv + 1)) {
+    return EXIT_FAILURE;
+  }
+
+  /* Keep informational messages out of the results */
+  LCH_LoggerSeveritySet(LCH_LOGGER_MESSAGE_TYPE_WARNING_BIT |
+                        LCH_LOGGER_MESSAGE_TYPE_ERROR_BIT);
+
+  char work_dir[] = "/tmp/leech-bench-XXXXXX";
+  if (mkdtemp(work_dir) == NULL) {
+    perror("mkdtemp(3)");
+    return EXIT_FAILURE;
+  }
+
+  const bool success = WriteConfig(&params, work_dir) &&
+                       StoreChain(&params, work_dir) &&
+                       BenchDiff(&params, work_dir);
+
+  LCH_FileDelete(work_dir);
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,221 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../lib/csv.h"
+#include "../lib/delta.h"
+#include "../lib/dict.h"
+#include "../lib/json.h"
+#include "../lib/utils.h"
+#include "bench.h"
+
+/**
+ * Measures the building blocks of a commit and a diff on synthetic tables.
+ * Usage:
+ *
+ *   bench_micro [KEY=VALUE ...]
+ *
+ * See BenchParseParams() for the parameters. Results are printed as one JSON
+ * object per line.
+ */
+
+static bool BenchDict(const BenchParams *const params,
+                      const LCH_Table *const table) {
+  const size_t num_rows = LCH_TableGetNumRows(table);
+
+  /* Use the first primary field of each record as key */
+  LCH_Buffer *const keys = (LCH_Buffer *)malloc(num_rows * sizeof(LCH_Buffer));
+  if (keys == NULL) {
+    return false;
+  }
+  for (size_t i = 0; i < num_rows; i++) {
+    keys[i] = LCH_BufferStaticFromString(LCH_TableGetField(table, i, 0, NULL));
+  }
+
+  LCH_Dict *const dict = LCH_DictCreate();
+  if (dict == NULL) {
+    free(keys);
+    return false;
+  }
+
+  double start = BenchNow();
+  for (size_t i = 0; i < num_rows; i++) {
+    if (!LCH_DictSet(dict, &keys[i], &keys[i], NULL)) {
+      LCH_DictDestroy(dict);
+      free(keys);
+      return false;
+    }
+  }
+  BenchReport(params, "dict_set", num_rows, 0, BenchNow() - start);
+
+  start = BenchNow();
+  for (size_t i = 0; i < num_rows; i++) {
+    if (LCH_DictGet(dict, &keys[i]) != &keys[i]) {
+      LCH_DictDestroy(dict);
+      free(keys);
+      return false;
+    }
+  }
+  BenchReport(params, "dict_get", num_rows, 0, BenchNow() - start);
+
+  LCH_DictDestroy(dict);
+  free(keys);
+  return true;
+}
+
+static bool BenchJson(const BenchParams *const params,
+                      const LCH_Json *const state) {
+  double start = BenchNow();
+  LCH_Buffer *const json = LCH_JsonCompose(state, false);
+  if (json == NULL) {
+    return false;
+  }
+  const size_t length = LCH_BufferLength(json);
+  BenchReport(params, "json_compose", 1, length, BenchNow() - start);
+
+  start = BenchNow();
+  LCH_Json *const parsed = LCH_JsonParse(LCH_BufferData(json), length);
+  BenchReport(params, "json_parse", 1, length, BenchNow() - start);
+  LCH_BufferDestroy(json);
+  if (parsed == NULL) {
+    return false;
+  }
+
+  LCH_JsonDestroy(parsed);
+  return true;
+}
+
+static bool BenchCSV(const BenchParams *const params,
+                     const LCH_Table *const table) {
+  LCH_Buffer *csv = NULL;
+  double start = BenchNow();
+  if (!LCH_CSVComposeTableColumnar(&csv, table)) {
+    return false;
+  }
+  const char *const data = LCH_BufferData(csv);
+  const size_t length = LCH_BufferLength(csv);
+  BenchReport(params, "csv_compose", 1, length, BenchNow() - start);
+
+  start = BenchNow();
+  LCH_List *const list = LCH_CSVParseTable(data, length);
+  BenchReport(params, "csv_parse", 1, length, BenchNow() - start);
+  if (list == NULL) {
+    LCH_BufferDestroy(csv);
+    return false;
+  }
+  LCH_ListDestroy(list);
+
+  start = BenchNow();
+  LCH_Table *const columnar = LCH_CSVParseTableColumnar(data, length);
+  BenchReport(params, "csv_parse_columnar", 1, length, BenchNow() - start);
+  if (columnar == NULL) {
+    LCH_BufferDestroy(csv);
+    return false;
+  }
+  LCH_TableDestroy(columnar);
+
+  LCH_Buffer *const digest = LCH_BufferCreate();
+  if (digest == NULL) {
+    LCH_BufferDestroy(csv);
+    return false;
+  }
+  start = BenchNow();
+  const bool success =
+      LCH_MessageDigest((const unsigned char *)data, length, digest);
+  BenchReport(params, "sha1", 1, length, BenchNow() - start);
+  LCH_BufferDestroy(digest);
+  LCH_BufferDestroy(csv);
+
+  return success;
+}
+
+static bool BenchDelta(const BenchParams *const params,
+                       LCH_Json *const *const states) {
+  const size_t num_deltas = params->chain_length;
+  LCH_Json **const deltas =
+      (LCH_Json **)calloc(num_deltas, sizeof(LCH_Json *));
+  if (deltas == NULL) {
+    return false;
+  }
+
+  double start = BenchNow();
+  for (size_t i = 0; i < num_deltas; i++) {
+    deltas[i] = LCH_DeltaCreate("bench", "delta", states[i + 1], states[i]);
+    if (deltas[i] == NULL) {
+      for (size_t j = 0; j < i; j++) {
+        LCH_JsonDestroy(deltas[j]);
+      }
+      free(deltas);
+      return false;
+    }
+  }
+  BenchReport(params, "delta_create", num_deltas, 0, BenchNow() - start);
+
+  /* Merge the way LCH_Diff does; starting with the most recent delta and
+   * merging each child into its parent */
+  bool success = true;
+  start = BenchNow();
+  for (size_t i = num_deltas - 1; i > 0; i--) {
+    if (!LCH_DeltaMerge(deltas[i - 1], deltas[i])) {
+      success = false;
+      break;
+    }
+  }
+  if (success) {
+    BenchReport(params, "delta_merge", num_deltas - 1, 0, BenchNow() - start);
+  }
+
+  for (size_t i = 0; i < num_deltas; i++) {
+    LCH_JsonDestroy(deltas[i]);
+  }
+  free(deltas);
+  return success;
+}
+
+int main(int argc, char *argv[]) {
+  BenchParams params;
+  if (!BenchParseParams(&params, argc - 1, argv + 1)) {
+    return EXIT_FAILURE;
+  }
+
+  LCH_List *const primary_fields = BenchPrimaryFields(&params);
+  LCH_List *const subsidiary_fields = BenchSubsidiaryFields(&params);
+  LCH_Json **const states =
+      (LCH_Json **)calloc(params.chain_length + 1, sizeof(LCH_Json *));
+  uint64_t state = params.seed;
+  size_t next_id = 0;
+  LCH_Table *const table = BenchGenerateTable(&params, &state, &next_id);
+
+  bool success = (primary_fields != NULL) && (subsidiary_fields != NULL) &&
+                 (states != NULL) && (table != NULL);
+  if (success) {
+    success = BenchDict(&params, table) && BenchCSV(&params, table);
+  }
+
+  /* Table states of each version, as they would be loaded during a commit */
+  for (size_t i = 0; success && i <= params.chain_length; i++) {
+    if (i > 0) {
+      success = BenchMutateTable(&params, table, &state, &next_id);
+    }
+    if (success) {
+      states[i] =
+          LCH_TableToJsonObject(table, primary_fields, subsidiary_fields);
+      success = (states[i] != NULL);
+    }
+  }
+
+  if (success) {
+    success = BenchJson(&params, states[0]) && BenchDelta(&params, states);
+  }
+
+  LCH_TableDestroy(table);
+  if (states != NULL) {
+    for (size_t i = 0; i <= params.chain_length; i++) {
+      LCH_JsonDestroy(states[i]);
+    }
+    free(states);
+  }
+  LCH_ListDestroy(subsidiary_fields);
+  LCH_ListDestroy(primary_fields);
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
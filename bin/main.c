@@ -11,19 +11,27 @@
 #include "common.h"
 #include "diff.h"
 #include "history.h"
+#include "migrate.h"
 #include "patch.h"
 #include "purge.h"
 #include "rebase.h"
+#include "serve.h"
 
 #ifdef HAVE_LIBPQ
 #include "libpq-fe.h"
 #endif  // HAVE_LIBPQ
 
+/* Number of messages kept for --debug-on-error */
+#define DEBUG_ON_ERROR_CAPACITY 256
+
 enum OPTION_VALUE {
   OPTION_WORKDIR = 1,
   OPTION_INFORM,
   OPTION_VERBOSE,
   OPTION_DEBUG,
+  OPTION_DEBUG_ON_ERROR,
+  OPTION_STATS,
+  OPTION_STATS_JSON,
   OPTION_VERSION,
   OPTION_HELP,
 };
@@ -39,14 +47,24 @@ static const struct option OPTIONS[] = {
     {"inform", no_argument, NULL, OPTION_INFORM},
     {"verbose", no_argument, NULL, OPTION_VERBOSE},
     {"debug", no_argument, NULL, OPTION_DEBUG},
+    {"debug-on-error", no_argument, NULL, OPTION_DEBUG_ON_ERROR},
+    {"stats", no_argument, NULL, OPTION_STATS},
+    {"stats-json", no_argument, NULL, OPTION_STATS_JSON},
     {"version", no_argument, NULL, OPTION_VERSION},
     {"help", no_argument, NULL, OPTION_HELP},
     {NULL, 0, NULL, 0},
 };
 
 static const char *const DESCRIPTIONS[] = {
-    "set work directory",    "enable info messages", "enable verbose messages",
-    "enable debug messages", "print version string", "print help message",
+    "set work directory",
+    "enable info messages",
+    "enable verbose messages",
+    "enable debug messages",
+    "print recent debug messages when an error occurs",
+    "print timings and counters to stderr",
+    "print timings and counters to stderr as JSON",
+    "print version string",
+    "print help message",
 };
 
 static const struct command COMMANDS[] = {
@@ -56,6 +74,8 @@ static const struct command COMMANDS[] = {
     {"patch", "apply changes to tables", Patch},
     {"history", "get history of a specific record", History},
     {"purge", "delete old/unreachable blocks", Purge},
+    {"migrate", "move blocks to the configured storage", Migrate},
+    {"serve", "serve requests over a unix socket", Serve},
     {NULL, NULL, NULL},
 };
 
@@ -87,11 +107,54 @@ static void PrintHelp(void) {
   printf("\n");
 }
 
+static void PrintStats(const bool json) {
+  LCH_Metrics metrics;
+  LCH_MetricsGet(&metrics);
+
+  const char *const names[] = {
+      "bytes_read",  "bytes_written", "rows_loaded",
+      "rows_patched", "allocations",   "statements",
+  };
+  const size_t counters[] = {
+      metrics.bytes_read,   metrics.bytes_written, metrics.rows_loaded,
+      metrics.rows_patched, metrics.allocations,   metrics.statements,
+  };
+  const size_t num_counters = sizeof(counters) / sizeof(counters[0]);
+
+  if (json) {
+    fprintf(stderr, "{\"seconds\": {");
+    for (int i = 0; i < LCH_METRICS_NUM_PHASES; i++) {
+      fprintf(stderr, "%s\"%s\": %.6f", (i > 0) ? ", " : "",
+              LCH_MetricsPhaseToString((LCH_MetricsPhase)i),
+              metrics.seconds[i]);
+    }
+    fprintf(stderr, "}");
+    for (size_t i = 0; i < num_counters; i++) {
+      fprintf(stderr, ", \"%s\": %zu", names[i], counters[i]);
+    }
+    fprintf(stderr, "}\n");
+    return;
+  }
+
+  fprintf(stderr, "timings:\n");
+  for (int i = 0; i < LCH_METRICS_NUM_PHASES; i++) {
+    fprintf(stderr, "  %-16s %.6fs\n",
+            LCH_MetricsPhaseToString((LCH_MetricsPhase)i), metrics.seconds[i]);
+  }
+  fprintf(stderr, "counters:\n");
+  for (size_t i = 0; i < num_counters; i++) {
+    fprintf(stderr, "  %-16s %zu\n", names[i], counters[i]);
+  }
+}
+
 int main(int argc, char *argv[]) {
   unsigned char severity =
       LCH_LOGGER_MESSAGE_TYPE_ERROR_BIT | LCH_LOGGER_MESSAGE_TYPE_WARNING_BIT;
 
   const char *work_dir = ".leech";
+  bool debug_on_error = false;
+  bool stats = false;
+  bool stats_json = false;
 
   /**
    * For some reason, if we don't reference something from libpq, we get
@@ -119,6 +182,15 @@ int main(int argc, char *argv[]) {
       case OPTION_INFORM:
         severity |= LCH_LOGGER_MESSAGE_TYPE_INFO_BIT;
         break;
+      case OPTION_DEBUG_ON_ERROR:
+        debug_on_error = true;
+        break;
+      case OPTION_STATS:
+        stats = true;
+        break;
+      case OPTION_STATS_JSON:
+        stats_json = true;
+        break;
       case OPTION_VERSION:
         PrintVersion();
         return EXIT_SUCCESS;
@@ -132,6 +204,13 @@ int main(int argc, char *argv[]) {
   }
 
   LCH_LoggerSeveritySet(severity);
+  if (debug_on_error &&
+      !LCH_LoggerRingBufferSet(DEBUG_ON_ERROR_CAPACITY,
+                               LCH_LOGGER_MESSAGE_TYPE_DEBUG_BIT |
+                                   LCH_LOGGER_MESSAGE_TYPE_VERBOSE_BIT |
+                                   LCH_LOGGER_MESSAGE_TYPE_INFO_BIT)) {
+    return EXIT_FAILURE;
+  }
 
   if (optind >= argc) {
     fprintf(stderr, "Missing command ...");
@@ -141,7 +220,12 @@ int main(int argc, char *argv[]) {
   for (int i = 0; COMMANDS[i].name != NULL; i++) {
     if (strcmp(argv[optind], COMMANDS[i].name) == 0) {
       optind += 1;
-      return COMMANDS[i].command(work_dir, argc, argv);
+      const int ret = COMMANDS[i].command(work_dir, argc, argv);
+      if (stats || stats_json) {
+        PrintStats(stats_json);
+      }
+      LCH_LoggerRingBufferSet(0, 0);
+      return ret;
     }
   }
   return EXIT_FAILURE;
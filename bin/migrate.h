@@ -0,0 +1,6 @@
+#ifndef _LEECH_MIGRATE_H
+#define _LEECH_MIGRATE_H
+
+int Migrate(const char *work_dir, int argc, char *argv[]);
+
+#endif  // _LEECH_MIGRATE_H
@@ -81,16 +81,11 @@ int Patch(const char *const work_dir, int argc, char *argv[]) {
     return EXIT_FAILURE;
   }
 
-  LCH_Buffer *const buffer = LCH_BufferCreate();
+  LCH_Buffer *const buffer = LCH_BufferMapFile(patch_file);
   if (buffer == NULL) {
     return EXIT_FAILURE;
   }
 
-  if (!LCH_BufferReadFile(buffer, patch_file)) {
-    LCH_BufferDestroy(buffer);
-    return EXIT_FAILURE;
-  }
-
   const char *const data = LCH_BufferData(buffer);
   const size_t length = LCH_BufferLength(buffer);
   LCH_LOG_DEBUG("Loaded patch file '%s' %zu Bytes.", patch_file, length);
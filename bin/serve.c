@@ -0,0 +1,536 @@
+#include "serve.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../lib/csv.h"
+#include "../lib/files.h"
+#include "../lib/logger.h"
+#include "common.h"
+
+/**
+ * Serves requests over a Unix domain socket, using a session such that the
+ * instance, the table modules and the table snapshots stay loaded between
+ * requests. Each connection carries a single request. The client sends a
+ * request line, optionally followed by a payload, and then shuts down the
+ * writing side of the connection:
+ *
+ *   commit
+ *   diff [BLOCK]                  (the block defaults to the genesis block)
+ *   patch FIELD VALUE             followed by the patch
+ *   history TABLE [FROM [TO]]     followed by the primary fields as CSV
+ *   histories TABLE [FROM [TO]]   followed by the primary fields of each
+ *                                 record as a CSV line
+ *   purge
+ *
+ * The server responds with "OK\n" followed by the result (i.e., the patch of
+ * a diff, or the histories), or "ERROR\n", and closes the connection.
+ */
+
+#define MAX_ARGUMENTS 4
+#define IDLE_TIMEOUT_MS 100
+#define REQUEST_TIMEOUT_MS 5000
+
+enum OPTION_VALUE {
+  OPTION_SOCKET = 1,
+  OPTION_HELP,
+};
+
+static const struct option OPTIONS[] = {
+    {"socket", required_argument, NULL, OPTION_SOCKET},
+    {"help", no_argument, NULL, OPTION_HELP},
+    {NULL, 0, NULL, 0},
+};
+
+static const char *const DESCRIPTIONS[] = {
+    "socket path (default WORKDIR/leech.sock)",
+    "print help message",
+};
+
+static volatile sig_atomic_t STOP = 0;
+
+static void PrintHelp(void) {
+  PrintVersion();
+  printf("\n");
+  PrintOptions(OPTIONS, DESCRIPTIONS);
+  printf("\n");
+  PrintBugreport();
+  printf("\n");
+}
+
+static void HandleSignal(int signum) {
+  (void)signum;
+  STOP = 1;
+}
+
+static long long MonotonicMilliseconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((long long)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+/**
+ * Read the request until the client shuts down the writing side of the
+ * connection. Requests are handled one at a time, hence a client that does
+ * not finish its request within REQUEST_TIMEOUT_MS is dropped rather than
+ * holding up everyone else.
+ */
+static LCH_Buffer *ReadRequest(const int fd) {
+  LCH_Buffer *const request = LCH_BufferCreate();
+  if (request == NULL) {
+    return NULL;
+  }
+
+  const long long deadline = MonotonicMilliseconds() + REQUEST_TIMEOUT_MS;
+  char buffer[BUFSIZ];
+  while (true) {
+    const long long remaining = deadline - MonotonicMilliseconds();
+    if (remaining <= 0) {
+      LCH_LOG_ERROR("Timed out reading request after %d ms",
+                    REQUEST_TIMEOUT_MS);
+      LCH_BufferDestroy(request);
+      return NULL;
+    }
+
+    struct pollfd pfd = {.fd = fd, .events = POLLIN, .revents = 0};
+    const int ret = poll(&pfd, 1, (int)remaining);
+    if (ret == 0 || (ret < 0 && errno == EINTR && !STOP)) {
+      continue;
+    }
+    if (ret < 0) {
+      LCH_LOG_ERROR("Failed to poll connection: %s", strerror(errno));
+      LCH_BufferDestroy(request);
+      return NULL;
+    }
+
+    const ssize_t n_read = read(fd, buffer, sizeof(buffer));
+    if (n_read == 0) {
+      break;
+    }
+    if (n_read < 0) {
+      if (errno == EINTR && !STOP) {
+        continue;
+      }
+      LCH_LOG_ERROR("Failed to read request: %s", strerror(errno));
+      LCH_BufferDestroy(request);
+      return NULL;
+    }
+    if (!LCH_BufferAppendBytes(request, buffer, (size_t)n_read)) {
+      LCH_BufferDestroy(request);
+      return NULL;
+    }
+  }
+
+  return request;
+}
+
+static bool WriteResponse(const int fd, const char *data, size_t length) {
+  while (length > 0) {
+    const ssize_t n_written = write(fd, data, length);
+    if (n_written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LCH_LOG_ERROR("Failed to write response: %s", strerror(errno));
+      return false;
+    }
+    data += n_written;
+    length -= (size_t)n_written;
+  }
+  return true;
+}
+
+static bool ParseTimestamp(const char *const str, double *const timestamp) {
+  char *end;
+  *timestamp = strtod(str, &end);
+  if (end == str || *end != '\0') {
+    LCH_LOG_ERROR("Failed to parse timestamp '%s'", str);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Parse the table identifier and the optional time range of a history request.
+ */
+static bool ParseHistoryArguments(const char *const *const args,
+                                  const size_t n_args, double *const from,
+                                  double *const to) {
+  if (n_args < 2) {
+    LCH_LOG_ERROR("Missing table identifier in %s request", args[0]);
+    return false;
+  }
+
+  *from = 0.0;
+  *to = (double)time(NULL);
+  if ((n_args > 2 && !ParseTimestamp(args[2], from)) ||
+      (n_args > 3 && !ParseTimestamp(args[3], to))) {
+    return false;
+  }
+  return true;
+}
+
+static LCH_Buffer *HandleHistory(LCH_Session *const session,
+                                 const char *const *const args,
+                                 const size_t n_args, const char *const payload,
+                                 const size_t payload_size) {
+  double from, to;
+  if (!ParseHistoryArguments(args, n_args, &from, &to)) {
+    return NULL;
+  }
+
+  /* Ignore the line ending after the record, if any */
+  size_t record_size = payload_size;
+  while (record_size > 0 && (payload[record_size - 1] == '\n' ||
+                             payload[record_size - 1] == '\r')) {
+    record_size -= 1;
+  }
+
+  LCH_List *const primary_fields = LCH_CSVParseRecord(payload, record_size);
+  if (primary_fields == NULL) {
+    return NULL;
+  }
+
+  LCH_Buffer *const history =
+      LCH_SessionHistory(session, args[1], primary_fields, from, to);
+  LCH_ListDestroy(primary_fields);
+  return history;
+}
+
+static LCH_Buffer *HandleHistories(LCH_Session *const session,
+                                   const char *const *const args,
+                                   const size_t n_args,
+                                   const char *const payload,
+                                   const size_t payload_size) {
+  double from, to;
+  if (!ParseHistoryArguments(args, n_args, &from, &to)) {
+    return NULL;
+  }
+
+  LCH_List *const primary_records = LCH_CSVParseTable(payload, payload_size);
+  if (primary_records == NULL) {
+    return NULL;
+  }
+
+  LCH_Buffer *const histories =
+      LCH_SessionHistoryMany(session, args[1], primary_records, from, to);
+  LCH_ListDestroy(primary_records);
+  return histories;
+}
+
+/**
+ * Handle a request. On success, the result is stored in the result buffer,
+ * which is left empty by requests without a result.
+ */
+static bool HandleRequest(LCH_Session *const session,
+                          const LCH_Buffer *const request,
+                          LCH_Buffer **const result) {
+  const char *const data = LCH_BufferData(request);
+  const size_t length = LCH_BufferLength(request);
+
+  /* Split the request line from the payload */
+  const char *const newline = memchr(data, '\n', length);
+  const size_t line_length =
+      (newline != NULL) ? (size_t)(newline - data) : length;
+  const char *const payload = (newline != NULL) ? newline + 1 : data + length;
+  const size_t payload_size = (size_t)(data + length - payload);
+
+  char line[LCH_BUFFER_SIZE];
+  if (line_length >= sizeof(line)) {
+    LCH_LOG_ERROR("Request line is too long (%zu >= %zu)", line_length,
+                  sizeof(line));
+    return false;
+  }
+  memcpy(line, data, line_length);
+  line[line_length] = '\0';
+
+  char *args[MAX_ARGUMENTS];
+  size_t n_args = 0;
+  char *saveptr = NULL;
+  for (char *arg = strtok_r(line, " \r", &saveptr); arg != NULL;
+       arg = strtok_r(NULL, " \r", &saveptr)) {
+    if (n_args >= MAX_ARGUMENTS) {
+      LCH_LOG_ERROR("Too many arguments in request");
+      return false;
+    }
+    args[n_args++] = arg;
+  }
+
+  if (n_args == 0) {
+    LCH_LOG_ERROR("Empty request");
+    return false;
+  }
+  const char *const command = args[0];
+  LCH_LOG_VERBOSE("Handling request '%s'", command);
+
+  if (strcmp(command, "commit") == 0) {
+    return LCH_SessionCommit(session);
+  }
+
+  if (strcmp(command, "diff") == 0) {
+    const char *const block_id =
+        (n_args > 1) ? args[1] : "0000000000000000000000000000000000000000";
+    *result = LCH_SessionDiff(session, block_id);
+    return *result != NULL;
+  }
+
+  if (strcmp(command, "patch") == 0) {
+    if (n_args != 3) {
+      LCH_LOG_ERROR("Expected field and value in patch request");
+      return false;
+    }
+    return LCH_SessionPatch(session, args[1], args[2], payload, payload_size);
+  }
+
+  if (strcmp(command, "history") == 0) {
+    *result = HandleHistory(session, (const char *const *)args, n_args,
+                            payload, payload_size);
+    return *result != NULL;
+  }
+
+  if (strcmp(command, "histories") == 0) {
+    *result = HandleHistories(session, (const char *const *)args, n_args,
+                              payload, payload_size);
+    return *result != NULL;
+  }
+
+  if (strcmp(command, "purge") == 0) {
+    return LCH_SessionPurge(session);
+  }
+
+  LCH_LOG_ERROR("Unknown request '%s'", command);
+  return false;
+}
+
+static void HandleConnection(LCH_Session *const session, const int fd) {
+  /* Nor may a client that does not read the response */
+  const struct timeval timeout = {
+      .tv_sec = REQUEST_TIMEOUT_MS / 1000,
+      .tv_usec = (REQUEST_TIMEOUT_MS % 1000) * 1000,
+  };
+  if (setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) !=
+      0) {
+    LCH_LOG_WARNING("Failed to set send timeout on connection: %s",
+                    strerror(errno));
+  }
+
+  LCH_Buffer *const request = ReadRequest(fd);
+  if (request == NULL) {
+    WriteResponse(fd, "ERROR\n", strlen("ERROR\n"));
+    return;
+  }
+
+  LCH_Buffer *result = NULL;
+  const bool success = HandleRequest(session, request, &result);
+  LCH_BufferDestroy(request);
+
+  if (!success) {
+    WriteResponse(fd, "ERROR\n", strlen("ERROR\n"));
+    return;
+  }
+
+  if (WriteResponse(fd, "OK\n", strlen("OK\n")) && result != NULL) {
+    WriteResponse(fd, LCH_BufferData(result), LCH_BufferLength(result));
+  }
+  LCH_BufferDestroy(result);
+}
+
+/**
+ * Remove the socket left behind by a server that is no longer running. A
+ * socket that still accepts connections belongs to a running server, which
+ * must not be replaced, as two servers would then commit to the same work
+ * directory.
+ */
+static bool RemoveStaleSocket(const struct sockaddr_un *const addr) {
+  const char *const path = addr->sun_path;
+
+  struct stat sb;
+  if (lstat(path, &sb) != 0) {
+    if (errno == ENOENT) {
+      return true;
+    }
+    LCH_LOG_ERROR("Failed to get status of '%s': %s", path, strerror(errno));
+    return false;
+  }
+
+  if (!S_ISSOCK(sb.st_mode)) {
+    LCH_LOG_ERROR("Refusing to replace '%s', which is not a socket", path);
+    return false;
+  }
+
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    LCH_LOG_ERROR("Failed to create socket: %s", strerror(errno));
+    return false;
+  }
+
+  const int ret = connect(fd, (const struct sockaddr *)addr, sizeof(*addr));
+  const int error = errno;
+  close(fd);
+
+  if (ret == 0) {
+    LCH_LOG_ERROR("Another server is already listening on socket '%s'", path);
+    return false;
+  }
+
+  if (error != ECONNREFUSED) {
+    LCH_LOG_ERROR("Failed to connect to socket '%s': %s", path,
+                  strerror(error));
+    return false;
+  }
+
+  LCH_LOG_DEBUG("Removing stale socket '%s'", path);
+  if (unlink(path) != 0 && errno != ENOENT) {
+    LCH_LOG_ERROR("Failed to remove stale socket '%s': %s", path,
+                  strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+static int Listen(const char *const path) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    LCH_LOG_ERROR("Socket path '%s' is too long", path);
+    return -1;
+  }
+  strcpy(addr.sun_path, path);
+
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    LCH_LOG_ERROR("Failed to create socket: %s", strerror(errno));
+    return -1;
+  }
+
+  if (!RemoveStaleSocket(&addr)) {
+    close(fd);
+    return -1;
+  }
+
+  /* Only the owner may connect to the socket */
+  const mode_t mask = umask(0077);
+  const int ret = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+  umask(mask);
+  if (ret != 0) {
+    LCH_LOG_ERROR("Failed to bind socket to '%s': %s", path, strerror(errno));
+    close(fd);
+    return -1;
+  }
+
+  if (listen(fd, SOMAXCONN) != 0) {
+    LCH_LOG_ERROR("Failed to listen on socket '%s': %s", path,
+                  strerror(errno));
+    close(fd);
+    unlink(path);
+    return -1;
+  }
+
+  return fd;
+}
+
+int Serve(const char *const work_dir, int argc, char *argv[]) {
+  assert(work_dir != NULL);
+
+  const char *socket_path = NULL;
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "+", OPTIONS, NULL)) != -1) {
+    switch (opt) {
+      case OPTION_SOCKET:
+        socket_path = optarg;
+        break;
+      case OPTION_HELP:
+        PrintHelp();
+        return EXIT_SUCCESS;
+      default:
+        return EXIT_FAILURE;
+    }
+  }
+
+  char path[PATH_MAX];
+  if (socket_path == NULL) {
+    if (!LCH_FilePathJoin(path, sizeof(path), 2, work_dir, "leech.sock")) {
+      return EXIT_FAILURE;
+    }
+    socket_path = path;
+  }
+
+  /* Without SA_RESTART, a signal interrupts accept(2), such that the server
+   * can shut down cleanly */
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = HandleSignal;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  /* A client disconnecting early must not kill the server */
+  signal(SIGPIPE, SIG_IGN);
+
+  LCH_Session *const session = LCH_SessionCreate(work_dir);
+  if (session == NULL) {
+    return EXIT_FAILURE;
+  }
+
+  const int server_fd = Listen(socket_path);
+  if (server_fd < 0) {
+    LCH_SessionDestroy(session);
+    return EXIT_FAILURE;
+  }
+  LCH_LOG_INFO("Listening on socket '%s'", socket_path);
+
+  while (!STOP) {
+    /* Deferred work (i.e., auto purging after a commit) is run once no
+     * connection has arrived for a while, such that clients are not kept
+     * waiting for it */
+    if (LCH_SessionHasDeferred(session)) {
+      struct pollfd pfd = {.fd = server_fd, .events = POLLIN, .revents = 0};
+      const int ret = poll(&pfd, 1, IDLE_TIMEOUT_MS);
+      if (ret < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        LCH_LOG_ERROR("Failed to poll socket: %s", strerror(errno));
+        break;
+      }
+      if (ret == 0) {
+        if (!LCH_SessionRunDeferred(session)) {
+          LCH_LOG_ERROR("Failed to run deferred work");
+        }
+        continue;
+      }
+    }
+
+    const int client_fd = accept(server_fd, NULL, NULL);
+    if (client_fd < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LCH_LOG_ERROR("Failed to accept connection: %s", strerror(errno));
+      break;
+    }
+
+    HandleConnection(session, client_fd);
+    close(client_fd);
+  }
+
+  LCH_LOG_INFO("Shutting down server");
+  close(server_fd);
+  unlink(socket_path);
+  LCH_SessionDestroy(session);
+  return STOP ? EXIT_SUCCESS : EXIT_FAILURE;
+}
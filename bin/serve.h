@@ -0,0 +1,6 @@
+#ifndef _LEECH_SERVE_H
+#define _LEECH_SERVE_H
+
+int Serve(const char *work_dir, int argc, char *argv[]);
+
+#endif  // _LEECH_SERVE_H
@@ -1,19 +1,34 @@
 #include "block.h"
 
 #include <assert.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
+#include <utime.h>
 
+#include "block_index.h"
+#include "chain_index.h"
+#include "compression.h"
 #include "definitions.h"
+#include "encoding.h"
 #include "files.h"
 #include "head.h"
 #include "leech.h"
 #include "logger.h"
+#include "metrics.h"
+#include "pack.h"
 #include "string_lib.h"
 #include "utils.h"
 
 LCH_Json *LCH_BlockCreate(const char *const parent_id,
-                          LCH_Json *const payload) {
+                          LCH_Json *const payload,
+                          const LCH_Encoding encoding) {
   assert(parent_id != NULL);
   assert(payload != NULL);
 
@@ -23,8 +38,11 @@ LCH_Json *LCH_BlockCreate(const char *const parent_id,
   }
 
   {
+    const size_t version = (encoding == LCH_ENCODING_BINARY)
+                               ? LCH_BLOCK_VERSION
+                               : LCH_BLOCK_VERSION_JSON;
     const LCH_Buffer key = LCH_BufferStaticFromString("version");
-    if (!LCH_JsonObjectSetNumber(block, &key, (double)LCH_BLOCK_VERSION)) {
+    if (!LCH_JsonObjectSetNumber(block, &key, (double)version)) {
       LCH_JsonDestroy(block);
       return NULL;
     }
@@ -66,14 +84,136 @@ LCH_Json *LCH_BlockCreate(const char *const parent_id,
   return block;
 }
 
+/* Length of the directory names in the fan-out layout (blocks/ab/cdef...) */
+#define FAN_OUT_LENGTH 2
+
+static bool BlockPath(char *const path, const size_t path_max,
+                      const char *const work_dir, const char *const block_id,
+                      const bool fan_out) {
+  if (!fan_out) {
+    return LCH_FilePathJoin(path, path_max, 3, work_dir, "blocks", block_id);
+  }
+
+  if (strlen(block_id) <= FAN_OUT_LENGTH) {
+    LCH_LOG_ERROR("Bad block identifier '%s'", block_id);
+    return false;
+  }
+
+  char dirname[FAN_OUT_LENGTH + 1];
+  memcpy(dirname, block_id, FAN_OUT_LENGTH);
+  dirname[FAN_OUT_LENGTH] = '\0';
+  return LCH_FilePathJoin(path, path_max, 4, work_dir, "blocks", dirname,
+                          block_id + FAN_OUT_LENGTH);
+}
+
+/**
+ * Find the path of a block in either layout. The flat layout is checked once
+ * more after the fan-out layout, such that blocks being moved by a concurrent
+ * LCH_BlockMigrate() in either direction are always found.
+ */
+static bool FindBlockPath(char *const path, const size_t path_max,
+                          const char *const work_dir,
+                          const char *const block_id, bool *const found) {
+  const bool layouts[] = {false, true, false};
+  for (size_t i = 0; i < sizeof(layouts) / sizeof(layouts[0]); i++) {
+    if (!BlockPath(path, path_max, work_dir, block_id, layouts[i])) {
+      return false;
+    }
+    if (LCH_FileIsRegular(path)) {
+      *found = true;
+      return true;
+    }
+  }
+
+  *found = false;
+  return true;
+}
+
+/**
+ * Adding or removing files in a fan-out directory, or blocks in a pack, does
+ * not change the modification time of the blocks directory, which is what
+ * block indexes use to detect changes made by other processes. Hence, we
+ * change it explicitly (creating the directory if needed).
+ */
+static bool TouchBlocksDirectory(const char *const work_dir) {
+  char path[PATH_MAX];
+  if (!LCH_FilePathJoin(path, PATH_MAX, 2, work_dir, "blocks")) {
+    return false;
+  }
+
+  if (utime(path, NULL) == 0) {
+    return true;
+  }
+
+  if (errno == ENOENT && mkdir(path, (mode_t)0700) == 0) {
+    return true;
+  }
+
+  LCH_LOG_ERROR("Failed to update modification time of '%s': %s", path,
+                strerror(errno));
+  return false;
+}
+
+static bool StoreLooseBlock(const LCH_Instance *const instance,
+                            const char *const block_id,
+                            const LCH_Buffer *const json,
+                            const LCH_Compression compression) {
+  const char *const work_dir = LCH_InstanceGetWorkDirectory(instance);
+  const bool fan_out = LCH_InstanceShouldFanOutBlocks(instance);
+
+  char path[PATH_MAX];
+  if (!BlockPath(path, PATH_MAX, work_dir, block_id, fan_out)) {
+    return false;
+  }
+
+  if (!LCH_CompressionWriteFile(json, path, compression)) {
+    return false;
+  }
+
+  return !fan_out || TouchBlocksDirectory(work_dir);
+}
+
+static bool StorePackedBlock(const LCH_Instance *const instance,
+                             const char *const block_id,
+                             const LCH_Buffer *const json,
+                             const LCH_Compression compression) {
+  LCH_Pack *const pack = LCH_InstanceGetPack(instance);
+
+  /* Packed blocks are stored exactly like they would be in a file */
+  if (compression == LCH_COMPRESSION_NONE) {
+    if (!LCH_PackAppend(pack, block_id, json)) {
+      return false;
+    }
+  } else {
+    LCH_Buffer *const compressed = LCH_CompressionEncode(
+        LCH_BufferData(json), LCH_BufferLength(json), compression);
+    if (compressed == NULL) {
+      return false;
+    }
+
+    if (!LCH_PackAppend(pack, block_id, compressed)) {
+      LCH_BufferDestroy(compressed);
+      return false;
+    }
+    LCH_BufferDestroy(compressed);
+  }
+
+  const char *const work_dir = LCH_InstanceGetWorkDirectory(instance);
+  return TouchBlocksDirectory(work_dir);
+}
+
 bool LCH_BlockStore(const LCH_Instance *const instance,
                     const LCH_Json *const block) {
   assert(block != NULL);
 
   const char *const work_dir = LCH_InstanceGetWorkDirectory(instance);
   const bool pretty_print = LCH_InstanceShouldPrettyPrint(instance);
+  const LCH_Compression compression = LCH_InstanceGetCompression(instance);
+  const LCH_Encoding encoding = LCH_InstanceGetEncoding(instance);
 
-  LCH_Buffer *const json = LCH_JsonCompose(block, pretty_print);
+  double start = LCH_MetricsStart();
+  LCH_Buffer *const json = LCH_EncodingCompose(block, encoding, pretty_print);
+  LCH_MetricsStop(LCH_METRICS_PHASE_BLOCK_COMPOSE, start);
   if (json == NULL) {
     return false;
   }
@@ -86,7 +226,10 @@ bool LCH_BlockStore(const LCH_Instance *const instance,
 
   const size_t length = LCH_BufferLength(json);
   const unsigned char *const data = (const unsigned char *)LCH_BufferData(json);
-  if (!LCH_MessageDigest(data, length, digest)) {
+  start = LCH_MetricsStart();
+  const bool digested = LCH_MessageDigest(data, length, digest);
+  LCH_MetricsStop(LCH_METRICS_PHASE_HASH, start);
+  if (!digested) {
     LCH_BufferDestroy(digest);
     LCH_BufferDestroy(json);
     return false;
@@ -95,19 +238,33 @@ bool LCH_BlockStore(const LCH_Instance *const instance,
   char *const block_id = LCH_BufferToString(digest);
   assert(block_id != NULL);
 
-  char path[PATH_MAX];
-  if (!LCH_FilePathJoin(path, PATH_MAX, 3, work_dir, "blocks", block_id)) {
+  LCH_BlockIndex *const index = LCH_InstanceGetBlockIndex(instance);
+  LCH_BlockIndexPrepare(index);
+
+  /* The block identifier is the digest of the uncompressed block, hence it
+   * does not depend on the compression method. */
+  start = LCH_MetricsStart();
+  const bool written =
+      LCH_InstanceShouldPackBlocks(instance)
+          ? StorePackedBlock(instance, block_id, json, compression)
+          : StoreLooseBlock(instance, block_id, json, compression);
+  LCH_MetricsStop(LCH_METRICS_PHASE_WRITE, start);
+  LCH_BufferDestroy(json);
+  if (!written) {
     free(block_id);
-    LCH_BufferDestroy(json);
     return false;
   }
+  LCH_BlockIndexAdd(index, block_id);
 
-  if (!LCH_BufferWriteFile(json, path)) {
-    free(block_id);
-    LCH_BufferDestroy(json);
-    return false;
+  /* The block is already stored, hence it is merely loaded when the header is
+   * needed, should it fail to be indexed */
+  const char *const parent_id = LCH_BlockGetParentId(block);
+  double timestamp;
+  if (parent_id == NULL || !LCH_BlockGetTimestamp(block, &timestamp) ||
+      !LCH_ChainIndexAdd(LCH_InstanceGetChainIndex(instance), block_id,
+                         parent_id, timestamp)) {
+    LCH_LOG_WARNING("Failed to index header of block %.7s", block_id);
   }
-  LCH_BufferDestroy(json);
 
   if (!LCH_HeadSet("HEAD", work_dir, block_id)) {
     free(block_id);
@@ -132,14 +289,74 @@ bool LCH_BlockGetVersion(const LCH_Json *const block, size_t *const version) {
   return true;
 }
 
-LCH_Json *LCH_BlockLoad(const char *const work_dir,
+/**
+ * Read a block as stored, i.e., possibly compressed, either from its own file
+ * or from a pack. The configured storage is tried first and once more at the
+ * end, such that blocks moved by a concurrent LCH_BlockMigrate() in either
+ * direction are always found. No buffer is returned if the block is not found.
+ */
+static bool ReadBlock(const LCH_Instance *const instance,
+                      const char *const block_id, LCH_Buffer **const buffer) {
+  const char *const work_dir = LCH_InstanceGetWorkDirectory(instance);
+  LCH_Pack *const pack = LCH_InstanceGetPack(instance);
+  const bool packed = LCH_InstanceShouldPackBlocks(instance);
+
+  const bool storages[] = {packed, !packed, packed};
+  for (size_t i = 0; i < sizeof(storages) / sizeof(storages[0]); i++) {
+    if (storages[i]) {
+      if (!LCH_PackRead(pack, block_id, buffer)) {
+        return false;
+      }
+    } else {
+      char path[PATH_MAX];
+      bool found;
+      if (!FindBlockPath(path, PATH_MAX, work_dir, block_id, &found)) {
+        return false;
+      }
+      *buffer = found ? LCH_BufferMapFile(path) : NULL;
+      if (found && *buffer == NULL) {
+        return false;
+      }
+    }
+
+    if (*buffer != NULL) {
+      return true;
+    }
+  }
+
+  return true;
+}
+
+LCH_Json *LCH_BlockLoad(const LCH_Instance *const instance,
                         const char *const block_id) {
-  char path[PATH_MAX];
-  if (!LCH_FilePathJoin(path, PATH_MAX, 3, work_dir, "blocks", block_id)) {
+  assert(instance != NULL);
+  assert(block_id != NULL);
+
+  const double start = LCH_MetricsStart();
+  LCH_Buffer *raw;
+  if (!ReadBlock(instance, block_id, &raw)) {
+    LCH_LOG_ERROR("Failed to read block with identifier %.7s", block_id);
     return NULL;
   }
+  if (raw == NULL) {
+    LCH_LOG_ERROR("Failed to find block with identifier %.7s", block_id);
+    return NULL;
+  }
+
+  LCH_Buffer *buffer = raw;
+  if (LCH_BufferLength(raw) > 0 &&
+      LCH_BufferData(raw)[0] == LCH_COMPRESSION_HEADER_PREFIX) {
+    buffer = LCH_CompressionDecode(LCH_BufferData(raw), LCH_BufferLength(raw));
+    LCH_BufferDestroy(raw);
+    if (buffer == NULL) {
+      LCH_LOG_ERROR("Failed to decompress block with identifier %.7s",
+                    block_id);
+      return NULL;
+    }
+  }
 
-  LCH_Json *const block = LCH_JsonParseFile(path);
+  LCH_Json *const block = LCH_EncodingParseBuffer(buffer);
+  LCH_MetricsStop(LCH_METRICS_PHASE_LOAD_BLOCK, start);
   if (block == NULL) {
     LCH_LOG_ERROR("Failed to parse block with identifier %.7s", block_id);
     return NULL;
@@ -152,7 +369,7 @@ LCH_Json *LCH_BlockLoad(const char *const work_dir,
     return NULL;
   }
 
-  if (version > LCH_PATCH_VERSION) {
+  if (version > LCH_BLOCK_VERSION) {
     LCH_LOG_ERROR("Unsupported block version %zu", version);
     LCH_JsonDestroy(block);
     return NULL;
@@ -208,6 +425,52 @@ bool LCH_BlockAppendPayload(const LCH_Json *const block,
   return true;
 }
 
+LCH_Dict *LCH_BlockIndexPayload(const LCH_Json *const block) {
+  assert(block != NULL);
+
+  const LCH_Json *const payload = LCH_BlockGetPayload(block);
+  if (payload == NULL) {
+    return NULL;
+  }
+
+  LCH_Dict *const index = LCH_DictCreate();
+  if (index == NULL) {
+    return NULL;
+  }
+
+  const LCH_Buffer id_key = LCH_BufferStaticFromString("id");
+  const size_t num_deltas = LCH_JsonArrayLength(payload);
+  for (size_t i = 0; i < num_deltas; i++) {
+    const LCH_Json *const delta = LCH_JsonArrayGetObject(payload, i);
+    if (delta == NULL) {
+      LCH_DictDestroy(index);
+      return NULL;
+    }
+
+    const LCH_Buffer *const table_id =
+        LCH_JsonObjectGetString(delta, &id_key);
+    if (table_id == NULL) {
+      LCH_DictDestroy(index);
+      return NULL;
+    }
+
+    if (LCH_DictHasKey(index, table_id)) {
+      LCH_LOG_ERROR("Found multiple deltas for table '%s' in block payload",
+                    LCH_BufferData(table_id));
+      LCH_DictDestroy(index);
+      return NULL;
+    }
+
+    /* The index does not own the deltas */
+    if (!LCH_DictSet(index, table_id, (void *)delta, NULL)) {
+      LCH_DictDestroy(index);
+      return NULL;
+    }
+  }
+
+  return index;
+}
+
 bool LCH_BlockGetTimestamp(const LCH_Json *const block,
                            double *const timestamp) {
   const LCH_Buffer key = LCH_BufferStaticFromString("timestamp");
@@ -217,89 +480,710 @@ bool LCH_BlockGetTimestamp(const LCH_Json *const block,
   return true;
 }
 
-static bool IsValidBlockId(const char *const block_id) {
+bool LCH_BlockLoadHeader(const LCH_Instance *const instance,
+                         const char *const block_id, char **const parent_id,
+                         double *const timestamp) {
+  assert(instance != NULL);
   assert(block_id != NULL);
+  assert(parent_id != NULL);
+  assert(timestamp != NULL);
+
+  LCH_ChainIndex *const index = LCH_InstanceGetChainIndex(instance);
+  const char *indexed_parent_id;
+  bool found;
+  if (!LCH_ChainIndexGet(index, block_id, &indexed_parent_id, timestamp,
+                         &found)) {
+    return false;
+  }
+
+  if (found) {
+    *parent_id = LCH_StringDuplicate(indexed_parent_id);
+    return *parent_id != NULL;
+  }
+
+  /* Blocks stored before the chain index existed, or by a process that
+   * failed to index them */
+  LCH_Json *const block = LCH_BlockLoad(instance, block_id);
+  if (block == NULL) {
+    return false;
+  }
+
+  const char *const block_parent_id = LCH_BlockGetParentId(block);
+  if (block_parent_id == NULL) {
+    LCH_JsonDestroy(block);
+    return false;
+  }
+
+  if (!LCH_BlockGetTimestamp(block, timestamp)) {
+    LCH_JsonDestroy(block);
+    return false;
+  }
+
+  *parent_id = LCH_StringDuplicate(block_parent_id);
+  LCH_JsonDestroy(block);
+  if (*parent_id == NULL) {
+    return false;
+  }
+
+  if (!LCH_ChainIndexAdd(index, block_id, *parent_id, *timestamp)) {
+    LCH_LOG_WARNING("Failed to index header of block %.7s", block_id);
+  }
+  return true;
+}
+
+char *LCH_BlockIdFromArgument(const LCH_Instance *const instance,
+                              const char *const argument) {
+  assert(instance != NULL);
+  assert(argument != NULL);
+
+  LCH_BlockIndex *const index = LCH_InstanceGetBlockIndex(instance);
+  const char *match;
+  size_t num_matching;
+  if (!LCH_BlockIndexFind(index, argument, &match, &num_matching)) {
+    return NULL;
+  }
+
+  if (num_matching != 1) {
+    LCH_LOG_ERROR("%s block identifier '%s': %zu blocks found",
+                  (num_matching > 1) ? "Ambiguous" : "Unknown", argument,
+                  num_matching);
+    return NULL;
+  }
 
+  return LCH_StringDuplicate(match);
+}
+
+static bool IsHexadecimal(const char *const str, const size_t length) {
   size_t i;
-  for (i = 0; block_id[i] != '\0'; i++) {
-    if (!(block_id[i] >= '0' && block_id[i] <= '9') &&
-        !(block_id[i] >= 'a' && block_id[i] <= 'f')) {
+  for (i = 0; str[i] != '\0'; i++) {
+    if (!(str[i] >= '0' && str[i] <= '9') &&
+        !(str[i] >= 'a' && str[i] <= 'f')) {
       /* Character is not in range [0-9] or [a-f] */
       return false;
     }
   }
+  return i == length;
+}
 
-  /* Make sure block ID is 40 characters long */
-  const bool correct_length = (i == strlen(LCH_GENISIS_BLOCK_ID));
-  return correct_length;
+static bool IsValidBlockId(const char *const block_id) {
+  return IsHexadecimal(block_id, strlen(LCH_GENISIS_BLOCK_ID));
 }
 
-char *LCH_BlockIdFromArgument(const char *const work_dir,
-                              const char *const argument) {
-  assert(work_dir != NULL);
-  assert(argument != NULL);
+/**
+ * Append the blocks in a fan-out directory to the list of block identifiers.
+ */
+static bool ListFanOutDirectory(LCH_List *const block_ids,
+                                const char *const path,
+                                const char *const dirname) {
+  LCH_List *const filenames = LCH_FileListDirectory(path, true);
+  if (filenames == NULL) {
+    LCH_LOG_ERROR("Failed to list directory '%s'", path);
+    return false;
+  }
+
+  const size_t id_length = strlen(LCH_GENISIS_BLOCK_ID);
+  const size_t num_filenames = LCH_ListLength(filenames);
+  for (size_t i = 0; i < num_filenames; i++) {
+    const char *const filename = (char *)LCH_ListGet(filenames, i);
+    if (!IsHexadecimal(filename, id_length - FAN_OUT_LENGTH)) {
+      LCH_LOG_WARNING(
+          "The file '%s%c%s' does not conform with the block naming convention "
+          "and will be ignored",
+          path, LCH_PATH_SEP, filename);
+      continue;
+    }
+
+    char *const block_id = (char *)malloc(id_length + 1);
+    if (block_id == NULL) {
+      LCH_LOG_ERROR("Failed to allocate memory: %s", strerror(errno));
+      LCH_ListDestroy(filenames);
+      return false;
+    }
+    memcpy(block_id, dirname, FAN_OUT_LENGTH);
+    strcpy(block_id + FAN_OUT_LENGTH, filename);
+
+    if (!LCH_ListAppend(block_ids, block_id, free)) {
+      free(block_id);
+      LCH_ListDestroy(filenames);
+      return false;
+    }
+  }
+
+  LCH_ListDestroy(filenames);
+  return true;
+}
 
+/**
+ * List the identifiers of the blocks stored in a file each.
+ */
+static LCH_List *ListLooseBlocks(const char *const work_dir) {
   char path[PATH_MAX];
   if (!LCH_FilePathJoin(path, PATH_MAX, 2, work_dir, "blocks")) {
-    /* Error already logged */
     return NULL;
   }
 
-  size_t index = 0, num_matching = 0;
-  LCH_List *blocks;
-  if (LCH_FileIsDirectory(path)) {
-    blocks = LCH_FileListDirectory(path, true);
-    if (blocks == NULL) {
-      LCH_LOG_ERROR("Failed to list directory '%s'", path);
-      return NULL;
+  if (!LCH_FileIsDirectory(path)) {
+    return LCH_ListCreate();
+  }
+
+  LCH_List *const block_ids = LCH_FileListDirectory(path, true);
+  if (block_ids == NULL) {
+    LCH_LOG_ERROR("Failed to list directory '%s'", path);
+    return NULL;
+  }
+
+  /* The blocks in the flat layout are kept in place. Going backwards, the
+   * entries that are not, are removed before the blocks of fan-out
+   * directories are appended to the end. */
+  for (size_t i = LCH_ListLength(block_ids); i > 0; i--) {
+    char *const filename = (char *)LCH_ListGet(block_ids, i - 1);
+    if (IsValidBlockId(filename)) {
+      continue;
     }
-  } else {
-    blocks = LCH_ListCreate();
-    if (blocks == NULL) {
-      LCH_LOG_ERROR("Failed to create list of blocks");
-      return NULL;
+
+    char subdir[PATH_MAX];
+    if (IsHexadecimal(filename, FAN_OUT_LENGTH) &&
+        LCH_FilePathJoin(subdir, PATH_MAX, 2, path, filename) &&
+        LCH_FileIsDirectory(subdir)) {
+      if (!ListFanOutDirectory(block_ids, subdir, filename)) {
+        LCH_ListDestroy(block_ids);
+        return NULL;
+      }
+    } else {
+      LCH_LOG_WARNING(
+          "The file '%s%c%s' does not conform with the block naming convention "
+          "and will be ignored",
+          path, LCH_PATH_SEP, filename);
     }
+    free(LCH_ListRemove(block_ids, i - 1));
   }
 
-  /* Add genesis block to the list */
-  char *const genisis_id = LCH_StringDuplicate(LCH_GENISIS_BLOCK_ID);
-  if (genisis_id == NULL) {
-    LCH_ListDestroy(blocks);
+  return block_ids;
+}
+
+bool LCH_BlockExists(const LCH_Instance *const instance,
+                     const char *const block_id) {
+  assert(instance != NULL);
+  assert(block_id != NULL);
+
+  const char *const work_dir = LCH_InstanceGetWorkDirectory(instance);
+  char path[PATH_MAX];
+  bool found;
+  if (!FindBlockPath(path, PATH_MAX, work_dir, block_id, &found)) {
+    return false;
+  }
+
+  if (!found) {
+    LCH_Pack *const pack = LCH_InstanceGetPack(instance);
+    if (!LCH_PackContains(pack, block_id, &found)) {
+      return false;
+    }
+  }
+  return found;
+}
+
+LCH_List *LCH_BlockList(const LCH_Instance *const instance) {
+  assert(instance != NULL);
+
+  const char *const work_dir = LCH_InstanceGetWorkDirectory(instance);
+  LCH_List *const block_ids = ListLooseBlocks(work_dir);
+  if (block_ids == NULL) {
     return NULL;
   }
 
-  if (!LCH_ListAppend(blocks, genisis_id, free)) {
-    /* Error already logged */
-    free(genisis_id);
-    LCH_ListDestroy(blocks);
+  LCH_Pack *const pack = LCH_InstanceGetPack(instance);
+  LCH_List *const packed_ids = LCH_PackList(pack);
+  if (packed_ids == NULL) {
+    LCH_ListDestroy(block_ids);
     return NULL;
   }
 
-  const size_t num_blocks = LCH_ListLength(blocks);
+  /* Blocks may be both packed and stored in a file during a migration, but
+   * are only listed once */
+  LCH_Dict *const packed = LCH_DictCreate();
+  if (packed == NULL) {
+    LCH_ListDestroy(packed_ids);
+    LCH_ListDestroy(block_ids);
+    return NULL;
+  }
 
-  for (size_t i = 0; i < num_blocks; i++) {
-    const char *const filename = (char *)LCH_ListGet(blocks, i);
-    if (!IsValidBlockId(filename)) {
+  const size_t num_packed = LCH_ListLength(packed_ids);
+  for (size_t i = 0; i < num_packed; i++) {
+    const char *const block_id = (char *)LCH_ListGet(packed_ids, i);
+    const LCH_Buffer key = LCH_BufferStaticFromString(block_id);
+    if (!LCH_DictSet(packed, &key, NULL, NULL)) {
+      LCH_DictDestroy(packed);
+      LCH_ListDestroy(packed_ids);
+      LCH_ListDestroy(block_ids);
+      return NULL;
+    }
+  }
+
+  for (size_t i = LCH_ListLength(block_ids); i > 0; i--) {
+    const char *const block_id = (char *)LCH_ListGet(block_ids, i - 1);
+    const LCH_Buffer key = LCH_BufferStaticFromString(block_id);
+    if (LCH_DictHasKey(packed, &key)) {
+      free(LCH_ListRemove(block_ids, i - 1));
+    }
+  }
+  LCH_DictDestroy(packed);
+
+  while (LCH_ListLength(packed_ids) > 0) {
+    char *const block_id =
+        (char *)LCH_ListRemove(packed_ids, LCH_ListLength(packed_ids) - 1);
+    if (!LCH_ListAppend(block_ids, block_id, free)) {
+      free(block_id);
+      LCH_ListDestroy(packed_ids);
+      LCH_ListDestroy(block_ids);
+      return NULL;
+    }
+  }
+  LCH_ListDestroy(packed_ids);
+
+  return block_ids;
+}
+
+/**
+ * Get the type of a directory entry (i.e., S_IFREG, S_IFDIR or 0 for
+ * anything else). The type reported by readdir(3) is used when available, so
+ * that the file does not have to be stat'ed.
+ */
+static mode_t EntryType(const int dir_fd, const struct dirent *const entry) {
+#ifdef DT_UNKNOWN
+  switch (entry->d_type) {
+    case DT_REG:
+      return S_IFREG;
+    case DT_DIR:
+      return S_IFDIR;
+    case DT_UNKNOWN:
+      break;
+    default:
+      return 0;
+  }
+#endif  // DT_UNKNOWN
+
+  struct stat sb;
+  if (fstatat(dir_fd, entry->d_name, &sb, AT_SYMLINK_NOFOLLOW) != 0) {
+    return 0;
+  }
+  return sb.st_mode & S_IFMT;
+}
+
+/**
+ * Delete the blocks that are not whitelisted from a directory, as it is read.
+ * The blocks are deleted relative to the directory file descriptor, which is
+ * closed before returning. In a fan-out directory, the prefix is the name of
+ * the directory. Otherwise, it is empty and fan-out directories are descended
+ * into. The identifiers of the deleted blocks are appended to the list.
+ */
+static bool RetainLooseBlocksAt(const int dir_fd, const char *const path,
+                                const char *const prefix,
+                                const LCH_Dict *const whitelist,
+                                LCH_List *const deleted,
+                                size_t *const num_blocks) {
+  DIR *const dir = fdopendir(dir_fd);
+  if (dir == NULL) {
+    LCH_LOG_ERROR("Failed to open directory '%s': %s", path, strerror(errno));
+    close(dir_fd);
+    return false;
+  }
+
+  const size_t id_length = strlen(LCH_GENISIS_BLOCK_ID);
+  const size_t prefix_length = strlen(prefix);
+  assert(prefix_length <= FAN_OUT_LENGTH);
+
+  char block_id[id_length + 1];
+  memcpy(block_id, prefix, prefix_length);
+
+  const struct dirent *entry;
+  errno = 0;
+  while ((entry = readdir(dir)) != NULL) {
+    const char *const filename = entry->d_name;
+    if (filename[0] == '.') {
+      /* Hidden files, including the current and the parent directory */
+      errno = 0;
+      continue;
+    }
+
+    const mode_t type = EntryType(dirfd(dir), entry);
+    if (type == S_IFDIR && prefix_length == 0 &&
+        IsHexadecimal(filename, FAN_OUT_LENGTH)) {
+      char subdir[PATH_MAX];
+      if (!LCH_FilePathJoin(subdir, PATH_MAX, 2, path, filename)) {
+        closedir(dir);
+        return false;
+      }
+
+      const int subdir_fd =
+          openat(dirfd(dir), filename, O_RDONLY | O_DIRECTORY);
+      if (subdir_fd == -1) {
+        LCH_LOG_ERROR("Failed to open directory '%s': %s", subdir,
+                      strerror(errno));
+        closedir(dir);
+        return false;
+      }
+
+      if (!RetainLooseBlocksAt(subdir_fd, subdir, filename, whitelist,
+                               deleted, num_blocks)) {
+        closedir(dir);
+        return false;
+      }
+      errno = 0;
+      continue;
+    }
+
+    if (type != S_IFREG ||
+        !IsHexadecimal(filename, id_length - prefix_length)) {
       LCH_LOG_WARNING(
           "The file '%s%c%s' does not conform with the block naming convention "
           "and will be ignored",
           path, LCH_PATH_SEP, filename);
-    } else if (LCH_StringStartsWith(filename, argument)) {
-      index = i;
-      num_matching += 1;
+      errno = 0;
+      continue;
+    }
+
+    strcpy(block_id + prefix_length, filename);
+    *num_blocks += 1;
+
+    const LCH_Buffer key = LCH_BufferStaticFromString(block_id);
+    if (LCH_DictHasKey(whitelist, &key)) {
+      LCH_LOG_DEBUG("Skipping deletion of block %.7s: Block is whitelisted",
+                    block_id);
+      errno = 0;
+      continue;
+    }
+
+    /* The block may have been deleted by another process in the meantime */
+    if (unlinkat(dirfd(dir), filename, 0) != 0 && errno != ENOENT) {
+      LCH_LOG_ERROR("Failed to delete file '%s%c%s': %s", path, LCH_PATH_SEP,
+                    filename, strerror(errno));
+      closedir(dir);
+      return false;
+    }
+    LCH_LOG_VERBOSE("Deleted file '%s%c%s'", path, LCH_PATH_SEP, filename);
+
+    char *const duplicate = LCH_StringDuplicate(block_id);
+    if (duplicate == NULL) {
+      closedir(dir);
+      return false;
+    }
+
+    if (!LCH_ListAppend(deleted, duplicate, free)) {
+      free(duplicate);
+      closedir(dir);
+      return false;
     }
+    errno = 0;
   }
 
-  char *block_id = NULL;
-  if (num_matching != 1) {
-    LCH_LOG_ERROR("%s block identifier '%s': %zu blocks found",
-                  (num_matching > 1) ? "Ambiguous" : "Unknown", argument,
-                  num_matching);
-  } else {
-    const char *const filename = (char *)LCH_ListGet(blocks, index);
-    block_id = LCH_StringDuplicate(filename);
+  if (errno != 0) {
+    LCH_LOG_ERROR("Failed to read directory '%s': %s", path, strerror(errno));
+    closedir(dir);
+    return false;
+  }
+
+  closedir(dir);
+  return true;
+}
+
+/**
+ * Delete the blocks stored in a file each that are not whitelisted, while
+ * walking the blocks directory.
+ */
+static bool RetainLooseBlocks(const char *const work_dir,
+                              const LCH_Dict *const whitelist,
+                              LCH_List *const deleted,
+                              size_t *const num_blocks) {
+  char path[PATH_MAX];
+  if (!LCH_FilePathJoin(path, PATH_MAX, 2, work_dir, "blocks")) {
+    return false;
+  }
+
+  const int dir_fd = open(path, O_RDONLY | O_DIRECTORY);
+  if (dir_fd == -1) {
+    if (errno == ENOENT) {
+      return true;
+    }
+    LCH_LOG_ERROR("Failed to open directory '%s': %s", path, strerror(errno));
+    return false;
+  }
+
+  return RetainLooseBlocksAt(dir_fd, path, "", whitelist, deleted, num_blocks);
+}
+
+bool LCH_BlockRetain(const LCH_Instance *const instance,
+                     const LCH_Dict *const whitelist) {
+  assert(instance != NULL);
+  assert(whitelist != NULL);
+
+  const char *const work_dir = LCH_InstanceGetWorkDirectory(instance);
+  LCH_BlockIndex *const index = LCH_InstanceGetBlockIndex(instance);
+  LCH_BlockIndexPrepare(index);
+
+  LCH_List *const deleted = LCH_ListCreate();
+  if (deleted == NULL) {
+    return false;
+  }
+
+  size_t num_blocks = 0;
+  if (!RetainLooseBlocks(work_dir, whitelist, deleted, &num_blocks)) {
+    LCH_ListDestroy(deleted);
+    return false;
+  }
+  const size_t num_loose = LCH_ListLength(deleted);
+
+  /* Packed blocks are deleted all at once, as it involves rewriting the
+   * segments containing them. Hence, they are listed up front. */
+  LCH_Pack *const pack = LCH_InstanceGetPack(instance);
+  LCH_List *const packed_ids = LCH_PackList(pack);
+  if (packed_ids == NULL) {
+    LCH_ListDestroy(deleted);
+    return false;
+  }
+
+  while (LCH_ListLength(packed_ids) > 0) {
+    char *const block_id =
+        (char *)LCH_ListRemove(packed_ids, LCH_ListLength(packed_ids) - 1);
+    num_blocks += 1;
+
+    const LCH_Buffer key = LCH_BufferStaticFromString(block_id);
+    if (LCH_DictHasKey(whitelist, &key)) {
+      free(block_id);
+      continue;
+    }
+
+    if (!LCH_ListAppend(deleted, block_id, free)) {
+      free(block_id);
+      LCH_ListDestroy(packed_ids);
+      LCH_ListDestroy(deleted);
+      return false;
+    }
+  }
+  LCH_ListDestroy(packed_ids);
+
+  if (!LCH_PackRetain(pack, whitelist)) {
+    LCH_ListDestroy(deleted);
+    return false;
+  }
+
+  if (num_loose > 0 && !TouchBlocksDirectory(work_dir)) {
+    LCH_ListDestroy(deleted);
+    return false;
+  }
+
+  const size_t num_deleted = LCH_ListLength(deleted);
+  for (size_t i = 0; i < num_deleted; i++) {
+    const char *const block_id = (char *)LCH_ListGet(deleted, i);
+    LCH_BlockIndexRemove(index, block_id);
+  }
+
+  if (!LCH_ChainIndexRetain(LCH_InstanceGetChainIndex(instance), whitelist)) {
+    LCH_LOG_WARNING("Failed to drop headers of purged blocks");
+  }
+
+  LCH_LOG_INFO("Purged %zu out of %zu blocks", num_deleted, num_blocks);
+  LCH_ListDestroy(deleted);
+  return true;
+}
+
+/**
+ * Move the blocks stored in a file each between the flat and the fan-out
+ * layout.
+ */
+static bool MoveLooseBlocks(const char *const work_dir, const bool fan_out) {
+  LCH_List *const block_ids = ListLooseBlocks(work_dir);
+  if (block_ids == NULL) {
+    return false;
+  }
+
+  size_t num_moved = 0;
+  const size_t num_blocks = LCH_ListLength(block_ids);
+  for (size_t i = 0; i < num_blocks; i++) {
+    const char *const block_id = (char *)LCH_ListGet(block_ids, i);
+
+    char src[PATH_MAX], dst[PATH_MAX];
+    if (!BlockPath(src, PATH_MAX, work_dir, block_id, !fan_out) ||
+        !BlockPath(dst, PATH_MAX, work_dir, block_id, fan_out)) {
+      LCH_ListDestroy(block_ids);
+      return false;
+    }
+
+    if (!LCH_FileIsRegular(src)) {
+      continue;  // Already in the configured layout
+    }
+
+    /* Each block is moved with rename(2), such that it can always be found by
+     * LCH_BlockLoad() while the migration is ongoing. A block that exists in
+     * both layouts has the same contents in both, as the identifier is its
+     * digest. */
+    if (LCH_FileIsRegular(dst)) {
+      if (!LCH_FileDelete(src)) {
+        LCH_ListDestroy(block_ids);
+        return false;
+      }
+    } else {
+      if (!LCH_FileCreateParentDirectories(dst)) {
+        LCH_ListDestroy(block_ids);
+        return false;
+      }
+      if (rename(src, dst) != 0) {
+        LCH_LOG_ERROR("Failed to move block from '%s' to '%s': %s", src, dst,
+                      strerror(errno));
+        LCH_ListDestroy(block_ids);
+        return false;
+      }
+    }
+    LCH_LOG_VERBOSE("Moved block from '%s' to '%s'", src, dst);
+    num_moved += 1;
+  }
+  LCH_ListDestroy(block_ids);
+
+  LCH_LOG_INFO("Moved %zu out of %zu blocks to the %s layout", num_moved,
+               num_blocks, fan_out ? "fan-out" : "flat");
+  return true;
+}
+
+/**
+ * Append the blocks stored in a file each to the pack. Each file is deleted
+ * only after its block is appended.
+ */
+static bool PackLooseBlocks(const LCH_Instance *const instance) {
+  const char *const work_dir = LCH_InstanceGetWorkDirectory(instance);
+  LCH_Pack *const pack = LCH_InstanceGetPack(instance);
+
+  LCH_List *const block_ids = ListLooseBlocks(work_dir);
+  if (block_ids == NULL) {
+    return false;
+  }
+
+  const size_t num_blocks = LCH_ListLength(block_ids);
+  for (size_t i = 0; i < num_blocks; i++) {
+    const char *const block_id = (char *)LCH_ListGet(block_ids, i);
+
+    char path[PATH_MAX];
+    bool found;
+    if (!FindBlockPath(path, PATH_MAX, work_dir, block_id, &found)) {
+      LCH_ListDestroy(block_ids);
+      return false;
+    }
+    if (!found) {
+      continue;
+    }
+
+    LCH_Buffer *const buffer = LCH_BufferMapFile(path);
+    if (buffer == NULL) {
+      LCH_ListDestroy(block_ids);
+      return false;
+    }
+
+    if (!LCH_PackAppend(pack, block_id, buffer)) {
+      LCH_BufferDestroy(buffer);
+      LCH_ListDestroy(block_ids);
+      return false;
+    }
+    LCH_BufferDestroy(buffer);
+
+    if (!LCH_FileDelete(path)) {
+      LCH_ListDestroy(block_ids);
+      return false;
+    }
+    LCH_LOG_VERBOSE("Moved block from '%s' to pack", path);
+  }
+  LCH_ListDestroy(block_ids);
+
+  LCH_LOG_INFO("Moved %zu blocks to the packed layout", num_blocks);
+  return true;
+}
+
+/**
+ * Store each packed block in a file of its own, before deleting all segments.
+ * The files are written under a temporary name first, such that they are
+ * never found incomplete.
+ */
+static bool UnpackBlocks(const LCH_Instance *const instance) {
+  const char *const work_dir = LCH_InstanceGetWorkDirectory(instance);
+  const bool fan_out = LCH_InstanceShouldFanOutBlocks(instance);
+  LCH_Pack *const pack = LCH_InstanceGetPack(instance);
+
+  LCH_List *const block_ids = LCH_PackList(pack);
+  if (block_ids == NULL) {
+    return false;
+  }
+
+  const size_t num_blocks = LCH_ListLength(block_ids);
+  for (size_t i = 0; i < num_blocks; i++) {
+    const char *const block_id = (char *)LCH_ListGet(block_ids, i);
+
+    char path[PATH_MAX];
+    if (!BlockPath(path, PATH_MAX, work_dir, block_id, fan_out)) {
+      LCH_ListDestroy(block_ids);
+      return false;
+    }
+    if (LCH_FileIsRegular(path)) {
+      continue;
+    }
+
+    LCH_Buffer *buffer;
+    if (!LCH_PackRead(pack, block_id, &buffer)) {
+      LCH_ListDestroy(block_ids);
+      return false;
+    }
+    if (buffer == NULL) {
+      continue;  // Deleted by another process in the meantime
+    }
+
+    char tmp_path[PATH_MAX];
+    const int ret = snprintf(tmp_path, PATH_MAX, "%s.tmp", path);
+    if (ret < 0 || (size_t)ret >= PATH_MAX) {
+      LCH_LOG_ERROR("Failed to create temporary file path: Path too long");
+      LCH_BufferDestroy(buffer);
+      LCH_ListDestroy(block_ids);
+      return false;
+    }
+
+    if (!LCH_BufferWriteFile(buffer, tmp_path)) {
+      LCH_BufferDestroy(buffer);
+      LCH_ListDestroy(block_ids);
+      return false;
+    }
+    LCH_BufferDestroy(buffer);
+
+    if (rename(tmp_path, path) != 0) {
+      LCH_LOG_ERROR("Failed to move file '%s' to '%s': %s", tmp_path, path,
+                    strerror(errno));
+      LCH_FileDelete(tmp_path);
+      LCH_ListDestroy(block_ids);
+      return false;
+    }
+    LCH_LOG_VERBOSE("Moved packed block %.7s to '%s'", block_id, path);
   }
+  LCH_ListDestroy(block_ids);
 
-  LCH_ListDestroy(blocks);
-  return block_id;
+  /* With an empty whitelist, all segments are deleted */
+  LCH_Dict *const whitelist = LCH_DictCreate();
+  if (whitelist == NULL) {
+    return false;
+  }
+
+  if (!LCH_PackRetain(pack, whitelist)) {
+    LCH_DictDestroy(whitelist);
+    return false;
+  }
+  LCH_DictDestroy(whitelist);
+
+  LCH_LOG_INFO("Moved %zu packed blocks to the %s layout", num_blocks,
+               fan_out ? "fan-out" : "flat");
+  return true;
+}
+
+bool LCH_BlockMigrate(const LCH_Instance *const instance) {
+  assert(instance != NULL);
+
+  if (LCH_InstanceShouldPackBlocks(instance)) {
+    return PackLooseBlocks(instance);
+  }
+
+  const char *const work_dir = LCH_InstanceGetWorkDirectory(instance);
+  const bool fan_out = LCH_InstanceShouldFanOutBlocks(instance);
+  return MoveLooseBlocks(work_dir, fan_out) && UnpackBlocks(instance);
 }
@@ -3,6 +3,8 @@
 
 #include <stdbool.h>
 
+#include "dict.h"
+#include "encoding.h"
 #include "instance.h"
 #include "json.h"
 
@@ -11,25 +13,33 @@
  * @param parent_id The block identifier of the parent block (usually the
  *                  currently latest block)
  * @param payload JSON list of deltas
+ * @param encoding Encoding the block will be serialized with
  * @return Block as a JSON structure or NULL in case of failure
+ * @note The block is only marked as version 2 when binary encoded, such that
+ *       peers predating the binary encoding still accept JSON encoded blocks.
  */
-LCH_Json *LCH_BlockCreate(const char *parent_id, LCH_Json *const payload);
+LCH_Json *LCH_BlockCreate(const char *parent_id, LCH_Json *const payload,
+                          LCH_Encoding encoding);
 
 /**
  * @brief Write a block to the disk and move the HEAD to point to this block
  * @param instance The leech instance
  * @param block The block
  * @return False in case of failure
+ * @note The block is stored in the layout configured for the instance, or
+ *       appended to a pack if blocks are packed
  */
 bool LCH_BlockStore(const LCH_Instance *const instance, const LCH_Json *block);
 
 /**
  * @brief Load a block from disk
- * @param work_dir The leech working directory
+ * @param instance The instance
  * @param block_id The block identifier
  * @return The block as a JSON structure or NULL in case of failure
+ * @note The block is loaded from either layout or a pack, regardless of
+ *       configuration
  */
-LCH_Json *LCH_BlockLoad(const char *work_dir, const char *block_id);
+LCH_Json *LCH_BlockLoad(const LCH_Instance *instance, const char *block_id);
 
 /**
  * @brief Get the protocol version of the block
@@ -75,6 +85,17 @@ LCH_Json *LCH_BlockRemovePayload(const LCH_Json *block);
  */
 bool LCH_BlockAppendPayload(const LCH_Json *block, LCH_Json *payload);
 
+/**
+ * @brief Index the deltas in the payload of a block by table identifier
+ * @param block The block
+ * @return Dictionary mapping table identifiers to deltas or NULL in case of
+ *         failure (e.g., if the payload contains two deltas for the same
+ *         table)
+ * @note The deltas are still owned by the block. Hence, the index must be
+ *       destroyed before the deltas are removed from the block.
+ */
+LCH_Dict *LCH_BlockIndexPayload(const LCH_Json *block);
+
 /**
  * @brief Get the timestamp from whence the block was created
  * @param block The block
@@ -83,14 +104,72 @@ bool LCH_BlockAppendPayload(const LCH_Json *block, LCH_Json *payload);
  */
 bool LCH_BlockGetTimestamp(const LCH_Json *block, double *timestamp);
 
+/**
+ * @brief Get the parent block identifier and the timestamp of a block without
+ *        loading its payload
+ * @param instance The instance
+ * @param block_id The block identifier
+ * @param parent_id The variable in which to store the parent block identifier
+ * @param timestamp The variable in which to store the timestamp
+ * @return False in case of failure
+ * @note The header is looked up in the chain index, and the block is only
+ *       loaded (and its header indexed) if it is missing. The caller takes
+ *       ownership of the parent block identifier.
+ */
+bool LCH_BlockLoadHeader(const LCH_Instance *instance, const char *block_id,
+                         char **parent_id, double *timestamp);
+
 /**
  * @brief Get block identifier from partial hash
- * @param work_dir Leech work directory
+ * @param instance The instance
  * @param argument Argument containing partial hash matching the start of the
  *                 identifier of an existing block
  * @return Full block identifier or NULL in case of ambiguous/unknown blocks or
  *         failure
  */
-char *LCH_BlockIdFromArgument(const char *work_dir, const char *argument);
+char *LCH_BlockIdFromArgument(const LCH_Instance *instance,
+                              const char *argument);
+
+/**
+ * @brief Check whether a block exists
+ * @param instance The instance
+ * @param block_id The block identifier
+ * @return True if the block exists in a file of its own (in either the flat or
+ *         the fan-out layout) or in a pack
+ */
+bool LCH_BlockExists(const LCH_Instance *instance, const char *block_id);
+
+/**
+ * @brief List the identifiers of all blocks
+ * @param instance The instance
+ * @return List of block identifiers in no particular order, or NULL in case
+ *         of failure
+ * @note Blocks are listed from the flat (blocks/abcdef...) and the fan-out
+ *       (blocks/ab/cdef...) layout, as well as from packs. Files that do not
+ *       conform with either layout are ignored.
+ */
+LCH_List *LCH_BlockList(const LCH_Instance *instance);
+
+/**
+ * @brief Delete all blocks that are not whitelisted
+ * @param instance The instance
+ * @param whitelist Dictionary with the identifiers of the blocks to keep as
+ *                  keys
+ * @return False in case of failure
+ */
+bool LCH_BlockRetain(const LCH_Instance *instance, const LCH_Dict *whitelist);
+
+/**
+ * @brief Move all blocks to the storage configured for the instance
+ * @param instance The instance
+ * @return False in case of failure
+ * @note If blocks are packed, blocks stored in a file each are appended to the
+ *       pack. Otherwise, blocks are moved between the flat and fan-out layout
+ *       using rename(2), and packed blocks are written to files of their own.
+ *       As LCH_BlockLoad() finds blocks in any storage, and blocks are only
+ *       removed from the old storage once they are in the new one, blocks can
+ *       be migrated while other processes are using them.
+ */
+bool LCH_BlockMigrate(const LCH_Instance *instance);
 
 #endif  // _LEECH_BLOCK_H
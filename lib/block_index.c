@@ -0,0 +1,235 @@
+#include "block_index.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "block.h"
+#include "definitions.h"
+#include "files.h"
+#include "leech.h"
+#include "logger.h"
+#include "string_lib.h"
+
+struct LCH_BlockIndex {
+  const LCH_Instance *instance;  // Not owned by the index
+  char *blocks_dir;
+  LCH_List *block_ids;  // Sorted, or NULL until the next lookup rebuilds it
+  LCH_FileStamp stamp;  // Stamp of the blocks directory the index reflects
+};
+
+LCH_BlockIndex *LCH_BlockIndexCreate(const LCH_Instance *const instance) {
+  assert(instance != NULL);
+
+  const char *const work_dir = LCH_InstanceGetWorkDirectory(instance);
+  char blocks_dir[PATH_MAX];
+  if (!LCH_FilePathJoin(blocks_dir, PATH_MAX, 2, work_dir, "blocks")) {
+    return NULL;
+  }
+
+  LCH_BlockIndex *const index =
+      (LCH_BlockIndex *)malloc(sizeof(LCH_BlockIndex));
+  if (index == NULL) {
+    LCH_LOG_ERROR("Failed to allocate memory for block index: %s",
+                  strerror(errno));
+    return NULL;
+  }
+
+  index->instance = instance;
+  index->blocks_dir = LCH_StringDuplicate(blocks_dir);
+  if (index->blocks_dir == NULL) {
+    free(index);
+    return NULL;
+  }
+  index->block_ids = NULL;
+  memset(&index->stamp, 0, sizeof(LCH_FileStamp));
+
+  return index;
+}
+
+void LCH_BlockIndexDestroy(void *const _index) {
+  LCH_BlockIndex *const index = (LCH_BlockIndex *)_index;
+  if (index != NULL) {
+    LCH_ListDestroy(index->block_ids);
+    free(index->blocks_dir);
+    free(index);
+  }
+}
+
+static int CompareBlockIds(const void *const left, const void *const right) {
+  return strcmp((const char *)left, (const char *)right);
+}
+
+/**
+ * Get the position of the first block identifier that is not less than the
+ * given string, i.e., where it would be inserted.
+ */
+static size_t LowerBound(const LCH_List *const block_ids,
+                         const char *const str) {
+  size_t low = 0;
+  size_t high = LCH_ListLength(block_ids);
+  while (low < high) {
+    const size_t mid = low + ((high - low) / 2);
+    const char *const block_id = (const char *)LCH_ListGet(block_ids, mid);
+    if (strcmp(block_id, str) < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+static void Invalidate(LCH_BlockIndex *const index) {
+  if (index->block_ids != NULL) {
+    LCH_LOG_DEBUG("Dropping index of blocks in '%s'", index->blocks_dir);
+    LCH_ListDestroy(index->block_ids);
+    index->block_ids = NULL;
+  }
+}
+
+/**
+ * Update the stamp after the process itself has modified the directory. In
+ * case of failure, the index is dropped and rebuilt on the next lookup.
+ */
+static void UpdateStamp(LCH_BlockIndex *const index) {
+  if (!LCH_FileGetStamp(index->blocks_dir, &index->stamp)) {
+    Invalidate(index);
+  }
+}
+
+static bool Rebuild(LCH_BlockIndex *const index) {
+  Invalidate(index);
+
+  /* The stamp is obtained before listing the directory, such that any changes
+   * made in between cause another rebuild on the next lookup */
+  if (!LCH_FileGetStamp(index->blocks_dir, &index->stamp)) {
+    return false;
+  }
+
+  LCH_List *const block_ids = LCH_BlockList(index->instance);
+  if (block_ids == NULL) {
+    return false;
+  }
+
+  /* Add genesis block to the list */
+  char *const genisis_id = LCH_StringDuplicate(LCH_GENISIS_BLOCK_ID);
+  if (genisis_id == NULL) {
+    LCH_ListDestroy(block_ids);
+    return false;
+  }
+
+  if (!LCH_ListAppend(block_ids, genisis_id, free)) {
+    free(genisis_id);
+    LCH_ListDestroy(block_ids);
+    return false;
+  }
+
+  LCH_ListSort(block_ids, CompareBlockIds);
+  index->block_ids = block_ids;
+  LCH_LOG_DEBUG("Indexed %zu blocks in '%s'", LCH_ListLength(block_ids),
+                index->blocks_dir);
+  return true;
+}
+
+bool LCH_BlockIndexFind(LCH_BlockIndex *const index, const char *const prefix,
+                        const char **const block_id,
+                        size_t *const num_matching) {
+  assert(index != NULL);
+  assert(prefix != NULL);
+  assert(block_id != NULL);
+  assert(num_matching != NULL);
+
+  LCH_FileStamp stamp;
+  if (!LCH_FileGetStamp(index->blocks_dir, &stamp)) {
+    return false;
+  }
+
+  if (index->block_ids == NULL || !LCH_FileStampEqual(&stamp, &index->stamp)) {
+    if (!Rebuild(index)) {
+      return false;
+    }
+  }
+
+  /* Block identifiers starting with the prefix are sorted right after where
+   * the prefix itself would be inserted */
+  const size_t num_blocks = LCH_ListLength(index->block_ids);
+  const size_t first = LowerBound(index->block_ids, prefix);
+  size_t last = first;
+  while (last < num_blocks &&
+         LCH_StringStartsWith((char *)LCH_ListGet(index->block_ids, last),
+                              prefix)) {
+    last += 1;
+  }
+
+  *block_id = (first < last) ? (char *)LCH_ListGet(index->block_ids, first)
+                             : NULL;
+  *num_matching = last - first;
+  return true;
+}
+
+void LCH_BlockIndexPrepare(LCH_BlockIndex *const index) {
+  assert(index != NULL);
+
+  if (index->block_ids == NULL) {
+    return;
+  }
+
+  LCH_FileStamp stamp;
+  if (!LCH_FileGetStamp(index->blocks_dir, &stamp) ||
+      !LCH_FileStampEqual(&stamp, &index->stamp)) {
+    Invalidate(index);
+  }
+}
+
+void LCH_BlockIndexAdd(LCH_BlockIndex *const index,
+                       const char *const block_id) {
+  assert(index != NULL);
+  assert(block_id != NULL);
+
+  if (index->block_ids == NULL) {
+    return;
+  }
+
+  const size_t pos = LowerBound(index->block_ids, block_id);
+  if (pos < LCH_ListLength(index->block_ids) &&
+      LCH_StringEqual((char *)LCH_ListGet(index->block_ids, pos), block_id)) {
+    /* The block was overwritten */
+    UpdateStamp(index);
+    return;
+  }
+
+  char *const duplicate = LCH_StringDuplicate(block_id);
+  if (duplicate == NULL) {
+    Invalidate(index);
+    return;
+  }
+
+  if (!LCH_ListInsert(index->block_ids, pos, duplicate, free)) {
+    free(duplicate);
+    Invalidate(index);
+    return;
+  }
+
+  UpdateStamp(index);
+}
+
+void LCH_BlockIndexRemove(LCH_BlockIndex *const index,
+                          const char *const block_id) {
+  assert(index != NULL);
+  assert(block_id != NULL);
+
+  if (index->block_ids == NULL) {
+    return;
+  }
+
+  const size_t pos = LowerBound(index->block_ids, block_id);
+  if (pos < LCH_ListLength(index->block_ids) &&
+      LCH_StringEqual((char *)LCH_ListGet(index->block_ids, pos), block_id)) {
+    free(LCH_ListRemove(index->block_ids, pos));
+  }
+
+  UpdateStamp(index);
+}
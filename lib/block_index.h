@@ -0,0 +1,73 @@
+#ifndef _LEECH_BLOCK_INDEX_H
+#define _LEECH_BLOCK_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct LCH_Instance;
+
+/**
+ * The block index is a sorted list of the identifiers of all blocks, packed or
+ * not (including the genesis block), allowing block identifiers
+ * to be looked up by prefix without listing the directory. It is built on
+ * first lookup, and kept up to date by LCH_BlockIndexAdd() and
+ * LCH_BlockIndexRemove(). Changes made by other processes are detected by
+ * the modification time of the blocks directory, in which case the index is
+ * rebuilt.
+ */
+typedef struct LCH_BlockIndex LCH_BlockIndex;
+
+/**
+ * @brief Create an (empty) block index
+ * @param instance The instance whose blocks to index
+ * @return The block index or NULL in case of failure
+ * @note The blocks are not listed until the first lookup. The index must not
+ *       outlive the instance.
+ */
+LCH_BlockIndex *LCH_BlockIndexCreate(const struct LCH_Instance *instance);
+
+/**
+ * @brief Destroy a block index
+ * @param index The block index
+ */
+void LCH_BlockIndexDestroy(void *index);
+
+/**
+ * @brief Find the block identifiers starting with a prefix
+ * @param index The block index
+ * @param prefix The prefix
+ * @param block_id The variable in which to store the first matching block
+ *                 identifier, or NULL if there are none
+ * @param num_matching The variable in which to store the number of matching
+ *                     block identifiers
+ * @return False in case of failure
+ * @note The block identifier is owned by the index and is only valid until
+ *       the index is modified
+ */
+bool LCH_BlockIndexFind(LCH_BlockIndex *index, const char *prefix,
+                        const char **block_id, size_t *num_matching);
+
+/**
+ * @brief Prepare the block index for a modification of the blocks directory
+ * @param index The block index
+ * @note Must be called before the process adds or removes blocks, such that
+ *       changes made by other processes in the meantime are not mistaken for
+ *       the process' own
+ */
+void LCH_BlockIndexPrepare(LCH_BlockIndex *index);
+
+/**
+ * @brief Add a block identifier to the block index
+ * @param index The block index
+ * @param block_id The identifier of the block that was just stored
+ */
+void LCH_BlockIndexAdd(LCH_BlockIndex *index, const char *block_id);
+
+/**
+ * @brief Remove a block identifier from the block index
+ * @param index The block index
+ * @param block_id The identifier of the block that was just deleted
+ */
+void LCH_BlockIndexRemove(LCH_BlockIndex *index, const char *block_id);
+
+#endif  // _LEECH_BLOCK_INDEX_H
@@ -4,10 +4,17 @@
 #include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#if HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif  // HAVE_SYS_MMAN_H
+
 #ifdef _WIN32
 #include <winsock2.h>
 #else  // _WIN32
@@ -17,28 +24,63 @@
 #include "definitions.h"
 #include "files.h"
 #include "logger.h"
+#include "metrics.h"
 
 static bool EnsureCapacity(LCH_Buffer *const self, const size_t needed) {
   assert(self != NULL);
 
-  while ((self->capacity - self->length) <= needed) {
-    size_t new_capacity = self->capacity * 2;
-    char *new_buffer = (char *)realloc(self->buffer, new_capacity);
-    if (new_buffer == NULL) {
-      LCH_LOG_ERROR("Failed to reallocate memory for buffer: %s",
+  if (self->capacity == 0 || self->mapped) {
+    /* The buffer borrows or maps its memory, make a copy of our own before
+     * writing */
+    const size_t capacity = self->length + needed + 1;
+    char *const copy = (char *)malloc(capacity);
+    LCH_MetricsCountAllocation();
+    if (copy == NULL) {
+      LCH_LOG_ERROR("Failed to allocate memory for buffer: %s",
                     strerror(errno));
       return false;
     }
+    memcpy(copy, self->buffer, self->length);
+    copy[self->length] = '\0';
+
+#if HAVE_SYS_MMAN_H
+    if (self->mapped) {
+      munmap(self->buffer, self->capacity);
+      self->mapped = false;
+    }
+#endif  // HAVE_SYS_MMAN_H
 
-    self->capacity = new_capacity;
-    self->buffer = new_buffer;
+    self->capacity = capacity;
+    self->buffer = copy;
+    return true;
+  }
+
+  if ((self->capacity - self->length) > needed) {
+    return true;
+  }
+
+  /* Figure out the new capacity first, so that we only reallocate once */
+  size_t new_capacity = self->capacity;
+  while ((new_capacity - self->length) <= needed) {
+    new_capacity *= 2;
+  }
+
+  char *const new_buffer = (char *)realloc(self->buffer, new_capacity);
+  LCH_MetricsCountAllocation();
+  if (new_buffer == NULL) {
+    LCH_LOG_ERROR("Failed to reallocate memory for buffer: %s",
+                  strerror(errno));
+    return false;
   }
 
+  self->capacity = new_capacity;
+  self->buffer = new_buffer;
   return true;
 }
 
 static LCH_Buffer *LCH_BufferCreateWithCapacity(size_t capacity) {
   LCH_Buffer *self = (LCH_Buffer *)malloc(sizeof(LCH_Buffer));
+  LCH_MetricsCountAllocation();
   if (self == NULL) {
     LCH_LOG_ERROR("Failed to allocate memory for buffer: %s", strerror(errno));
     return NULL;
@@ -46,7 +88,9 @@ static LCH_Buffer *LCH_BufferCreateWithCapacity(size_t capacity) {
 
   self->capacity = capacity + 1;
   self->length = 0;
+  self->mapped = false;
   self->buffer = (char *)malloc(self->capacity);
+  LCH_MetricsCountAllocation();
   if (self->buffer == NULL) {
     LCH_LOG_ERROR("Failed to allocate memory for buffer: %s", strerror(errno));
     free(self);
@@ -61,6 +105,24 @@ LCH_Buffer *LCH_BufferCreate(void) {
   return LCH_BufferCreateWithCapacity(LCH_BUFFER_SIZE);
 }
 
+LCH_Buffer *LCH_BufferCreateView(const char *const data, const size_t length) {
+  assert(data != NULL);
+  assert(data[length] == '\0');
+
+  LCH_Buffer *const self = (LCH_Buffer *)malloc(sizeof(LCH_Buffer));
+  LCH_MetricsCountAllocation();
+  if (self == NULL) {
+    LCH_LOG_ERROR("Failed to allocate memory for buffer: %s", strerror(errno));
+    return NULL;
+  }
+
+  self->buffer = (char *)data;
+  self->length = length;
+  self->capacity = 0;
+  self->mapped = false;
+  return self;
+}
+
 bool LCH_BufferAppend(LCH_Buffer *const self, const char byte) {
   if (!EnsureCapacity(self, 1)) {
     return false;
@@ -71,45 +133,41 @@ bool LCH_BufferAppend(LCH_Buffer *const self, const char byte) {
   return true;
 }
 
+bool LCH_BufferAppendBytes(LCH_Buffer *const self, const void *const data,
+                           const size_t length) {
+  assert(self != NULL);
+  assert(data != NULL || length == 0);
+
+  if (!EnsureCapacity(self, length)) {
+    return false;
+  }
+
+  if (length > 0) {
+    memcpy(self->buffer + self->length, data, length);
+  }
+  self->length += length;
+  self->buffer[self->length] = '\0';
+  return true;
+}
+
 bool LCH_BufferPrintFormat(LCH_Buffer *const self, const char *const format,
                            ...) {
   assert(self != NULL);
   assert(self->buffer != NULL);
   assert(format != NULL);
 
-  va_list ap;
-
-  /* TODO:
-   * Concerning the return value of snprintf(), SUSv2 and C99 contradict each
-   * other: when snprintf() is called with size=0 then SUSv2 stipulates an
-   * unspecified return value less than 1, while C99 allows str to be NULL in
-   * this case, and gives the return value (as always) as the number of
-   * characters that would have been written in case the output string has
-   * been large enough. */
-
-  // Figure out how many bytes we need
-  va_start(ap, format);
-  const int length = vsnprintf(NULL, 0, format, ap);
-  assert(length >= 0);
-  va_end(ap);
-  if (length < 0) {
-    LCH_LOG_ERROR(
-        "Failed to calculate length needed to print formatted string to "
-        "buffer: "
-        "%s",
-        strerror(errno));
-    self->buffer[self->length] = '\0';
-    return false;
-  }
-
-  if (!EnsureCapacity(self, (size_t)length)) {
+  /* Make sure we own the memory before writing to it */
+  if (self->capacity == 0 && !EnsureCapacity(self, 0)) {
     return false;
   }
 
+  /* Most of the time, the formatted string fits in the remaining capacity.
+   * Hence, we optimistically print it right away, and only print it a second
+   * time if it was truncated. */
+  va_list ap;
   va_start(ap, format);
-  LCH_NDEBUG_UNUSED const int ret = vsnprintf(
-      self->buffer + self->length, self->capacity - self->length, format, ap);
-  assert(length >= 0);
+  const int length = vsnprintf(self->buffer + self->length,
+                               self->capacity - self->length, format, ap);
   va_end(ap);
   if (length < 0) {
     LCH_LOG_ERROR("Failed to print formatted string to buffer: %s",
@@ -117,8 +175,20 @@ bool LCH_BufferPrintFormat(LCH_Buffer *const self, const char *const format,
     self->buffer[self->length] = '\0';
     return false;
   }
-  assert(ret == length);
-  assert((size_t)ret < self->capacity - self->length);
+
+  if ((size_t)length >= self->capacity - self->length) {
+    if (!EnsureCapacity(self, (size_t)length)) {
+      self->buffer[self->length] = '\0';
+      return false;
+    }
+
+    va_start(ap, format);
+    LCH_NDEBUG_UNUSED const int ret = vsnprintf(
+        self->buffer + self->length, self->capacity - self->length, format, ap);
+    va_end(ap);
+    assert(ret == length);
+    assert((size_t)ret < self->capacity - self->length);
+  }
 
   self->length += (size_t)length;
   return true;
@@ -155,7 +225,17 @@ void LCH_BufferDestroy(void *const self) {
   LCH_Buffer *const buffer = (LCH_Buffer *)self;
   if (buffer != NULL) {
     assert(buffer->buffer != NULL);
-    free(buffer->buffer);
+    if (buffer->capacity > 0) {
+#if HAVE_SYS_MMAN_H
+      if (buffer->mapped) {
+        munmap(buffer->buffer, buffer->capacity);
+      } else {
+        free(buffer->buffer);
+      }
+#else   // HAVE_SYS_MMAN_H
+      free(buffer->buffer);
+#endif  // HAVE_SYS_MMAN_H
+    }
 
     free(buffer);
   }
@@ -192,6 +272,11 @@ void LCH_BufferChop(LCH_Buffer *const self, size_t offset) {
 }
 
 char *LCH_BufferToString(LCH_Buffer *const self) {
+  if ((self->capacity == 0 || self->mapped) && !EnsureCapacity(self, 0)) {
+    LCH_BufferDestroy(self);
+    return NULL;
+  }
+
   char *str = self->buffer;
   free(self);
   return str;
@@ -217,6 +302,26 @@ LCH_Buffer *LCH_BufferFromString(const char *const str) {
   return buffer;
 }
 
+static bool WriteFileDescriptor(const LCH_Buffer *const buffer, const int fd,
+                                const char *const filename) {
+  size_t tot_written = 0;
+  while (tot_written < buffer->length) {
+    ssize_t n_written = write(fd, buffer->buffer + tot_written,
+                              buffer->length - tot_written);
+    if (n_written < 0) {
+      LCH_LOG_ERROR("Failed to write to file '%s': %s", filename,
+                    strerror(errno));
+      return false;
+    }
+
+    tot_written += (size_t)n_written;
+  }
+
+  LCH_MetricsCountBytesWritten(tot_written);
+  LCH_LOG_DEBUG("Wrote %zu bytes to file '%s'", tot_written, filename);
+  return true;
+}
+
 bool LCH_BufferWriteFile(const LCH_Buffer *buffer, const char *filename) {
   assert(buffer != NULL);
   assert(filename != NULL);
@@ -225,6 +330,8 @@ bool LCH_BufferWriteFile(const LCH_Buffer *buffer, const char *filename) {
     return false;
   }
 
+  /* Truncating keeps the inode, hence the mode, ownership and hard links of
+   * existing files are preserved */
   const int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, (mode_t)0600);
   if (fd == -1) {
     LCH_LOG_ERROR("Failed to open file '%s' for writing: %s", filename,
@@ -232,61 +339,213 @@ bool LCH_BufferWriteFile(const LCH_Buffer *buffer, const char *filename) {
     return false;
   }
 
-  size_t tot_written = 0;
-  while (tot_written < buffer->length) {
-    ssize_t n_written = write(fd, buffer->buffer, buffer->length);
-    if (n_written < 0) {
-      LCH_LOG_ERROR("Failed to write to file '%s': %s", filename,
-                    strerror(errno));
-      close(fd);
-      return false;
-    }
+  const bool success = WriteFileDescriptor(buffer, fd, filename);
+  close(fd);
+  return success;
+}
 
-    tot_written += (size_t)n_written;
+bool LCH_BufferReplaceFile(const LCH_Buffer *buffer, const char *filename) {
+  assert(buffer != NULL);
+  assert(filename != NULL);
+
+  if (!LCH_FileCreateParentDirectories(filename)) {
+    return false;
+  }
+
+  char tmp_path[PATH_MAX];
+  const int ret = snprintf(tmp_path, PATH_MAX, "%s.XXXXXX", filename);
+  if (ret < 0 || ret >= PATH_MAX) {
+    LCH_LOG_ERROR("Failed to create temporary file path: Path too long");
+    return false;
   }
 
+  const int fd = mkstemp(tmp_path);  // Created with mode 0600
+  if (fd == -1) {
+    LCH_LOG_ERROR("Failed to create temporary file '%s': %s", tmp_path,
+                  strerror(errno));
+    return false;
+  }
+
+  if (!WriteFileDescriptor(buffer, fd, filename)) {
+    close(fd);
+    unlink(tmp_path);
+    return false;
+  }
   close(fd);
-  LCH_LOG_DEBUG("Wrote %zu bytes to file '%s'", tot_written, filename);
+
+  if (rename(tmp_path, filename) != 0) {
+    LCH_LOG_ERROR("Failed to move file '%s' to '%s': %s", tmp_path, filename,
+                  strerror(errno));
+    unlink(tmp_path);
+    return false;
+  }
 
   return true;
 }
 
-bool LCH_BufferReadFile(LCH_Buffer *const buffer, const char *const filename) {
+/**
+ * Reads until End-of-File. The size hint is the expected number of bytes, for
+ * which room is made up front.
+ */
+static bool ReadFileDescriptor(LCH_Buffer *const buffer, const int fd,
+                               const char *const filename,
+                               const size_t size_hint) {
   assert(buffer != NULL);
   assert(filename != NULL);
 
-  const int fd = open(filename, O_RDONLY);
-  if (fd < 0) {
-    LCH_LOG_ERROR("Failed to open file '%s' for reading: %s", filename,
-                  strerror(errno));
+  /* Make room for one more byte than expected, so that End-of-File can be
+   * detected without expanding the buffer */
+  if (!EnsureCapacity(buffer, size_hint + 1)) {
     return false;
   }
 
-  const size_t to_read = 4096;
   ssize_t n_read = 0;
   do {
-    if (!EnsureCapacity(buffer, to_read)) {
-      close(fd);
+    if ((buffer->capacity - buffer->length) <= 1 &&
+        !EnsureCapacity(buffer, LCH_BUFFER_SIZE)) {
       return false;
     }
 
+    const size_t to_read = buffer->capacity - buffer->length - 1;
     n_read = read(fd, buffer->buffer + buffer->length, to_read);
     if (n_read < 0) {
       LCH_LOG_ERROR("Failed to read file '%s': %s", filename, strerror(errno));
-      close(fd);
       return false;
     }
 
     buffer->length += (size_t)n_read;
+    LCH_MetricsCountBytesRead((size_t)n_read);
   } while (n_read > 0);
 
-  close(fd);
   buffer->buffer[buffer->length] = '\0';
+  return true;
+}
+
+/**
+ * Returns the size of the file if it is a regular file, otherwise zero.
+ */
+static size_t GetFileSize(const int fd, const char *const filename) {
+  struct stat sb;
+  if (fstat(fd, &sb) != 0) {
+    LCH_LOG_DEBUG("Failed to get size of file '%s': %s", filename,
+                  strerror(errno));
+    return 0;
+  }
+  return S_ISREG(sb.st_mode) ? (size_t)sb.st_size : 0;
+}
+
+bool LCH_BufferReadFile(LCH_Buffer *const buffer, const char *const filename) {
+  assert(buffer != NULL);
+  assert(filename != NULL);
+
+  const int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    LCH_LOG_ERROR("Failed to open file '%s' for reading: %s", filename,
+                  strerror(errno));
+    return false;
+  }
+
+  const size_t size_hint = GetFileSize(fd, filename);
+  if (!ReadFileDescriptor(buffer, fd, filename, size_hint)) {
+    close(fd);
+    return false;
+  }
+
+  close(fd);
   LCH_LOG_DEBUG("Read %zu bytes from file '%s'", buffer->length, filename);
 
   return true;
 }
 
+#if HAVE_SYS_MMAN_H
+/**
+ * Maps the file if it is large enough. Returns NULL if the file was not
+ * mapped, in which case it should be read instead.
+ */
+static LCH_Buffer *MapFileDescriptor(const int fd, const char *const filename,
+                                     const size_t size) {
+  assert(filename != NULL);
+
+  /* Bytes past End-of-File in the last page of the mapping are zero, which
+   * serves as the terminating NULL-byte. Files ending exactly at a page
+   * boundary have no such byte. */
+  const long page_size = sysconf(_SC_PAGESIZE);
+  if (size < LCH_BUFFER_MMAP_THRESHOLD || page_size <= 0 ||
+      (size % (size_t)page_size) == 0) {
+    return NULL;
+  }
+
+  /* The mapping is private so that the parsers can write to it in place
+   * without modifying the file */
+  void *const data =
+      mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED) {
+    LCH_LOG_DEBUG("Failed to map file '%s': %s", filename, strerror(errno));
+    return NULL;
+  }
+
+  /* This is merely a hint, so we don't care if it fails */
+  posix_madvise(data, size, POSIX_MADV_SEQUENTIAL);
+
+  LCH_Buffer *const self = (LCH_Buffer *)malloc(sizeof(LCH_Buffer));
+  LCH_MetricsCountAllocation();
+  if (self == NULL) {
+    LCH_LOG_ERROR("Failed to allocate memory for buffer: %s", strerror(errno));
+    munmap(data, size);
+    return NULL;
+  }
+
+  self->buffer = (char *)data;
+  self->length = size;
+  self->capacity = size + 1;
+  self->mapped = true;
+  assert(self->buffer[self->length] == '\0');
+
+  LCH_MetricsCountBytesRead(size);
+  LCH_LOG_DEBUG("Mapped %zu bytes from file '%s'", size, filename);
+  return self;
+}
+#endif  // HAVE_SYS_MMAN_H
+
+LCH_Buffer *LCH_BufferMapFile(const char *const filename) {
+  assert(filename != NULL);
+
+  const int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    LCH_LOG_ERROR("Failed to open file '%s' for reading: %s", filename,
+                  strerror(errno));
+    return NULL;
+  }
+
+  const size_t size = GetFileSize(fd, filename);
+
+#if HAVE_SYS_MMAN_H
+  LCH_Buffer *const mapped = MapFileDescriptor(fd, filename, size);
+  if (mapped != NULL) {
+    close(fd);  // The mapping stays valid after closing the file
+    return mapped;
+  }
+#endif  // HAVE_SYS_MMAN_H
+
+  /* One more byte than the size of the file, so that End-of-File is detected
+   * without expanding the buffer */
+  LCH_Buffer *const buffer = LCH_BufferCreateWithCapacity(size + 1);
+  if (buffer == NULL) {
+    close(fd);
+    return NULL;
+  }
+
+  if (!ReadFileDescriptor(buffer, fd, filename, size)) {
+    LCH_BufferDestroy(buffer);
+    close(fd);
+    return NULL;
+  }
+
+  close(fd);
+  LCH_LOG_DEBUG("Read %zu bytes from file '%s'", buffer->length, filename);
+  return buffer;
+}
+
 void LCH_BufferTrim(LCH_Buffer *const buffer, const char ch) {
   assert(buffer != NULL);
   assert(buffer->buffer != NULL);
@@ -366,8 +625,8 @@ LCH_Buffer *LCH_BufferDuplicate(const LCH_Buffer *const original) {
     return NULL;
   }
 
-  memcpy(duplicate->buffer, original->buffer,
-         original->length + 1 /* NULL-byte */);
+  memcpy(duplicate->buffer, original->buffer, original->length);
+  duplicate->buffer[original->length] = '\0';
   duplicate->length = original->length;
   return duplicate;
 }
@@ -14,11 +14,19 @@
 /**
  * @brief Self expanding byte buffer
  * @note Always null-byte terminated
+ * @note A capacity of zero means that the buffer borrows memory it does not
+ *       own. Such memory is never freed by the buffer, and is copied on the
+ *       first write.
+ * @note Mapped buffers hold a private mapping of a file (see
+ *       LCH_BufferMapFile()). The memory can be written to in place, but is
+ *       copied before it grows. The mapped flag is only meaningful if the
+ *       capacity is non-zero.
  */
 struct LCH_Buffer {
   size_t length;
   size_t capacity;
   char *buffer;
+  bool mapped;
 };
 
 /**
@@ -35,9 +43,19 @@ static inline LCH_Buffer LCH_BufferStaticFromString(const char *const str) {
   buffer.buffer = (char *)str;
   buffer.length = strlen(str);
   buffer.capacity = 0;
+  buffer.mapped = false;
   return buffer;
 }
 
+/**
+ * @brief Create a buffer borrowing memory from elsewhere
+ * @param data Null-byte terminated data to borrow
+ * @param length The length of the data excluding the null-byte
+ * @return Byte buffer or NULL in case of failure
+ * @warning The borrowed data must outlive the returned buffer
+ */
+LCH_Buffer *LCH_BufferCreateView(const char *data, size_t length);
+
 /**
  * @brief Allocate memory in the buffer
  * @param buffer The byte buffer
@@ -0,0 +1,433 @@
+#include "chain_index.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "definitions.h"
+#include "files.h"
+#include "logger.h"
+#include "string_lib.h"
+
+#define BLOCK_ID_LENGTH (sizeof(LCH_GENISIS_BLOCK_ID) - 1)
+
+/* Records are "<block identifier> <parent identifier> <timestamp>\n", where
+ * the timestamp is the zero-padded number of seconds since the epoch */
+#define TIMESTAMP_DIGITS 20
+#define RECORD_SIZE \
+  (BLOCK_ID_LENGTH + 1 + BLOCK_ID_LENGTH + 1 + TIMESTAMP_DIGITS + 1)
+
+typedef struct {
+  char parent_id[BLOCK_ID_LENGTH + 1];
+  double timestamp;
+} ChainRecord;
+
+struct LCH_ChainIndex {
+  char *path;
+  LCH_Dict *records;    // Block identifier to record, NULL until loaded
+  LCH_FileStamp stamp;  // Stamp of the chain file the records were read from
+  size_t end;           // End of the last complete record read
+};
+
+LCH_ChainIndex *LCH_ChainIndexCreate(const char *const work_dir) {
+  assert(work_dir != NULL);
+
+  char path[PATH_MAX];
+  if (!LCH_FilePathJoin(path, PATH_MAX, 2, work_dir, "chain")) {
+    return NULL;
+  }
+
+  LCH_ChainIndex *const index =
+      (LCH_ChainIndex *)malloc(sizeof(LCH_ChainIndex));
+  if (index == NULL) {
+    LCH_LOG_ERROR("Failed to allocate memory for chain index: %s",
+                  strerror(errno));
+    return NULL;
+  }
+
+  index->path = LCH_StringDuplicate(path);
+  if (index->path == NULL) {
+    free(index);
+    return NULL;
+  }
+  index->records = NULL;
+  memset(&index->stamp, 0, sizeof(LCH_FileStamp));
+  index->end = 0;
+
+  return index;
+}
+
+void LCH_ChainIndexDestroy(void *const _index) {
+  LCH_ChainIndex *const index = (LCH_ChainIndex *)_index;
+  if (index != NULL) {
+    LCH_DictDestroy(index->records);
+    free(index->path);
+    free(index);
+  }
+}
+
+static bool IsHexadecimal(const char *const str, const size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    if (!(str[i] >= '0' && str[i] <= '9') &&
+        !(str[i] >= 'a' && str[i] <= 'f')) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Parse a record without the trailing newline character.
+ */
+static bool ParseRecord(const char *const line, const size_t length,
+                        char *const block_id, ChainRecord *const record) {
+  if (length != RECORD_SIZE - 1) {
+    return false;
+  }
+
+  const char *const parent_id = line + BLOCK_ID_LENGTH + 1;
+  const char *const timestamp = parent_id + BLOCK_ID_LENGTH + 1;
+  if (!IsHexadecimal(line, BLOCK_ID_LENGTH) || line[BLOCK_ID_LENGTH] != ' ' ||
+      !IsHexadecimal(parent_id, BLOCK_ID_LENGTH) ||
+      parent_id[BLOCK_ID_LENGTH] != ' ') {
+    return false;
+  }
+
+  double value = 0;
+  for (size_t i = 0; i < TIMESTAMP_DIGITS; i++) {
+    if (timestamp[i] < '0' || timestamp[i] > '9') {
+      return false;
+    }
+    value = (value * 10) + (timestamp[i] - '0');
+  }
+
+  memcpy(block_id, line, BLOCK_ID_LENGTH);
+  block_id[BLOCK_ID_LENGTH] = '\0';
+  memcpy(record->parent_id, parent_id, BLOCK_ID_LENGTH);
+  record->parent_id[BLOCK_ID_LENGTH] = '\0';
+  record->timestamp = value;
+  return true;
+}
+
+static bool InsertRecord(const LCH_ChainIndex *const index,
+                         const char *const block_id,
+                         const ChainRecord *const record) {
+  ChainRecord *const copy = (ChainRecord *)malloc(sizeof(ChainRecord));
+  if (copy == NULL) {
+    LCH_LOG_ERROR("Failed to allocate memory for chain record: %s",
+                  strerror(errno));
+    return false;
+  }
+  memcpy(copy, record, sizeof(ChainRecord));
+
+  const LCH_Buffer key = LCH_BufferStaticFromString(block_id);
+  if (!LCH_DictSet(index->records, &key, copy, free)) {
+    free(copy);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Parse the complete records in a chunk of the chain file, and add them to
+ * the index. The length of the complete records is returned in consumed.
+ */
+static bool ParseRecords(const LCH_ChainIndex *const index,
+                         const char *const data, const size_t length,
+                         size_t *const consumed) {
+  size_t offset = 0;
+  while (offset < length) {
+    const char *const begin = data + offset;
+    const char *const end = (const char *)memchr(begin, '\n', length - offset);
+    if (end == NULL) {
+      /* Being appended by another process, or left behind by one that was
+       * interrupted */
+      break;
+    }
+
+    char block_id[BLOCK_ID_LENGTH + 1];
+    ChainRecord record;
+    if (ParseRecord(begin, (size_t)(end - begin), block_id, &record)) {
+      if (!InsertRecord(index, block_id, &record)) {
+        return false;
+      }
+    } else {
+      LCH_LOG_WARNING("Ignoring malformed record at offset %zu in file '%s'",
+                      index->end + offset, index->path);
+    }
+    offset = (size_t)(end - data) + 1;
+  }
+
+  *consumed = offset;
+  return true;
+}
+
+/**
+ * Read the records appended to the chain file since the last refresh. The
+ * records are read from the start if the file was replaced in the meantime.
+ */
+static bool Refresh(LCH_ChainIndex *const index) {
+  LCH_FileStamp stamp;
+  if (!LCH_FileGetStamp(index->path, &stamp)) {
+    return false;
+  }
+
+  if (index->records == NULL || !stamp.exists ||
+      stamp.device != index->stamp.device ||
+      stamp.inode != index->stamp.inode || stamp.size < index->end) {
+    LCH_DictDestroy(index->records);
+    index->records = LCH_DictCreate();
+    if (index->records == NULL) {
+      return false;
+    }
+    index->end = 0;
+  }
+  index->stamp = stamp;
+
+  if (!stamp.exists || stamp.size == index->end) {
+    return true;
+  }
+
+  const int fd = open(index->path, O_RDONLY);
+  if (fd == -1) {
+    LCH_LOG_ERROR("Failed to open file '%s': %s", index->path,
+                  strerror(errno));
+    return false;
+  }
+
+  const size_t length = (size_t)stamp.size - index->end;
+  char *const data = (char *)malloc(length);
+  if (data == NULL) {
+    LCH_LOG_ERROR("Failed to allocate memory: %s", strerror(errno));
+    close(fd);
+    return false;
+  }
+
+  size_t total = 0;
+  while (total < length) {
+    const ssize_t n =
+        pread(fd, data + total, length - total, (off_t)(index->end + total));
+    if (n < 0) {
+      LCH_LOG_ERROR("Failed to read file '%s': %s", index->path,
+                    strerror(errno));
+      free(data);
+      close(fd);
+      return false;
+    }
+    if (n == 0) {
+      break;
+    }
+    total += (size_t)n;
+  }
+  close(fd);
+
+  size_t consumed;
+  if (!ParseRecords(index, data, total, &consumed)) {
+    free(data);
+    return false;
+  }
+  free(data);
+
+  LCH_LOG_DEBUG("Read %zu bytes of block headers from file '%s'", consumed,
+                index->path);
+  index->end += consumed;
+  return true;
+}
+
+bool LCH_ChainIndexGet(LCH_ChainIndex *const index, const char *const block_id,
+                       const char **const parent_id, double *const timestamp,
+                       bool *const found) {
+  assert(index != NULL);
+  assert(block_id != NULL);
+  assert(parent_id != NULL);
+  assert(timestamp != NULL);
+  assert(found != NULL);
+
+  const LCH_Buffer key = LCH_BufferStaticFromString(block_id);
+  if (index->records == NULL || !LCH_DictHasKey(index->records, &key)) {
+    if (!Refresh(index)) {
+      return false;
+    }
+  }
+
+  *found = LCH_DictHasKey(index->records, &key);
+  if (*found) {
+    const ChainRecord *const record =
+        (const ChainRecord *)LCH_DictGet(index->records, &key);
+    *parent_id = record->parent_id;
+    *timestamp = record->timestamp;
+  }
+  return true;
+}
+
+static bool ComposeRecord(char *const line, const size_t size,
+                          const char *const block_id,
+                          const char *const parent_id, const double timestamp) {
+  if (strlen(block_id) != BLOCK_ID_LENGTH ||
+      strlen(parent_id) != BLOCK_ID_LENGTH || timestamp < 0) {
+    LCH_LOG_ERROR("Bad header for block %.7s", block_id);
+    return false;
+  }
+
+  const int ret = snprintf(line, size, "%s %s %0*lld\n", block_id, parent_id,
+                           TIMESTAMP_DIGITS, (long long)timestamp);
+  if (ret < 0 || (size_t)ret != RECORD_SIZE) {
+    LCH_LOG_ERROR("Failed to compose header for block %.7s", block_id);
+    return false;
+  }
+  return true;
+}
+
+bool LCH_ChainIndexAdd(LCH_ChainIndex *const index, const char *const block_id,
+                       const char *const parent_id, const double timestamp) {
+  assert(index != NULL);
+  assert(block_id != NULL);
+  assert(parent_id != NULL);
+
+  /* Room for a leading newline character that terminates an incomplete
+   * record at the end of the file */
+  char line[1 + RECORD_SIZE + 1];
+  if (!ComposeRecord(line + 1, sizeof(line) - 1, block_id, parent_id,
+                     timestamp)) {
+    return false;
+  }
+
+  const int fd =
+      open(index->path, O_RDWR | O_CREAT | O_APPEND, (mode_t)0600);
+  if (fd == -1) {
+    LCH_LOG_ERROR("Failed to open file '%s': %s", index->path,
+                  strerror(errno));
+    return false;
+  }
+
+  struct stat sb;
+  if (fstat(fd, &sb) != 0) {
+    LCH_LOG_ERROR("Failed to get status of file '%s': %s", index->path,
+                  strerror(errno));
+    close(fd);
+    return false;
+  }
+
+  const char *data = line + 1;
+  size_t length = RECORD_SIZE;
+  if (sb.st_size > 0) {
+    char last;
+    if (pread(fd, &last, 1, sb.st_size - 1) != 1) {
+      LCH_LOG_ERROR("Failed to read file '%s': %s", index->path,
+                    strerror(errno));
+      close(fd);
+      return false;
+    }
+    if (last != '\n') {
+      line[0] = '\n';
+      data = line;
+      length += 1;
+    }
+  }
+
+  size_t total = 0;
+  while (total < length) {
+    const ssize_t n = write(fd, data + total, length - total);
+    if (n < 0) {
+      LCH_LOG_ERROR("Failed to write to file '%s': %s", index->path,
+                    strerror(errno));
+      close(fd);
+      return false;
+    }
+    total += (size_t)n;
+  }
+  close(fd);
+
+  /* The record is read back on the next refresh, which does no harm */
+  if (index->records != NULL) {
+    ChainRecord record;
+    strcpy(record.parent_id, parent_id);
+    record.timestamp = timestamp;
+    if (!InsertRecord(index, block_id, &record)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool LCH_ChainIndexRetain(LCH_ChainIndex *const index,
+                          const LCH_Dict *const whitelist) {
+  assert(index != NULL);
+  assert(whitelist != NULL);
+
+  if (!Refresh(index)) {
+    return false;
+  }
+  if (!index->stamp.exists) {
+    return true;
+  }
+
+  LCH_List *const block_ids = LCH_DictGetKeys(index->records);
+  if (block_ids == NULL) {
+    return false;
+  }
+
+  LCH_Buffer *const buffer = LCH_BufferCreate();
+  if (buffer == NULL) {
+    LCH_ListDestroy(block_ids);
+    return false;
+  }
+
+  const size_t num_records = LCH_ListLength(block_ids);
+  for (size_t i = 0; i < num_records; i++) {
+    const LCH_Buffer *const key = (LCH_Buffer *)LCH_ListGet(block_ids, i);
+    if (!LCH_DictHasKey(whitelist, key)) {
+      continue;
+    }
+
+    const ChainRecord *const record =
+        (const ChainRecord *)LCH_DictGet(index->records, key);
+    char line[RECORD_SIZE + 1];
+    if (!ComposeRecord(line, sizeof(line), LCH_BufferData(key),
+                       record->parent_id, record->timestamp) ||
+        !LCH_BufferPrintFormat(buffer, "%s", line)) {
+      LCH_BufferDestroy(buffer);
+      LCH_ListDestroy(block_ids);
+      return false;
+    }
+  }
+  LCH_ListDestroy(block_ids);
+
+  /* Other processes must never see the chain file incomplete */
+  char tmp_path[PATH_MAX];
+  const int ret = snprintf(tmp_path, PATH_MAX, "%s.tmp", index->path);
+  if (ret < 0 || ret >= PATH_MAX) {
+    LCH_LOG_ERROR("Failed to create temporary file path: Path too long");
+    LCH_BufferDestroy(buffer);
+    return false;
+  }
+
+  if (!LCH_BufferWriteFile(buffer, tmp_path)) {
+    LCH_BufferDestroy(buffer);
+    return false;
+  }
+  const size_t num_kept = LCH_BufferLength(buffer) / RECORD_SIZE;
+  LCH_BufferDestroy(buffer);
+
+  if (rename(tmp_path, index->path) != 0) {
+    LCH_LOG_ERROR("Failed to move file '%s' to '%s': %s", tmp_path,
+                  index->path, strerror(errno));
+    unlink(tmp_path);
+    return false;
+  }
+
+  LCH_LOG_DEBUG("Kept %zu out of %zu block headers in file '%s'", num_kept,
+                num_records, index->path);
+
+  /* Read the rewritten file from the start on the next lookup */
+  LCH_DictDestroy(index->records);
+  index->records = NULL;
+  return true;
+}
@@ -0,0 +1,73 @@
+#ifndef _LEECH_CHAIN_INDEX_H
+#define _LEECH_CHAIN_INDEX_H
+
+#include <stdbool.h>
+
+#include "dict.h"
+
+/**
+ * The chain index holds the header of each block (i.e., the identifier of its
+ * parent and its timestamp), such that the chain can be walked without
+ * loading and parsing the blocks. The headers are appended to the chain file
+ * in the working directory as blocks are stored, or when a block that is not
+ * yet indexed is loaded, and read back on first lookup. A lookup that misses
+ * picks up headers appended by other processes in the meantime.
+ *
+ * As blocks never change, neither do their headers. Hence, the index is only
+ * a cache: A header that is missing merely costs a block load, and headers of
+ * deleted blocks are harmless until they are dropped by a purge.
+ */
+typedef struct LCH_ChainIndex LCH_ChainIndex;
+
+/**
+ * @brief Create an (empty) chain index
+ * @param work_dir Leech work directory
+ * @return The chain index or NULL in case of failure
+ * @note The chain file is not read until the first lookup
+ */
+LCH_ChainIndex *LCH_ChainIndexCreate(const char *work_dir);
+
+/**
+ * @brief Destroy a chain index
+ * @param index The chain index
+ */
+void LCH_ChainIndexDestroy(void *index);
+
+/**
+ * @brief Look up the header of a block
+ * @param index The chain index
+ * @param block_id The block identifier
+ * @param parent_id The variable in which to store the parent block identifier,
+ *                  which is owned by the index
+ * @param timestamp The variable in which to store the timestamp of the block
+ * @param found The variable in which to store whether the block is indexed
+ * @return False in case of failure
+ * @note The parent block identifier is only valid until the index is modified
+ */
+bool LCH_ChainIndexGet(LCH_ChainIndex *index, const char *block_id,
+                       const char **parent_id, double *timestamp, bool *found);
+
+/**
+ * @brief Append the header of a block to the chain file
+ * @param index The chain index
+ * @param block_id The block identifier
+ * @param parent_id The parent block identifier
+ * @param timestamp The timestamp of the block
+ * @return False in case of failure
+ */
+bool LCH_ChainIndexAdd(LCH_ChainIndex *index, const char *block_id,
+                       const char *parent_id, double timestamp);
+
+/**
+ * @brief Drop the headers of all blocks that are not whitelisted
+ * @param index The chain index
+ * @param whitelist Dictionary with the identifiers of the blocks to keep as
+ *                  keys
+ * @return False in case of failure
+ * @note The chain file is rewritten to a temporary file, which then replaces
+ *       it. Headers appended by other processes in the meantime may be lost,
+ *       which only costs a block load on the next lookup.
+ */
+bool LCH_ChainIndexRetain(LCH_ChainIndex *index, const LCH_Dict *whitelist);
+
+#endif  // _LEECH_CHAIN_INDEX_H
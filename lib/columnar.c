@@ -0,0 +1,353 @@
+#include "columnar.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+
+#include "logger.h"
+
+/**
+ * Location of a field within the arena. Fields are followed by a NULL-byte in
+ * the arena, which is not included in the length.
+ */
+typedef struct {
+  size_t offset;
+  size_t length;
+} LCH_TableSlice;
+
+/**
+ * All field data is stored in one contiguous arena, in the order it was
+ * appended. Each column has an array of slices, indexed by row, pointing into
+ * the arena.
+ */
+struct LCH_Table {
+  size_t num_columns;
+  size_t num_rows;    // Number of complete rows
+  size_t num_fields;  // Number of fields in the incomplete row
+  size_t capacity;    // Number of rows allocated in each column
+  size_t num_removed;  // Number of rows marked for removal
+  LCH_TableSlice **columns;
+  bool *removed;  // Whether each row is marked for removal
+  LCH_Buffer *arena;
+};
+
+static bool EnsureCapacity(LCH_Table *const table, const size_t num_rows) {
+  assert(table != NULL);
+
+  if (num_rows <= table->capacity) {
+    return true;
+  }
+
+  size_t new_capacity = (table->capacity > 0) ? table->capacity : 1;
+  while (new_capacity < num_rows) {
+    new_capacity *= 2;
+  }
+
+  for (size_t i = 0; i < table->num_columns; i++) {
+    LCH_TableSlice *const column = (LCH_TableSlice *)realloc(
+        table->columns[i], sizeof(LCH_TableSlice) * new_capacity);
+    if (column == NULL) {
+      LCH_LOG_ERROR("Failed to expand table from %zu to %zu rows: %s",
+                    table->capacity, new_capacity, strerror(errno));
+      /* Columns expanded so far remain valid, as the capacity is only updated
+       * once all columns are expanded. */
+      return false;
+    }
+    table->columns[i] = column;
+  }
+
+  bool *const removed =
+      (bool *)realloc(table->removed, sizeof(bool) * new_capacity);
+  if (removed == NULL) {
+    LCH_LOG_ERROR("Failed to expand table from %zu to %zu rows: %s",
+                  table->capacity, new_capacity, strerror(errno));
+    return false;
+  }
+  table->removed = removed;
+
+  table->capacity = new_capacity;
+  return true;
+}
+
+LCH_Table *LCH_TableCreate(const size_t num_columns) {
+  assert(num_columns > 0);
+
+  LCH_Table *const table = (LCH_Table *)malloc(sizeof(LCH_Table));
+  if (table == NULL) {
+    LCH_LOG_ERROR("malloc(3): Failed to allocate memory: %s", strerror(errno));
+    return NULL;
+  }
+
+  table->num_columns = num_columns;
+  table->num_rows = 0;
+  table->num_fields = 0;
+  table->capacity = 0;
+  table->num_removed = 0;
+  table->removed = NULL;
+
+  table->columns =
+      (LCH_TableSlice **)calloc(num_columns, sizeof(LCH_TableSlice *));
+  if (table->columns == NULL) {
+    LCH_LOG_ERROR("calloc(3): Failed to allocate memory: %s", strerror(errno));
+    free(table);
+    return NULL;
+  }
+
+  table->arena = LCH_BufferCreate();
+  if (table->arena == NULL) {
+    free(table->columns);
+    free(table);
+    return NULL;
+  }
+
+  return table;
+}
+
+bool LCH_TableReserve(LCH_Table *const table, const size_t num_rows,
+                      const size_t num_bytes) {
+  assert(table != NULL);
+
+  if (!EnsureCapacity(table, num_rows)) {
+    return false;
+  }
+
+  /* Allocate and give back the memory in order to grow the arena in one go */
+  const size_t length = LCH_BufferLength(table->arena);
+  if (num_bytes > length) {
+    size_t offset;
+    if (!LCH_BufferAllocate(table->arena, num_bytes - length, &offset)) {
+      return false;
+    }
+    LCH_BufferChop(table->arena, offset);
+  }
+
+  return true;
+}
+
+size_t LCH_TableGetNumColumns(const LCH_Table *const table) {
+  assert(table != NULL);
+  return table->num_columns;
+}
+
+size_t LCH_TableGetNumRows(const LCH_Table *const table) {
+  assert(table != NULL);
+  return table->num_rows;
+}
+
+static bool ArenaAppend(LCH_Table *const table, const char *const data,
+                        const size_t length, LCH_TableSlice *const slice) {
+  assert(table != NULL);
+  assert(data != NULL || length == 0);
+  assert(slice != NULL);
+
+  /* The allocated memory is zeroed, which includes the terminating
+   * NULL-byte */
+  size_t offset;
+  if (!LCH_BufferAllocate(table->arena, length + 1, &offset)) {
+    return false;
+  }
+  if (length > 0) {
+    LCH_BufferSet(table->arena, offset, data, length);
+  }
+
+  slice->offset = offset;
+  slice->length = length;
+  return true;
+}
+
+bool LCH_TableAppendField(LCH_Table *const table, const char *const data,
+                          const size_t length) {
+  assert(table != NULL);
+  assert(table->num_fields < table->num_columns);
+
+  if (!EnsureCapacity(table, table->num_rows + 1)) {
+    return false;
+  }
+
+  LCH_TableSlice *const slice =
+      &table->columns[table->num_fields][table->num_rows];
+  if (!ArenaAppend(table, data, length, slice)) {
+    return false;
+  }
+
+  table->num_fields += 1;
+  if (table->num_fields == table->num_columns) {
+    table->removed[table->num_rows] = false;
+    table->num_fields = 0;
+    table->num_rows += 1;
+  }
+  return true;
+}
+
+bool LCH_TableAppendRecord(LCH_Table *const table,
+                           const LCH_List *const record) {
+  assert(table != NULL);
+  assert(record != NULL);
+  assert(table->num_fields == 0);
+
+  const size_t num_fields = LCH_ListLength(record);
+  if (num_fields != table->num_columns) {
+    LCH_LOG_ERROR(
+        "Failed to append record to table: Expected %zu fields, found %zu",
+        table->num_columns, num_fields);
+    return false;
+  }
+
+  for (size_t i = 0; i < num_fields; i++) {
+    const LCH_Buffer *const field = (LCH_Buffer *)LCH_ListGet(record, i);
+    if (!LCH_TableAppendField(table, LCH_BufferData(field),
+                              LCH_BufferLength(field))) {
+      /* Leave the table the way we found it */
+      table->num_fields = 0;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+const char *LCH_TableGetField(const LCH_Table *const table, const size_t row,
+                              const size_t column, size_t *const length) {
+  assert(table != NULL);
+  assert(row < table->num_rows);
+  assert(column < table->num_columns);
+
+  const LCH_TableSlice *const slice = &table->columns[column][row];
+  if (length != NULL) {
+    *length = slice->length;
+  }
+  return LCH_BufferData(table->arena) + slice->offset;
+}
+
+bool LCH_TableFieldEqual(const LCH_Table *const table, const size_t row,
+                         const size_t column, const LCH_Buffer *const value) {
+  assert(value != NULL);
+
+  size_t length;
+  const char *const field = LCH_TableGetField(table, row, column, &length);
+  const bool equal = (length == LCH_BufferLength(value)) &&
+                     (memcmp(field, LCH_BufferData(value), length) == 0);
+  return equal;
+}
+
+bool LCH_TableSetField(LCH_Table *const table, const size_t row,
+                       const size_t column, const char *const data,
+                       const size_t length) {
+  assert(table != NULL);
+  assert(row < table->num_rows);
+  assert(column < table->num_columns);
+
+  /* The previous value is left behind in the arena until the table is
+   * destroyed */
+  LCH_TableSlice slice;
+  if (!ArenaAppend(table, data, length, &slice)) {
+    return false;
+  }
+
+  table->columns[column][row] = slice;
+  return true;
+}
+
+void LCH_TableRemoveRow(LCH_Table *const table, const size_t row) {
+  assert(table != NULL);
+  assert(table->num_fields == 0);
+  assert(row < table->num_rows);
+  assert(!table->removed[row]);
+
+  table->removed[row] = true;
+  table->num_removed += 1;
+}
+
+bool LCH_TableIsRowRemoved(const LCH_Table *const table, const size_t row) {
+  assert(table != NULL);
+  assert(row < table->num_rows);
+  return table->removed[row];
+}
+
+void LCH_TableCompact(LCH_Table *const table) {
+  assert(table != NULL);
+  assert(table->num_fields == 0);
+
+  if (table->num_removed == 0) {
+    return;
+  }
+
+  for (size_t i = 0; i < table->num_columns; i++) {
+    LCH_TableSlice *const column = table->columns[i];
+    size_t num_kept = 0;
+    for (size_t row = 0; row < table->num_rows; row++) {
+      if (!table->removed[row]) {
+        column[num_kept++] = column[row];
+      }
+    }
+  }
+
+  table->num_rows -= table->num_removed;
+  table->num_removed = 0;
+  memset(table->removed, 0, sizeof(bool) * table->num_rows);
+}
+
+size_t LCH_TableGetColumnIndex(const LCH_Table *const table,
+                               const LCH_Buffer *const name) {
+  assert(table != NULL);
+  assert(name != NULL);
+  assert(table->num_rows > 0);  // Require a table header
+
+  for (size_t i = 0; i < table->num_columns; i++) {
+    if (LCH_TableFieldEqual(table, 0, i, name)) {
+      return i;
+    }
+  }
+  return table->num_columns;
+}
+
+LCH_Table *LCH_TableFromList(const LCH_List *const list) {
+  assert(list != NULL);
+
+  const size_t num_records = LCH_ListLength(list);
+  if (num_records == 0) {
+    LCH_LOG_ERROR("Failed to convert table: Missing table header");
+    return NULL;
+  }
+
+  const LCH_List *const header = (LCH_List *)LCH_ListGet(list, 0);
+  const size_t num_columns = LCH_ListLength(header);
+  if (num_columns == 0) {
+    LCH_LOG_ERROR("Failed to convert table: Table header has no columns");
+    return NULL;
+  }
+
+  LCH_Table *const table = LCH_TableCreate(num_columns);
+  if (table == NULL) {
+    return NULL;
+  }
+
+  if (!LCH_TableReserve(table, num_records, 0)) {
+    LCH_TableDestroy(table);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < num_records; i++) {
+    const LCH_List *const record = (LCH_List *)LCH_ListGet(list, i);
+    if (!LCH_TableAppendRecord(table, record)) {
+      LCH_LOG_ERROR("Failed to convert record %zu of table", i + 1);
+      LCH_TableDestroy(table);
+      return NULL;
+    }
+  }
+
+  return table;
+}
+
+void LCH_TableDestroy(void *const _table) {
+  LCH_Table *const table = (LCH_Table *)_table;
+  if (table != NULL) {
+    for (size_t i = 0; i < table->num_columns; i++) {
+      free(table->columns[i]);
+    }
+    free(table->columns);
+    free(table->removed);
+    LCH_BufferDestroy(table->arena);
+  }
+  free(table);
+}
@@ -0,0 +1,86 @@
+#ifndef _LEECH_COLUMNAR_H
+#define _LEECH_COLUMNAR_H
+
+#include <stdbool.h>
+
+#include "buffer.h"
+#include "leech.h"
+
+/**
+ * Put private LCH_Table functions here:
+ */
+
+/**
+ * @brief Append a complete row to a table
+ * @param table The table
+ * @param record One-dimentional list of buffers with one field per column
+ * @return False in case of failure
+ */
+bool LCH_TableAppendRecord(LCH_Table *table, const LCH_List *record);
+
+/**
+ * @brief Check if a field in a table is equal to a value
+ * @param table The table
+ * @param row The row index
+ * @param column The column index
+ * @param value The value to compare the field against
+ * @return True if the field is equal to the value
+ */
+bool LCH_TableFieldEqual(const LCH_Table *table, size_t row, size_t column,
+                         const LCH_Buffer *value);
+
+/**
+ * @brief Replace the value of a field in a table
+ * @param table The table
+ * @param row The row index
+ * @param column The column index
+ * @param data The new value
+ * @param length The length of the new value
+ * @return False in case of failure
+ * @note The previous value is not reclaimed until the table is destroyed
+ */
+bool LCH_TableSetField(LCH_Table *table, size_t row, size_t column,
+                       const char *data, size_t length);
+
+/**
+ * @brief Mark a row in a table for removal
+ * @param table The table
+ * @param row The row index
+ * @note The row is only marked, such that removing many rows does not shift
+ *       the remaining rows each time. Row indices stay the same, and marked
+ *       rows remain part of the table until LCH_TableCompact() is called.
+ */
+void LCH_TableRemoveRow(LCH_Table *table, size_t row);
+
+/**
+ * @brief Check whether a row in a table is marked for removal
+ * @param table The table
+ * @param row The row index
+ * @return True if the row is marked for removal
+ */
+bool LCH_TableIsRowRemoved(const LCH_Table *table, size_t row);
+
+/**
+ * @brief Remove the rows marked for removal from a table
+ * @param table The table
+ * @note The order of the remaining rows is preserved
+ */
+void LCH_TableCompact(LCH_Table *table);
+
+/**
+ * @brief Get the index of a column by its name in the table header
+ * @param table The table
+ * @param name The column name
+ * @return The column index or the number of columns if it was not found
+ */
+size_t LCH_TableGetColumnIndex(const LCH_Table *table, const LCH_Buffer *name);
+
+/**
+ * @brief Convert a two-dimentional list of buffers into a table
+ * @param list The two-dimentional list, starting with the table header
+ * @return The table or NULL in case of failure
+ * @note All records must have as many fields as the table header
+ */
+LCH_Table *LCH_TableFromList(const LCH_List *list);
+
+#endif  // _LEECH_COLUMNAR_H
@@ -0,0 +1,323 @@
+#include "compression.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <string.h>
+
+#ifdef HAVE_ZLIB_H
+#include <zlib.h>
+#endif  // HAVE_ZLIB_H
+
+#include "definitions.h"
+#include "logger.h"
+#include "string_lib.h"
+
+#define LCH_COMPRESSION_CHUNK_SIZE LCH_KIBIBYTE(64)
+
+static const char *const CODEC_NAMES[] = {
+    "none",
+    "zlib",
+};
+
+bool LCH_CompressionFromString(const char *const name,
+                               LCH_Compression *const method) {
+  assert(name != NULL);
+  assert(method != NULL);
+
+  if (LCH_StringEqual(name, CODEC_NAMES[LCH_COMPRESSION_NONE])) {
+    *method = LCH_COMPRESSION_NONE;
+    return true;
+  }
+
+  if (LCH_StringEqual(name, CODEC_NAMES[LCH_COMPRESSION_ZLIB])) {
+#ifdef HAVE_ZLIB_H
+    *method = LCH_COMPRESSION_ZLIB;
+    return true;
+#else   // HAVE_ZLIB_H
+    LCH_LOG_ERROR("Leech was built without support for compression method '%s'",
+                  name);
+    return false;
+#endif  // HAVE_ZLIB_H
+  }
+
+  LCH_LOG_ERROR("Unknown compression method '%s'", name);
+  return false;
+}
+
+const char *LCH_CompressionToString(const LCH_Compression method) {
+  /* Also used to log unsupported methods, so out of range is not a bug */
+  if ((size_t)method >= LCH_LENGTH(CODEC_NAMES)) {
+    return "unknown";
+  }
+  return CODEC_NAMES[method];
+}
+
+/******************************************************************************/
+
+static LCH_Buffer *CopyAsIs(const char *const data, const size_t length) {
+  LCH_Buffer *const buffer = LCH_BufferCreate();
+  if (buffer == NULL) {
+    return NULL;
+  }
+
+  if (length > 0) {
+    size_t offset;
+    if (!LCH_BufferAllocate(buffer, length, &offset)) {
+      LCH_BufferDestroy(buffer);
+      return NULL;
+    }
+    LCH_BufferSet(buffer, offset, data, length);
+  }
+
+  return buffer;
+}
+
+#ifdef HAVE_ZLIB_H
+static LCH_Buffer *CreateWithHeader(const LCH_Compression method) {
+  LCH_Buffer *const buffer = LCH_BufferCreate();
+  if (buffer == NULL) {
+    return NULL;
+  }
+
+  if (!LCH_BufferPrintFormat(buffer, "%c%s\n", LCH_COMPRESSION_HEADER_PREFIX,
+                             LCH_CompressionToString(method))) {
+    LCH_BufferDestroy(buffer);
+    return NULL;
+  }
+
+  return buffer;
+}
+
+static LCH_Buffer *ZlibCompress(const char *const data, const size_t length) {
+  if (length > UINT_MAX) {
+    LCH_LOG_ERROR("Failed to compress data: Too large (%zu bytes)", length);
+    return NULL;
+  }
+
+  LCH_Buffer *const buffer = CreateWithHeader(LCH_COMPRESSION_ZLIB);
+  if (buffer == NULL) {
+    return NULL;
+  }
+
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  int ret = deflateInit(&stream, Z_DEFAULT_COMPRESSION);
+  if (ret != Z_OK) {
+    LCH_LOG_ERROR("Failed to initialize zlib deflate stream: %s",
+                  (stream.msg != NULL) ? stream.msg : "Unknown error");
+    LCH_BufferDestroy(buffer);
+    return NULL;
+  }
+
+  /* Allocate the worst case output size up front, so that the data can be
+   * compressed in one go. */
+  const size_t bound = (size_t)deflateBound(&stream, (uLong)length);
+  size_t offset;
+  if (!LCH_BufferAllocate(buffer, bound, &offset)) {
+    deflateEnd(&stream);
+    LCH_BufferDestroy(buffer);
+    return NULL;
+  }
+
+  stream.next_in = (Bytef *)data;
+  stream.avail_in = (uInt)length;
+  stream.next_out = (Bytef *)buffer->buffer + offset;
+  stream.avail_out = (uInt)bound;
+
+  ret = deflate(&stream, Z_FINISH);
+  if (ret != Z_STREAM_END) {
+    LCH_LOG_ERROR("Failed to compress data: %s",
+                  (stream.msg != NULL) ? stream.msg : "Unknown error");
+    deflateEnd(&stream);
+    LCH_BufferDestroy(buffer);
+    return NULL;
+  }
+
+  buffer->length = offset + (size_t)stream.total_out;
+  buffer->buffer[buffer->length] = '\0';
+  deflateEnd(&stream);
+
+  LCH_LOG_DEBUG("Compressed %zu bytes into %zu bytes using zlib", length,
+                (size_t)stream.total_out);
+  return buffer;
+}
+
+static LCH_Buffer *ZlibDecompress(const char *const data, const size_t length) {
+  if (length > UINT_MAX) {
+    LCH_LOG_ERROR("Failed to decompress data: Too large (%zu bytes)", length);
+    return NULL;
+  }
+
+  LCH_Buffer *const buffer = LCH_BufferCreate();
+  if (buffer == NULL) {
+    return NULL;
+  }
+
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  stream.next_in = (Bytef *)data;
+  stream.avail_in = (uInt)length;
+
+  int ret = inflateInit(&stream);
+  if (ret != Z_OK) {
+    LCH_LOG_ERROR("Failed to initialize zlib inflate stream: %s",
+                  (stream.msg != NULL) ? stream.msg : "Unknown error");
+    LCH_BufferDestroy(buffer);
+    return NULL;
+  }
+
+  /* Inflate chunk by chunk straight into the output buffer */
+  do {
+    size_t offset;
+    if (!LCH_BufferAllocate(buffer, LCH_COMPRESSION_CHUNK_SIZE, &offset)) {
+      inflateEnd(&stream);
+      LCH_BufferDestroy(buffer);
+      return NULL;
+    }
+
+    stream.next_out = (Bytef *)buffer->buffer + offset;
+    stream.avail_out = LCH_COMPRESSION_CHUNK_SIZE;
+
+    ret = inflate(&stream, Z_NO_FLUSH);
+    if (ret != Z_OK && ret != Z_STREAM_END) {
+      LCH_LOG_ERROR("Failed to decompress data: %s",
+                    (stream.msg != NULL) ? stream.msg : "Unknown error");
+      inflateEnd(&stream);
+      LCH_BufferDestroy(buffer);
+      return NULL;
+    }
+
+    buffer->length -= stream.avail_out;
+    buffer->buffer[buffer->length] = '\0';
+
+    if (ret != Z_STREAM_END && stream.avail_in == 0 &&
+        stream.avail_out != 0) {
+      LCH_LOG_ERROR("Failed to decompress data: Unexpected end of stream");
+      inflateEnd(&stream);
+      LCH_BufferDestroy(buffer);
+      return NULL;
+    }
+  } while (ret != Z_STREAM_END);
+
+  inflateEnd(&stream);
+
+  LCH_LOG_DEBUG("Decompressed %zu bytes into %zu bytes using zlib", length,
+                buffer->length);
+  return buffer;
+}
+#endif  // HAVE_ZLIB_H
+
+LCH_Buffer *LCH_CompressionEncode(const char *const data, const size_t length,
+                                  const LCH_Compression method) {
+  assert(data != NULL || length == 0);
+
+  switch (method) {
+    case LCH_COMPRESSION_NONE:
+      return CopyAsIs(data, length);
+
+    case LCH_COMPRESSION_ZLIB:
+#ifdef HAVE_ZLIB_H
+      return ZlibCompress(data, length);
+#else   // HAVE_ZLIB_H
+      break;
+#endif  // HAVE_ZLIB_H
+  }
+
+  LCH_LOG_ERROR("Unsupported compression method '%s'",
+                LCH_CompressionToString(method));
+  return NULL;
+}
+
+LCH_Buffer *LCH_CompressionDecode(const char *const data, const size_t length) {
+  assert(data != NULL || length == 0);
+
+  if (length == 0 || data[0] != LCH_COMPRESSION_HEADER_PREFIX) {
+    return CopyAsIs(data, length);
+  }
+
+  const char *const end = (const char *)memchr(data, '\n', length);
+  if (end == NULL) {
+    LCH_LOG_ERROR("Failed to decompress data: Missing end of codec header");
+    return NULL;
+  }
+
+  const size_t header_length = (size_t)(end - data) + 1;
+  const size_t name_length = header_length - 2;  // Excluding '#' and '\n'
+
+  for (size_t i = 0; i < LCH_LENGTH(CODEC_NAMES); i++) {
+    if (strlen(CODEC_NAMES[i]) != name_length ||
+        strncmp(data + 1, CODEC_NAMES[i], name_length) != 0) {
+      continue;
+    }
+
+    switch ((LCH_Compression)i) {
+      case LCH_COMPRESSION_NONE:
+        return CopyAsIs(data + header_length, length - header_length);
+
+      case LCH_COMPRESSION_ZLIB:
+#ifdef HAVE_ZLIB_H
+        return ZlibDecompress(data + header_length, length - header_length);
+#else   // HAVE_ZLIB_H
+        LCH_LOG_ERROR(
+            "Failed to decompress data: Leech was built without support for "
+            "compression method '%s'",
+            CODEC_NAMES[i]);
+        return NULL;
+#endif  // HAVE_ZLIB_H
+    }
+  }
+
+  LCH_LOG_ERROR("Failed to decompress data: Unknown codec '%.*s'",
+                (int)name_length, data + 1);
+  return NULL;
+}
+
+/******************************************************************************/
+
+bool LCH_CompressionWriteFile(const LCH_Buffer *const buffer,
+                              const char *const filename,
+                              const LCH_Compression method) {
+  assert(buffer != NULL);
+  assert(filename != NULL);
+
+  if (method == LCH_COMPRESSION_NONE) {
+    return LCH_BufferReplaceFile(buffer, filename);
+  }
+
+  LCH_Buffer *const compressed =
+      LCH_CompressionEncode(buffer->buffer, buffer->length, method);
+  if (compressed == NULL) {
+    return false;
+  }
+
+  if (!LCH_BufferReplaceFile(compressed, filename)) {
+    LCH_BufferDestroy(compressed);
+    return false;
+  }
+
+  LCH_BufferDestroy(compressed);
+  return true;
+}
+
+LCH_Buffer *LCH_CompressionReadFile(const char *const filename) {
+  assert(filename != NULL);
+
+  LCH_Buffer *const raw = LCH_BufferMapFile(filename);
+  if (raw == NULL) {
+    return NULL;
+  }
+
+  if (raw->length == 0 || raw->buffer[0] != LCH_COMPRESSION_HEADER_PREFIX) {
+    return raw;
+  }
+
+  LCH_Buffer *const decompressed =
+      LCH_CompressionDecode(raw->buffer, raw->length);
+  LCH_BufferDestroy(raw);
+  if (decompressed == NULL) {
+    LCH_LOG_ERROR("Failed to decompress file '%s'", filename);
+    return NULL;
+  }
+
+  return decompressed;
+}
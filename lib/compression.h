@@ -0,0 +1,78 @@
+#ifndef _LEECH_COMPRESSION_H
+#define _LEECH_COMPRESSION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "buffer.h"
+
+/**
+ * Compressed data is prefixed with a header line containing the name of the
+ * codec (e.g. "#zlib\n"). Neither JSON nor the "SHA1=" patch prefix can start
+ * with '#', hence uncompressed data is still recognized as such.
+ */
+#define LCH_COMPRESSION_HEADER_PREFIX '#'
+
+typedef enum {
+  LCH_COMPRESSION_NONE = 0,
+  LCH_COMPRESSION_ZLIB,
+} LCH_Compression;
+
+/**
+ * @brief Get compression method from its name
+ * @param name Name of the compression method (i.e., "none" or "zlib")
+ * @param method Variable to store the compression method
+ * @return False in case of failure
+ * @note Fails if the compression method is unknown or if leech was built
+ *       without support for it
+ */
+bool LCH_CompressionFromString(const char *name, LCH_Compression *method);
+
+/**
+ * @brief Get the name of a compression method
+ * @param method The compression method
+ * @return The name of the compression method
+ */
+const char *LCH_CompressionToString(LCH_Compression method);
+
+/**
+ * @brief Compress data and prepend the codec header
+ * @param data The data to compress
+ * @param length The length of the data
+ * @param method The compression method
+ * @return Buffer containing the encoded data or NULL in case of failure
+ * @note With method LCH_COMPRESSION_NONE, the data is copied as is without any
+ *       header
+ */
+LCH_Buffer *LCH_CompressionEncode(const char *data, size_t length,
+                                  LCH_Compression method);
+
+/**
+ * @brief Detect the codec header and decompress data
+ * @param data The data to decompress
+ * @param length The length of the data
+ * @return Buffer containing the decoded data or NULL in case of failure
+ * @note Data without a codec header is copied as is
+ */
+LCH_Buffer *LCH_CompressionDecode(const char *data, size_t length);
+
+/**
+ * @brief Compress buffer and write it to file
+ * @param buffer The buffer to compress
+ * @param filename The file to write to
+ * @param method The compression method
+ * @return False in case of failure
+ */
+bool LCH_CompressionWriteFile(const LCH_Buffer *buffer, const char *filename,
+                              LCH_Compression method);
+
+/**
+ * @brief Read file and decompress its content
+ * @param filename The file to read from
+ * @return Buffer containing the decompressed content or NULL in case of
+ *         failure
+ * @note Files without a codec header are returned as is
+ */
+LCH_Buffer *LCH_CompressionReadFile(const char *filename);
+
+#endif  // _LEECH_COMPRESSION_H
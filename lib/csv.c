@@ -2,7 +2,11 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <stdint.h>
+#include <string.h>
 
+#include "columnar.h"
+#include "definitions.h"
 #include "logger.h"
 
 /**
@@ -19,65 +23,153 @@ typedef struct LCH_CSVParser {
   size_t column;          // Current column number (used in error messages)
 } LCH_CSVParser;
 
+/**
+ * The scanner below skips over text data a word (i.e., eight bytes) at a time.
+ * Each byte in the word is tested in parallel using the bit tricks from
+ * "Determine if a word has a byte less than / greater than n" (Sean Eron
+ * Anderson, Bit Twiddling Hacks). The tests may report false positives in
+ * the bytes following a match, but never for a word without one.
+ */
+#define ONES UINT64_C(0x0101010101010101)
+#define HIGHS UINT64_C(0x8080808080808080)
+#define WORD_SIZE sizeof(uint64_t)
+
+/**
+ * Returns true if the word contains a byte that may not be TEXTDATA, i.e., a
+ * COMMA, a DQUOTE, a control character (including CR, LF and TAB) or a byte
+ * above 0x7E.
+ */
+static bool HasSpecialByte(const uint64_t word) {
+  const uint64_t comma = word ^ (ONES * ',');
+  const uint64_t quote = word ^ (ONES * '"');
+  const uint64_t is_comma = (comma - ONES) & ~comma;
+  const uint64_t is_quote = (quote - ONES) & ~quote;
+  const uint64_t is_control = (word - (ONES * 0x20)) & ~word;
+  const uint64_t is_high = (word + (ONES * (0x7F - 0x7E))) | word;
+  return ((is_comma | is_quote | is_control | is_high) & HIGHS) != 0;
+}
+
+/**
+ * Returns a pointer to the first byte between cursor and end that is not
+ * TEXTDATA, or end if there is none.
+ */
+static const char *SkipTextData(const char *cursor, const char *const end) {
+  while (cursor < end) {
+    const size_t length = LCH_MIN((size_t)(end - cursor), WORD_SIZE);
+    if (length == WORD_SIZE) {
+      uint64_t word;
+      memcpy(&word, cursor, WORD_SIZE);  // Unaligned load
+      if (!HasSpecialByte(word)) {
+        cursor += WORD_SIZE;
+        continue;
+      }
+    }
+
+    /* Locate the exact byte (TAB is allowed, hence we may continue) */
+    const char *const stop = cursor + length;
+    while ((cursor < stop) && TEXTDATA(cursor[0])) {
+      cursor += 1;
+    }
+    if (cursor < stop) {
+      break;
+    }
+  }
+  return cursor;
+}
+
+/**
+ * Copies data into the buffer, replacing each 2DQUOTE with a DQUOTE.
+ */
+static bool AppendUnescaped(LCH_Buffer *const buffer, const char *data,
+                            size_t length) {
+  assert(buffer != NULL);
+
+  while (length > 0) {
+    const char *const quote = (const char *)memchr(data, '"', length);
+    /* Include the first of the two double quotes in the chunk */
+    const size_t chunk =
+        (quote == NULL) ? length : (size_t)(quote - data) + 1;
+
+    if (!LCH_BufferAppendBytes(buffer, data, chunk)) {
+      return false;
+    }
+
+    if (quote == NULL) {
+      break;
+    }
+    assert(chunk < length && data[chunk] == '"');
+    data += chunk + 1;
+    length -= chunk + 1;
+  }
+  return true;
+}
+
 /**
  * escaped = DQUOTE *(TEXTDATA / COMMA / CR / LF / 2DQUOTE) DQUOTE
+ *
+ * The slice excludes the enclosing double quotes. The escaped flag is set if
+ * the slice contains 2DQUOTE's that need to be unescaped.
  */
-static bool ParseEscaped(LCH_CSVParser *const parser, LCH_Buffer *const field) {
+static bool ScanEscaped(LCH_CSVParser *const parser, const char **const data,
+                        size_t *const length, bool *const escaped) {
   assert(parser != NULL);
   assert(parser->cursor != NULL);
   assert(parser->end != NULL);
-  assert(field != NULL);
 
   // Remove leading double quote
   assert(parser->cursor[0] == '"');
   parser->cursor += 1;
 
+  const char *const start = parser->cursor;
+  *escaped = false;
+
   while (parser->cursor < parser->end) {
-    if (((parser->cursor + 1) < parser->end) &&
-        (parser->cursor[0] == '"' && parser->cursor[1] == '"')) {
+    const char *const quote = (const char *)memchr(
+        parser->cursor, '"', (size_t)(parser->end - parser->cursor));
+    if (quote == NULL) {
+      break;
+    }
+
+    if (((quote + 1) < parser->end) && (quote[1] == '"')) {
       // Found escaped quote in field
-      if (!LCH_BufferAppend(field, '"')) {
-        return false;
-      }
-      parser->cursor += 2;
-    } else if (parser->cursor[0] == '"') {
-      // Reached end of field
-      parser->cursor += 1;
+      *escaped = true;
+      parser->cursor = quote + 2;
+      continue;
+    }
 
-      // Trim trailing spaces
-      while (((parser->cursor) < parser->end) && (parser->cursor[0] == ' ')) {
-        parser->cursor += 1;
-      }
+    // Reached end of field
+    *data = start;
+    *length = (size_t)(quote - start);
+    parser->cursor = quote + 1;
 
-      if (parser->cursor >= parser->end) {
-        // Reached End-of-Buffer
-        return true;
-      }
+    // Trim trailing spaces
+    while (((parser->cursor) < parser->end) && (parser->cursor[0] == ' ')) {
+      parser->cursor += 1;
+    }
 
-      if ((parser->cursor < parser->end) && (parser->cursor[0] == ',')) {
-        // Reached End-of-Field
-        return true;
-      }
+    if (parser->cursor >= parser->end) {
+      // Reached End-of-Buffer
+      return true;
+    }
 
-      if ((parser->cursor + 1 < parser->end) && (parser->cursor[0] == '\r') &&
-          (parser->cursor[1] == '\n')) {
-        // Reached End-of-Record
-        return true;
-      }
+    if ((parser->cursor < parser->end) && (parser->cursor[0] == ',')) {
+      // Reached End-of-Field
+      return true;
+    }
 
-      LCH_LOG_ERROR(
-          "Failed to parse CSV: Expected End-of-Buffer, COMMA or CRLF, but "
-          "found token %#02x (Row %zu, Col %zu)",
-          parser->cursor[0], parser->row, parser->column);
-      return false;
-    } else {
-      // Found byte
-      if (!LCH_BufferAppend(field, parser->cursor[0])) {
-        return false;
-      }
-      parser->cursor += 1;
+    if ((parser->cursor + 1 < parser->end) && (parser->cursor[0] == '\r') &&
+        (parser->cursor[1] == '\n')) {
+      // Reached End-of-Record
+      return true;
     }
+
+    LCH_LOG_ERROR(
+        "Failed to parse CSV: Expected End-of-Buffer, COMMA or CRLF, but "
+        "found token %#02x (Row %zu, Col %zu)",
+        parser->cursor[0], parser->row, parser->column);
+    return false;
   }
+
   LCH_LOG_ERROR(
       "Failed to parse CSV: Expected DQUOTE, but reached End-of-Buffer (Row "
       "%zu, Col %zu)",
@@ -88,28 +180,21 @@ static bool ParseEscaped(LCH_CSVParser *const parser, LCH_Buffer *const field) {
 /**
  * non-escaped = *TEXTDATA
  */
-static bool ParseNonEscaped(LCH_CSVParser *const parser,
-                            LCH_Buffer *const field) {
+static bool ScanNonEscaped(LCH_CSVParser *const parser,
+                           const char **const data, size_t *const length) {
   assert(parser != NULL);
   assert(parser->cursor != NULL);
   assert(parser->end != NULL);
-  assert(field != NULL);
 
-  while (parser->cursor < parser->end) {
-    if (((parser->cursor + 1) < parser->end) && parser->cursor[0] == '\r' &&
-        parser->cursor[1] == '\n') {
-      // Reached end of record
-      break;
-    } else if (parser->cursor[0] == ',') {
-      // Reached end of field
-      break;
-    } else if (TEXTDATA(parser->cursor[0])) {
-      // Found text data
-      if (!LCH_BufferAppend(field, parser->cursor[0])) {
-        return false;
-      }
-      parser->cursor += 1;
-    } else {
+  const char *const start = parser->cursor;
+  parser->cursor = SkipTextData(parser->cursor, parser->end);
+
+  if (parser->cursor < parser->end) {
+    const bool end_of_field = parser->cursor[0] == ',';
+    const bool end_of_record = ((parser->cursor + 1) < parser->end) &&
+                               (parser->cursor[0] == '\r') &&
+                               (parser->cursor[1] == '\n');
+    if (!end_of_field && !end_of_record) {
       LCH_LOG_ERROR(
           "Failed to parse CSV: Expected End-of-Buffer, TEXTDATA, COMMA or "
           "CRLF, but found token %#02x (Row %zu, Col %zu)",
@@ -117,49 +202,110 @@ static bool ParseNonEscaped(LCH_CSVParser *const parser,
       return false;
     }
   }
-  LCH_BufferTrim(field, ' ');  // Remove trailing spaces
+
+  // Remove trailing spaces
+  size_t field_length = (size_t)(parser->cursor - start);
+  while ((field_length > 0) && (start[field_length - 1] == ' ')) {
+    field_length -= 1;
+  }
+
+  *data = start;
+  *length = field_length;
   return true;
 }
 
 /**
  * field = escaped / non-escaped
+ *
+ * The field is returned as a slice of the input. If the escaped flag is set,
+ * the slice must be unescaped using AppendUnescaped().
  */
-static LCH_Buffer *ParseField(LCH_CSVParser *const parser) {
+static bool ScanField(LCH_CSVParser *const parser, const char **const data,
+                      size_t *const length, bool *const escaped) {
   assert(parser != NULL);
   assert(parser->cursor != NULL);
   assert(parser->end != NULL);
+  assert(data != NULL);
+  assert(length != NULL);
+  assert(escaped != NULL);
 
   // Trim leading spaces
   while ((parser->cursor < parser->end) && (parser->cursor[0] == ' ')) {
     parser->cursor += 1;
   }
 
+  *data = parser->cursor;
+  *length = 0;
+  *escaped = false;
+
+  if (parser->cursor < parser->end) {
+    if (parser->cursor[0] == '"') {
+      return ScanEscaped(parser, data, length, escaped);
+    }
+    return ScanNonEscaped(parser, data, length);
+  }
+
+  return true;
+}
+
+static bool ParseFieldInto(LCH_CSVParser *const parser,
+                           LCH_Buffer *const field) {
+  assert(field != NULL);
+
+  const char *data;
+  size_t length;
+  bool escaped;
+  if (!ScanField(parser, &data, &length, &escaped)) {
+    return false;
+  }
+
+  if (escaped) {
+    return AppendUnescaped(field, data, length);
+  }
+
+  return LCH_BufferAppendBytes(field, data, length);
+}
+
+static LCH_Buffer *ParseField(LCH_CSVParser *const parser) {
   LCH_Buffer *const field = LCH_BufferCreate();
   if (field == NULL) {
     return NULL;
   }
 
-  if (parser->cursor < parser->end) {
-    if (parser->cursor[0] == '"') {
-      if (!ParseEscaped(parser, field)) {
-        LCH_BufferDestroy(field);
-        return NULL;
-      }
-    } else {
-      if (!ParseNonEscaped(parser, field)) {
-        LCH_BufferDestroy(field);
-        return NULL;
-      }
-    }
+  if (!ParseFieldInto(parser, field)) {
+    LCH_BufferDestroy(field);
+    return NULL;
   }
 
   return field;
 }
 
+/**
+ * Counts the occurrences of ch between cursor and end. Quoted occurrences are
+ * counted as well. Hence, the result is only an upper bound used to size lists
+ * up front.
+ */
+static size_t CountBytes(const char *cursor, const char *const end,
+                         const char ch) {
+  size_t count = 0;
+  while (cursor < end) {
+    cursor = (const char *)memchr(cursor, ch, (size_t)(end - cursor));
+    if (cursor == NULL) {
+      break;
+    }
+    count += 1;
+    cursor += 1;
+  }
+  return count;
+}
+
 /**
  * record = field *(COMMA field)
+ *
+ * If the expected number of fields is zero, it is estimated from the input.
  */
-static LCH_List *ParseRecord(LCH_CSVParser *const parser) {
+static LCH_List *ParseRecord(LCH_CSVParser *const parser,
+                             size_t num_fields) {
   assert(parser != NULL);
   assert(parser->cursor != NULL);
 
@@ -168,6 +314,19 @@ static LCH_List *ParseRecord(LCH_CSVParser *const parser) {
     return NULL;
   }
 
+  if (num_fields == 0) {
+    const char *line_end = (const char *)memchr(
+        parser->cursor, '\n', (size_t)(parser->end - parser->cursor));
+    if (line_end == NULL) {
+      line_end = parser->end;
+    }
+    num_fields = CountBytes(parser->cursor, line_end, ',') + 1;
+  }
+  if (!LCH_ListReserve(record, num_fields)) {
+    LCH_ListDestroy(record);
+    return NULL;
+  }
+
   LCH_Buffer *field = ParseField(parser);
   if (field == NULL) {
     LCH_ListDestroy(record);
@@ -211,7 +370,15 @@ static LCH_List *ParseTable(LCH_CSVParser *const parser) {
     return NULL;
   }
 
-  LCH_List *record = ParseRecord(parser);
+  /* There is one record per line, plus possibly one without trailing CRLF */
+  const size_t num_records =
+      CountBytes(parser->cursor, parser->end, '\n') + 1;
+  if (!LCH_ListReserve(table, num_records)) {
+    LCH_ListDestroy(table);
+    return NULL;
+  }
+
+  LCH_List *record = ParseRecord(parser, 0);
   if (record == NULL) {
     LCH_ListDestroy(table);
     return NULL;
@@ -237,7 +404,8 @@ static LCH_List *ParseTable(LCH_CSVParser *const parser) {
     parser->row += 1;
     parser->column = 1;
 
-    record = ParseRecord(parser);
+    /* Records usually have as many fields as the first one */
+    record = ParseRecord(parser, LCH_ListLength(LCH_ListGet(table, 0)));
     if (record == NULL) {
       LCH_ListDestroy(table);
       return NULL;
@@ -254,6 +422,139 @@ static LCH_List *ParseTable(LCH_CSVParser *const parser) {
   return table;
 }
 
+/**
+ * Parses a record straight into the table. Fields are copied directly from
+ * the input into the table, except for fields containing escaped double
+ * quotes, which are unescaped into the scratch buffer first. Hence, parsing
+ * does not allocate memory per field.
+ */
+static bool ParseRecordColumnar(LCH_CSVParser *const parser,
+                                LCH_Table *const table,
+                                LCH_Buffer *const scratch) {
+  assert(parser != NULL);
+  assert(table != NULL);
+  assert(scratch != NULL);
+
+  const size_t num_columns = LCH_TableGetNumColumns(table);
+  size_t num_fields = 0;
+  while (true) {
+    const char *data;
+    size_t length;
+    bool escaped;
+    if (!ScanField(parser, &data, &length, &escaped)) {
+      return false;
+    }
+
+    if (num_fields >= num_columns) {
+      LCH_LOG_ERROR(
+          "Failed to parse CSV: Expected %zu fields, but found more (Row %zu)",
+          num_columns, parser->row);
+      return false;
+    }
+
+    if (escaped) {
+      LCH_BufferChop(scratch, 0);
+      if (!AppendUnescaped(scratch, data, length)) {
+        return false;
+      }
+      data = LCH_BufferData(scratch);
+      length = LCH_BufferLength(scratch);
+    }
+
+    if (!LCH_TableAppendField(table, data, length)) {
+      return false;
+    }
+    num_fields += 1;
+
+    if ((parser->cursor >= parser->end) || (parser->cursor[0] != ',')) {
+      break;
+    }
+    parser->column += 1;
+    parser->cursor += 1;
+  }
+
+  if (num_fields != num_columns) {
+    LCH_LOG_ERROR(
+        "Failed to parse CSV: Expected %zu fields, but found %zu (Row %zu)",
+        num_columns, num_fields, parser->row);
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * table = record *(CRLF record) [CRLF]
+ *
+ * The table header determines the number of columns.
+ */
+static LCH_Table *ParseTableColumnar(LCH_CSVParser *const parser) {
+  assert(parser != NULL);
+  assert(parser->cursor != NULL);
+
+  LCH_List *const header = ParseRecord(parser, 0);
+  if (header == NULL) {
+    return NULL;
+  }
+
+  LCH_Table *const table = LCH_TableCreate(LCH_ListLength(header));
+  if (table == NULL) {
+    LCH_ListDestroy(header);
+    return NULL;
+  }
+
+  /* There is one record per line, plus possibly one without trailing CRLF.
+   * Field data never takes up more space than the input, except for the
+   * NULL-byte terminating each field. */
+  const size_t num_records =
+      CountBytes(parser->cursor, parser->end, '\n') + 2;
+  const size_t num_bytes = (size_t)(parser->end - parser->cursor) +
+                           (num_records * LCH_TableGetNumColumns(table));
+  if (!LCH_TableReserve(table, num_records, num_bytes)) {
+    LCH_TableDestroy(table);
+    LCH_ListDestroy(header);
+    return NULL;
+  }
+
+  if (!LCH_TableAppendRecord(table, header)) {
+    LCH_TableDestroy(table);
+    LCH_ListDestroy(header);
+    return NULL;
+  }
+  LCH_ListDestroy(header);
+
+  LCH_Buffer *const scratch = LCH_BufferCreate();
+  if (scratch == NULL) {
+    LCH_TableDestroy(table);
+    return NULL;
+  }
+
+  while (parser->cursor < parser->end) {
+    assert(parser->cursor + 1 < parser->end);
+    assert(parser->cursor[0] == '\r');
+    assert(parser->cursor[1] == '\n');
+    parser->cursor += 2;
+
+    if (parser->cursor >= parser->end) {
+      // This was just the optional trailing CRLF
+      break;
+    }
+
+    parser->row += 1;
+    parser->column = 1;
+
+    if (!ParseRecordColumnar(parser, table, scratch)) {
+      LCH_BufferDestroy(scratch);
+      LCH_TableDestroy(table);
+      return NULL;
+    }
+  }
+
+  LCH_BufferDestroy(scratch);
+  assert(parser->cursor == parser->end);
+  return table;
+}
+
 LCH_Buffer *LCH_CSVParseField(const char *const csv, const size_t size) {
   assert(csv != NULL);
 
@@ -281,13 +582,70 @@ LCH_List *LCH_CSVParseRecord(const char *const csv, const size_t size) {
       .column = 1,
   };
 
-  LCH_List *const record = ParseRecord(&parser);
+  LCH_List *const record = ParseRecord(&parser, 0);
   if (record == NULL) {
     return NULL;
   }
   return record;
 }
 
+bool LCH_CSVForEachField(const char *const csv, const size_t size,
+                         const LCH_CSVFieldFn fn, void *const data) {
+  assert(csv != NULL);
+  assert(fn != NULL);
+
+  LCH_CSVParser parser = {
+      .cursor = csv,
+      .end = csv + size,
+      .row = 1,
+      .column = 1,
+  };
+
+  /* Only allocated if we come across a field that needs to be unescaped */
+  LCH_Buffer *unescaped = NULL;
+
+  while (true) {
+    const char *field;
+    size_t length;
+    bool escaped;
+    if (!ScanField(&parser, &field, &length, &escaped)) {
+      LCH_BufferDestroy(unescaped);
+      return false;
+    }
+
+    if (escaped) {
+      if (unescaped == NULL) {
+        unescaped = LCH_BufferCreate();
+        if (unescaped == NULL) {
+          return false;
+        }
+      }
+
+      LCH_BufferChop(unescaped, 0);
+      if (!AppendUnescaped(unescaped, field, length)) {
+        LCH_BufferDestroy(unescaped);
+        return false;
+      }
+      field = LCH_BufferData(unescaped);
+      length = LCH_BufferLength(unescaped);
+    }
+
+    if (!fn(field, length, data)) {
+      LCH_BufferDestroy(unescaped);
+      return false;
+    }
+
+    if ((parser.cursor >= parser.end) || (parser.cursor[0] != ',')) {
+      break;
+    }
+    parser.column += 1;
+    parser.cursor += 1;
+  }
+
+  LCH_BufferDestroy(unescaped);
+  return true;
+}
+
 LCH_List *LCH_CSVParseTable(const char *str, const size_t size) {
   assert(str != NULL);
 
@@ -303,16 +661,11 @@ LCH_List *LCH_CSVParseTable(const char *str, const size_t size) {
 }
 
 LCH_List *LCH_CSVParseFile(const char *const path) {
-  LCH_Buffer *const buffer = LCH_BufferCreate();
+  LCH_Buffer *const buffer = LCH_BufferMapFile(path);
   if (buffer == NULL) {
     return NULL;
   }
 
-  if (!LCH_BufferReadFile(buffer, path)) {
-    LCH_BufferDestroy(buffer);
-    return NULL;
-  }
-
   const char *const csv = LCH_BufferData(buffer);
   const size_t size = LCH_BufferLength(buffer);
 
@@ -326,55 +679,71 @@ LCH_List *LCH_CSVParseFile(const char *const path) {
   return table;
 }
 
+LCH_Table *LCH_CSVParseTableColumnar(const char *const csv,
+                                     const size_t size) {
+  assert(csv != NULL);
+
+  LCH_CSVParser parser = {
+      .cursor = csv,
+      .end = csv + size,
+      .row = 1,
+      .column = 1,
+  };
+
+  LCH_Table *const table = ParseTableColumnar(&parser);
+  return table;
+}
+
+LCH_Table *LCH_CSVParseFileColumnar(const char *const path) {
+  LCH_Buffer *const buffer = LCH_BufferMapFile(path);
+  if (buffer == NULL) {
+    return NULL;
+  }
+
+  LCH_Table *const table = LCH_CSVParseTableColumnar(
+      LCH_BufferData(buffer), LCH_BufferLength(buffer));
+  LCH_BufferDestroy(buffer);
+  return table;
+}
+
 static bool ComposeField(LCH_Buffer *const csv, const char *const raw,
                          const size_t size) {
   assert(csv != NULL);
   assert(raw != NULL);
 
-  LCH_Buffer *temp = LCH_BufferCreate();
-  if (temp == NULL) {
-    return false;
+  /* Fields starting with or ending with a space should be escaped, and so
+   * should fields containing anything but TEXTDATA */
+  const bool escape = (size > 0 && (raw[0] == ' ' || raw[size - 1] == ' ')) ||
+                      (SkipTextData(raw, raw + size) < (raw + size));
+  if (!escape) {
+    return LCH_BufferAppendBytes(csv, raw, size);
   }
 
-  /* Fields starting with or ending with a space should be escaped */
-  bool escape = size > 0 && (raw[0] == ' ' || raw[size - 1] == ' ');
+  if (!LCH_BufferAppend(csv, '"')) {
+    return false;
+  }
 
-  for (size_t i = 0; i < size; i++) {
-    if (!TEXTDATA(raw[i])) {
-      escape = true;
-      if (raw[i] == '"') {
-        if (!LCH_BufferPrintFormat(temp, "\"\"")) {
-          LCH_BufferDestroy(temp);
-          return false;
-        }
-        continue;
-      }
-    }
-    if (!LCH_BufferAppend(temp, raw[i])) {
-      LCH_BufferDestroy(temp);
+  /* Copy everything in bulk, doubling each DQUOTE */
+  const char *cursor = raw;
+  size_t remaining = size;
+  while (remaining > 0) {
+    const char *const quote = (const char *)memchr(cursor, '"', remaining);
+    /* Include the double quote in the chunk */
+    const size_t chunk =
+        (quote == NULL) ? remaining : (size_t)(quote - cursor) + 1;
+    if (!LCH_BufferAppendBytes(csv, cursor, chunk)) {
       return false;
     }
-  }
-
-  if (escape) {
-    if (!LCH_BufferAppend(csv, '"')) {
-      LCH_BufferDestroy(temp);
+    if (quote != NULL && !LCH_BufferAppend(csv, '"')) {
       return false;
     }
+    cursor += chunk;
+    remaining -= chunk;
   }
 
-  if (!LCH_BufferAppendBuffer(csv, temp)) {
-    LCH_BufferDestroy(temp);
+  if (!LCH_BufferAppend(csv, '"')) {
     return false;
   }
-  LCH_BufferDestroy(temp);
-
-  if (escape) {
-    if (!LCH_BufferAppend(csv, '"')) {
-      return false;
-    }
-  }
-
   return true;
 }
 
@@ -389,11 +758,11 @@ bool LCH_CSVComposeField(LCH_Buffer **const _csv, const char *const raw,
   const size_t offset = LCH_BufferLength(csv);
   if (!ComposeField(csv, raw, size)) {
     if (create_buffer) {
-      LCH_BufferChop(csv, offset);
-    } else {
       LCH_BufferDestroy(csv);
+    } else {
+      LCH_BufferChop(csv, offset);
     }
-    return NULL;
+    return false;
   }
 
   *_csv = csv;
@@ -461,7 +830,7 @@ bool LCH_CSVComposeTable(LCH_Buffer **const _csv, const LCH_List *const table) {
   const size_t length = LCH_ListLength(table);
   for (size_t i = 0; i < length; i++) {
     if (i > 0) {
-      if (!LCH_BufferPrintFormat(csv, "\r\n")) {
+      if (!LCH_BufferAppendBytes(csv, "\r\n", 2)) {
         if (create_buffer) {
           LCH_BufferDestroy(csv);
         } else {
@@ -502,3 +871,111 @@ bool LCH_CSVComposeFile(const LCH_List *table, const char *path) {
   LCH_BufferDestroy(buffer);
   return true;
 }
+
+/**
+ * Composes the given columns of a row, or all columns if columns is NULL.
+ */
+static bool ComposeRecordColumnar(LCH_Buffer *const csv,
+                                  const LCH_Table *const table,
+                                  const size_t row, const size_t *const columns,
+                                  const size_t num_columns) {
+  assert(csv != NULL);
+  assert(table != NULL);
+
+  for (size_t i = 0; i < num_columns; i++) {
+    if (i > 0) {
+      if (!LCH_BufferAppend(csv, ',')) {
+        return false;
+      }
+    }
+
+    const size_t column = (columns != NULL) ? columns[i] : i;
+    size_t length;
+    const char *const raw = LCH_TableGetField(table, row, column, &length);
+    if (!ComposeField(csv, raw, length)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool LCH_CSVComposeRecordColumnar(LCH_Buffer **const _csv,
+                                  const LCH_Table *const table,
+                                  const size_t row, const size_t *const columns,
+                                  size_t num_columns) {
+  assert(_csv != NULL);
+  assert(table != NULL);
+
+  if (columns == NULL) {
+    num_columns = LCH_TableGetNumColumns(table);
+  }
+
+  const bool create_buffer = *_csv == NULL;
+  LCH_Buffer *const csv = (create_buffer) ? LCH_BufferCreate() : *_csv;
+  if (csv == NULL) {
+    return false;
+  }
+  const size_t offset = LCH_BufferLength(csv);
+
+  if (!ComposeRecordColumnar(csv, table, row, columns, num_columns)) {
+    if (create_buffer) {
+      LCH_BufferDestroy(csv);
+    } else {
+      LCH_BufferChop(csv, offset);
+    }
+    return false;
+  }
+
+  *_csv = csv;
+  return true;
+}
+
+bool LCH_CSVComposeTableColumnar(LCH_Buffer **const _csv,
+                                 const LCH_Table *const table) {
+  assert(_csv != NULL);
+  assert(table != NULL);
+
+  const bool create_buffer = *_csv == NULL;
+  LCH_Buffer *const csv = (create_buffer) ? LCH_BufferCreate() : *_csv;
+  if (csv == NULL) {
+    return false;
+  }
+  const size_t offset = LCH_BufferLength(csv);
+
+  const size_t num_rows = LCH_TableGetNumRows(table);
+  const size_t num_columns = LCH_TableGetNumColumns(table);
+  for (size_t i = 0; i < num_rows; i++) {
+    if ((i > 0 && !LCH_BufferAppendBytes(csv, "\r\n", 2)) ||
+        !ComposeRecordColumnar(csv, table, i, NULL, num_columns)) {
+      if (create_buffer) {
+        LCH_BufferDestroy(csv);
+      } else {
+        LCH_BufferChop(csv, offset);
+      }
+      return false;
+    }
+  }
+
+  *_csv = csv;
+  return true;
+}
+
+bool LCH_CSVComposeFileColumnar(const LCH_Table *const table,
+                                const char *const path) {
+  assert(table != NULL);
+  assert(path != NULL);
+
+  LCH_Buffer *buffer = NULL;
+  if (!LCH_CSVComposeTableColumnar(&buffer, table)) {
+    return false;
+  }
+
+  if (!LCH_BufferWriteFile(buffer, path)) {
+    LCH_BufferDestroy(buffer);
+    return false;
+  }
+
+  LCH_BufferDestroy(buffer);
+  return true;
+}
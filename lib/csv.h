@@ -2,6 +2,7 @@
 #define _LEECH_CSV_H
 
 #include "buffer.h"
+#include "columnar.h"
 #include "list.h"
 
 /**
@@ -38,6 +39,30 @@ LCH_List *LCH_CSVParseRecord(const char *csv, size_t len);
  */
 LCH_Buffer *LCH_CSVParseField(const char *csv, size_t len);
 
+/**
+ * @brief Function called for each field visited by LCH_CSVForEachField()
+ * @param field The unescaped field (not null-byte terminated)
+ * @param len The length of the field
+ * @param data The data argument passed to LCH_CSVForEachField()
+ * @return False to stop visiting fields
+ */
+typedef bool (*LCH_CSVFieldFn)(const char *field, size_t len, void *data);
+
+/**
+ * @brief Visit the fields of a CSV formatted record
+ * @param csv The CSV formatted string
+ * @param len The length of the CSV formatted string (excluding the optional
+ *            terminating null-byte).
+ * @param fn Function called for each field in order
+ * @param data Data argument passed on to the function
+ * @return False in case of failure, or if the function returns false
+ * @note Unlike LCH_CSVParseRecord(), fields are not copied into a list.
+ *       Fields are passed as slices of the CSV string, unless they contain
+ *       escaped double quotes.
+ */
+bool LCH_CSVForEachField(const char *csv, size_t len, LCH_CSVFieldFn fn,
+                         void *data);
+
 /**
  * @brief Parse a CSV formatted file into a table
  * @param path Path to CSV file
@@ -47,6 +72,25 @@ LCH_Buffer *LCH_CSVParseField(const char *csv, size_t len);
  */
 LCH_List *LCH_CSVParseFile(const char *path);
 
+/**
+ * @brief Parse a CSV formatted string into a columnar table
+ * @param csv The CSV formatted string
+ * @param len The length of the CSV formatted string (excluding the optional
+ *            terminating null-byte)
+ * @return The table or NULL in case of failure
+ * @note The first record determines the number of columns, and all other
+ *       records must have the same number of fields
+ */
+LCH_Table *LCH_CSVParseTableColumnar(const char *csv, size_t len);
+
+/**
+ * @brief Parse a CSV formatted file into a columnar table
+ * @param path Path to CSV file
+ * @return The table or NULL in case of failure
+ * @note See LCH_CSVParseTableColumnar()
+ */
+LCH_Table *LCH_CSVParseFileColumnar(const char *path);
+
 /****************************************************************************/
 
 /**
@@ -87,4 +131,38 @@ bool LCH_CSVComposeField(LCH_Buffer **csv, const char *const raw, size_t len);
  */
 bool LCH_CSVComposeFile(const LCH_List *table, const char *path);
 
+/**
+ * @brief Compose a CSV formatted string from a row in a columnar table
+ * @param csv The buffer in which to write the resulting CSV string
+ * @param table The table
+ * @param row The row index
+ * @param columns The indices of the columns to include in the given order, or
+ *                NULL to include all columns
+ * @param num_columns The number of column indices (ignored if columns is
+ *                    NULL)
+ * @return False in case of failure
+ * @note If the CSV buffer is NULL, then a new buffer is allocated on the heap
+ */
+bool LCH_CSVComposeRecordColumnar(LCH_Buffer **csv, const LCH_Table *table,
+                                  size_t row, const size_t *columns,
+                                  size_t num_columns);
+
+/**
+ * @brief Compose a CSV formatted string from a columnar table
+ * @param csv The buffer in which to write the resulting CSV string
+ * @param table The table
+ * @return False in case of failure
+ * @note If the CSV buffer is NULL, then a new buffer is allocated on the heap
+ */
+bool LCH_CSVComposeTableColumnar(LCH_Buffer **csv, const LCH_Table *table);
+
+/**
+ * @brief Compose a CSV file from a columnar table
+ * @param table The table
+ * @param path Path to CSV file in which to write the resulting CSV
+ * @return False in case of failure
+ * @note The file will be created/trunctated
+ */
+bool LCH_CSVComposeFileColumnar(const LCH_Table *table, const char *path);
+
 #endif  // _LEECH_CSV_H
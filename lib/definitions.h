@@ -3,13 +3,27 @@
 
 /**
  * @brief Bump this when ever changing the specification of a patch.
+ * @note Version 2 introduced the binary encoding (see encoding.h).
  */
-#define LCH_PATCH_VERSION 1
+#define LCH_PATCH_VERSION 2
+
+/**
+ * @brief Version written to JSON encoded patches.
+ * @note Peers predating the binary encoding reject patches above version 1.
+ */
+#define LCH_PATCH_VERSION_JSON 1
 
 /**
  * @brief Bump this when ever changing the specification of a block.
+ * @note Version 2 introduced the binary encoding (see encoding.h).
  */
-#define LCH_BLOCK_VERSION 1
+#define LCH_BLOCK_VERSION 2
+
+/**
+ * @brief Version written to JSON encoded blocks.
+ * @note Peers predating the binary encoding reject blocks above version 1.
+ */
+#define LCH_BLOCK_VERSION_JSON 1
 
 /**
  * @brief Utility macro to specify kilo bytes as an exponential with base 2.
@@ -32,6 +46,12 @@
  */
 #define LCH_GENISIS_BLOCK_ID "0000000000000000000000000000000000000000"
 
+/**
+ * @brief Length of the row digests stored in snapshots (i.e., the first 128
+ * bits of the SHA-1 digest as hex characters).
+ */
+#define LCH_ROW_DIGEST_LENGTH 32
+
 /**
  * @breif Utility macro to compute the length of an array.
  */
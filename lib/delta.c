@@ -1,10 +1,16 @@
 #include "delta.h"
 
 #include <assert.h>
+#include <stdio.h>
 
+#include "csv.h"
 #include "logger.h"
+#include "string_lib.h"
 #include "utils.h"
 
+/* Large enough to hold any field index printed as a decimal number */
+#define LCH_FIELD_INDEX_MAX 32
+
 LCH_Json *LCH_DeltaCreate(const char *const table_id, const char *const type,
                           const LCH_Json *const new_state,
                           const LCH_Json *const old_state) {
@@ -167,10 +173,532 @@ bool LCH_DeltaGetNumOperations(const LCH_Json *const delta,
       assert(updates != NULL);
       *num_updates = LCH_JsonObjectLength(updates);
     } else {
-      *num_deletes = 0;
+      *num_updates = 0;
+    }
+  }
+
+  return true;
+}
+
+static bool ResolveValues(const LCH_Json *const operations,
+                          const LCH_Json *const new_state) {
+  LCH_List *const keys = LCH_JsonObjectGetKeys(operations);
+  if (keys == NULL) {
+    return false;
+  }
+
+  const size_t num_keys = LCH_ListLength(keys);
+  for (size_t i = 0; i < num_keys; i++) {
+    const LCH_Buffer *const key = (LCH_Buffer *)LCH_ListGet(keys, i);
+
+    LCH_Json *value;
+    if (new_state == NULL) {
+      value = LCH_JsonNullCreate();
+    } else {
+      const LCH_Json *const original = LCH_JsonObjectGet(new_state, key);
+      value = (original == NULL) ? NULL : LCH_JsonCopy(original);
+    }
+
+    if (value == NULL) {
+      LCH_ListDestroy(keys);
+      return false;
+    }
+
+    if (!LCH_JsonObjectSet(operations, key, value)) {
+      LCH_JsonDestroy(value);
+      LCH_ListDestroy(keys);
+      return false;
+    }
+  }
+
+  LCH_ListDestroy(keys);
+  return true;
+}
+
+bool LCH_DeltaResolveDigests(const LCH_Json *const delta,
+                             const LCH_Json *const new_state) {
+  assert(delta != NULL);
+  assert(new_state != NULL);
+
+  const LCH_Json *const inserts = LCH_DeltaGetInserts(delta);
+  if (inserts == NULL || !ResolveValues(inserts, new_state)) {
+    return false;
+  }
+
+  const LCH_Json *const updates = LCH_DeltaGetUpdates(delta);
+  if (updates == NULL || !ResolveValues(updates, new_state)) {
+    return false;
+  }
+
+  /* The deleted values are lost, but only the key is required to delete a
+   * record. Hence, we use null as place holder (same as when merging). */
+  const LCH_Json *const deletes = LCH_DeltaGetDeletes(delta);
+  if (deletes == NULL || !ResolveValues(deletes, NULL)) {
+    return false;
+  }
+
+  return true;
+}
+
+static bool ParseFieldIndex(const LCH_Buffer *const key,
+                            const size_t num_fields, size_t *const index) {
+  long number;
+  if (!LCH_StringParseNumber(LCH_BufferData(key), &number)) {
+    return false;
+  }
+
+  if (number < 0 || (size_t)number >= num_fields) {
+    LCH_LOG_ERROR(
+        "Field index %ld in partial update is out of bounds (%zu fields)",
+        number, num_fields);
+    return false;
+  }
+
+  *index = (size_t)number;
+  return true;
+}
+
+static bool NarrowUpdate(const LCH_Json *const updates,
+                         const LCH_Buffer *const key,
+                         const LCH_Buffer *const old_value) {
+  const LCH_Buffer *const new_value = LCH_JsonObjectGetString(updates, key);
+  if (new_value == NULL) {
+    return false;
+  }
+
+  LCH_List *const new_fields = LCH_CSVParseRecord(LCH_BufferData(new_value),
+                                                  LCH_BufferLength(new_value));
+  if (new_fields == NULL) {
+    return false;
+  }
+
+  LCH_List *const old_fields = LCH_CSVParseRecord(LCH_BufferData(old_value),
+                                                  LCH_BufferLength(old_value));
+  if (old_fields == NULL) {
+    LCH_ListDestroy(new_fields);
+    return false;
+  }
+
+  const size_t num_fields = LCH_ListLength(new_fields);
+  if (num_fields != LCH_ListLength(old_fields)) {
+    /* The fields cannot be compared one by one, so we keep the full update */
+    LCH_ListDestroy(old_fields);
+    LCH_ListDestroy(new_fields);
+    return true;
+  }
+
+  LCH_Json *const partial = LCH_JsonObjectCreate();
+  if (partial == NULL) {
+    LCH_ListDestroy(old_fields);
+    LCH_ListDestroy(new_fields);
+    return false;
+  }
+
+  for (size_t i = 0; i < num_fields; i++) {
+    const LCH_Buffer *const new_field =
+        (LCH_Buffer *)LCH_ListGet(new_fields, i);
+    const LCH_Buffer *const old_field =
+        (LCH_Buffer *)LCH_ListGet(old_fields, i);
+    if (LCH_BufferEqual(new_field, old_field)) {
+      continue;
+    }
+
+    char index[LCH_FIELD_INDEX_MAX];
+    const int ret = snprintf(index, sizeof(index), "%zu", i);
+    assert(ret >= 0 && (size_t)ret < sizeof(index));
+    (void)ret;
+
+    const LCH_Buffer field_key = LCH_BufferStaticFromString(index);
+    if (!LCH_JsonObjectSetStringDuplicate(partial, &field_key, new_field)) {
+      LCH_JsonDestroy(partial);
+      LCH_ListDestroy(old_fields);
+      LCH_ListDestroy(new_fields);
+      return false;
+    }
+  }
+  LCH_ListDestroy(old_fields);
+  LCH_ListDestroy(new_fields);
+
+  if (LCH_JsonObjectLength(partial) == num_fields) {
+    /* All fields changed, nothing to gain from a partial update */
+    LCH_JsonDestroy(partial);
+    return true;
+  }
+
+  if (!LCH_JsonObjectSet(updates, key, partial)) {
+    LCH_JsonDestroy(partial);
+    return false;
+  }
+
+  return true;
+}
+
+bool LCH_DeltaNarrowUpdates(const LCH_Json *const delta,
+                            const LCH_Json *const old_state) {
+  assert(delta != NULL);
+  assert(old_state != NULL);
+
+  const LCH_Json *const updates = LCH_DeltaGetUpdates(delta);
+  if (updates == NULL) {
+    return false;
+  }
+
+  LCH_List *const keys = LCH_JsonObjectGetKeys(updates);
+  if (keys == NULL) {
+    return false;
+  }
+
+  const size_t num_keys = LCH_ListLength(keys);
+  for (size_t i = 0; i < num_keys; i++) {
+    const LCH_Buffer *const key = (LCH_Buffer *)LCH_ListGet(keys, i);
+
+    const LCH_Buffer *const old_value = LCH_JsonObjectGetString(old_state, key);
+    if (old_value == NULL) {
+      LCH_ListDestroy(keys);
+      return false;
+    }
+
+    if (!NarrowUpdate(updates, key, old_value)) {
+      LCH_ListDestroy(keys);
+      return false;
+    }
+  }
+
+  LCH_ListDestroy(keys);
+  return true;
+}
+
+LCH_List *LCH_DeltaGetRecordFields(const LCH_Json *const record) {
+  assert(record != NULL);
+
+  if (LCH_JsonIsString(record)) {
+    const LCH_Buffer *const csv = LCH_JsonStringGet(record);
+    return LCH_CSVParseRecord(LCH_BufferData(csv), LCH_BufferLength(csv));
+  }
+
+  if (!LCH_JsonIsArray(record)) {
+    LCH_LOG_ERROR(
+        "Expected record to be of type string or array, found type %s",
+        LCH_JsonGetTypeAsString(record));
+    return NULL;
+  }
+
+  LCH_List *const fields = LCH_ListCreate();
+  if (fields == NULL) {
+    return NULL;
+  }
+
+  const size_t num_fields = LCH_JsonArrayLength(record);
+  if (!LCH_ListReserve(fields, num_fields)) {
+    LCH_ListDestroy(fields);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < num_fields; i++) {
+    const LCH_Buffer *const field = LCH_JsonArrayGetString(record, i);
+    if (field == NULL) {
+      LCH_ListDestroy(fields);
+      return NULL;
+    }
+
+    /* The field is borrowed from the record */
+    if (!LCH_ListAppend(fields, (void *)field, NULL)) {
+      LCH_ListDestroy(fields);
+      return NULL;
+    }
+  }
+
+  return fields;
+}
+
+static bool GetPartialUpdateFields(const LCH_Json *const partial,
+                                   const LCH_List *const subsidiary_fields,
+                                   LCH_List *const fields,
+                                   LCH_List *const values) {
+  LCH_List *const keys = LCH_JsonObjectGetKeys(partial);
+  if (keys == NULL) {
+    return false;
+  }
+
+  const size_t num_keys = LCH_ListLength(keys);
+  for (size_t i = 0; i < num_keys; i++) {
+    const LCH_Buffer *const key = (LCH_Buffer *)LCH_ListGet(keys, i);
+
+    size_t index;
+    if (!ParseFieldIndex(key, LCH_ListLength(subsidiary_fields), &index)) {
+      LCH_ListDestroy(keys);
+      return false;
+    }
+
+    const LCH_Buffer *const value = LCH_JsonObjectGetString(partial, key);
+    if (value == NULL) {
+      LCH_ListDestroy(keys);
+      return false;
+    }
+
+    LCH_Buffer *const field =
+        LCH_BufferDuplicate((LCH_Buffer *)LCH_ListGet(subsidiary_fields, index));
+    if (field == NULL) {
+      LCH_ListDestroy(keys);
+      return false;
+    }
+
+    if (!LCH_ListAppend(fields, field, LCH_BufferDestroy)) {
+      LCH_BufferDestroy(field);
+      LCH_ListDestroy(keys);
+      return false;
+    }
+
+    LCH_Buffer *const duplicate = LCH_BufferDuplicate(value);
+    if (duplicate == NULL) {
+      LCH_ListDestroy(keys);
+      return false;
+    }
+
+    if (!LCH_ListAppend(values, duplicate, LCH_BufferDestroy)) {
+      LCH_BufferDestroy(duplicate);
+      LCH_ListDestroy(keys);
+      return false;
+    }
+  }
+
+  LCH_ListDestroy(keys);
+  return true;
+}
+
+bool LCH_DeltaGetUpdatedFields(const LCH_Json *const value,
+                               const LCH_List *const subsidiary_fields,
+                               LCH_List **const fields,
+                               LCH_List **const values) {
+  assert(value != NULL);
+  assert(subsidiary_fields != NULL);
+  assert(fields != NULL);
+  assert(values != NULL);
+
+  if (LCH_JsonIsString(value) || LCH_JsonIsArray(value)) {
+    *values = LCH_DeltaGetRecordFields(value);
+    if (*values == NULL) {
+      return false;
+    }
+
+    if (LCH_ListLength(*values) != LCH_ListLength(subsidiary_fields)) {
+      LCH_LOG_ERROR(
+          "Number of fields in record does not match the number of subsidiary "
+          "fields in table (%zu != %zu)",
+          LCH_ListLength(*values), LCH_ListLength(subsidiary_fields));
+      LCH_ListDestroy(*values);
+      return false;
+    }
+
+    *fields = LCH_ListCopy(subsidiary_fields,
+                           (LCH_DuplicateFn)LCH_BufferDuplicate,
+                           LCH_BufferDestroy);
+    if (*fields == NULL) {
+      LCH_ListDestroy(*values);
+      return false;
+    }
+
+    return true;
+  }
+
+  if (!LCH_JsonIsObject(value)) {
+    LCH_LOG_ERROR(
+        "Expected update value to be of type string, array or object, found "
+        "type %s",
+        LCH_JsonGetTypeAsString(value));
+    return false;
+  }
+
+  *fields = LCH_ListCreate();
+  if (*fields == NULL) {
+    return false;
+  }
+
+  *values = LCH_ListCreate();
+  if (*values == NULL) {
+    LCH_ListDestroy(*fields);
+    return false;
+  }
+
+  if (!GetPartialUpdateFields(value, subsidiary_fields, *fields, *values)) {
+    LCH_ListDestroy(*values);
+    LCH_ListDestroy(*fields);
+    return false;
+  }
+
+  return true;
+}
+
+static LCH_Json *ApplyPartialUpdate(const LCH_Buffer *const record,
+                                    const LCH_Json *const partial) {
+  LCH_List *const fields =
+      LCH_CSVParseRecord(LCH_BufferData(record), LCH_BufferLength(record));
+  if (fields == NULL) {
+    return NULL;
+  }
+
+  LCH_List *const keys = LCH_JsonObjectGetKeys(partial);
+  if (keys == NULL) {
+    LCH_ListDestroy(fields);
+    return NULL;
+  }
+
+  const size_t num_keys = LCH_ListLength(keys);
+  for (size_t i = 0; i < num_keys; i++) {
+    const LCH_Buffer *const key = (LCH_Buffer *)LCH_ListGet(keys, i);
+
+    size_t index;
+    if (!ParseFieldIndex(key, LCH_ListLength(fields), &index)) {
+      LCH_ListDestroy(keys);
+      LCH_ListDestroy(fields);
+      return NULL;
+    }
+
+    const LCH_Buffer *const value = LCH_JsonObjectGetString(partial, key);
+    if (value == NULL) {
+      LCH_ListDestroy(keys);
+      LCH_ListDestroy(fields);
+      return NULL;
+    }
+
+    LCH_Buffer *const duplicate = LCH_BufferDuplicate(value);
+    if (duplicate == NULL) {
+      LCH_ListDestroy(keys);
+      LCH_ListDestroy(fields);
+      return NULL;
+    }
+
+    LCH_ListSet(fields, index, duplicate, LCH_BufferDestroy);
+  }
+  LCH_ListDestroy(keys);
+
+  LCH_Buffer *csv = NULL;
+  if (!LCH_CSVComposeRecord(&csv, fields)) {
+    LCH_ListDestroy(fields);
+    return NULL;
+  }
+  LCH_ListDestroy(fields);
+
+  LCH_Json *const json = LCH_JsonStringCreate(csv);
+  if (json == NULL) {
+    LCH_BufferDestroy(csv);
+    return NULL;
+  }
+
+  return json;
+}
+
+static LCH_Json *MergePartialUpdates(const LCH_Json *const parent_partial,
+                                     const LCH_Json *const child_partial) {
+  LCH_Json *const merged = LCH_JsonCopy(parent_partial);
+  if (merged == NULL) {
+    return NULL;
+  }
+
+  LCH_List *const keys = LCH_JsonObjectGetKeys(child_partial);
+  if (keys == NULL) {
+    LCH_JsonDestroy(merged);
+    return NULL;
+  }
+
+  const size_t num_keys = LCH_ListLength(keys);
+  for (size_t i = 0; i < num_keys; i++) {
+    const LCH_Buffer *const key = (LCH_Buffer *)LCH_ListGet(keys, i);
+
+    const LCH_Buffer *const value = LCH_JsonObjectGetString(child_partial, key);
+    if (value == NULL) {
+      LCH_ListDestroy(keys);
+      LCH_JsonDestroy(merged);
+      return NULL;
+    }
+
+    if (!LCH_JsonObjectSetStringDuplicate(merged, key, value)) {
+      LCH_ListDestroy(keys);
+      LCH_JsonDestroy(merged);
+      return NULL;
     }
   }
 
+  LCH_ListDestroy(keys);
+  return merged;
+}
+
+/**
+ * Combine the value of an insert- or update operation with the value of a
+ * subsequent update operation. Full updates (CSV records) replace whatever was
+ * there, while partial updates (objects of changed fields) are applied on top.
+ */
+static LCH_Json *MergeUpdateValues(const LCH_Json *const parent_value,
+                                   const LCH_Json *const child_value) {
+  if (!LCH_JsonIsObject(child_value)) {
+    return LCH_JsonCopy(child_value);
+  }
+
+  if (LCH_JsonIsObject(parent_value)) {
+    return MergePartialUpdates(parent_value, child_value);
+  }
+
+  if (!LCH_JsonIsString(parent_value)) {
+    LCH_LOG_ERROR(
+        "Expected value to be of type string or object, found type %s",
+        LCH_JsonGetTypeAsString(parent_value));
+    return NULL;
+  }
+
+  const LCH_Buffer *const record = LCH_JsonStringGet(parent_value);
+  return ApplyPartialUpdate(record, child_value);
+}
+
+/**
+ * Check whether the value of an update operation agrees with the value of a
+ * subsequent delete operation. For partial updates, only the changed fields
+ * are compared.
+ */
+static bool UpdateMatchesRecord(const LCH_Json *const update,
+                                const LCH_Json *const record,
+                                bool *const matches) {
+  if (!LCH_JsonIsObject(update) || !LCH_JsonIsString(record)) {
+    *matches = LCH_JsonEqual(update, record);
+    return true;
+  }
+
+  const LCH_Buffer *const csv = LCH_JsonStringGet(record);
+  LCH_List *const fields =
+      LCH_CSVParseRecord(LCH_BufferData(csv), LCH_BufferLength(csv));
+  if (fields == NULL) {
+    return false;
+  }
+
+  LCH_List *const keys = LCH_JsonObjectGetKeys(update);
+  if (keys == NULL) {
+    LCH_ListDestroy(fields);
+    return false;
+  }
+
+  *matches = true;
+  const size_t num_keys = LCH_ListLength(keys);
+  for (size_t i = 0; i < num_keys && *matches; i++) {
+    const LCH_Buffer *const key = (LCH_Buffer *)LCH_ListGet(keys, i);
+
+    size_t index;
+    if (!ParseFieldIndex(key, LCH_ListLength(fields), &index)) {
+      LCH_ListDestroy(keys);
+      LCH_ListDestroy(fields);
+      return false;
+    }
+
+    const LCH_Buffer *const value = LCH_JsonObjectGetString(update, key);
+    if (value == NULL) {
+      LCH_ListDestroy(keys);
+      LCH_ListDestroy(fields);
+      return false;
+    }
+
+    *matches = LCH_BufferEqual(value, (LCH_Buffer *)LCH_ListGet(fields, index));
+  }
+
+  LCH_ListDestroy(keys);
+  LCH_ListDestroy(fields);
   return true;
 }
 
@@ -192,6 +720,21 @@ static LCH_Json *DeltaRemoveUpdates(LCH_Json *const delta) {
   return value;
 }
 
+/**
+ * Returns the key in a printable form for log messages. Since the merge
+ * functions visit every key, and most of their messages are debug messages,
+ * it is only computed on first use. The result is stored in printable, which
+ * the caller must free.
+ */
+static const char *PrintableKey(const LCH_Buffer *const key,
+                                char **const printable) {
+  if (*printable == NULL) {
+    *printable = LCH_BufferToPrintable(key);
+  }
+  /* Error is already logged */
+  return (*printable != NULL) ? *printable : "(unknown)";
+}
+
 static bool MergeInsertOperations(const LCH_Json *const parent,
                                   LCH_Json *const child_inserts) {
   assert(parent != NULL);
@@ -221,12 +764,7 @@ static bool MergeInsertOperations(const LCH_Json *const parent,
   for (size_t i = 0; i < num_keys; i++) {
     const LCH_Buffer *const key = (LCH_Buffer *)LCH_ListGet(keys, i);
 
-    char *const printable_key = LCH_BufferToPrintable(key);
-    if (printable_key == NULL) {
-      /* Error is already logged */
-      LCH_ListDestroy(keys);
-      return false;
-    }
+    char *printable_key = NULL;  // Computed on demand by PrintableKey()
 
     if (LCH_JsonObjectHasKey(parent_inserts, key)) {
       //////////////////////////////////////////////////////////////////////////
@@ -236,7 +774,7 @@ static bool MergeInsertOperations(const LCH_Json *const parent,
       // parent_insert(key, val) -> child_insert(key, val) => ERROR
       LCH_LOG_ERROR(
           "Found two subsequent insert operations on the same key (key=%s)",
-          printable_key);
+          PrintableKey(key, &printable_key));
       free(printable_key);
       LCH_ListDestroy(keys);
       return false;
@@ -269,13 +807,13 @@ static bool MergeInsertOperations(const LCH_Json *const parent,
         LCH_LOG_DEBUG(
             "Merging: delete(key, val) -> insert(key, val) => NOOP "
             "(key=%s)",
-            printable_key);
+            PrintableKey(key, &printable_key));
         LCH_JsonDestroy(child_value);
       } else {
         LCH_LOG_DEBUG(
             "Merging: delete(key, val1) -> insert(key, val2) => update(key, "
             "val2) (key=%s)",
-            printable_key);
+            PrintableKey(key, &printable_key));
 
         if (!LCH_JsonObjectSet(parent_updates, key, child_value)) {
           LCH_JsonDestroy(child_value);
@@ -298,7 +836,7 @@ static bool MergeInsertOperations(const LCH_Json *const parent,
       LCH_LOG_ERROR(
           "Found an update operation followed by an insert operation on the "
           "same key (key=%s)",
-          printable_key);
+          PrintableKey(key, &printable_key));
       free(printable_key);
       LCH_ListDestroy(keys);
       return false;
@@ -306,7 +844,7 @@ static bool MergeInsertOperations(const LCH_Json *const parent,
 
     LCH_LOG_DEBUG(
         "Merging: NOOP -> insert(key, val) => insert(key, val) (key=%s)",
-        printable_key);
+        PrintableKey(key, &printable_key));
     LCH_Json *const child_value = LCH_JsonObjectRemove(child_inserts, key);
     if (child_value == NULL) {
       free(printable_key);
@@ -357,11 +895,7 @@ static bool MergeDeleteOperations(const LCH_Json *const parent,
   for (size_t i = 0; i < num_keys; i++) {
     const LCH_Buffer *const key = (LCH_Buffer *)LCH_ListGet(keys, i);
 
-    char *const printable_key = LCH_BufferToPrintable(key);
-    if (printable_key == NULL) {
-      LCH_ListDestroy(keys);
-      return false;
-    }
+    char *printable_key = NULL;  // Computed on demand by PrintableKey()
 
     if (LCH_JsonObjectHasKey(parent_inserts, key)) {
       //////////////////////////////////////////////////////////////////////////
@@ -393,13 +927,13 @@ static bool MergeDeleteOperations(const LCH_Json *const parent,
         LCH_LOG_DEBUG(
             "Merging: insert(key, val) -> delete(key, val) => NOOP "
             "(key=%s)",
-            printable_key);
+            PrintableKey(key, &printable_key));
       } else if (!is_null) {
         // insert(key, val1) -> delete(key, val2) => ERROR
         LCH_LOG_ERROR(
             "Found insert operation followed by delete operation on the same "
             "key, but with different values (key=%s)",
-            printable_key);
+            PrintableKey(key, &printable_key));
         free(printable_key);
         LCH_ListDestroy(keys);
         return false;
@@ -407,7 +941,7 @@ static bool MergeDeleteOperations(const LCH_Json *const parent,
         LCH_LOG_DEBUG(
             "Merging: insert(key, val) -> delete(key, null) => NOOP "
             "(key=%s)",
-            printable_key);
+            PrintableKey(key, &printable_key));
       }
       free(printable_key);
       continue;
@@ -421,7 +955,7 @@ static bool MergeDeleteOperations(const LCH_Json *const parent,
       // parent_delete(key, val) -> child_delete(key, val) => ERROR
       LCH_LOG_ERROR(
           "Found two subsequent delete operations on the same key (key=%s)",
-          printable_key);
+          PrintableKey(key, &printable_key));
       free(printable_key);
       LCH_ListDestroy(keys);
       return false;
@@ -447,7 +981,14 @@ static bool MergeDeleteOperations(const LCH_Json *const parent,
         return false;
       }
 
-      const bool is_equal = LCH_JsonEqual(parent_value, child_value);
+      bool is_equal;
+      if (!UpdateMatchesRecord(parent_value, child_value, &is_equal)) {
+        LCH_JsonDestroy(child_value);
+        LCH_JsonDestroy(parent_value);
+        free(printable_key);
+        LCH_ListDestroy(keys);
+        return false;
+      }
       LCH_JsonDestroy(parent_value);
 
       const bool is_null = LCH_JsonIsNull(child_value);
@@ -457,12 +998,12 @@ static bool MergeDeleteOperations(const LCH_Json *const parent,
         LCH_LOG_DEBUG(
             "Merging: update(key, val) -> delete(key, val) => delete(key, "
             "null) (key=%s)",
-            printable_key);
+            PrintableKey(key, &printable_key));
       } else if (!is_null) {
         LCH_LOG_ERROR(
             "Found an update operation followed by a delete operation on the "
             "same key, but with different values (key=%s)",
-            printable_key);
+            PrintableKey(key, &printable_key));
         free(printable_key);
         LCH_ListDestroy(keys);
         return false;
@@ -470,7 +1011,7 @@ static bool MergeDeleteOperations(const LCH_Json *const parent,
         LCH_LOG_DEBUG(
             "Merging: update(key, val) -> delete(key, null) => delete(key, "
             "null) (key=%s)",
-            printable_key);
+            PrintableKey(key, &printable_key));
       }
 
       /* We have to use null as place holder, because we have no clue what the
@@ -497,7 +1038,7 @@ static bool MergeDeleteOperations(const LCH_Json *const parent,
 
     LCH_LOG_DEBUG(
         "Merging: NOOP -> delete(key, val) => delete(key, val) (key=%s)",
-        printable_key);
+        PrintableKey(key, &printable_key));
     LCH_Json *const child_value = LCH_JsonObjectRemove(child_deletes, key);
     if (!LCH_JsonObjectSet(parent_deletes, key, child_value)) {
       free(printable_key);
@@ -541,12 +1082,7 @@ static bool MergeUpdateOperations(const LCH_Json *const parent,
   for (size_t i = 0; i < num_keys; i++) {
     const LCH_Buffer *const key = (LCH_Buffer *)LCH_ListGet(keys, i);
 
-    char *const printable_key = LCH_BufferToPrintable(key);
-    if (printable_key == NULL) {
-      /* Error already logged */
-      LCH_ListDestroy(keys);
-      return false;
-    }
+    char *printable_key = NULL;  // Computed on demand by PrintableKey()
 
     if (LCH_JsonObjectHasKey(parent_inserts, key)) {
       //////////////////////////////////////////////////////////////////////////
@@ -556,10 +1092,26 @@ static bool MergeUpdateOperations(const LCH_Json *const parent,
       LCH_LOG_DEBUG(
           "Merging: insert(key, val1) -> update(key, val2) => insert(key, "
           "val2) (key=%s)",
-          printable_key);
+          PrintableKey(key, &printable_key));
 
-      LCH_Json *const child_value = LCH_JsonObjectRemove(child_updates, key);
-      if (!LCH_JsonObjectSet(parent_inserts, key, child_value)) {
+      const LCH_Json *const parent_value =
+          LCH_JsonObjectGet(parent_inserts, key);
+      const LCH_Json *const child_value = LCH_JsonObjectGet(child_updates, key);
+      if (parent_value == NULL || child_value == NULL) {
+        free(printable_key);
+        LCH_ListDestroy(keys);
+        return false;
+      }
+
+      LCH_Json *const value = MergeUpdateValues(parent_value, child_value);
+      if (value == NULL) {
+        free(printable_key);
+        LCH_ListDestroy(keys);
+        return false;
+      }
+
+      if (!LCH_JsonObjectSet(parent_inserts, key, value)) {
+        LCH_JsonDestroy(value);
         free(printable_key);
         LCH_ListDestroy(keys);
         return false;
@@ -577,7 +1129,7 @@ static bool MergeUpdateOperations(const LCH_Json *const parent,
       LCH_LOG_DEBUG(
           "Found a delete block followed by an update operation on the same "
           "key (key=%s)",
-          printable_key);
+          PrintableKey(key, &printable_key));
       free(printable_key);
       LCH_ListDestroy(keys);
       return false;
@@ -591,11 +1143,26 @@ static bool MergeUpdateOperations(const LCH_Json *const parent,
       LCH_LOG_DEBUG(
           "Merging: update(key, val1) -> update(key, val2) => update(key, "
           "val2) (key=%s)",
-          printable_key);
+          PrintableKey(key, &printable_key));
 
-      LCH_Json *const child_value = LCH_JsonObjectRemove(child_updates, key);
-      if (!LCH_JsonObjectSet(parent_updates, key, child_value)) {
-        LCH_JsonDestroy(child_value);
+      const LCH_Json *const parent_value =
+          LCH_JsonObjectGet(parent_updates, key);
+      const LCH_Json *const child_value = LCH_JsonObjectGet(child_updates, key);
+      if (parent_value == NULL || child_value == NULL) {
+        free(printable_key);
+        LCH_ListDestroy(keys);
+        return false;
+      }
+
+      LCH_Json *const value = MergeUpdateValues(parent_value, child_value);
+      if (value == NULL) {
+        free(printable_key);
+        LCH_ListDestroy(keys);
+        return false;
+      }
+
+      if (!LCH_JsonObjectSet(parent_updates, key, value)) {
+        LCH_JsonDestroy(value);
         free(printable_key);
         LCH_ListDestroy(keys);
         return false;
@@ -607,7 +1174,7 @@ static bool MergeUpdateOperations(const LCH_Json *const parent,
 
     LCH_LOG_DEBUG(
         "Merging: NOOP -> update(key, val) => update(key, val) (key=%s)",
-        printable_key);
+        PrintableKey(key, &printable_key));
     LCH_Json *const child_value = LCH_JsonObjectRemove(child_updates, key);
     if (!LCH_JsonObjectSet(parent_updates, key, child_value)) {
       LCH_JsonDestroy(child_value);
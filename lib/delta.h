@@ -2,6 +2,7 @@
 #define _LEECH_DELTA_H
 
 #include "json.h"
+#include "list.h"
 
 /**
  * @brief Create a patch between two table states
@@ -67,12 +68,60 @@ const LCH_Json *LCH_DeltaGetUpdates(const LCH_Json *delta);
 bool LCH_DeltaGetNumOperations(const LCH_Json *delta, size_t *num_inserts,
                                size_t *num_deletes, size_t *num_updates);
 
+/**
+ * @brief Replace row digests in a delta with the actual values
+ * @param delta The delta created from digested table states
+ * @param new_state The current (non-digested) state of the table
+ * @return False in case of failure
+ * @note Insert- and update operations get their values from the new state,
+ *       while delete operations get null, as the deleted values are lost.
+ */
+bool LCH_DeltaResolveDigests(const LCH_Json *delta, const LCH_Json *new_state);
+
+/**
+ * @brief Narrow the update operations of a delta down to the changed fields
+ * @param delta The delta as returned by LCH_DeltaCreate
+ * @param old_state The previous state of the table used to create the delta
+ * @return False in case of failure
+ * @note Each update value (a CSV record of the subsidiary fields) is replaced by
+ *       a partial update; a JSON object mapping the index of each changed
+ *       subsidiary field to its new value. Updates where every field changed
+ *       are left as they are.
+ */
+bool LCH_DeltaNarrowUpdates(const LCH_Json *delta, const LCH_Json *old_state);
+
+/**
+ * @brief Get the fields of a record
+ * @param record The record as a CSV string, or as an array of fields (see
+ *               LCH_EncodingParseFields())
+ * @return List of fields or NULL in case of failure
+ * @note Fields in an array are not copied. Hence, the record must outlive the
+ *       returned list.
+ */
+LCH_List *LCH_DeltaGetRecordFields(const LCH_Json *record);
+
+/**
+ * @brief Get the subsidiary fields changed by an update operation
+ * @param value The value of the update operation (either a full record or a
+ *              partial update)
+ * @param subsidiary_fields The names of all subsidiary fields in the table
+ * @param fields Variable to store the list of names of the changed fields
+ * @param values Variable to store the list of new values of the changed fields
+ * @return False in case of failure
+ * @note Full updates yield all the subsidiary fields.
+ */
+bool LCH_DeltaGetUpdatedFields(const LCH_Json *value,
+                               const LCH_List *subsidiary_fields,
+                               LCH_List **fields, LCH_List **values);
+
 /**
  * @brief Merge two patches
  * @param parent The patch from the parent block
  * @param child The patch from the child block
  * @note The insert-, delete-, & update operations are removed from the child
- *       patch during the merge. Both child- & parent patches are mutated
+ *       patch during the merge. Both child- & parent patches are mutated.
+ *       Partial updates in the child patch are applied on top of the record in
+ *       the parent patch.
  */
 bool LCH_DeltaMerge(const LCH_Json *parent, LCH_Json *child);
 
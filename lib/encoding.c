@@ -0,0 +1,1099 @@
+#include "encoding.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "csv.h"
+#include "definitions.h"
+#include "dict.h"
+#include "logger.h"
+#include "string_lib.h"
+
+/**
+ * Binary format:
+ *
+ *   binary := magic value
+ *   value  := tag payload
+ *   string := varint(length) bytes
+ *   number := 8 bytes, IEEE 754 double in network byte order
+ *   array  := varint(count) value*
+ *   object := varint(count) (string value)*
+ *   delta  := string(id) string(type) columns(keys) columns(values)
+ *             section(inserts) section(deletes) section(updates)
+ *   columns:= varint(num_columns) (varint(dict_size) string*)*
+ *   section:= varint(num_records) (fields(key) fields(value))*
+ *   fields := varint(dict_index + 1)* varint(0)
+ *
+ * The n-th field of a key (or value) refers to an entry in the dictionary of
+ * the n-th key (or value) column. Varints are unsigned LEB128 (7 bits per
+ * byte, least significant group first).
+ */
+
+enum {
+  TAG_NULL = 0,
+  TAG_TRUE,
+  TAG_FALSE,
+  TAG_STRING,
+  TAG_NUMBER,
+  TAG_ARRAY,
+  TAG_OBJECT,
+  TAG_DELTA,
+};
+
+static const char *const ENCODING_NAMES[] = {
+    "json",
+    "binary",
+};
+
+static const char *const DELTA_SECTIONS[] = {
+    "inserts",
+    "deletes",
+    "updates",
+};
+
+bool LCH_EncodingFromString(const char *const name,
+                            LCH_Encoding *const encoding) {
+  assert(name != NULL);
+  assert(encoding != NULL);
+
+  for (size_t i = 0; i < LCH_LENGTH(ENCODING_NAMES); i++) {
+    if (LCH_StringEqual(name, ENCODING_NAMES[i])) {
+      *encoding = (LCH_Encoding)i;
+      return true;
+    }
+  }
+
+  LCH_LOG_ERROR("Unknown encoding '%s'", name);
+  return false;
+}
+
+const char *LCH_EncodingToString(const LCH_Encoding encoding) {
+  assert((size_t)encoding < LCH_LENGTH(ENCODING_NAMES));
+  return ENCODING_NAMES[encoding];
+}
+
+bool LCH_EncodingIsBinary(const char *const data, const size_t length) {
+  assert(data != NULL || length == 0);
+  return (length >= LCH_BINARY_MAGIC_LENGTH) &&
+         (memcmp(data, LCH_BINARY_MAGIC, LCH_BINARY_MAGIC_LENGTH) == 0);
+}
+
+/******************************************************************************/
+
+static bool EncodeVarint(LCH_Buffer *const buffer, uint64_t value) {
+  do {
+    unsigned char byte = (unsigned char)(value & 0x7F);
+    value >>= 7;
+    if (value != 0) {
+      byte |= 0x80;
+    }
+    if (!LCH_BufferAppend(buffer, (char)byte)) {
+      return false;
+    }
+  } while (value != 0);
+  return true;
+}
+
+static bool EncodeBytes(LCH_Buffer *const buffer, const char *const data,
+                        const size_t length) {
+  if (!EncodeVarint(buffer, (uint64_t)length)) {
+    return false;
+  }
+
+  if (length > 0) {
+    size_t offset;
+    if (!LCH_BufferAllocate(buffer, length, &offset)) {
+      return false;
+    }
+    LCH_BufferSet(buffer, offset, data, length);
+  }
+  return true;
+}
+
+static bool EncodeString(LCH_Buffer *const buffer, const LCH_Buffer *const str) {
+  return EncodeBytes(buffer, LCH_BufferData(str), LCH_BufferLength(str));
+}
+
+static bool EncodeNumber(LCH_Buffer *const buffer, const double number) {
+  uint64_t bits;
+  memcpy(&bits, &number, sizeof(bits));
+
+  for (int shift = 56; shift >= 0; shift -= 8) {
+    if (!LCH_BufferAppend(buffer, (char)((bits >> shift) & 0xFF))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool IsDelta(const LCH_Json *const json) {
+  if (!LCH_JsonIsObject(json) || LCH_JsonObjectLength(json) != 5) {
+    return false;
+  }
+
+  const LCH_Buffer id_key = LCH_BufferStaticFromString("id");
+  const LCH_Buffer type_key = LCH_BufferStaticFromString("type");
+  if (!LCH_JsonObjectHasKey(json, &id_key) ||
+      !LCH_JsonIsString(LCH_JsonObjectGet(json, &id_key)) ||
+      !LCH_JsonObjectHasKey(json, &type_key) ||
+      !LCH_JsonIsString(LCH_JsonObjectGet(json, &type_key))) {
+    return false;
+  }
+
+  for (size_t i = 0; i < LCH_LENGTH(DELTA_SECTIONS); i++) {
+    const LCH_Buffer key = LCH_BufferStaticFromString(DELTA_SECTIONS[i]);
+    if (!LCH_JsonObjectHasKey(json, &key) ||
+        !LCH_JsonIsObject(LCH_JsonObjectGet(json, &key))) {
+      return false;
+    }
+
+    /* Records are only split into fields if all values are CSV strings */
+    const LCH_Json *const section = LCH_JsonObjectGet(json, &key);
+    LCH_List *const keys = LCH_JsonObjectGetKeys(section);
+    if (keys == NULL) {
+      return false;
+    }
+    const size_t num_keys = LCH_ListLength(keys);
+    for (size_t j = 0; j < num_keys; j++) {
+      const LCH_Buffer *const record_key = (LCH_Buffer *)LCH_ListGet(keys, j);
+      if (!LCH_JsonIsString(LCH_JsonObjectGet(section, record_key))) {
+        LCH_ListDestroy(keys);
+        return false;
+      }
+    }
+    LCH_ListDestroy(keys);
+  }
+
+  return true;
+}
+
+/**
+ * Each column of a table (i.e., each position in the key- and value records)
+ * has its own dictionary of distinct field values. Values tend to repeat
+ * within a column rather than across columns, hence this keeps dictionary
+ * indices small.
+ */
+typedef struct {
+  LCH_Dict *dict;       // Maps field values to their dictionary index
+  LCH_Buffer *entries;  // Encoded field values in the order of their index
+  size_t num_entries;
+} Column;
+
+typedef struct {
+  Column *columns;
+  size_t num_columns;
+  size_t index;         // Index of the column of the next field
+  LCH_Buffer *records;  // Buffer to write field references to
+} ColumnEncoder;
+
+static void ColumnEncoderDestroy(ColumnEncoder *const encoder) {
+  for (size_t i = 0; i < encoder->num_columns; i++) {
+    LCH_DictDestroy(encoder->columns[i].dict);
+    LCH_BufferDestroy(encoder->columns[i].entries);
+  }
+  free(encoder->columns);
+}
+
+static Column *GetColumn(ColumnEncoder *const encoder, const size_t index) {
+  if (index < encoder->num_columns) {
+    return &encoder->columns[index];
+  }
+  assert(index == encoder->num_columns);
+
+  Column *const columns = (Column *)realloc(
+      encoder->columns, sizeof(Column) * (encoder->num_columns + 1));
+  if (columns == NULL) {
+    LCH_LOG_ERROR("Failed to reallocate memory for columns: %s",
+                  strerror(errno));
+    return NULL;
+  }
+  encoder->columns = columns;
+
+  Column *const column = &columns[index];
+  column->dict = LCH_DictCreate();
+  if (column->dict == NULL) {
+    return NULL;
+  }
+
+  column->entries = LCH_BufferCreate();
+  if (column->entries == NULL) {
+    LCH_DictDestroy(column->dict);
+    return NULL;
+  }
+
+  column->num_entries = 0;
+  encoder->num_columns += 1;
+  return column;
+}
+
+/**
+ * Writes a reference to the field into the records buffer. Fields not yet in
+ * the dictionary of their column are added to it.
+ */
+static bool EncodeField(const char *const data, const size_t length,
+                        void *const arg) {
+  ColumnEncoder *const encoder = (ColumnEncoder *)arg;
+
+  Column *const column = GetColumn(encoder, encoder->index);
+  if (column == NULL) {
+    return false;
+  }
+  encoder->index += 1;
+
+  /* The field is only copied if it is added to the dictionary */
+  const LCH_Buffer field = {
+      .buffer = (char *)data,
+      .length = length,
+      .capacity = 0,
+      .mapped = false,
+  };
+
+  size_t index;
+  if (LCH_DictHasKey(column->dict, &field)) {
+    /* Indices are stored directly in the value pointer */
+    index = (size_t)(uintptr_t)LCH_DictGet(column->dict, &field);
+  } else {
+    index = column->num_entries;
+    if (!LCH_DictSet(column->dict, &field, (void *)(uintptr_t)index, NULL)) {
+      return false;
+    }
+    if (!EncodeBytes(column->entries, data, length)) {
+      return false;
+    }
+    column->num_entries += 1;
+  }
+
+  /* Zero is reserved for terminating the record */
+  return EncodeVarint(encoder->records, (uint64_t)index + 1);
+}
+
+static bool EncodeFields(ColumnEncoder *const encoder,
+                         const LCH_Buffer *const csv) {
+  encoder->index = 0;
+  if (!LCH_CSVForEachField(LCH_BufferData(csv), LCH_BufferLength(csv),
+                           EncodeField, encoder)) {
+    return false;
+  }
+  return EncodeVarint(encoder->records, 0);
+}
+
+static bool EncodeColumns(LCH_Buffer *const buffer,
+                          const ColumnEncoder *const encoder) {
+  if (!EncodeVarint(buffer, (uint64_t)encoder->num_columns)) {
+    return false;
+  }
+
+  for (size_t i = 0; i < encoder->num_columns; i++) {
+    const Column *const column = &encoder->columns[i];
+    if (!EncodeVarint(buffer, (uint64_t)column->num_entries) ||
+        !LCH_BufferAppendBuffer(buffer, column->entries)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool EncodeDelta(LCH_Buffer *const buffer, const LCH_Json *const delta) {
+  {
+    const LCH_Buffer key = LCH_BufferStaticFromString("id");
+    const LCH_Buffer *const id = LCH_JsonObjectGetString(delta, &key);
+    if (id == NULL || !EncodeString(buffer, id)) {
+      return false;
+    }
+  }
+
+  {
+    const LCH_Buffer key = LCH_BufferStaticFromString("type");
+    const LCH_Buffer *const type = LCH_JsonObjectGetString(delta, &key);
+    if (type == NULL || !EncodeString(buffer, type)) {
+      return false;
+    }
+  }
+
+  LCH_Buffer *const records = LCH_BufferCreate();
+  if (records == NULL) {
+    return false;
+  }
+
+  /* Keys and values have separate columns */
+  ColumnEncoder keys_encoder = {
+      .columns = NULL,
+      .num_columns = 0,
+      .index = 0,
+      .records = records,
+  };
+  ColumnEncoder values_encoder = keys_encoder;
+
+  for (size_t i = 0; i < LCH_LENGTH(DELTA_SECTIONS); i++) {
+    const LCH_Buffer section_key =
+        LCH_BufferStaticFromString(DELTA_SECTIONS[i]);
+    const LCH_Json *const section = LCH_JsonObjectGet(delta, &section_key);
+    assert(section != NULL);
+
+    LCH_List *const keys = LCH_JsonObjectGetKeys(section);
+    if (keys == NULL) {
+      ColumnEncoderDestroy(&values_encoder);
+      ColumnEncoderDestroy(&keys_encoder);
+      LCH_BufferDestroy(records);
+      return false;
+    }
+
+    const size_t num_keys = LCH_ListLength(keys);
+    if (!EncodeVarint(records, (uint64_t)num_keys)) {
+      LCH_ListDestroy(keys);
+      ColumnEncoderDestroy(&values_encoder);
+      ColumnEncoderDestroy(&keys_encoder);
+      LCH_BufferDestroy(records);
+      return false;
+    }
+
+    for (size_t j = 0; j < num_keys; j++) {
+      const LCH_Buffer *const key = (LCH_Buffer *)LCH_ListGet(keys, j);
+      const LCH_Buffer *const value = LCH_JsonObjectGetString(section, key);
+      assert(value != NULL);
+
+      if (!EncodeFields(&keys_encoder, key) ||
+          !EncodeFields(&values_encoder, value)) {
+        LCH_ListDestroy(keys);
+        ColumnEncoderDestroy(&values_encoder);
+        ColumnEncoderDestroy(&keys_encoder);
+        LCH_BufferDestroy(records);
+        return false;
+      }
+    }
+    LCH_ListDestroy(keys);
+  }
+
+  if (!EncodeColumns(buffer, &keys_encoder) ||
+      !EncodeColumns(buffer, &values_encoder) ||
+      !LCH_BufferAppendBuffer(buffer, records)) {
+    ColumnEncoderDestroy(&values_encoder);
+    ColumnEncoderDestroy(&keys_encoder);
+    LCH_BufferDestroy(records);
+    return false;
+  }
+
+  ColumnEncoderDestroy(&values_encoder);
+  ColumnEncoderDestroy(&keys_encoder);
+  LCH_BufferDestroy(records);
+  return true;
+}
+
+static bool EncodeJson(LCH_Buffer *const buffer, const LCH_Json *const json) {
+  if (IsDelta(json)) {
+    if (!LCH_BufferAppend(buffer, TAG_DELTA)) {
+      return false;
+    }
+    return EncodeDelta(buffer, json);
+  }
+
+  switch (LCH_JsonGetType(json)) {
+    case LCH_JSON_TYPE_NULL:
+      return LCH_BufferAppend(buffer, TAG_NULL);
+
+    case LCH_JSON_TYPE_TRUE:
+      return LCH_BufferAppend(buffer, TAG_TRUE);
+
+    case LCH_JSON_TYPE_FALSE:
+      return LCH_BufferAppend(buffer, TAG_FALSE);
+
+    case LCH_JSON_TYPE_STRING:
+      return LCH_BufferAppend(buffer, TAG_STRING) &&
+             EncodeString(buffer, LCH_JsonStringGet(json));
+
+    case LCH_JSON_TYPE_NUMBER:
+      return LCH_BufferAppend(buffer, TAG_NUMBER) &&
+             EncodeNumber(buffer, LCH_JsonNumberGet(json));
+
+    case LCH_JSON_TYPE_ARRAY: {
+      const size_t length = LCH_JsonArrayLength(json);
+      if (!LCH_BufferAppend(buffer, TAG_ARRAY) ||
+          !EncodeVarint(buffer, (uint64_t)length)) {
+        return false;
+      }
+      for (size_t i = 0; i < length; i++) {
+        if (!EncodeJson(buffer, LCH_JsonArrayGet(json, i))) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    case LCH_JSON_TYPE_OBJECT: {
+      LCH_List *const keys = LCH_JsonObjectGetKeys(json);
+      if (keys == NULL) {
+        return false;
+      }
+
+      const size_t length = LCH_ListLength(keys);
+      if (!LCH_BufferAppend(buffer, TAG_OBJECT) ||
+          !EncodeVarint(buffer, (uint64_t)length)) {
+        LCH_ListDestroy(keys);
+        return false;
+      }
+
+      for (size_t i = 0; i < length; i++) {
+        const LCH_Buffer *const key = (LCH_Buffer *)LCH_ListGet(keys, i);
+        if (!EncodeString(buffer, key) ||
+            !EncodeJson(buffer, LCH_JsonObjectGet(json, key))) {
+          LCH_ListDestroy(keys);
+          return false;
+        }
+      }
+      LCH_ListDestroy(keys);
+      return true;
+    }
+  }
+
+  LCH_LOG_ERROR("Failed to encode JSON: Unknown type");
+  return false;
+}
+
+LCH_Buffer *LCH_EncodingCompose(const LCH_Json *const json,
+                                const LCH_Encoding encoding,
+                                const bool pretty) {
+  assert(json != NULL);
+
+  if (encoding == LCH_ENCODING_JSON) {
+    return LCH_JsonCompose(json, pretty);
+  }
+
+  assert(encoding == LCH_ENCODING_BINARY);
+  LCH_Buffer *const buffer = LCH_BufferCreate();
+  if (buffer == NULL) {
+    return NULL;
+  }
+
+  if (!LCH_BufferAppendBytes(buffer, LCH_BINARY_MAGIC, LCH_BINARY_MAGIC_LENGTH)) {
+    LCH_BufferDestroy(buffer);
+    return NULL;
+  }
+
+  if (!EncodeJson(buffer, json)) {
+    LCH_LOG_ERROR("Failed to compose binary encoding");
+    LCH_BufferDestroy(buffer);
+    return NULL;
+  }
+
+  return buffer;
+}
+
+/******************************************************************************/
+
+typedef struct {
+  const unsigned char *cursor;
+  const unsigned char *end;
+  bool split_records;  // Keep delta records split into fields
+} Decoder;
+
+typedef struct {
+  const char *data;
+  size_t length;
+} DictEntry;
+
+static bool DecodeVarint(Decoder *const decoder, uint64_t *const value) {
+  uint64_t result = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    if (decoder->cursor >= decoder->end) {
+      LCH_LOG_ERROR("Failed to decode varint: Unexpected end of buffer");
+      return false;
+    }
+
+    const unsigned char byte = *decoder->cursor;
+    decoder->cursor += 1;
+    result |= (uint64_t)(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      *value = result;
+      return true;
+    }
+  }
+
+  LCH_LOG_ERROR("Failed to decode varint: Too many bytes");
+  return false;
+}
+
+static bool DecodeSize(Decoder *const decoder, size_t *const size) {
+  uint64_t value;
+  if (!DecodeVarint(decoder, &value)) {
+    return false;
+  }
+
+  /* A size can never exceed the number of remaining bytes, which also keeps
+   * us from allocating huge amounts of memory given corrupt input. */
+  if (value > (uint64_t)(decoder->end - decoder->cursor)) {
+    LCH_LOG_ERROR("Failed to decode size: Value %llu is out of bounds",
+                  (unsigned long long)value);
+    return false;
+  }
+
+  *size = (size_t)value;
+  return true;
+}
+
+static bool DecodeBytes(Decoder *const decoder, const char **const data,
+                        size_t *const length) {
+  if (!DecodeSize(decoder, length)) {
+    return false;
+  }
+
+  *data = (const char *)decoder->cursor;
+  decoder->cursor += *length;
+  return true;
+}
+
+static LCH_Buffer *BufferFromBytes(const char *const data,
+                                   const size_t length) {
+  LCH_Buffer *const str = LCH_BufferCreate();
+  if (str == NULL) {
+    return NULL;
+  }
+
+  if (length > 0) {
+    size_t offset;
+    if (!LCH_BufferAllocate(str, length, &offset)) {
+      LCH_BufferDestroy(str);
+      return NULL;
+    }
+    LCH_BufferSet(str, offset, data, length);
+  }
+  return str;
+}
+
+static LCH_Buffer *DecodeString(Decoder *const decoder) {
+  const char *data;
+  size_t length;
+  if (!DecodeBytes(decoder, &data, &length)) {
+    return NULL;
+  }
+  return BufferFromBytes(data, length);
+}
+
+static bool DecodeNumber(Decoder *const decoder, double *const number) {
+  if (decoder->end - decoder->cursor < 8) {
+    LCH_LOG_ERROR("Failed to decode number: Unexpected end of buffer");
+    return false;
+  }
+
+  uint64_t bits = 0;
+  for (int i = 0; i < 8; i++) {
+    bits = (bits << 8) | decoder->cursor[i];
+  }
+  decoder->cursor += 8;
+
+  memcpy(number, &bits, sizeof(bits));
+  return true;
+}
+
+typedef struct {
+  DictEntry *entries;
+  size_t num_entries;
+} DecodedColumn;
+
+static void DecodedColumnsDestroy(DecodedColumn *const columns,
+                                  const size_t num_columns) {
+  if (columns != NULL) {
+    for (size_t i = 0; i < num_columns; i++) {
+      free(columns[i].entries);
+    }
+    free(columns);
+  }
+}
+
+static DecodedColumn *DecodeColumns(Decoder *const decoder,
+                                    size_t *const num_columns) {
+  if (!DecodeSize(decoder, num_columns)) {
+    return NULL;
+  }
+
+  DecodedColumn *const columns = (DecodedColumn *)calloc(
+      LCH_MAX(*num_columns, 1), sizeof(DecodedColumn));
+  if (columns == NULL) {
+    LCH_LOG_ERROR("Failed to allocate memory for columns: %s",
+                  strerror(errno));
+    return NULL;
+  }
+
+  for (size_t i = 0; i < *num_columns; i++) {
+    DecodedColumn *const column = &columns[i];
+    if (!DecodeSize(decoder, &column->num_entries)) {
+      DecodedColumnsDestroy(columns, *num_columns);
+      return NULL;
+    }
+
+    /* Dictionary entries point straight into the input buffer */
+    column->entries = (DictEntry *)malloc(LCH_MAX(column->num_entries, 1) *
+                                          sizeof(DictEntry));
+    if (column->entries == NULL) {
+      LCH_LOG_ERROR("Failed to allocate memory for dictionary: %s",
+                    strerror(errno));
+      DecodedColumnsDestroy(columns, *num_columns);
+      return NULL;
+    }
+
+    for (size_t j = 0; j < column->num_entries; j++) {
+      if (!DecodeBytes(decoder, &column->entries[j].data,
+                       &column->entries[j].length)) {
+        DecodedColumnsDestroy(columns, *num_columns);
+        return NULL;
+      }
+    }
+  }
+
+  return columns;
+}
+
+/**
+ * Reads the next field reference. Sets field to NULL when reaching the end of
+ * the record.
+ */
+static bool DecodeField(Decoder *const decoder,
+                        const DecodedColumn *const columns,
+                        const size_t num_columns, const size_t index,
+                        const DictEntry **const field) {
+  uint64_t reference;
+  if (!DecodeVarint(decoder, &reference)) {
+    return false;
+  }
+
+  if (reference == 0) {
+    *field = NULL;
+    return true;
+  }
+
+  if (index >= num_columns) {
+    LCH_LOG_ERROR("Failed to decode delta: Column %zu is out of bounds",
+                  index);
+    return false;
+  }
+
+  const DecodedColumn *const column = &columns[index];
+  if (reference - 1 >= (uint64_t)column->num_entries) {
+    LCH_LOG_ERROR(
+        "Failed to decode delta: Dictionary index %llu is out of bounds",
+        (unsigned long long)(reference - 1));
+    return false;
+  }
+
+  *field = &column->entries[reference - 1];
+  return true;
+}
+
+/**
+ * Reads field references and composes them into a CSV record.
+ */
+static LCH_Buffer *DecodeRecord(Decoder *const decoder,
+                                const DecodedColumn *const columns,
+                                const size_t num_columns) {
+  LCH_Buffer *csv = LCH_BufferCreate();
+  if (csv == NULL) {
+    return NULL;
+  }
+
+  for (size_t i = 0;; i++) {
+    const DictEntry *field;
+    if (!DecodeField(decoder, columns, num_columns, i, &field)) {
+      LCH_BufferDestroy(csv);
+      return NULL;
+    }
+
+    if (field == NULL) {
+      return csv;
+    }
+
+    if (i > 0 && !LCH_BufferAppend(csv, ',')) {
+      LCH_BufferDestroy(csv);
+      return NULL;
+    }
+
+    if (!LCH_CSVComposeField(&csv, field->data, field->length)) {
+      LCH_BufferDestroy(csv);
+      return NULL;
+    }
+  }
+}
+
+/**
+ * Reads field references into a JSON array of fields.
+ */
+static LCH_Json *DecodeFields(Decoder *const decoder,
+                              const DecodedColumn *const columns,
+                              const size_t num_columns) {
+  LCH_Json *const fields = LCH_JsonArrayCreate();
+  if (fields == NULL) {
+    return NULL;
+  }
+
+  for (size_t i = 0;; i++) {
+    const DictEntry *field;
+    if (!DecodeField(decoder, columns, num_columns, i, &field)) {
+      LCH_JsonDestroy(fields);
+      return NULL;
+    }
+
+    if (field == NULL) {
+      return fields;
+    }
+
+    LCH_Buffer *const str = BufferFromBytes(field->data, field->length);
+    if (str == NULL) {
+      LCH_JsonDestroy(fields);
+      return NULL;
+    }
+
+    if (!LCH_JsonArrayAppendString(fields, str)) {
+      LCH_BufferDestroy(str);
+      LCH_JsonDestroy(fields);
+      return NULL;
+    }
+  }
+}
+
+/**
+ * Decodes a delta section into an object mapping CSV keys to CSV values.
+ */
+static LCH_Json *DecodeDeltaSection(Decoder *const decoder,
+                                    const DecodedColumn *const key_columns,
+                                    const size_t num_key_columns,
+                                    const DecodedColumn *const value_columns,
+                                    const size_t num_value_columns) {
+  size_t num_records;
+  if (!DecodeSize(decoder, &num_records)) {
+    return NULL;
+  }
+
+  LCH_Json *const section = LCH_JsonObjectCreate();
+  if (section == NULL) {
+    return NULL;
+  }
+
+  for (size_t i = 0; i < num_records; i++) {
+    LCH_Buffer *const key =
+        DecodeRecord(decoder, key_columns, num_key_columns);
+    if (key == NULL) {
+      LCH_JsonDestroy(section);
+      return NULL;
+    }
+
+    LCH_Buffer *const value =
+        DecodeRecord(decoder, value_columns, num_value_columns);
+    if (value == NULL) {
+      LCH_BufferDestroy(key);
+      LCH_JsonDestroy(section);
+      return NULL;
+    }
+
+    if (!LCH_JsonObjectSetString(section, key, value)) {
+      LCH_BufferDestroy(value);
+      LCH_BufferDestroy(key);
+      LCH_JsonDestroy(section);
+      return NULL;
+    }
+    LCH_BufferDestroy(key);
+  }
+
+  return section;
+}
+
+/**
+ * Decodes a delta section into an array of [key, value] pairs, where the key
+ * and value are arrays of fields.
+ */
+static LCH_Json *DecodeDeltaSectionFields(
+    Decoder *const decoder, const DecodedColumn *const key_columns,
+    const size_t num_key_columns, const DecodedColumn *const value_columns,
+    const size_t num_value_columns) {
+  size_t num_records;
+  if (!DecodeSize(decoder, &num_records)) {
+    return NULL;
+  }
+
+  LCH_Json *const section = LCH_JsonArrayCreate();
+  if (section == NULL) {
+    return NULL;
+  }
+
+  for (size_t i = 0; i < num_records; i++) {
+    LCH_Json *const record = LCH_JsonArrayCreate();
+    if (record == NULL) {
+      LCH_JsonDestroy(section);
+      return NULL;
+    }
+
+    if (!LCH_JsonArrayAppend(section, record)) {
+      LCH_JsonDestroy(record);
+      LCH_JsonDestroy(section);
+      return NULL;
+    }
+
+    LCH_Json *const key = DecodeFields(decoder, key_columns, num_key_columns);
+    if (key == NULL) {
+      LCH_JsonDestroy(section);
+      return NULL;
+    }
+
+    if (!LCH_JsonArrayAppend(record, key)) {
+      LCH_JsonDestroy(key);
+      LCH_JsonDestroy(section);
+      return NULL;
+    }
+
+    LCH_Json *const value =
+        DecodeFields(decoder, value_columns, num_value_columns);
+    if (value == NULL) {
+      LCH_JsonDestroy(section);
+      return NULL;
+    }
+
+    if (!LCH_JsonArrayAppend(record, value)) {
+      LCH_JsonDestroy(value);
+      LCH_JsonDestroy(section);
+      return NULL;
+    }
+  }
+
+  return section;
+}
+
+static LCH_Json *DecodeDelta(Decoder *const decoder) {
+  LCH_Json *const delta = LCH_JsonObjectCreate();
+  if (delta == NULL) {
+    return NULL;
+  }
+
+  {
+    LCH_Buffer *const id = DecodeString(decoder);
+    if (id == NULL) {
+      LCH_JsonDestroy(delta);
+      return NULL;
+    }
+
+    const LCH_Buffer key = LCH_BufferStaticFromString("id");
+    if (!LCH_JsonObjectSetString(delta, &key, id)) {
+      LCH_BufferDestroy(id);
+      LCH_JsonDestroy(delta);
+      return NULL;
+    }
+  }
+
+  {
+    LCH_Buffer *const type = DecodeString(decoder);
+    if (type == NULL) {
+      LCH_JsonDestroy(delta);
+      return NULL;
+    }
+
+    const LCH_Buffer key = LCH_BufferStaticFromString("type");
+    if (!LCH_JsonObjectSetString(delta, &key, type)) {
+      LCH_BufferDestroy(type);
+      LCH_JsonDestroy(delta);
+      return NULL;
+    }
+  }
+
+  size_t num_key_columns;
+  DecodedColumn *const key_columns = DecodeColumns(decoder, &num_key_columns);
+  if (key_columns == NULL) {
+    LCH_JsonDestroy(delta);
+    return NULL;
+  }
+
+  size_t num_value_columns;
+  DecodedColumn *const value_columns =
+      DecodeColumns(decoder, &num_value_columns);
+  if (value_columns == NULL) {
+    DecodedColumnsDestroy(key_columns, num_key_columns);
+    LCH_JsonDestroy(delta);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < LCH_LENGTH(DELTA_SECTIONS); i++) {
+    LCH_Json *const section =
+        decoder->split_records
+            ? DecodeDeltaSectionFields(decoder, key_columns, num_key_columns,
+                                       value_columns, num_value_columns)
+            : DecodeDeltaSection(decoder, key_columns, num_key_columns,
+                                 value_columns, num_value_columns);
+    if (section == NULL) {
+      DecodedColumnsDestroy(value_columns, num_value_columns);
+      DecodedColumnsDestroy(key_columns, num_key_columns);
+      LCH_JsonDestroy(delta);
+      return NULL;
+    }
+
+    const LCH_Buffer key = LCH_BufferStaticFromString(DELTA_SECTIONS[i]);
+    if (!LCH_JsonObjectSet(delta, &key, section)) {
+      LCH_JsonDestroy(section);
+      DecodedColumnsDestroy(value_columns, num_value_columns);
+      DecodedColumnsDestroy(key_columns, num_key_columns);
+      LCH_JsonDestroy(delta);
+      return NULL;
+    }
+  }
+
+  DecodedColumnsDestroy(value_columns, num_value_columns);
+  DecodedColumnsDestroy(key_columns, num_key_columns);
+  return delta;
+}
+
+static LCH_Json *DecodeJson(Decoder *const decoder) {
+  if (decoder->cursor >= decoder->end) {
+    LCH_LOG_ERROR("Failed to decode value: Unexpected end of buffer");
+    return NULL;
+  }
+
+  const unsigned char tag = *decoder->cursor;
+  decoder->cursor += 1;
+
+  switch (tag) {
+    case TAG_NULL:
+      return LCH_JsonNullCreate();
+
+    case TAG_TRUE:
+      return LCH_JsonTrueCreate();
+
+    case TAG_FALSE:
+      return LCH_JsonFalseCreate();
+
+    case TAG_STRING: {
+      LCH_Buffer *const str = DecodeString(decoder);
+      if (str == NULL) {
+        return NULL;
+      }
+      LCH_Json *const json = LCH_JsonStringCreate(str);
+      if (json == NULL) {
+        LCH_BufferDestroy(str);
+        return NULL;
+      }
+      return json;
+    }
+
+    case TAG_NUMBER: {
+      double number;
+      if (!DecodeNumber(decoder, &number)) {
+        return NULL;
+      }
+      return LCH_JsonNumberCreate(number);
+    }
+
+    case TAG_ARRAY: {
+      size_t length;
+      if (!DecodeSize(decoder, &length)) {
+        return NULL;
+      }
+
+      LCH_Json *const array = LCH_JsonArrayCreate();
+      if (array == NULL) {
+        return NULL;
+      }
+
+      for (size_t i = 0; i < length; i++) {
+        LCH_Json *const element = DecodeJson(decoder);
+        if (element == NULL) {
+          LCH_JsonDestroy(array);
+          return NULL;
+        }
+        if (!LCH_JsonArrayAppend(array, element)) {
+          LCH_JsonDestroy(element);
+          LCH_JsonDestroy(array);
+          return NULL;
+        }
+      }
+      return array;
+    }
+
+    case TAG_OBJECT: {
+      size_t length;
+      if (!DecodeSize(decoder, &length)) {
+        return NULL;
+      }
+
+      LCH_Json *const object = LCH_JsonObjectCreate();
+      if (object == NULL) {
+        return NULL;
+      }
+
+      for (size_t i = 0; i < length; i++) {
+        LCH_Buffer *const key = DecodeString(decoder);
+        if (key == NULL) {
+          LCH_JsonDestroy(object);
+          return NULL;
+        }
+
+        LCH_Json *const value = DecodeJson(decoder);
+        if (value == NULL) {
+          LCH_BufferDestroy(key);
+          LCH_JsonDestroy(object);
+          return NULL;
+        }
+
+        if (!LCH_JsonObjectSet(object, key, value)) {
+          LCH_JsonDestroy(value);
+          LCH_BufferDestroy(key);
+          LCH_JsonDestroy(object);
+          return NULL;
+        }
+        LCH_BufferDestroy(key);
+      }
+      return object;
+    }
+
+    case TAG_DELTA:
+      return DecodeDelta(decoder);
+  }
+
+  LCH_LOG_ERROR("Failed to decode value: Unknown tag 0x%02x", tag);
+  return NULL;
+}
+
+static LCH_Json *Parse(const char *const data, const size_t length,
+                       const bool split_records) {
+  assert(data != NULL || length == 0);
+
+  if (!LCH_EncodingIsBinary(data, length)) {
+    return LCH_JsonParse(data, length);
+  }
+
+  Decoder decoder = {
+      .cursor = (const unsigned char *)data + LCH_BINARY_MAGIC_LENGTH,
+      .end = (const unsigned char *)data + length,
+      .split_records = split_records,
+  };
+
+  LCH_Json *const json = DecodeJson(&decoder);
+  if (json == NULL) {
+    LCH_LOG_ERROR("Failed to parse binary encoding");
+    return NULL;
+  }
+
+  if (decoder.cursor != decoder.end) {
+    LCH_LOG_ERROR(
+        "Failed to parse binary encoding: Trailing bytes after value (%zu)",
+        (size_t)(decoder.end - decoder.cursor));
+    LCH_JsonDestroy(json);
+    return NULL;
+  }
+
+  return json;
+}
+
+LCH_Json *LCH_EncodingParse(const char *const data, const size_t length) {
+  return Parse(data, length, false);
+}
+
+LCH_Json *LCH_EncodingParseFields(const char *const data, const size_t length) {
+  return Parse(data, length, true);
+}
+
+LCH_Json *LCH_EncodingParseBuffer(LCH_Buffer *const buffer) {
+  assert(buffer != NULL);
+
+  if (!LCH_EncodingIsBinary(buffer->buffer, buffer->length)) {
+    return LCH_JsonParseBuffer(buffer);
+  }
+
+  LCH_Json *const json = LCH_EncodingParse(buffer->buffer, buffer->length);
+  LCH_BufferDestroy(buffer);
+  return json;
+}
@@ -0,0 +1,93 @@
+#ifndef _LEECH_ENCODING_H
+#define _LEECH_ENCODING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "buffer.h"
+#include "json.h"
+
+/**
+ * Binary encoded blocks and patches start with this magic sequence. It can
+ * neither be confused with JSON, the "SHA1=" patch prefix nor a compression
+ * header.
+ */
+#define LCH_BINARY_MAGIC "\x89LCH"
+#define LCH_BINARY_MAGIC_LENGTH 4
+
+/**
+ * @brief Used to specify how blocks and patches are serialized.
+ */
+typedef enum {
+  LCH_ENCODING_JSON = 0,
+  LCH_ENCODING_BINARY,
+} LCH_Encoding;
+
+/**
+ * @brief Get encoding from its name
+ * @param name Name of the encoding (i.e., "json" or "binary")
+ * @param encoding Variable to store the encoding
+ * @return False in case of failure
+ */
+bool LCH_EncodingFromString(const char *name, LCH_Encoding *encoding);
+
+/**
+ * @brief Get the name of an encoding
+ * @param encoding The encoding
+ * @return The name of the encoding
+ */
+const char *LCH_EncodingToString(LCH_Encoding encoding);
+
+/**
+ * @brief Check whether data is binary encoded
+ * @param data The data
+ * @param length The length of the data
+ * @return True if data starts with the binary magic sequence
+ */
+bool LCH_EncodingIsBinary(const char *data, size_t length);
+
+/**
+ * @brief Serialize JSON element using the given encoding
+ * @param json The JSON element
+ * @param encoding The encoding
+ * @param pretty Pretty print (only applies to the JSON encoding)
+ * @return Buffer containing the serialized element or NULL in case of failure
+ * @note In the binary encoding, all fields are length-prefixed and integers
+ *       are stored as varints. Deltas get special treatment; each record is
+ *       split into its fields, and each field is stored as a reference into a
+ *       per-column dictionary of distinct field values. This removes the CSV
+ *       and JSON escaping, and stores repeated values only once.
+ */
+LCH_Buffer *LCH_EncodingCompose(const LCH_Json *json, LCH_Encoding encoding,
+                                bool pretty);
+
+/**
+ * @brief Deserialize JSON element, detecting the encoding
+ * @param data The serialized element
+ * @param length The length of the serialized element
+ * @return The JSON element or NULL in case of failure
+ */
+LCH_Json *LCH_EncodingParse(const char *data, size_t length);
+
+/**
+ * @brief Deserialize JSON element, keeping delta records split into fields
+ * @param data The serialized element
+ * @param length The length of the serialized element
+ * @return The JSON element or NULL in case of failure
+ * @note The sections of binary encoded deltas become arrays of [key, value]
+ *       pairs, where key and value are arrays of fields. This spares composing
+ *       CSV records that would only be parsed again when applying the delta
+ *       (see LCH_TablePatch()). JSON encoded elements are left as they are.
+ */
+LCH_Json *LCH_EncodingParseFields(const char *data, size_t length);
+
+/**
+ * @brief Deserialize JSON element from buffer, detecting the encoding
+ * @param buffer The serialized element. The function takes ownership of the
+ *               buffer, also in case of failure.
+ * @return The JSON element or NULL in case of failure
+ * @note JSON encoded elements are parsed in place (see LCH_JsonParseBuffer)
+ */
+LCH_Json *LCH_EncodingParseBuffer(LCH_Buffer *buffer);
+
+#endif  // _LEECH_ENCODING_H
@@ -287,3 +287,46 @@ LCH_List *LCH_FileListDirectory(const char *const path,
   closedir(dir);
   return filenames;
 }
+
+/******************************************************************************/
+
+bool LCH_FileGetStamp(const char *const path, LCH_FileStamp *const stamp) {
+  assert(path != NULL);
+  assert(stamp != NULL);
+
+  memset(stamp, 0, sizeof(LCH_FileStamp));
+
+  struct stat sb;
+  if (stat(path, &sb) != 0) {
+    if (errno == ENOENT) {
+      return true;
+    }
+    LCH_LOG_ERROR("Failed to get status of file '%s': %s", path,
+                  strerror(errno));
+    return false;
+  }
+
+  stamp->exists = true;
+  stamp->device = (unsigned long long)sb.st_dev;
+  stamp->inode = (unsigned long long)sb.st_ino;
+  stamp->size = (unsigned long long)sb.st_size;
+  stamp->mtime_sec = (long long)sb.st_mtime;
+#if defined(__APPLE__)
+  stamp->mtime_nsec = sb.st_mtimespec.tv_nsec;
+#elif !defined(_WIN32)
+  stamp->mtime_nsec = sb.st_mtim.tv_nsec;
+#endif
+  return true;
+}
+
+/******************************************************************************/
+
+bool LCH_FileStampEqual(const LCH_FileStamp *const a,
+                        const LCH_FileStamp *const b) {
+  assert(a != NULL);
+  assert(b != NULL);
+
+  return (a->exists == b->exists) && (a->device == b->device) &&
+         (a->inode == b->inode) && (a->size == b->size) &&
+         (a->mtime_sec == b->mtime_sec) && (a->mtime_nsec == b->mtime_nsec);
+}
@@ -77,4 +77,36 @@ bool LCH_FileCreateParentDirectories(const char *filename);
  */
 LCH_List *LCH_FileListDirectory(const char *path, bool filter_hidden);
 
+/**
+ * @brief Identifies a version of a file
+ * @note Two stamps of the same path compare equal as long as the file has not
+ *       been replaced or modified in between
+ */
+typedef struct {
+  bool exists;
+  unsigned long long device;
+  unsigned long long inode;
+  unsigned long long size;
+  long long mtime_sec;
+  long mtime_nsec;
+} LCH_FileStamp;
+
+/**
+ * @brief Get the stamp of a file
+ * @param path The file path
+ * @param stamp The variable in which to store the stamp
+ * @return False in case of failure
+ * @note A file that does not exist is not a failure, but gets a stamp with
+ *       the exists field set to false
+ */
+bool LCH_FileGetStamp(const char *path, LCH_FileStamp *stamp);
+
+/**
+ * @brief Compare two file stamps
+ * @param a The first stamp
+ * @param b The second stamp
+ * @return True if the stamps are equal
+ */
+bool LCH_FileStampEqual(const LCH_FileStamp *a, const LCH_FileStamp *b);
+
 #endif  // _LEECH_FILES_H
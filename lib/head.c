@@ -60,7 +60,7 @@ bool LCH_HeadSet(const char *const name, const char *const work_dir,
     return false;
   }
 
-  if (!LCH_BufferWriteFile(buffer, path)) {
+  if (!LCH_BufferReplaceFile(buffer, path)) {
     LCH_BufferDestroy(buffer);
     return false;
   }
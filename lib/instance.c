@@ -5,6 +5,8 @@
 #include <limits.h>
 #include <string.h>
 
+#include "compression.h"
+#include "dict.h"
 #include "files.h"
 #include "list.h"
 #include "logger.h"
@@ -20,12 +22,51 @@ struct LCH_Instance {
   size_t chain_length;
   bool pretty_print;
   bool auto_purge;
-  LCH_List *tables;
+  bool snapshot_digests;
+  bool snapshot_log;
+  size_t snapshot_log_limit;
+  bool fan_out_blocks;
+  bool pack_blocks;
+  LCH_Compression compression;
+  LCH_Encoding encoding;
+  LCH_Json *config;
+  const LCH_Json *table_defs;  // Owned by config
+  LCH_List *table_ids;
+  LCH_Dict *tables;      // Table definitions loaded so far, by identifier
+  LCH_List *all_tables;  // Filled by LCH_InstanceGetTables()
+  LCH_Dict *modules;     // Modules shared by the table definitions
+  LCH_FileStamp config_stamp;
+  LCH_Dict *snapshots;  // NULL unless the snapshot cache is enabled
+  LCH_BlockIndex *block_index;
+  LCH_Pack *pack;
+  LCH_ChainIndex *chain_index;
 };
 
+typedef struct {
+  LCH_Json *state;
+  LCH_FileStamp stamp;
+  LCH_FileStamp log_stamp;
+} CachedSnapshot;
+
+static void CachedSnapshotDestroy(void *const _snapshot) {
+  CachedSnapshot *const snapshot = (CachedSnapshot *)_snapshot;
+  if (snapshot != NULL) {
+    LCH_JsonDestroy(snapshot->state);
+    free(snapshot);
+  }
+}
+
 void LCH_InstanceDestroy(void *const _instance) {
   LCH_Instance *const instance = (LCH_Instance *)_instance;
-  LCH_ListDestroy(instance->tables);
+  LCH_ListDestroy(instance->all_tables);
+  LCH_DictDestroy(instance->tables);
+  LCH_DictDestroy(instance->modules);  // After the tables using them
+  LCH_ListDestroy(instance->table_ids);
+  LCH_JsonDestroy(instance->config);
+  LCH_DictDestroy(instance->snapshots);
+  LCH_BlockIndexDestroy(instance->block_index);
+  LCH_PackDestroy(instance->pack);
+  LCH_ChainIndexDestroy(instance->chain_index);
   free(instance);
 }
 
@@ -37,6 +78,13 @@ LCH_Instance *LCH_InstanceLoad(const char *const work_dir) {
     return NULL;
   }
 
+  /* The stamp is obtained before parsing the file, such that any changes made
+   * in between are detected by LCH_InstanceIsStale() */
+  LCH_FileStamp config_stamp;
+  if (!LCH_FileGetStamp(path, &config_stamp)) {
+    return NULL;
+  }
+
   LCH_Json *const config = LCH_JsonParseFile(path);
   if (config == NULL) {
     return NULL;
@@ -51,6 +99,17 @@ LCH_Instance *LCH_InstanceLoad(const char *const work_dir) {
   }
 
   instance->work_dir = work_dir;
+  instance->config = NULL;
+  instance->table_defs = NULL;
+  instance->table_ids = NULL;
+  instance->tables = NULL;
+  instance->all_tables = NULL;
+  instance->modules = NULL;
+  instance->config_stamp = config_stamp;
+  instance->snapshots = NULL;
+  instance->block_index = NULL;
+  instance->pack = NULL;
+  instance->chain_index = NULL;
 
   {
     const LCH_Buffer key = LCH_BufferStaticFromString("version");
@@ -132,61 +191,231 @@ LCH_Instance *LCH_InstanceLoad(const char *const work_dir) {
                   (instance->pretty_print) ? "true" : "false");
   }
 
+  {
+    instance->compression = LCH_COMPRESSION_NONE;  // None by default
+    const LCH_Buffer key = LCH_BufferStaticFromString("compression");
+    if (LCH_JsonObjectHasKey(config, &key)) {
+      const LCH_Buffer *const value = LCH_JsonObjectGetString(config, &key);
+      if (value == NULL) {
+        LCH_InstanceDestroy(instance);
+        LCH_JsonDestroy(config);
+        return NULL;
+      }
+      if (!LCH_CompressionFromString(LCH_BufferData(value),
+                                     &instance->compression)) {
+        LCH_LOG_ERROR("Illegal value for config[\"compression\"]");
+        LCH_InstanceDestroy(instance);
+        LCH_JsonDestroy(config);
+        return NULL;
+      }
+    }
+    LCH_LOG_DEBUG("config[\"compression\"] = \"%s\"",
+                  LCH_CompressionToString(instance->compression));
+  }
+
+  {
+    instance->encoding = LCH_ENCODING_JSON;  // JSON by default
+    const LCH_Buffer key = LCH_BufferStaticFromString("encoding");
+    if (LCH_JsonObjectHasKey(config, &key)) {
+      const LCH_Buffer *const value = LCH_JsonObjectGetString(config, &key);
+      if (value == NULL) {
+        LCH_InstanceDestroy(instance);
+        LCH_JsonDestroy(config);
+        return NULL;
+      }
+      if (!LCH_EncodingFromString(LCH_BufferData(value),
+                                  &instance->encoding)) {
+        LCH_LOG_ERROR("Illegal value for config[\"encoding\"]");
+        LCH_InstanceDestroy(instance);
+        LCH_JsonDestroy(config);
+        return NULL;
+      }
+    }
+    LCH_LOG_DEBUG("config[\"encoding\"] = \"%s\"",
+                  LCH_EncodingToString(instance->encoding));
+  }
+
+  {
+    instance->snapshot_digests = false;  // False by default
+    const LCH_Buffer key = LCH_BufferStaticFromString("snapshot_digests");
+    if (LCH_JsonObjectHasKey(config, &key)) {
+      const LCH_Json *const snapshot_digests = LCH_JsonObjectGet(config, &key);
+      if (snapshot_digests == NULL) {
+        LCH_InstanceDestroy(instance);
+        LCH_JsonDestroy(config);
+        return NULL;
+      }
+      if (LCH_JsonIsTrue(snapshot_digests)) {
+        instance->snapshot_digests = true;
+      } else if (!LCH_JsonIsFalse(snapshot_digests)) {
+        const char *const type = LCH_JsonGetTypeAsString(snapshot_digests);
+        LCH_LOG_ERROR(
+            "Illegal value for config[\"snapshot_digests\"]: "
+            "Expected type true or false, found %s",
+            type);
+        LCH_InstanceDestroy(instance);
+        LCH_JsonDestroy(config);
+        return NULL;
+      }
+    }
+    LCH_LOG_DEBUG("config[\"snapshot_digests\"] = %s",
+                  (instance->snapshot_digests) ? "true" : "false");
+  }
+
+  {
+    instance->snapshot_log = false;  // False by default
+    const LCH_Buffer key = LCH_BufferStaticFromString("snapshot_log");
+    if (LCH_JsonObjectHasKey(config, &key)) {
+      const LCH_Json *const snapshot_log = LCH_JsonObjectGet(config, &key);
+      if (snapshot_log == NULL) {
+        LCH_InstanceDestroy(instance);
+        LCH_JsonDestroy(config);
+        return NULL;
+      }
+      if (LCH_JsonIsTrue(snapshot_log)) {
+        instance->snapshot_log = true;
+      } else if (!LCH_JsonIsFalse(snapshot_log)) {
+        const char *const type = LCH_JsonGetTypeAsString(snapshot_log);
+        LCH_LOG_ERROR(
+            "Illegal value for config[\"snapshot_log\"]: "
+            "Expected type true or false, found %s",
+            type);
+        LCH_InstanceDestroy(instance);
+        LCH_JsonDestroy(config);
+        return NULL;
+      }
+    }
+    LCH_LOG_DEBUG("config[\"snapshot_log\"] = %s",
+                  (instance->snapshot_log) ? "true" : "false");
+  }
+
+  {
+    const LCH_Buffer key = LCH_BufferStaticFromString("snapshot_log_limit");
+    if (LCH_JsonObjectHasKey(config, &key)) {
+      double number;
+      if (!LCH_JsonObjectGetNumber(config, &key, &number)) {
+        LCH_InstanceDestroy(instance);
+        LCH_JsonDestroy(config);
+        return NULL;
+      }
+      if (!LCH_DoubleToSize(number, &(instance->snapshot_log_limit))) {
+        LCH_InstanceDestroy(instance);
+        LCH_JsonDestroy(config);
+        return NULL;
+      }
+    } else {
+      instance->snapshot_log_limit = LCH_DEFAULT_SNAPSHOT_LOG_LIMIT;
+    }
+    LCH_LOG_DEBUG("config[\"snapshot_log_limit\"] = %zu",
+                  instance->snapshot_log_limit);
+  }
+
+  {
+    instance->fan_out_blocks = false;  // False by default
+    const LCH_Buffer key = LCH_BufferStaticFromString("fan_out_blocks");
+    if (LCH_JsonObjectHasKey(config, &key)) {
+      const LCH_Json *const fan_out_blocks = LCH_JsonObjectGet(config, &key);
+      if (fan_out_blocks == NULL) {
+        LCH_InstanceDestroy(instance);
+        LCH_JsonDestroy(config);
+        return NULL;
+      }
+      if (LCH_JsonIsTrue(fan_out_blocks)) {
+        instance->fan_out_blocks = true;
+      } else if (!LCH_JsonIsFalse(fan_out_blocks)) {
+        const char *const type = LCH_JsonGetTypeAsString(fan_out_blocks);
+        LCH_LOG_ERROR(
+            "Illegal value for config[\"fan_out_blocks\"]: "
+            "Expected type true or false, found %s",
+            type);
+        LCH_InstanceDestroy(instance);
+        LCH_JsonDestroy(config);
+        return NULL;
+      }
+    }
+    LCH_LOG_DEBUG("config[\"fan_out_blocks\"] = %s",
+                  (instance->fan_out_blocks) ? "true" : "false");
+  }
+
+  {
+    instance->pack_blocks = false;  // False by default
+    const LCH_Buffer key = LCH_BufferStaticFromString("pack_blocks");
+    if (LCH_JsonObjectHasKey(config, &key)) {
+      const LCH_Json *const pack_blocks = LCH_JsonObjectGet(config, &key);
+      if (pack_blocks == NULL) {
+        LCH_InstanceDestroy(instance);
+        LCH_JsonDestroy(config);
+        return NULL;
+      }
+      if (LCH_JsonIsTrue(pack_blocks)) {
+        instance->pack_blocks = true;
+      } else if (!LCH_JsonIsFalse(pack_blocks)) {
+        const char *const type = LCH_JsonGetTypeAsString(pack_blocks);
+        LCH_LOG_ERROR(
+            "Illegal value for config[\"pack_blocks\"]: "
+            "Expected type true or false, found %s",
+            type);
+        LCH_InstanceDestroy(instance);
+        LCH_JsonDestroy(config);
+        return NULL;
+      }
+    }
+    LCH_LOG_DEBUG("config[\"pack_blocks\"] = %s",
+                  (instance->pack_blocks) ? "true" : "false");
+  }
+
   const LCH_Buffer key = LCH_BufferStaticFromString("tables");
-  const LCH_Json *const table_defs = LCH_JsonObjectGetObject(config, &key);
-  if (table_defs == NULL) {
+  instance->table_defs = LCH_JsonObjectGetObject(config, &key);
+  if (instance->table_defs == NULL) {
     LCH_InstanceDestroy(instance);
     LCH_JsonDestroy(config);
     return NULL;
   }
 
-  LCH_List *const table_ids = LCH_JsonObjectGetKeys(table_defs);
-  if (table_ids == NULL) {
+  /* The table definitions are loaded on demand */
+  instance->config = config;
+
+  instance->table_ids = LCH_JsonObjectGetKeys(instance->table_defs);
+  if (instance->table_ids == NULL) {
     LCH_InstanceDestroy(instance);
-    LCH_JsonDestroy(config);
     return NULL;
   }
 
-  instance->tables = LCH_ListCreate();
+  instance->tables = LCH_DictCreate();
   if (instance->tables == NULL) {
-    LCH_ListDestroy(table_ids);
     LCH_InstanceDestroy(instance);
     return NULL;
   }
 
-  const size_t num_tables = LCH_ListLength(table_ids);
-  for (size_t i = 0; i < num_tables; i++) {
-    const LCH_Buffer *const table_id = (LCH_Buffer *)LCH_ListGet(table_ids, i);
-    assert(table_id != NULL);
+  instance->modules = LCH_DictCreate();
+  if (instance->modules == NULL) {
+    LCH_InstanceDestroy(instance);
+    return NULL;
+  }
 
-    const LCH_Json *const table_definition =
-        LCH_JsonObjectGetObject(table_defs, table_id);
-    if (table_definition == NULL) {
-      LCH_ListDestroy(table_ids);
-      LCH_InstanceDestroy(instance);
-      LCH_JsonDestroy(config);
-      return NULL;
-    }
+  instance->all_tables = LCH_ListCreate();
+  if (instance->all_tables == NULL) {
+    LCH_InstanceDestroy(instance);
+    return NULL;
+  }
 
-    LCH_TableInfo *const table_info =
-        LCH_TableInfoLoad(LCH_BufferData(table_id), table_definition);
-    if (table_info == NULL) {
-      LCH_ListDestroy(table_ids);
-      LCH_InstanceDestroy(instance);
-      LCH_JsonDestroy(config);
-      return NULL;
-    }
+  instance->block_index = LCH_BlockIndexCreate(instance);
+  if (instance->block_index == NULL) {
+    LCH_InstanceDestroy(instance);
+    return NULL;
+  }
 
-    if (!LCH_ListAppend(instance->tables, table_info, LCH_TableInfoDestroy)) {
-      LCH_TableInfoDestroy(table_info);
-      LCH_ListDestroy(table_ids);
-      LCH_InstanceDestroy(instance);
-      LCH_JsonDestroy(config);
-      return NULL;
-    }
+  instance->pack = LCH_PackCreate(work_dir);
+  if (instance->pack == NULL) {
+    LCH_InstanceDestroy(instance);
+    return NULL;
+  }
+
+  instance->chain_index = LCH_ChainIndexCreate(work_dir);
+  if (instance->chain_index == NULL) {
+    LCH_InstanceDestroy(instance);
+    return NULL;
   }
-  LCH_ListDestroy(table_ids);
-  LCH_JsonDestroy(config);
 
   return instance;
 }
@@ -197,22 +426,172 @@ const LCH_TableInfo *LCH_InstanceGetTable(const LCH_Instance *const self,
   assert(self->tables != NULL);
   assert(table_id != NULL);
 
-  const size_t num_tables = LCH_ListLength(self->tables);
-  for (size_t i = 0; i < num_tables; i++) {
-    const LCH_TableInfo *const table_def =
-        (LCH_TableInfo *)LCH_ListGet(self->tables, i);
-    assert(table_def != NULL);
+  const LCH_Buffer key = LCH_BufferStaticFromString(table_id);
+  if (LCH_DictHasKey(self->tables, &key)) {
+    return (const LCH_TableInfo *)LCH_DictGet(self->tables, &key);
+  }
+
+  if (!LCH_JsonObjectHasKey(self->table_defs, &key)) {
+    return NULL;
+  }
+
+  const LCH_Json *const table_definition =
+      LCH_JsonObjectGetObject(self->table_defs, &key);
+  if (table_definition == NULL) {
+    return NULL;
+  }
+
+  LCH_TableInfo *const table_info =
+      LCH_TableInfoLoad(table_id, table_definition, self->modules);
+  if (table_info == NULL) {
+    return NULL;
+  }
+
+  if (!LCH_DictSet(self->tables, &key, table_info, LCH_TableInfoDestroy)) {
+    LCH_TableInfoDestroy(table_info);
+    return NULL;
+  }
+
+  return table_info;
+}
+
+bool LCH_InstanceHasTable(const LCH_Instance *const self,
+                          const char *const table_id) {
+  assert(self != NULL);
+  assert(table_id != NULL);
+
+  const LCH_Buffer key = LCH_BufferStaticFromString(table_id);
+  return LCH_JsonObjectHasKey(self->table_defs, &key);
+}
+
+bool LCH_InstanceIsStale(const LCH_Instance *const self) {
+  assert(self != NULL);
+
+  char path[PATH_MAX];
+  if (!LCH_FilePathJoin(path, PATH_MAX, 2, self->work_dir, "leech.json")) {
+    return true;
+  }
+
+  LCH_FileStamp stamp;
+  if (!LCH_FileGetStamp(path, &stamp)) {
+    return true;
+  }
+
+  return !LCH_FileStampEqual(&stamp, &self->config_stamp);
+}
 
-    if (LCH_StringEqual(LCH_TableInfoGetIdentifier(table_def), table_id)) {
-      return table_def;
+bool LCH_InstanceEnableSnapshotCache(LCH_Instance *const self) {
+  assert(self != NULL);
+
+  if (self->snapshots == NULL) {
+    self->snapshots = LCH_DictCreate();
+    if (self->snapshots == NULL) {
+      return false;
     }
   }
-  return NULL;
+  return true;
+}
+
+static bool SnapshotStamp(const LCH_Instance *const self,
+                          const char *const table_id,
+                          LCH_FileStamp *const stamp,
+                          LCH_FileStamp *const log_stamp) {
+  char path[PATH_MAX];
+  if (!LCH_FilePathJoin(path, sizeof(path), 3, self->work_dir, "snapshot",
+                        table_id) ||
+      !LCH_FileGetStamp(path, stamp)) {
+    return false;
+  }
+
+  /* Changes may also have been appended to the snapshot log */
+  return LCH_TableSnapshotLogPath(path, sizeof(path), self->work_dir,
+                                  table_id) &&
+         LCH_FileGetStamp(path, log_stamp);
+}
+
+LCH_Json *LCH_InstanceTakeSnapshot(const LCH_Instance *const self,
+                                   const char *const table_id) {
+  assert(self != NULL);
+  assert(table_id != NULL);
+
+  const LCH_Buffer key = LCH_BufferStaticFromString(table_id);
+  if (self->snapshots == NULL || !LCH_DictHasKey(self->snapshots, &key)) {
+    return NULL;
+  }
+
+  CachedSnapshot *const snapshot =
+      (CachedSnapshot *)LCH_DictRemove(self->snapshots, &key);
+
+  /* The snapshot may have been replaced by another process since it was
+   * cached (e.g., a commit from the command line) */
+  LCH_FileStamp stamp, log_stamp;
+  if (!SnapshotStamp(self, table_id, &stamp, &log_stamp) ||
+      !LCH_FileStampEqual(&stamp, &snapshot->stamp) ||
+      !LCH_FileStampEqual(&log_stamp, &snapshot->log_stamp)) {
+    LCH_LOG_DEBUG("Cached snapshot of table '%s' is outdated", table_id);
+    CachedSnapshotDestroy(snapshot);
+    return NULL;
+  }
+
+  LCH_LOG_DEBUG("Using cached snapshot of table '%s'", table_id);
+  LCH_Json *const state = snapshot->state;
+  free(snapshot);
+  return state;
+}
+
+void LCH_InstanceKeepSnapshot(const LCH_Instance *const self,
+                              const char *const table_id,
+                              LCH_Json *const state) {
+  assert(self != NULL);
+  assert(table_id != NULL);
+  assert(state != NULL);
+
+  if (self->snapshots == NULL) {
+    LCH_JsonDestroy(state);
+    return;
+  }
+
+  CachedSnapshot *const snapshot =
+      (CachedSnapshot *)malloc(sizeof(CachedSnapshot));
+  if (snapshot == NULL) {
+    LCH_LOG_WARNING("Failed to allocate memory for cached snapshot: %s",
+                    strerror(errno));
+    LCH_JsonDestroy(state);
+    return;
+  }
+  snapshot->state = state;
+
+  const LCH_Buffer key = LCH_BufferStaticFromString(table_id);
+  if (!SnapshotStamp(self, table_id, &snapshot->stamp,
+                     &snapshot->log_stamp) ||
+      !LCH_DictSet(self->snapshots, &key, snapshot, CachedSnapshotDestroy)) {
+    CachedSnapshotDestroy(snapshot);
+  }
 }
 
 const LCH_List *LCH_InstanceGetTables(const LCH_Instance *const self) {
   assert(self != NULL);
-  return self->tables;
+  assert(self->all_tables != NULL);
+
+  /* Load the remaining table definitions in the order of the configuration
+   * file. A failure leaves the loaded ones in place, for the next call. */
+  const size_t num_tables = LCH_ListLength(self->table_ids);
+  for (size_t i = LCH_ListLength(self->all_tables); i < num_tables; i++) {
+    const LCH_Buffer *const table_id =
+        (LCH_Buffer *)LCH_ListGet(self->table_ids, i);
+    const LCH_TableInfo *const table_info =
+        LCH_InstanceGetTable(self, LCH_BufferData(table_id));
+    if (table_info == NULL) {
+      return NULL;
+    }
+
+    /* The table definitions are owned by the tables dictionary */
+    if (!LCH_ListAppend(self->all_tables, (LCH_TableInfo *)table_info, NULL)) {
+      return NULL;
+    }
+  }
+
+  return self->all_tables;
 }
 
 const char *LCH_InstanceGetWorkDirectory(const LCH_Instance *const self) {
@@ -220,6 +599,21 @@ const char *LCH_InstanceGetWorkDirectory(const LCH_Instance *const self) {
   return self->work_dir;
 }
 
+LCH_BlockIndex *LCH_InstanceGetBlockIndex(const LCH_Instance *const self) {
+  assert(self != NULL);
+  return self->block_index;
+}
+
+LCH_Pack *LCH_InstanceGetPack(const LCH_Instance *const self) {
+  assert(self != NULL);
+  return self->pack;
+}
+
+LCH_ChainIndex *LCH_InstanceGetChainIndex(const LCH_Instance *const self) {
+  assert(self != NULL);
+  return self->chain_index;
+}
+
 size_t LCH_InstanceGetPreferredChainLength(const LCH_Instance *const instance) {
   assert(instance != NULL);
   return instance->chain_length;
@@ -234,3 +628,39 @@ bool LCH_InstanceShouldAutoPurge(const LCH_Instance *const instance) {
   assert(instance != NULL);
   return instance->auto_purge;
 }
+
+bool LCH_InstanceShouldStoreSnapshotDigests(
+    const LCH_Instance *const instance) {
+  assert(instance != NULL);
+  return instance->snapshot_digests;
+}
+
+bool LCH_InstanceShouldLogSnapshots(const LCH_Instance *const instance) {
+  assert(instance != NULL);
+  return instance->snapshot_log;
+}
+
+size_t LCH_InstanceGetSnapshotLogLimit(const LCH_Instance *const instance) {
+  assert(instance != NULL);
+  return instance->snapshot_log_limit;
+}
+
+bool LCH_InstanceShouldFanOutBlocks(const LCH_Instance *const instance) {
+  assert(instance != NULL);
+  return instance->fan_out_blocks;
+}
+
+bool LCH_InstanceShouldPackBlocks(const LCH_Instance *const instance) {
+  assert(instance != NULL);
+  return instance->pack_blocks;
+}
+
+LCH_Compression LCH_InstanceGetCompression(const LCH_Instance *const instance) {
+  assert(instance != NULL);
+  return instance->compression;
+}
+
+LCH_Encoding LCH_InstanceGetEncoding(const LCH_Instance *const instance) {
+  assert(instance != NULL);
+  return instance->encoding;
+}
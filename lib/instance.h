@@ -1,6 +1,11 @@
 #ifndef _LEECH_INSTANCE_H
 #define _LEECH_INSTANCE_H
 
+#include "block_index.h"
+#include "chain_index.h"
+#include "compression.h"
+#include "encoding.h"
+#include "pack.h"
 #include "table.h"
 
 typedef struct LCH_Instance LCH_Instance;
@@ -24,14 +29,64 @@ void LCH_InstanceDestroy(void *instance);
  * @param instance The instance
  * @param table_id Unique table identifier
  * @return The table definition or NULL in case of failure
+ * @note Table definitions are loaded on first access. The source and
+ *       destination modules are in turn loaded on first use.
  */
 const LCH_TableInfo *LCH_InstanceGetTable(const LCH_Instance *instance,
                                           const char *table_id);
 
+/**
+ * @brief Check whether the configuration file changed since it was loaded
+ * @param instance The instance
+ * @return True if the instance should be reloaded
+ */
+bool LCH_InstanceIsStale(const LCH_Instance *instance);
+
+/**
+ * @brief Keep table snapshots in memory between commits
+ * @param instance The instance
+ * @return False in case of failure
+ * @note Only worth it for instances that live across several commits, as the
+ *       snapshots are otherwise held until the instance is destroyed
+ */
+bool LCH_InstanceEnableSnapshotCache(LCH_Instance *instance);
+
+/**
+ * @brief Take a table snapshot out of the snapshot cache
+ * @param instance The instance
+ * @param table_id Unique table identifier
+ * @return The snapshot or NULL if it is not cached (or outdated)
+ * @note The caller takes ownership of the returned snapshot
+ */
+LCH_Json *LCH_InstanceTakeSnapshot(const LCH_Instance *instance,
+                                   const char *table_id);
+
+/**
+ * @brief Put a table snapshot into the snapshot cache
+ * @param instance The instance
+ * @param table_id Unique table identifier
+ * @param state The table state that is currently stored as snapshot
+ * @note The instance takes ownership of the state, which is destroyed right
+ *       away unless the snapshot cache is enabled
+ */
+void LCH_InstanceKeepSnapshot(const LCH_Instance *instance,
+                              const char *table_id, LCH_Json *state);
+
+/**
+ * @brief Check whether a table is defined in the configuration file
+ * @param instance The instance
+ * @param table_id Unique table identifier
+ * @return True if the table is defined
+ * @note Unlike LCH_InstanceGetTable(), this does not load the table definition
+ */
+bool LCH_InstanceHasTable(const LCH_Instance *instance, const char *table_id);
+
 /**
  * @brief Get a list of all table definitions
  * @param instance The instance
  * @return A list of all table definitions or NULL in case of failure
+ * @note This loads all table definitions. Prefer LCH_InstanceGetTable() when
+ *       only some tables are needed.
  */
 const LCH_List *LCH_InstanceGetTables(const LCH_Instance *instance);
 
@@ -42,6 +97,31 @@ const LCH_List *LCH_InstanceGetTables(const LCH_Instance *instance);
  */
 const char *LCH_InstanceGetWorkDirectory(const LCH_Instance *instance);
 
+/**
+ * @brief Get the index of the blocks in the working directory
+ * @param instance The instance
+ * @return The block index
+ * @note The index lives as long as the instance, hence it is reused across
+ *       requests by a session
+ */
+LCH_BlockIndex *LCH_InstanceGetBlockIndex(const LCH_Instance *instance);
+
+/**
+ * @brief Get the pack holding the packed blocks in the working directory
+ * @param instance The instance
+ * @return The pack
+ * @note Like the block index, the pack lives as long as the instance
+ */
+LCH_Pack *LCH_InstanceGetPack(const LCH_Instance *instance);
+
+/**
+ * @brief Get the index of the block headers in the working directory
+ * @param instance The instance
+ * @return The chain index
+ * @note Like the block index, the chain index lives as long as the instance
+ */
+LCH_ChainIndex *LCH_InstanceGetChainIndex(const LCH_Instance *instance);
+
 /**
  * @brief Get the preferred chain length
  * @param instance The instance
@@ -69,4 +149,61 @@ bool LCH_InstanceShouldPrettyPrint(const LCH_Instance *instance);
  */
 bool LCH_InstanceShouldAutoPurge(const LCH_Instance *instance);
 
+/**
+ * @brief Whether or not snapshots should only hold row digests
+ * @param instance The instance
+ * @return True if snapshots store the primary key and a digest of the
+ *         subsidiary fields of each row, instead of the full row
+ * @note Digest snapshots are smaller and faster to parse, but a rebase must
+ *       then read the current table from the source instead of the snapshot
+ */
+bool LCH_InstanceShouldStoreSnapshotDigests(const LCH_Instance *instance);
+
+/**
+ * @brief Whether or not snapshot changes should be appended to a log
+ * @param instance The instance
+ * @return True if the changes of each commit are appended to the snapshot log,
+ *         instead of rewriting the snapshot
+ */
+bool LCH_InstanceShouldLogSnapshots(const LCH_Instance *instance);
+
+/**
+ * @brief Get the maximum size of the snapshot log
+ * @param instance The instance
+ * @return The size in percent of the snapshot size, beyond which the log is
+ *         compacted into a new snapshot
+ */
+size_t LCH_InstanceGetSnapshotLogLimit(const LCH_Instance *instance);
+
+/**
+ * @brief Whether or not blocks should be stored in the fan-out layout
+ * @param instance The instance
+ * @return True if blocks are stored as blocks/ab/cdef..., instead of
+ *         blocks/abcdef...
+ */
+bool LCH_InstanceShouldFanOutBlocks(const LCH_Instance *instance);
+
+/**
+ * @brief Whether or not blocks should be appended to packs
+ * @param instance The instance
+ * @return True if blocks are stored in packs/, instead of in a file each
+ */
+bool LCH_InstanceShouldPackBlocks(const LCH_Instance *instance);
+
+/**
+ * @brief Get the compression method
+ * @param instance The instance
+ * @return The compression method used when writing blocks, snapshots and
+ *         patches
+ * @note Compression trades CPU time for disk space and network bandwidth
+ */
+LCH_Compression LCH_InstanceGetCompression(const LCH_Instance *instance);
+
+/**
+ * @brief Get the encoding
+ * @param instance The instance
+ * @return The encoding used when writing blocks and patches
+ */
+LCH_Encoding LCH_InstanceGetEncoding(const LCH_Instance *instance);
+
 #endif  // _LEECH_INSTANCE_H
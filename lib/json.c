@@ -3,7 +3,9 @@
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "definitions.h"
@@ -11,21 +13,50 @@
 #include "logger.h"
 #include "string_lib.h"
 
+/**
+ * Doubles represent all integers up to 2^53 exactly
+ */
+#define LCH_JSON_MAX_SAFE_INTEGER 9007199254740992.0
+
+/**
+ * Reference counted input of an in place parse. Strings borrowing from it keep
+ * it alive, even after being moved into other JSON elements.
+ */
+typedef struct {
+  size_t references;
+  LCH_Buffer *buffer;
+} LCH_JsonSource;
+
 struct LCH_Json {
   LCH_JsonType type;
   double number;
   LCH_Buffer *str;
   LCH_List *array;
   LCH_Dict *object;
+  LCH_JsonSource *source;  // Only set if str borrows from the source
 };
 
 typedef struct {
   const char *cursor;
   const char *const end;
+  LCH_JsonSource *const source;  // NULL unless parsing in place
 } LCH_JsonParser;
 
 /****************************************************************************/
 
+static void JsonSourceRelease(LCH_JsonSource *const source) {
+  if (source != NULL) {
+    assert(source->references > 0);
+    source->references -= 1;
+    if (source->references == 0) {
+      LCH_BufferDestroy(source->buffer);
+      free(source);
+    }
+  }
+}
+
+/****************************************************************************/
+
 static const char *const LCH_JSON_TYPE_TO_STRING[] = {
     "null", "true", "false", "string", "number", "array", "object"};
 
@@ -968,7 +999,7 @@ static LCH_Json *JsonObjectCopy(const LCH_Json *const object) {
   assert(LCH_JsonIsObject(object));
 
   LCH_Json *const object_copy = LCH_JsonObjectCreate();
-  if (object_copy != NULL) {
+  if (object_copy == NULL) {
     return NULL;
   }
 
@@ -1001,7 +1032,7 @@ static LCH_Json *JsonObjectCopy(const LCH_Json *const object) {
     }
   }
 
-  LCH_JsonDestroy(keys);
+  LCH_ListDestroy(keys);
   return object_copy;
 }
 
@@ -1325,7 +1356,13 @@ static LCH_Json *ParseFalse(LCH_JsonParser *const parser) {
   return json;
 }
 
-static LCH_Buffer *BufferParseString(LCH_JsonParser *const parser) {
+/**
+ * Scans a JSON string without copying it. On success, start and length
+ * describe the raw string between the quotes, and num_escapes holds the number
+ * of escape sequences in it.
+ */
+static bool ScanString(LCH_JsonParser *const parser, const char **const start,
+                       size_t *const length, size_t *const num_escapes) {
   assert(parser != NULL);
   assert(parser->cursor != NULL);
   assert(parser->end != NULL);
@@ -1333,115 +1370,107 @@ static LCH_Buffer *BufferParseString(LCH_JsonParser *const parser) {
   LCH_NDEBUG_UNUSED const bool success = ParseToken(parser, "\"");
   assert(success);
 
-  LCH_Buffer *const str = LCH_BufferCreate();
-  if (str == NULL) {
-    return NULL;
-  }
-
-  while ((parser->cursor < parser->end) && (parser->cursor[0] != '"')) {
-    if (parser->cursor[0] == '\\') {
-      if (parser->cursor + 2 > parser->end) {
+  const char *cursor = parser->cursor;
+  size_t escapes = 0;
+  while ((cursor < parser->end) && (cursor[0] != '"')) {
+    if (cursor[0] == '\\') {
+      if (cursor + 2 > parser->end) {
         LCH_LOG_ERROR(
             "Failed to parse JSON: Expected control character after '\\', "
             "but reached End-of-Buffer");
-        LCH_BufferDestroy(str);
-        return NULL;
-      }
-
-      switch (parser->cursor[1]) {
-        case '"':
-          if (!LCH_BufferAppend(str, '"')) {
-            LCH_BufferDestroy(str);
-            return NULL;
-          }
-          break;
-        case '\\':
-          if (!LCH_BufferAppend(str, '\\')) {
-            LCH_BufferDestroy(str);
-            return NULL;
-          }
-          break;
-        /* This could modify binary strings
-        case '/':
-          if (!LCH_BufferAppend(str, '/')) {
-            LCH_BufferDestroy(str);
-            return NULL;
-          }
-          break;
-        case 'b':
-          if (!LCH_BufferAppend(str, '\b')) {
-            LCH_BufferDestroy(str);
-            return NULL;
-          }
-          break;
-        case 'f':
-          if (!LCH_BufferAppend(str, '\f')) {
-            LCH_BufferDestroy(str);
-            return NULL;
-          }
-          break;
-        case 'n':
-          if (!LCH_BufferAppend(str, '\n')) {
-            LCH_BufferDestroy(str);
-            return NULL;
-          }
-          break;
-        case 'r':
-          if (!LCH_BufferAppend(str, '\r')) {
-            LCH_BufferDestroy(str);
-            return NULL;
-          }
-          break;
-        case 't':
-          if (!LCH_BufferAppend(str, '\t')) {
-            LCH_BufferDestroy(str);
-            return NULL;
-          }
-          break;
-        case 'u':
-          if (parser->cursor + 6 > parser->end) {
-            LCH_LOG_ERROR(
-                "Failed to parse JSON: "
-                "Expected uncode control sequence after '\\u', "
-                "but reached End-of-Buffer");
-            LCH_BufferDestroy(str);
-            return NULL;
-          }
-          if (!LCH_BufferUnicodeToUTF8(str, parser->cursor + 2)) {
-            LCH_BufferDestroy(str);
-            return NULL;
-          }
-          parser->cursor += 4;
-          break;
-        */
-        default:
-          /* Same reason as above
-          LCH_LOG_ERROR(
-              "Failed to parse JSON string: "
-              "Illegal control character '\\%c'",
-              parser->cursor[0]);
-          LCH_BufferDestroy(str);
-          return NULL;
-          */
-          if (!LCH_BufferAppend(str, parser->cursor[1])) {
-            LCH_BufferDestroy(str);
-            return NULL;
-          }
+        return false;
       }
-      parser->cursor++;
-    } else if (!LCH_BufferAppend(str, parser->cursor[0])) {
-      LCH_BufferDestroy(str);
-      return NULL;
+      /* Control characters such as '\n' and '\u' are deliberately not
+       * interpreted, as this could modify binary strings. Hence, the
+       * backslash is simply dropped and the next character kept as is. */
+      escapes += 1;
+      cursor += 1;
     }
-    parser->cursor++;
+    cursor += 1;
   }
 
+  *start = parser->cursor;
+  assert(cursor >= parser->cursor);
+  *length = (size_t)(cursor - parser->cursor);
+  *num_escapes = escapes;
+
+  parser->cursor = cursor;
   if (!ParseToken(parser, "\"")) {
-    LCH_BufferDestroy(str);
-    return NULL;
+    return false;
   }
+  return true;
+}
 
-  return str;
+/**
+ * Copies a raw JSON string into dst while dropping escape characters. The
+ * destination may be the raw string itself, since it never grows.
+ */
+static void UnescapeString(char *const dst, const char *const src,
+                           const size_t length) {
+  size_t j = 0;
+  for (size_t i = 0; i < length; i++) {
+    if (src[i] == '\\') {
+      i += 1;
+    }
+    dst[j++] = src[i];
+  }
+}
+
+/**
+ * Parses a JSON string without copying it unless it has to be unescaped. When
+ * parsing in place, the string is unescaped within the source and terminated
+ * by a NULL-byte. Otherwise, strings containing escape sequences are unescaped
+ * into a new buffer returned through copy, and view borrows from it. In any
+ * other case, copy is set to NULL and view borrows straight from the input. In
+ * the latter case, view is not NULL-byte terminated.
+ */
+static bool ParseStringView(LCH_JsonParser *const parser,
+                            LCH_Buffer *const view, LCH_Buffer **const copy) {
+  const char *start;
+  size_t length, num_escapes;
+  if (!ScanString(parser, &start, &length, &num_escapes)) {
+    return false;
+  }
+
+  *copy = NULL;
+  view->capacity = 0;
+  view->mapped = false;
+
+  if (parser->source != NULL) {
+    /* The source is owned by the parser, so it is safe to write to it. The
+     * NULL-byte replaces the closing quote at the latest. */
+    char *const data = (char *)start;
+    if (num_escapes > 0) {
+      UnescapeString(data, start, length);
+    }
+    data[length - num_escapes] = '\0';
+    view->buffer = data;
+    view->length = length - num_escapes;
+    return true;
+  }
+
+  if (num_escapes == 0) {
+    view->buffer = (char *)start;
+    view->length = length;
+    return true;
+  }
+
+  LCH_Buffer *const buffer = LCH_BufferCreate();
+  if (buffer == NULL) {
+    return false;
+  }
+
+  size_t offset;
+  if (!LCH_BufferAllocate(buffer, length - num_escapes, &offset)) {
+    LCH_BufferDestroy(buffer);
+    return false;
+  }
+  UnescapeString(buffer->buffer + offset, start, length);
+
+  view->buffer = buffer->buffer;
+  view->length = buffer->length;
+  *copy = buffer;
+  return true;
 }
 
 static LCH_Json *ParseString(LCH_JsonParser *const parser) {
@@ -1449,17 +1478,32 @@ static LCH_Json *ParseString(LCH_JsonParser *const parser) {
   assert(parser->cursor != NULL);
   assert(parser->end != NULL);
 
-  LCH_Buffer *buffer = BufferParseString(parser);
-  if (buffer == NULL) {
+  LCH_Buffer view;
+  LCH_Buffer *buffer;
+  if (!ParseStringView(parser, &view, &buffer)) {
     return NULL;
   }
 
+  const bool borrowed = (buffer == NULL) && (parser->source != NULL);
+  if (buffer == NULL) {
+    buffer = borrowed ? LCH_BufferCreateView(view.buffer, view.length)
+                      : LCH_BufferDuplicate(&view);
+    if (buffer == NULL) {
+      return NULL;
+    }
+  }
+
   LCH_Json *const json = LCH_JsonStringCreate(buffer);
   if (json == NULL) {
     LCH_BufferDestroy(buffer);
     return NULL;
   }
 
+  if (borrowed) {
+    json->source = parser->source;
+    json->source->references += 1;
+  }
+
   return json;
 }
 
@@ -1489,8 +1533,17 @@ static LCH_Json *ParseObject(LCH_JsonParser *const parser) {
     }
     first = false;
 
-    LCH_Buffer *key = BufferParseString(parser);
-    if (key == NULL) {
+    if (!CheckToken(parser, "\"")) {
+      LCH_LOG_ERROR("Failed to parse JSON: Expected STRING as object key");
+      LCH_JsonDestroy(object);
+      return NULL;
+    }
+
+    /* The object makes its own copy of the key, hence there is no need to
+     * copy it here unless it contains escape sequences. */
+    LCH_Buffer key;
+    LCH_Buffer *copy;
+    if (!ParseStringView(parser, &key, &copy)) {
       LCH_JsonDestroy(object);
       return NULL;
     }
@@ -1498,26 +1551,26 @@ static LCH_Json *ParseObject(LCH_JsonParser *const parser) {
     TrimLeadingWhitespace(parser);
 
     if (!ParseToken(parser, ":")) {
-      LCH_BufferDestroy(key);
+      LCH_BufferDestroy(copy);
       LCH_JsonDestroy(object);
       return NULL;
     }
 
     LCH_Json *value = Parse(parser);
     if (value == NULL) {
-      LCH_BufferDestroy(key);
+      LCH_BufferDestroy(copy);
       LCH_JsonDestroy(object);
       return NULL;
     }
 
-    if (!LCH_JsonObjectSet(object, key, value)) {
+    if (!LCH_JsonObjectSet(object, &key, value)) {
       LCH_JsonDestroy(value);
-      LCH_BufferDestroy(key);
+      LCH_BufferDestroy(copy);
       LCH_JsonDestroy(object);
       return NULL;
     }
 
-    LCH_BufferDestroy(key);
+    LCH_BufferDestroy(copy);
     TrimLeadingWhitespace(parser);
   }
 
@@ -1584,11 +1637,17 @@ static LCH_Json *ParseNumber(LCH_JsonParser *const parser) {
   assert(parser->end != NULL);
 
   /* We make a null-byte terminated copy in order to make sure we don't scan
-   * beyond the buffer. */
+   * beyond the buffer. Only the characters that can be part of a number are
+   * copied, as opposed to the remaining buffer. */
   assert(parser->end >= parser->cursor);
-  const size_t max = (size_t)(parser->end - parser->cursor);
+  size_t max = 0;
+  while ((parser->cursor + max < parser->end) &&
+         (strchr("0123456789+-.eE", parser->cursor[max]) != NULL) &&
+         (parser->cursor[max] != '\0')) {
+    max += 1;
+  }
   char nt_copy[max + 1];
-  strncpy(nt_copy, parser->cursor, max);
+  memcpy(nt_copy, parser->cursor, max);
   nt_copy[max] = '\0';
 
   int n_chars;
@@ -1664,25 +1723,20 @@ static LCH_Json *Parse(LCH_JsonParser *const parser) {
   return NULL;
 }
 
-LCH_Json *LCH_JsonParse(const char *const str, const size_t len) {
-  assert(str != NULL);
-
-  LCH_JsonParser parser = {
-      .cursor = str,
-      .end = str + len,
-  };
+static LCH_Json *ParseAll(LCH_JsonParser *const parser) {
+  assert(parser != NULL);
 
-  LCH_Json *json = Parse(&parser);
+  LCH_Json *json = Parse(parser);
   if (json == NULL) {
     return NULL;
   }
 
-  TrimLeadingWhitespace(&parser);
+  TrimLeadingWhitespace(parser);
 
-  if (parser.cursor < parser.end) {
-    assert(parser.end >= parser.cursor);
+  if (parser->cursor < parser->end) {
+    assert(parser->end >= parser->cursor);
     char *const truncated = LCH_StringTruncate(
-        parser.cursor, (size_t)(parser.end - parser.cursor), 64);
+        parser->cursor, (size_t)(parser->end - parser->cursor), 64);
     LCH_LOG_ERROR("Failed to parse JSON: Expected End-of-File; but found '%s'",
                   truncated);
     free(truncated);
@@ -1693,26 +1747,51 @@ LCH_Json *LCH_JsonParse(const char *const str, const size_t len) {
   return json;
 }
 
-LCH_Json *LCH_JsonParseFile(const char *const filename) {
-  LCH_Buffer *const raw = LCH_BufferCreate();
-  if (raw == NULL) {
-    return NULL;
-  }
+LCH_Json *LCH_JsonParse(const char *const str, const size_t len) {
+  assert(str != NULL);
+
+  LCH_JsonParser parser = {
+      .cursor = str,
+      .end = str + len,
+      .source = NULL,
+  };
 
-  if (!LCH_BufferReadFile(raw, filename)) {
-    LCH_BufferDestroy(raw);
+  LCH_Json *const json = ParseAll(&parser);
+  return json;
+}
+
+LCH_Json *LCH_JsonParseBuffer(LCH_Buffer *const buffer) {
+  assert(buffer != NULL);
+  assert(buffer->capacity > 0);  // We must own the memory to write to it
+
+  LCH_JsonSource *const source =
+      (LCH_JsonSource *)malloc(sizeof(LCH_JsonSource));
+  if (source == NULL) {
+    LCH_LOG_ERROR("malloc(3): Failed to allocate memory: %s", strerror(errno));
+    LCH_BufferDestroy(buffer);
     return NULL;
   }
+  source->buffer = buffer;
+  source->references = 1;  // Held by the parser until it returns
 
-  const size_t length = LCH_BufferLength(raw);
-  const char *const data = LCH_BufferData(raw);
+  LCH_JsonParser parser = {
+      .cursor = buffer->buffer,
+      .end = buffer->buffer + buffer->length,
+      .source = source,
+  };
 
-  LCH_Json *const json = LCH_JsonParse(data, length);
-  LCH_BufferDestroy(raw);
-  if (json == NULL) {
+  LCH_Json *const json = ParseAll(&parser);
+  JsonSourceRelease(source);
+  return json;
+}
+
+LCH_Json *LCH_JsonParseFile(const char *const filename) {
+  LCH_Buffer *const raw = LCH_BufferMapFile(filename);
+  if (raw == NULL) {
     return NULL;
   }
 
+  LCH_Json *const json = LCH_JsonParseBuffer(raw);
   return json;
 }
 
@@ -1727,7 +1806,7 @@ static bool ComposeNull(LCH_NDEBUG_UNUSED const LCH_Json *const json,
   assert(buffer != NULL);
   assert(LCH_JsonGetType(json) == LCH_JSON_TYPE_NULL);
 
-  if (!LCH_BufferPrintFormat(buffer, "null")) {
+  if (!LCH_BufferAppendBytes(buffer, "null", strlen("null"))) {
     return false;
   }
   return true;
@@ -1739,7 +1818,7 @@ static bool ComposeTrue(LCH_NDEBUG_UNUSED const LCH_Json *const json,
   assert(buffer != NULL);
   assert(LCH_JsonGetType(json) == LCH_JSON_TYPE_TRUE);
 
-  if (!LCH_BufferPrintFormat(buffer, "true")) {
+  if (!LCH_BufferAppendBytes(buffer, "true", strlen("true"))) {
     return false;
   }
   return true;
@@ -1751,7 +1830,7 @@ static bool ComposeFalse(LCH_NDEBUG_UNUSED const LCH_Json *const json,
   assert(buffer != NULL);
   assert(LCH_JsonGetType(json) == LCH_JSON_TYPE_FALSE);
 
-  if (!LCH_BufferPrintFormat(buffer, "false")) {
+  if (!LCH_BufferAppendBytes(buffer, "false", strlen("false"))) {
     return false;
   }
   return true;
@@ -1766,45 +1845,46 @@ static bool StringComposeString(const LCH_Buffer *const str,
     return false;
   }
 
-  const size_t length = LCH_BufferLength(str);
-  const char *const data = LCH_BufferData(str);
-  for (size_t i = 0; i < length; i++) {
-    const char *control_sequence = NULL;
-    switch (data[i]) {
-      case '"':
-        control_sequence = "\\\"";
-        break;
-      case '\\':
-        control_sequence = "\\\\";
-        break;
-      /* This could modify binary strings!
-      case '\b':
-        control_sequence = "\\b";
-        break;
-      case '\f':
-        control_sequence = "\\f";
-        break;
-      case '\n':
-        control_sequence = "\\n";
-        break;
-      case '\r':
-        control_sequence = "\\r";
-        break;
-      case '\t':
-        control_sequence = "\\t";
-        break;
-      */
-      default:
-        if (!LCH_BufferAppend(buffer, data[i])) {
-          return false;
-        }
-        continue;
+  /* Only double quotes and backslashes are escaped, as escaping other control
+   * characters (e.g., '\n' as "\\n") could modify binary strings. Both are
+   * escaped by prefixing them with a backslash. Hence, we copy everything in
+   * between in bulk, and locate the next occurrence of each using memchr(3). */
+  const char *cursor = LCH_BufferData(str);
+  const char *const end = cursor + LCH_BufferLength(str);
+  const char *quote = (const char *)memchr(cursor, '"', (size_t)(end - cursor));
+  const char *backslash =
+      (const char *)memchr(cursor, '\\', (size_t)(end - cursor));
+
+  while (true) {
+    const char *special = end;
+    if (quote != NULL && quote < special) {
+      special = quote;
     }
-    assert(control_sequence != NULL);
-    if (!LCH_BufferPrintFormat(buffer, "%s", control_sequence)) {
+    if (backslash != NULL && backslash < special) {
+      special = backslash;
+    }
+
+    if (!LCH_BufferAppendBytes(buffer, cursor, (size_t)(special - cursor))) {
       return false;
     }
+
+    if (special == end) {
+      break;
+    }
+
+    const char escaped[] = {'\\', special[0]};
+    if (!LCH_BufferAppendBytes(buffer, escaped, sizeof(escaped))) {
+      return false;
+    }
+    cursor = special + 1;
+
+    if (special == quote) {
+      quote = (const char *)memchr(cursor, '"', (size_t)(end - cursor));
+    } else {
+      backslash = (const char *)memchr(cursor, '\\', (size_t)(end - cursor));
+    }
   }
+
   if (!LCH_BufferAppend(buffer, '"')) {
     return false;
   }
@@ -1824,34 +1904,61 @@ static bool ComposeString(const LCH_Json *const json,
   return true;
 }
 
+/**
+ * Formats an integer without going through printf(3). The number must be
+ * integral and within the range where doubles represent integers exactly.
+ */
+static bool ComposeInteger(const double number, LCH_Buffer *const buffer) {
+  assert(buffer != NULL);
+
+  char digits[24];
+  size_t index = sizeof(digits);
+
+  const bool negative = number < 0.0;
+  uint64_t value = (uint64_t)(negative ? -number : number);
+  do {
+    digits[--index] = (char)('0' + (value % 10));
+    value /= 10;
+  } while (value > 0);
+
+  if (negative) {
+    digits[--index] = '-';
+  }
+
+  return LCH_BufferAppendBytes(buffer, digits + index, sizeof(digits) - index);
+}
+
 static bool ComposeNumber(const LCH_Json *const json,
                           LCH_Buffer *const buffer) {
   assert(json != NULL);
   assert(buffer != NULL);
   assert(LCH_JsonGetType(json) == LCH_JSON_TYPE_NUMBER);
 
-  if (!LCH_BufferPrintFormat(buffer, "%f", json->number)) {
-    return false;
-  }
-
-  // Remove trailing zeroes
-  size_t length = LCH_BufferLength(buffer);
-  for (size_t i = 1; i < length; i++) {
-    const char *const data = LCH_BufferData(buffer);
-    if (data[length - i] != '0') {
+  /* Integers (e.g., timestamps and versions) are by far the most common. Note
+   * that NaN fails both comparisons. */
+  const double number = json->number;
+  if ((number >= -LCH_JSON_MAX_SAFE_INTEGER) &&
+      (number <= LCH_JSON_MAX_SAFE_INTEGER) &&
+      (number == (double)(int64_t)number)) {
+    return ComposeInteger(number, buffer);
+  }
+
+  /* Use the shortest representation that parses back to the same number. At
+   * most 17 significant digits are needed for any double. */
+  char str[32];
+  int length = 0;
+  for (int precision = 15; precision <= 17; precision++) {
+    length = snprintf(str, sizeof(str), "%.*g", precision, number);
+    if (length < 0 || (size_t)length >= sizeof(str)) {
+      LCH_LOG_ERROR("Failed to format number %g", number);
+      return false;
+    }
+    if (strtod(str, NULL) == number) {
       break;
     }
-    LCH_BufferChop(buffer, length - i);
-  }
-
-  // Remove trailing dot
-  length = LCH_BufferLength(buffer);
-  const char *const data = LCH_BufferData(buffer);
-  if (data[length - 1] == '.') {
-    LCH_BufferChop(buffer, length - 1);
   }
 
-  return true;
+  return LCH_BufferAppendBytes(buffer, str, (size_t)length);
 }
 
 static bool ComposeArray(const LCH_Json *const json, LCH_Buffer *const buffer,
@@ -1939,7 +2046,7 @@ static bool ComposeObject(const LCH_Json *const json, LCH_Buffer *const buffer,
     }
 
     if (pretty) {
-      if (!LCH_BufferPrintFormat(buffer, ": ")) {
+      if (!LCH_BufferAppendBytes(buffer, ": ", strlen(": "))) {
         LCH_ListDestroy(keys);
         return false;
       }
@@ -2048,6 +2155,7 @@ void LCH_JsonDestroy(void *const self) {
     LCH_BufferDestroy(json->str);
     LCH_ListDestroy(json->array);
     LCH_DictDestroy(json->object);
+    JsonSourceRelease(json->source);
   }
   free(json);
 }
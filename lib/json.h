@@ -622,12 +622,25 @@ bool LCH_JsonEqual(const LCH_Json *left, const LCH_Json *right);
  */
 LCH_Json *LCH_JsonParse(const char *str, size_t len);
 
+/**
+ * @brief Parse JSON formatted buffer in place.
+ * @param buffer Buffer containing JSON formatted string. The function takes
+ *               ownership of the buffer, also in case of failure.
+ * @return Parsed JSON element, or NULL in case of errors.
+ * @note Strings are unescaped within the buffer and borrowed by the returned
+ *       element instead of being copied. The buffer is destroyed once the last
+ *       string borrowing from it is destroyed, regardless of which element it
+ *       ended up in.
+ */
+LCH_Json *LCH_JsonParseBuffer(LCH_Buffer *buffer);
+
 /**
  * @brief Parse JSON formatted file.
  * @param filename Path to JSON formatted file.
  * @return Parsed JSON object.
  * @note Unlike other JSON parser, here JSON strings do not have to be
  *       NULL-terminated nor do they have to be ASCII.
+ * @note The file is parsed in place (see LCH_JsonParseBuffer).
  */
 LCH_Json *LCH_JsonParseFile(const char *filename);
 
@@ -8,15 +8,18 @@
 #include <string.h>
 
 #include "block.h"
+#include "compression.h"
 #include "csv.h"
 #include "definitions.h"
 #include "delta.h"
 #include "dict.h"
+#include "encoding.h"
 #include "files.h"
 #include "head.h"
 #include "instance.h"
 #include "json.h"
 #include "logger.h"
+#include "metrics.h"
 #include "patch.h"
 #include "string_lib.h"
 #include "table.h"
@@ -40,32 +43,21 @@ static bool Purge(const LCH_Instance *const instance) {
     return false;
   }
 
-  LCH_Json *child = NULL;
-  LCH_Json *parent = NULL;
-  const char *child_id = NULL;
-  const char *parent_id = head;
+  /* Only the block headers are needed to walk the chain */
+  char *child_id = NULL;
+  char *parent_id = head;
 
-  char path[PATH_MAX];
   for (size_t i = 0; i < chain_length; i++) {
-    if (!LCH_FilePathJoin(path, PATH_MAX, 3, work_dir, "blocks", parent_id)) {
-      LCH_JsonDestroy(child);
-      LCH_JsonDestroy(parent);
-      LCH_DictDestroy(whitelist);
-      free(head);
-      return false;
-    }
-
-    if (!LCH_FileExists(path)) {
+    if (!LCH_BlockExists(instance, parent_id)) {
       LCH_LOG_DEBUG("End-of-Chain reached at index %zu", i);
       break;
     }
 
     const LCH_Buffer key = LCH_BufferStaticFromString(parent_id);
     if (!LCH_DictSet(whitelist, &key, NULL, NULL)) {
-      LCH_JsonDestroy(child);
-      LCH_JsonDestroy(parent);
       LCH_DictDestroy(whitelist);
-      free(head);
+      free(child_id);
+      free(parent_id);
       return false;
     }
     if (child_id == NULL) {
@@ -76,110 +68,59 @@ static bool Purge(const LCH_Instance *const instance) {
                     parent_id, child_id, i);
     }
 
-    LCH_Json *const block = LCH_BlockLoad(work_dir, parent_id);
-    if (block == NULL) {
-      LCH_JsonDestroy(parent);
-      LCH_JsonDestroy(child);
+    char *grandparent_id;
+    double timestamp;
+    if (!LCH_BlockLoadHeader(instance, parent_id, &grandparent_id,
+                             &timestamp)) {
       LCH_DictDestroy(whitelist);
-      free(head);
+      free(child_id);
+      free(parent_id);
       return false;
     }
 
-    LCH_JsonDestroy(child);
-    child = parent;
-    parent = block;
-
+    free(child_id);
     child_id = parent_id;
-    parent_id = LCH_BlockGetParentId(parent);
-    if (parent_id == NULL) {
-      LCH_JsonDestroy(parent);
-      LCH_JsonDestroy(child);
-      LCH_DictDestroy(whitelist);
-      free(head);
-      return false;
-    }
+    parent_id = grandparent_id;
   }
 
-  LCH_JsonDestroy(parent);
-  LCH_JsonDestroy(child);
-  free(head);
+  free(child_id);
+  free(parent_id);
 
-  if (!LCH_FilePathJoin(path, PATH_MAX, 2, work_dir, "blocks")) {
+  const double start = LCH_MetricsStart();
+  if (!LCH_BlockRetain(instance, whitelist)) {
     LCH_DictDestroy(whitelist);
     return false;
   }
+  LCH_MetricsStop(LCH_METRICS_PHASE_PURGE, start);
 
-  LCH_List *const files = LCH_FileListDirectory(path, true);
-  if (files == NULL) {
-    LCH_DictDestroy(whitelist);
+  LCH_DictDestroy(whitelist);
+  return true;
+}
+
+bool LCH_Purge(const char *const work_dir) {
+  LCH_Instance *const instance = LCH_InstanceLoad(work_dir);
+  if (instance == NULL) {
+    LCH_LOG_ERROR("Failed to load instance from configuration file");
     return false;
   }
 
-  size_t num_deleted = 0;
-  size_t num_blocks = 0;
-  const size_t num_files = LCH_ListLength(files);
-  for (size_t i = 0; i < num_files; i++) {
-    const char *const filename = (char *)LCH_ListGet(files, i);
-    if (!LCH_FilePathJoin(path, PATH_MAX, 3, work_dir, "blocks", filename)) {
-      LCH_ListDestroy(files);
-      LCH_DictDestroy(whitelist);
-      return false;
-    }
-
-    bool is_block_id = true;
-    for (const char *ch = filename; *ch != '\0'; ch++) {
-      if (isxdigit((int)(*ch)) == 0) {
-        is_block_id = false;
-        break;
-      }
-    }
-    if (!is_block_id) {
-      LCH_LOG_DEBUG(
-          "Skipping deletion of file '%s': "
-          "Basename contains an invalid block identifier '%s'",
-          path, filename);
-      continue;
-    }
-
-    if (!LCH_FileIsRegular(path)) {
-      LCH_LOG_DEBUG("Skipping deletion of file '%s': Not a regular file", path);
-      continue;
-    }
-
-    // By now we're pretty certain that it is indeed a block.
-    num_blocks += 1;
-
-    const LCH_Buffer key = LCH_BufferStaticFromString(filename);
-    if (LCH_DictHasKey(whitelist, &key)) {
-      LCH_LOG_DEBUG("Skipping deletion of file '%s': Block is whitelisted",
-                    path);
-      continue;
-    }
-
-    if (!LCH_FileDelete(path)) {
-      LCH_ListDestroy(files);
-      LCH_DictDestroy(whitelist);
-      return false;
-    }
-    LCH_LOG_VERBOSE("Deleted file '%s'", path);
-    num_deleted += 1;
+  if (!Purge(instance)) {
+    LCH_InstanceDestroy(instance);
+    return false;
   }
 
-  LCH_LOG_INFO("Purged %zu out of %zu blocks", num_deleted, num_blocks);
-
-  LCH_ListDestroy(files);
-  LCH_DictDestroy(whitelist);
+  LCH_InstanceDestroy(instance);
   return true;
 }
 
-bool LCH_Purge(const char *const work_dir) {
+bool LCH_MigrateBlocks(const char *const work_dir) {
   LCH_Instance *const instance = LCH_InstanceLoad(work_dir);
   if (instance == NULL) {
     LCH_LOG_ERROR("Failed to load instance from configuration file");
     return false;
   }
 
-  if (!Purge(instance)) {
+  if (!LCH_BlockMigrate(instance)) {
     LCH_InstanceDestroy(instance);
     return false;
   }
@@ -188,10 +129,102 @@ bool LCH_Purge(const char *const work_dir) {
   return true;
 }
 
-static bool Commit(const LCH_Instance *const instance) {
+/**
+ * Compute the delta between the new state and the old state of a table. In
+ * case the snapshots hold row digests, the new state is replaced by its
+ * digested form, so that it can be stored as the next snapshot.
+ */
+static LCH_Json *CommitDelta(const LCH_TableInfo *const table_def,
+                             const bool snapshot_digests,
+                             LCH_Json **const new_state,
+                             const LCH_Json *const old_state) {
+  const char *const table_id = LCH_TableInfoGetIdentifier(table_def);
+  const bool partial_updates = LCH_TableInfoShouldUsePartialUpdates(table_def);
+
+  if (!snapshot_digests) {
+    LCH_Json *const delta =
+        LCH_DeltaCreate(table_id, "delta", *new_state, old_state);
+    if (delta == NULL) {
+      return NULL;
+    }
+
+    if (partial_updates && !LCH_DeltaNarrowUpdates(delta, old_state)) {
+      LCH_LOG_ERROR("Failed to compute partial updates for table '%s'.",
+                    table_id);
+      LCH_JsonDestroy(delta);
+      return NULL;
+    }
+
+    return delta;
+  }
+
+  if (partial_updates) {
+    LCH_LOG_VERBOSE(
+        "Partial updates are not available for table '%s', because the old "
+        "values are not stored in snapshots with row digests.",
+        table_id);
+  }
+
+  LCH_Json *const digests = LCH_TableStateDigest(*new_state);
+  if (digests == NULL) {
+    return NULL;
+  }
+
+  LCH_Json *const delta = LCH_DeltaCreate(table_id, "delta", digests, old_state);
+  if (delta == NULL) {
+    LCH_JsonDestroy(digests);
+    return NULL;
+  }
+
+  if (!LCH_DeltaResolveDigests(delta, *new_state)) {
+    LCH_JsonDestroy(delta);
+    LCH_JsonDestroy(digests);
+    return NULL;
+  }
+
+  LCH_JsonDestroy(*new_state);
+  *new_state = digests;
+  return delta;
+}
+
+/**
+ * Store the new state of a table as the next snapshot. With the snapshot log
+ * enabled, only the changes are appended to the log, until it grows too large
+ * and is compacted into a complete snapshot.
+ */
+static bool StoreSnapshot(const LCH_Instance *const instance,
+                          const LCH_TableInfo *const table_def,
+                          const LCH_Json *const delta,
+                          const LCH_Json *const new_state) {
   const char *const work_dir = LCH_InstanceGetWorkDirectory(instance);
+
+  if (LCH_InstanceShouldLogSnapshots(instance)) {
+    const size_t log_limit = LCH_InstanceGetSnapshotLogLimit(instance);
+    bool appended;
+    if (!LCH_TableAppendNewState(table_def, work_dir, log_limit, delta,
+                                 new_state, &appended)) {
+      return false;
+    }
+    if (appended) {
+      return true;
+    }
+  }
+
   const bool pretty_print = LCH_InstanceShouldPrettyPrint(instance);
+  const LCH_Compression compression = LCH_InstanceGetCompression(instance);
+  return LCH_TableStoreNewState(table_def, work_dir, pretty_print, compression,
+                                new_state);
+}
+
+static bool Commit(const LCH_Instance *const instance) {
+  const char *const work_dir = LCH_InstanceGetWorkDirectory(instance);
+  const bool snapshot_digests =
+      LCH_InstanceShouldStoreSnapshotDigests(instance);
   const LCH_List *const table_defs = LCH_InstanceGetTables(instance);
+  if (table_defs == NULL) {
+    LCH_LOG_ERROR("Failed to load table definitions");
+    return false;
+  }
 
   size_t n_tables = LCH_ListLength(table_defs);
   size_t tot_inserts = 0, tot_deletes = 0, tot_updates = 0;
@@ -208,19 +241,47 @@ static bool Commit(const LCH_Instance *const instance) {
 
     /************************************************************************/
 
-    LCH_Json *const new_state = LCH_TableInfoLoadNewState(table_def);
+    /* The fingerprint is obtained before loading the table, such that any
+     * changes made in between are picked up by the next commit. */
+    LCH_Buffer *const fingerprint = LCH_TableInfoLoadFingerprint(table_def);
+    if (fingerprint != NULL &&
+        LCH_TableFingerprintMatches(table_def, work_dir, fingerprint)) {
+      LCH_LOG_VERBOSE(
+          "Fingerprint of table '%s' is unchanged; skipping table.", table_id);
+      LCH_BufferDestroy(fingerprint);
+      continue;
+    }
+
+    /* Remove the old fingerprint, as it no longer matches the snapshot once
+     * the snapshot is updated */
+    if (!LCH_TableStoreFingerprint(table_def, work_dir, NULL)) {
+      LCH_BufferDestroy(fingerprint);
+      LCH_JsonDestroy(deltas);
+      return false;
+    }
+
+    double start = LCH_MetricsStart();
+    LCH_Json *new_state = LCH_TableInfoLoadNewState(table_def);
+    LCH_MetricsStop(LCH_METRICS_PHASE_LOAD_NEW_STATE, start);
     if (new_state == NULL) {
       LCH_LOG_ERROR("Failed to load new state for table '%s'.", table_id);
+      LCH_BufferDestroy(fingerprint);
       LCH_JsonDestroy(deltas);
       return false;
     }
     LCH_LOG_VERBOSE("Loaded new state for table '%s' containing %zu rows.",
                     table_id, LCH_JsonObjectLength(new_state));
 
-    LCH_Json *const old_state = LCH_TableInfoLoadOldState(table_def, work_dir);
+    start = LCH_MetricsStart();
+    LCH_Json *old_state = LCH_InstanceTakeSnapshot(instance, table_id);
+    if (old_state == NULL) {
+      old_state = LCH_TableInfoLoadOldState(table_def, work_dir);
+    }
+    LCH_MetricsStop(LCH_METRICS_PHASE_LOAD_OLD_STATE, start);
     if (old_state == NULL) {
       LCH_LOG_ERROR("Failed to load old state for table '%s'.", table_id);
       LCH_JsonDestroy(new_state);
+      LCH_BufferDestroy(fingerprint);
       LCH_JsonDestroy(deltas);
       return false;
     }
@@ -229,12 +290,15 @@ static bool Commit(const LCH_Instance *const instance) {
 
     /************************************************************************/
 
+    start = LCH_MetricsStart();
     LCH_Json *const delta =
-        LCH_DeltaCreate(table_id, "delta", new_state, old_state);
+        CommitDelta(table_def, snapshot_digests, &new_state, old_state);
+    LCH_MetricsStop(LCH_METRICS_PHASE_DELTA, start);
     LCH_JsonDestroy(old_state);
     if (delta == NULL) {
       LCH_LOG_ERROR("Failed to compute delta for table '%s'.", table_id);
       LCH_JsonDestroy(new_state);
+      LCH_BufferDestroy(fingerprint);
       LCH_JsonDestroy(deltas);
       return false;
     }
@@ -243,6 +307,7 @@ static bool Commit(const LCH_Instance *const instance) {
     if (!LCH_DeltaGetNumOperations(delta, &num_inserts, &num_deletes,
                                    &num_updates)) {
       LCH_JsonDestroy(new_state);
+      LCH_BufferDestroy(fingerprint);
       LCH_JsonDestroy(deltas);
       return false;
     }
@@ -258,6 +323,7 @@ static bool Commit(const LCH_Instance *const instance) {
     if (!LCH_JsonArrayAppend(deltas, delta)) {
       LCH_JsonDestroy(delta);
       LCH_JsonDestroy(new_state);
+      LCH_BufferDestroy(fingerprint);
       LCH_JsonDestroy(deltas);
       return false;
     }
@@ -265,10 +331,13 @@ static bool Commit(const LCH_Instance *const instance) {
     /************************************************************************/
 
     if (num_inserts > 0 || num_deletes > 0 || num_updates > 0) {
-      if (!LCH_TableStoreNewState(table_def, work_dir, pretty_print,
-                                  new_state)) {
+      start = LCH_MetricsStart();
+      const bool stored = StoreSnapshot(instance, table_def, delta, new_state);
+      LCH_MetricsStop(LCH_METRICS_PHASE_STORE_SNAPSHOT, start);
+      if (!stored) {
         LCH_LOG_ERROR("Failed to store new state for table '%s'.", table_id);
         LCH_JsonDestroy(new_state);
+        LCH_BufferDestroy(fingerprint);
         LCH_JsonDestroy(deltas);
         return false;
       }
@@ -279,7 +348,15 @@ static bool Commit(const LCH_Instance *const instance) {
           "Zero changes made in table '%s'; skipping snapshot update.",
           table_id);
     }
-    LCH_JsonDestroy(new_state);
+    LCH_InstanceKeepSnapshot(instance, table_id, new_state);
+
+    if (!LCH_TableStoreFingerprint(table_def, work_dir, fingerprint)) {
+      LCH_LOG_ERROR("Failed to store fingerprint for table '%s'.", table_id);
+      LCH_BufferDestroy(fingerprint);
+      LCH_JsonDestroy(deltas);
+      return false;
+    }
+    LCH_BufferDestroy(fingerprint);
   }
 
   char *const parent_id = LCH_HeadGet("HEAD", work_dir);
@@ -289,7 +366,8 @@ static bool Commit(const LCH_Instance *const instance) {
     return false;
   }
 
-  LCH_Json *const block = LCH_BlockCreate(parent_id, deltas);
+  LCH_Json *const block = LCH_BlockCreate(parent_id, deltas,
+                                          LCH_InstanceGetEncoding(instance));
   free(parent_id);
   if (block == NULL) {
     LCH_LOG_ERROR("Failed to create block.");
@@ -312,40 +390,44 @@ static bool Commit(const LCH_Instance *const instance) {
   return true;
 }
 
-bool LCH_Commit(const char *const work_dir) {
-  assert(work_dir != NULL);
-
-  LCH_Instance *const instance = LCH_InstanceLoad(work_dir);
-  if (instance == NULL) {
-    LCH_LOG_ERROR("Failed to load instance from configuration file");
-    return false;
-  }
-
+static bool CommitAndPurge(const LCH_Instance *const instance) {
   if (!Commit(instance)) {
     LCH_LOG_ERROR("Failed to commit state changes");
-    LCH_InstanceDestroy(instance);
     return false;
   }
 
   if (LCH_InstanceShouldAutoPurge(instance)) {
     LCH_LOG_DEBUG("Auto purge is enabled; purging blocks");
     if (!Purge(instance)) {
-      LCH_InstanceDestroy(instance);
       return false;
     }
   }
 
-  LCH_InstanceDestroy(instance);
   return true;
 }
 
-static LCH_Json *CreateEmptyBlock(const char *const parent_id) {
+bool LCH_Commit(const char *const work_dir) {
+  assert(work_dir != NULL);
+
+  LCH_Instance *const instance = LCH_InstanceLoad(work_dir);
+  if (instance == NULL) {
+    LCH_LOG_ERROR("Failed to load instance from configuration file");
+    return false;
+  }
+
+  const bool success = CommitAndPurge(instance);
+  LCH_InstanceDestroy(instance);
+  return success;
+}
+
+static LCH_Json *CreateEmptyBlock(const char *const parent_id,
+                                  const LCH_Encoding encoding) {
   LCH_Json *const empty_payload = LCH_JsonArrayCreate();
   if (empty_payload == NULL) {
     return NULL;
   }
 
-  LCH_Json *block = LCH_BlockCreate(parent_id, empty_payload);
+  LCH_Json *block = LCH_BlockCreate(parent_id, empty_payload, encoding);
   if (block == NULL) {
     LCH_JsonDestroy(empty_payload);
     return NULL;
@@ -362,7 +444,6 @@ static LCH_Json *MergeBlocks(const LCH_Instance *const instance,
   assert(child != NULL);
   assert(patch != NULL);
 
-  const char *const work_dir = LCH_InstanceGetWorkDirectory(instance);
   const char *const parent_id = LCH_BlockGetParentId(child);
 
   if (LCH_StringEqual(parent_id, final_id)) {
@@ -370,7 +451,7 @@ static LCH_Json *MergeBlocks(const LCH_Instance *const instance,
     return child;
   }
 
-  LCH_Json *const parent = LCH_BlockLoad(work_dir, parent_id);
+  LCH_Json *const parent = LCH_BlockLoad(instance, parent_id);
   if (parent == NULL) {
     LCH_LOG_ERROR("Failed to load block with identifier %.7s", parent_id);
     LCH_JsonDestroy(child);
@@ -385,106 +466,124 @@ static LCH_Json *MergeBlocks(const LCH_Instance *const instance,
     return NULL;
   }
 
-  const LCH_Json *child_payload = LCH_BlockGetPayload(child);
+  /* Index the parent deltas by table identifier, such that each child delta
+   * is matched by a single lookup */
+  LCH_Dict *const parent_deltas = LCH_BlockIndexPayload(parent);
+  if (parent_deltas == NULL) {
+    LCH_JsonDestroy(child);
+    LCH_JsonDestroy(parent);
+    return NULL;
+  }
+
+  LCH_Json *const child_payload = LCH_BlockRemovePayload(child);
   if (child_payload == NULL) {
+    LCH_DictDestroy(parent_deltas);
+    LCH_JsonDestroy(child);
+    LCH_JsonDestroy(parent);
+    return NULL;
+  }
+
+  /* Child deltas to keep after merge */
+  LCH_Json *const keep = LCH_JsonArrayCreate();
+  if (keep == NULL) {
+    LCH_JsonDestroy(child_payload);
+    LCH_DictDestroy(parent_deltas);
     LCH_JsonDestroy(child);
     LCH_JsonDestroy(parent);
     return NULL;
   }
 
-  size_t num_keep = 0; /* Number of child deltas to keep after merge */
-  LCH_Buffer id_key = LCH_BufferStaticFromString("id");
-  const size_t num_parent_deltas = LCH_JsonArrayLength(parent_payload);
-  while (LCH_JsonArrayLength(child_payload) > num_keep) {
-    LCH_Json *const child_delta = LCH_JsonArrayRemoveObject(child_payload, 0);
+  /* Removing the deltas from the end of the reversed array visits them in
+   * their original order, without shifting the remaining ones */
+  LCH_JsonArrayReverse(child_payload);
+  size_t num_deltas;
+  while ((num_deltas = LCH_JsonArrayLength(child_payload)) > 0) {
+    LCH_Json *const child_delta =
+        LCH_JsonArrayRemoveObject(child_payload, num_deltas - 1);
     if (child_delta == NULL) {
+      LCH_JsonDestroy(keep);
+      LCH_JsonDestroy(child_payload);
+      LCH_DictDestroy(parent_deltas);
       LCH_JsonDestroy(child);
       LCH_JsonDestroy(parent);
       return NULL;
     }
 
-    const LCH_Buffer *const child_table_id =
-        LCH_JsonObjectGetString(child_delta, &id_key);
-    if (child_table_id == NULL) {
+    const char *const table_id = LCH_DeltaGetTableId(child_delta);
+    if (table_id == NULL) {
       LCH_JsonDestroy(child_delta);
+      LCH_JsonDestroy(keep);
+      LCH_JsonDestroy(child_payload);
+      LCH_DictDestroy(parent_deltas);
       LCH_JsonDestroy(child);
       LCH_JsonDestroy(parent);
       return NULL;
     }
 
-    bool found = false;
-    const LCH_Json *parent_delta = NULL;
-
-    for (size_t i = 0; i < num_parent_deltas; i++) {
-      parent_delta = LCH_JsonArrayGetObject(parent_payload, i);
-      if (parent_delta == NULL) {
-        LCH_JsonDestroy(child_delta);
-        LCH_JsonDestroy(child);
-        LCH_JsonDestroy(parent);
-        return NULL;
-      }
-
-      const LCH_Buffer *const parent_table_id =
-          LCH_JsonObjectGetString(parent_delta, &id_key);
-      if (parent_table_id == NULL) {
-        LCH_JsonDestroy(child_delta);
-        LCH_JsonDestroy(child);
-        LCH_JsonDestroy(parent);
-        return NULL;
-      }
-
-      if (LCH_BufferEqual(parent_table_id, child_table_id)) {
-        found = true;
-        break;
-      }
-    }
+    const LCH_Buffer key = LCH_BufferStaticFromString(table_id);
+    if (LCH_DictHasKey(parent_deltas, &key)) {
+      const LCH_Json *const parent_delta =
+          (const LCH_Json *)LCH_DictGet(parent_deltas, &key);
 
-    if (found) {
       const LCH_TableInfo *const table =
-          LCH_InstanceGetTable(instance, LCH_BufferData(child_table_id));
+          LCH_InstanceGetTable(instance, table_id);
       if (table == NULL) {
         LCH_LOG_ERROR("Could not find table definition for table '%s'",
-                      child_table_id);
+                      table_id);
         LCH_JsonDestroy(child_delta);
+        LCH_JsonDestroy(keep);
+        LCH_JsonDestroy(child_payload);
+        LCH_DictDestroy(parent_deltas);
         LCH_JsonDestroy(child);
         LCH_JsonDestroy(parent);
         return NULL;
       }
 
       if (LCH_TableInfoShouldMergeTable(table)) {
-        if (!LCH_DeltaMerge(parent_delta, child_delta)) {
+        const double start = LCH_MetricsStart();
+        const bool merged = LCH_DeltaMerge(parent_delta, child_delta);
+        LCH_MetricsStop(LCH_METRICS_PHASE_MERGE, start);
+        if (!merged) {
           LCH_LOG_ERROR(
               "Failed to merge parent block delta with child block delta for "
               "table '%s'",
-              child_table_id);
+              table_id);
           LCH_JsonDestroy(child_delta);
+          LCH_JsonDestroy(keep);
+          LCH_JsonDestroy(child_payload);
+          LCH_DictDestroy(parent_deltas);
           LCH_JsonDestroy(child);
           LCH_JsonDestroy(parent);
           return NULL;
         }
         LCH_JsonDestroy(child_delta);
       } else {
-        if (!LCH_JsonArrayAppend(child_payload, child_delta)) {
+        if (!LCH_JsonArrayAppend(keep, child_delta)) {
           LCH_LOG_ERROR(
               "Failed to add delta for table '%s' back to child block",
-              child_table_id);
+              table_id);
           LCH_JsonDestroy(child_delta);
+          LCH_JsonDestroy(keep);
+          LCH_JsonDestroy(child_payload);
+          LCH_DictDestroy(parent_deltas);
           LCH_JsonDestroy(child);
           LCH_JsonDestroy(parent);
           return NULL;
         }
-        num_keep += 1;
       }
     } else {
       /* Even though some tables may have disabled merging of blocks, it's still
        * fine to move deltas from one block to the next as long as it does not
        * hide any intermediary states. This is one of those cases. */
-      if (!LCH_JsonArrayAppend(parent, child_delta)) {
+      if (!LCH_JsonArrayAppend(parent_payload, child_delta)) {
         LCH_LOG_ERROR(
             "Failed to append child block delta for table '%s' to parent block "
             "payload",
-            child_table_id);
+            table_id);
         LCH_JsonDestroy(child_delta);
+        LCH_JsonDestroy(keep);
+        LCH_JsonDestroy(child_payload);
+        LCH_DictDestroy(parent_deltas);
         LCH_JsonDestroy(child);
         LCH_JsonDestroy(parent);
         return NULL;
@@ -492,10 +591,19 @@ static LCH_Json *MergeBlocks(const LCH_Instance *const instance,
     }
   }
 
-  if (LCH_JsonArrayLength(child_payload) > 0) {
+  LCH_JsonDestroy(child_payload);
+  LCH_DictDestroy(parent_deltas);
+
+  if (LCH_JsonArrayLength(keep) > 0) {
     /* Child payload did not get fully merged. Most likely due to merging being
      * disabled for some tables. We'll add the block back to the patch payload.
      */
+    if (!LCH_BlockAppendPayload(child, keep)) {
+      LCH_JsonDestroy(keep);
+      LCH_JsonDestroy(child);
+      LCH_JsonDestroy(parent);
+      return NULL;
+    }
     if (!LCH_PatchAppendBlock(patch, child)) {
       LCH_LOG_ERROR("Failed to child block to patch");
       LCH_JsonDestroy(child);
@@ -503,6 +611,7 @@ static LCH_Json *MergeBlocks(const LCH_Instance *const instance,
       return NULL;
     }
   } else {
+    LCH_JsonDestroy(keep);
     LCH_JsonDestroy(child);
   }
 
@@ -510,49 +619,40 @@ static LCH_Json *MergeBlocks(const LCH_Instance *const instance,
   return merged;
 }
 
-LCH_Buffer *LCH_Diff(const char *const work_dir, const char *const argument) {
-  assert(work_dir != NULL);
-  assert(argument != NULL);
-
-  char *const final_id = LCH_BlockIdFromArgument(work_dir, argument);
+static LCH_Buffer *Diff(const LCH_Instance *const instance,
+                        const char *const argument) {
+  const char *const work_dir = LCH_InstanceGetWorkDirectory(instance);
+  char *const final_id = LCH_BlockIdFromArgument(instance, argument);
   if (final_id == NULL) {
     return NULL;
   }
 
-  LCH_Instance *const instance = LCH_InstanceLoad(work_dir);
-  if (instance == NULL) {
-    LCH_LOG_ERROR("Failed to load instance from configuration file");
-    free(final_id);
-    return NULL;
-  }
-
   const bool pretty_print = LCH_InstanceShouldPrettyPrint(instance);
+  const LCH_Compression compression = LCH_InstanceGetCompression(instance);
+  const LCH_Encoding encoding = LCH_InstanceGetEncoding(instance);
 
   char *const block_id = LCH_HeadGet("HEAD", work_dir);
   if (block_id == NULL) {
     LCH_LOG_ERROR(
         "Failed to get block identifier from the head of the chain. "
         "Maybe there has not been any commits yet?");
-    LCH_InstanceDestroy(instance);
     free(final_id);
     return NULL;
   }
 
-  LCH_Json *const patch = LCH_PatchCreate(block_id);
+  LCH_Json *const patch = LCH_PatchCreate(block_id, encoding);
   if (patch == NULL) {
     LCH_LOG_ERROR("Failed to create patch");
     free(block_id);
-    LCH_InstanceDestroy(instance);
     free(final_id);
     return NULL;
   }
 
-  LCH_Json *const empty = CreateEmptyBlock(block_id);
+  LCH_Json *const empty = CreateEmptyBlock(block_id, encoding);
   free(block_id);
   if (empty == NULL) {
     LCH_LOG_ERROR("Failed to create empty block");
     LCH_JsonDestroy(patch);
-    LCH_InstanceDestroy(instance);
     free(final_id);
     return NULL;
   }
@@ -561,11 +661,9 @@ LCH_Buffer *LCH_Diff(const char *const work_dir, const char *const argument) {
   if (block == NULL) {
     LCH_LOG_ERROR("Failed to generate patch file");
     LCH_JsonDestroy(patch);
-    LCH_InstanceDestroy(instance);
     free(final_id);
     return NULL;
   }
-  LCH_InstanceDestroy(instance);
   free(final_id);
 
   if (!LCH_PatchAppendBlock(patch, block)) {
@@ -583,13 +681,26 @@ LCH_Buffer *LCH_Diff(const char *const work_dir, const char *const argument) {
     return NULL;
   }
 
-  LCH_Buffer *patch_buffer = LCH_JsonCompose(patch, pretty_print);
+  double start = LCH_MetricsStart();
+  LCH_Buffer *const json_buffer =
+      LCH_EncodingCompose(patch, encoding, pretty_print);
   LCH_JsonDestroy(patch);
-  if (patch_buffer == NULL) {
+  if (json_buffer == NULL) {
     LCH_LOG_ERROR("Failed to compose patch into JSON");
     return NULL;
   }
 
+  /* The codec header tells the receiving end how to decompress the patch */
+  LCH_Buffer *const patch_buffer = LCH_CompressionEncode(
+      LCH_BufferData(json_buffer), LCH_BufferLength(json_buffer), compression);
+  LCH_BufferDestroy(json_buffer);
+  LCH_MetricsStop(LCH_METRICS_PHASE_BLOCK_COMPOSE, start);
+  if (patch_buffer == NULL) {
+    LCH_LOG_ERROR("Failed to compress patch using compression method '%s'",
+                  LCH_CompressionToString(compression));
+    return NULL;
+  }
+
   LCH_Buffer *digest_buffer = LCH_BufferCreate();
   if (digest_buffer == NULL) {
     LCH_LOG_ERROR("Failed to create buffer for message digest");
@@ -598,15 +709,19 @@ LCH_Buffer *LCH_Diff(const char *const work_dir, const char *const argument) {
   }
 
   /* In the future we might support different algorithms */
-  if (!LCH_BufferPrintFormat(digest_buffer, "SHA1=")) {
+  if (!LCH_BufferAppendBytes(digest_buffer, "SHA1=", strlen("SHA1="))) {
     LCH_LOG_ERROR("Failed to write message digest algorithm to buffer");
     LCH_BufferDestroy(patch_buffer);
     LCH_BufferDestroy(digest_buffer);
     return NULL;
   }
 
-  if (!LCH_MessageDigest((const unsigned char *)LCH_BufferData(patch_buffer),
-                         LCH_BufferLength(patch_buffer), digest_buffer)) {
+  start = LCH_MetricsStart();
+  const bool digested =
+      LCH_MessageDigest((const unsigned char *)LCH_BufferData(patch_buffer),
+                        LCH_BufferLength(patch_buffer), digest_buffer);
+  LCH_MetricsStop(LCH_METRICS_PHASE_HASH, start);
+  if (!digested) {
     LCH_LOG_ERROR("Failed to compute message digest");
     LCH_BufferDestroy(patch_buffer);
     LCH_BufferDestroy(digest_buffer);
@@ -625,6 +740,21 @@ LCH_Buffer *LCH_Diff(const char *const work_dir, const char *const argument) {
   return digest_buffer;
 }
 
+LCH_Buffer *LCH_Diff(const char *const work_dir, const char *const argument) {
+  assert(work_dir != NULL);
+  assert(argument != NULL);
+
+  LCH_Instance *const instance = LCH_InstanceLoad(work_dir);
+  if (instance == NULL) {
+    LCH_LOG_ERROR("Failed to load instance from configuration file");
+    return NULL;
+  }
+
+  LCH_Buffer *const patch = Diff(instance, argument);
+  LCH_InstanceDestroy(instance);
+  return patch;
+}
+
 LCH_Buffer *LCH_Rebase(const char *const work_dir) {
   LCH_Instance *const instance = LCH_InstanceLoad(work_dir);
   if (instance == NULL) {
@@ -633,8 +763,17 @@ LCH_Buffer *LCH_Rebase(const char *const work_dir) {
   }
 
   const bool pretty_print = LCH_InstanceShouldPrettyPrint(instance);
+  const bool snapshot_digests =
+      LCH_InstanceShouldStoreSnapshotDigests(instance);
+  const LCH_Compression compression = LCH_InstanceGetCompression(instance);
+  const LCH_Encoding encoding = LCH_InstanceGetEncoding(instance);
 
   const LCH_List *const table_defs = LCH_InstanceGetTables(instance);
+  if (table_defs == NULL) {
+    LCH_LOG_ERROR("Failed to load table definitions");
+    LCH_InstanceDestroy(instance);
+    return NULL;
+  }
   size_t n_tables = LCH_ListLength(table_defs);
   size_t tot_inserts = 0;
 
@@ -650,17 +789,36 @@ LCH_Buffer *LCH_Rebase(const char *const work_dir) {
     const char *const table_id = LCH_TableInfoGetIdentifier(table_def);
 
     /************************************************************************/
-    LCH_Json *const new_state = LCH_TableInfoLoadOldState(table_def, work_dir);
-    if (new_state == NULL) {
-      LCH_LOG_ERROR("Failed to load old state as new state for table '%s'.",
-                    table_id);
-      LCH_JsonDestroy(deltas);
-      LCH_InstanceDestroy(instance);
-      return NULL;
+    LCH_Json *new_state;
+    if (snapshot_digests) {
+      /* The snapshot only holds row digests. Hence, we have to read the
+       * current state of the table from the source instead. */
+      const double start = LCH_MetricsStart();
+      new_state = LCH_TableInfoLoadNewState(table_def);
+      LCH_MetricsStop(LCH_METRICS_PHASE_LOAD_NEW_STATE, start);
+      if (new_state == NULL) {
+        LCH_LOG_ERROR("Failed to load new state for table '%s'.", table_id);
+        LCH_JsonDestroy(deltas);
+        LCH_InstanceDestroy(instance);
+        return NULL;
+      }
+      LCH_LOG_VERBOSE("Loaded new state for table '%s' containing %zu rows.",
+                      table_id, LCH_JsonObjectLength(new_state));
+    } else {
+      const double start = LCH_MetricsStart();
+      new_state = LCH_TableInfoLoadOldState(table_def, work_dir);
+      LCH_MetricsStop(LCH_METRICS_PHASE_LOAD_OLD_STATE, start);
+      if (new_state == NULL) {
+        LCH_LOG_ERROR("Failed to load old state as new state for table '%s'.",
+                      table_id);
+        LCH_JsonDestroy(deltas);
+        LCH_InstanceDestroy(instance);
+        return NULL;
+      }
+      LCH_LOG_VERBOSE(
+          "Loaded old state as new state for table '%s' containing %zu rows.",
+          table_id, LCH_JsonObjectLength(new_state));
     }
-    LCH_LOG_VERBOSE(
-        "Loaded old state as new state for table '%s' containing %zu rows.",
-        table_id, LCH_JsonObjectLength(new_state));
 
     LCH_Json *const old_state = LCH_JsonObjectCreate();
     if (old_state == NULL) {
@@ -677,8 +835,10 @@ LCH_Buffer *LCH_Rebase(const char *const work_dir) {
 
     /************************************************************************/
 
+    const double start = LCH_MetricsStart();
     LCH_Json *const delta =
         LCH_DeltaCreate(table_id, "rebase", new_state, old_state);
+    LCH_MetricsStop(LCH_METRICS_PHASE_DELTA, start);
     LCH_JsonDestroy(old_state);
     LCH_JsonDestroy(new_state);
     if (delta == NULL) {
@@ -717,7 +877,7 @@ LCH_Buffer *LCH_Rebase(const char *const work_dir) {
 
   LCH_InstanceDestroy(instance);
 
-  LCH_Json *const block = LCH_BlockCreate(parent_id, deltas);
+  LCH_Json *const block = LCH_BlockCreate(parent_id, deltas, encoding);
   if (block == NULL) {
     LCH_LOG_ERROR("Failed to create block.");
     free(parent_id);
@@ -730,7 +890,7 @@ LCH_Buffer *LCH_Rebase(const char *const work_dir) {
       "tables",
       tot_inserts, 0, 0, n_tables);
 
-  LCH_Json *const patch = LCH_PatchCreate(parent_id);
+  LCH_Json *const patch = LCH_PatchCreate(parent_id, encoding);
   free(parent_id);
   if (patch == NULL) {
     LCH_LOG_ERROR("Failed to create patch");
@@ -744,13 +904,25 @@ LCH_Buffer *LCH_Rebase(const char *const work_dir) {
     return NULL;
   }
 
-  LCH_Buffer *const buffer = LCH_JsonCompose(patch, pretty_print);
+  const double start = LCH_MetricsStart();
+  LCH_Buffer *const json_buffer =
+      LCH_EncodingCompose(patch, encoding, pretty_print);
   LCH_JsonDestroy(patch);
-  if (buffer == NULL) {
+  if (json_buffer == NULL) {
     LCH_LOG_ERROR("Failed to compose patch into JSON");
     return NULL;
   }
 
+  LCH_Buffer *const buffer = LCH_CompressionEncode(
+      LCH_BufferData(json_buffer), LCH_BufferLength(json_buffer), compression);
+  LCH_MetricsStop(LCH_METRICS_PHASE_BLOCK_COMPOSE, start);
+  LCH_BufferDestroy(json_buffer);
+  if (buffer == NULL) {
+    LCH_LOG_ERROR("Failed to compress patch using compression method '%s'",
+                  LCH_CompressionToString(compression));
+    return NULL;
+  }
+
   return buffer;
 }
 
@@ -760,7 +932,7 @@ static bool HistoryAppendRecord(const LCH_Instance *const instance,
                                 const char *const block_id,
                                 const double timestamp,
                                 const char *const operation,
-                                const LCH_Buffer *const subsidiary_value) {
+                                const LCH_Json *const subsidiary_value) {
   LCH_Json *const record = LCH_JsonObjectCreate();
   if (record == NULL) {
     return false;
@@ -804,45 +976,58 @@ static bool HistoryAppendRecord(const LCH_Instance *const instance,
     }
   }
 
-  {
-    const char *const data = LCH_BufferData(subsidiary_value);
-    const size_t length = LCH_BufferLength(subsidiary_value);
-
-    LCH_List *const subsidiary_fields = LCH_CSVParseRecord(data, length);
-    if (subsidiary_fields == NULL) {
+  if (LCH_JsonIsNull(subsidiary_value)) {
+    /* The value of a delete operation is not known when snapshots only hold
+     * row digests */
+    LCH_Json *const subsidiary = LCH_JsonNullCreate();
+    if (subsidiary == NULL) {
       LCH_JsonDestroy(record);
       return false;
     }
 
+    const LCH_Buffer key = LCH_BufferStaticFromString("subsidiary");
+    if (!LCH_JsonObjectSet(record, &key, subsidiary)) {
+      LCH_JsonDestroy(subsidiary);
+      LCH_JsonDestroy(record);
+      return false;
+    }
+  } else {
     const LCH_TableInfo *const table_info =
         LCH_InstanceGetTable(instance, table_id);
     const LCH_List *const subsidiary_names =
         LCH_TableInfoGetSubsidiaryFields(table_info);
 
-    const size_t num_fields = LCH_ListLength(subsidiary_fields);
-    assert(num_fields == LCH_ListLength(subsidiary_names));
+    /* Partial updates only record the fields that changed */
+    LCH_List *names, *fields;
+    if (!LCH_DeltaGetUpdatedFields(subsidiary_value, subsidiary_names, &names,
+                                   &fields)) {
+      LCH_JsonDestroy(record);
+      return false;
+    }
 
     LCH_Json *const subsidiary = LCH_JsonObjectCreate();
     if (subsidiary == NULL) {
-      LCH_ListDestroy(subsidiary_fields);
+      LCH_ListDestroy(fields);
+      LCH_ListDestroy(names);
       LCH_JsonDestroy(record);
       return false;
     }
 
+    const size_t num_fields = LCH_ListLength(fields);
     for (size_t i = 0; i < num_fields; i++) {
-      const LCH_Buffer *const name =
-          (LCH_Buffer *)LCH_ListGet(subsidiary_names, i);
-      const LCH_Buffer *const field =
-          (LCH_Buffer *)LCH_ListGet(subsidiary_fields, i);
+      const LCH_Buffer *const name = (LCH_Buffer *)LCH_ListGet(names, i);
+      const LCH_Buffer *const field = (LCH_Buffer *)LCH_ListGet(fields, i);
 
       if (!LCH_JsonObjectSetStringDuplicate(subsidiary, name, field)) {
         LCH_JsonDestroy(subsidiary);
-        LCH_ListDestroy(subsidiary_fields);
+        LCH_ListDestroy(fields);
+        LCH_ListDestroy(names);
         LCH_JsonDestroy(record);
         return false;
       }
     }
-    LCH_ListDestroy(subsidiary_fields);
+    LCH_ListDestroy(fields);
+    LCH_ListDestroy(names);
 
     const LCH_Buffer key = LCH_BufferStaticFromString("subsidiary");
     if (!LCH_JsonObjectSet(record, &key, subsidiary)) {
@@ -866,58 +1051,62 @@ static bool HistoryAppendRecord(const LCH_Instance *const instance,
   return true;
 }
 
-static bool HistoryFindRecord(const LCH_Instance *const instance,
-                              const LCH_Json *const history,
-                              const char *const table_id,
-                              const LCH_Buffer *const primary_key,
-                              const char *const block_id, const double from,
-                              const double to) {
-  const char *const work_dir = LCH_InstanceGetWorkDirectory(instance);
-
-  char path[PATH_MAX];
-  if (!LCH_FilePathJoin(path, PATH_MAX, 3, work_dir, "blocks", block_id)) {
+/**
+ * Append the changes of one kind (i.e., inserts, deletes or updates) in a
+ * delta to the histories of the records they apply to. Whichever is smaller of
+ * the set of histories and the set of changes is iterated, and each of its
+ * primary keys is looked up in the other.
+ */
+static bool HistoryProbeChanges(const LCH_Instance *const instance,
+                                const LCH_Dict *const histories,
+                                const char *const table_id,
+                                const char *const block_id,
+                                const double timestamp,
+                                const char *const operation,
+                                const LCH_Json *const changes) {
+  LCH_List *const keys =
+      (LCH_DictLength(histories) <= LCH_JsonObjectLength(changes))
+          ? LCH_DictGetKeys(histories)
+          : LCH_JsonObjectGetKeys(changes);
+  if (keys == NULL) {
     return false;
   }
 
-  if (!LCH_FileExists(path)) {
-    LCH_LOG_VERBOSE("Reached End-of-Chain with block identifier '%s'",
-                    block_id);
-    return true;
-  }
+  const size_t num_keys = LCH_ListLength(keys);
+  for (size_t i = 0; i < num_keys; i++) {
+    const LCH_Buffer *const key = (LCH_Buffer *)LCH_ListGet(keys, i);
+    if (!LCH_DictHasKey(histories, key) ||
+        !LCH_JsonObjectHasKey(changes, key)) {
+      continue;
+    }
 
-  LCH_Json *const block = LCH_BlockLoad(work_dir, block_id);
-  if (block == NULL) {
-    return false;
-  }
+    const LCH_Json *const history =
+        (const LCH_Json *)LCH_DictGet(histories, key);
+    const LCH_Json *const subsidiary_value = LCH_JsonObjectGet(changes, key);
+    if (subsidiary_value == NULL) {
+      LCH_ListDestroy(keys);
+      return false;
+    }
 
-  const char *const parent_id = LCH_BlockGetParentId(block);
-  if (parent_id == NULL) {
-    LCH_JsonDestroy(block);
-    return false;
-  }
-
-  double timestamp;
-  if (!LCH_BlockGetTimestamp(block, &timestamp)) {
-    LCH_JsonDestroy(block);
-    return false;
-  }
-
-  if (timestamp < from) {
-    // Base case reached, stop recording history
-    LCH_JsonDestroy(block);
-    return true;
-  }
-
-  if (timestamp >= to) {
-    // Continue without recording history (yet)
-    if (!HistoryFindRecord(instance, history, table_id, primary_key, parent_id,
-                           from, to)) {
-      LCH_JsonDestroy(block);
+    if (!HistoryAppendRecord(instance, table_id, history, block_id, timestamp,
+                             operation, subsidiary_value)) {
+      LCH_ListDestroy(keys);
       return false;
     }
+  }
 
-    LCH_JsonDestroy(block);
-    return true;
+  LCH_ListDestroy(keys);
+  return true;
+}
+
+static bool HistoryFindRecords(const LCH_Instance *const instance,
+                               const LCH_Dict *const histories,
+                               const char *const table_id,
+                               const char *const block_id,
+                               const double timestamp) {
+  LCH_Json *const block = LCH_BlockLoad(instance, block_id);
+  if (block == NULL) {
+    return false;
   }
 
   const LCH_Json *const payload = LCH_BlockGetPayload(block);
@@ -965,105 +1154,110 @@ static bool HistoryFindRecord(const LCH_Instance *const instance,
       return false;
     }
 
-    if (LCH_JsonObjectHasKey(inserts, primary_key)) {
-      const LCH_Buffer *const subsidiary_value =
-          LCH_JsonObjectGetString(inserts, primary_key);
-      if (subsidiary_value == NULL) {
-        LCH_JsonDestroy(block);
-        return false;
-      }
-
-      if (!HistoryAppendRecord(instance, table_id, history, block_id, timestamp,
-                               "insert", subsidiary_value)) {
-        LCH_JsonDestroy(block);
-        return false;
-      }
-    } else if (LCH_JsonObjectHasKey(deletes, primary_key)) {
-      const LCH_Buffer *const subsidiary_value =
-          LCH_JsonObjectGetString(deletes, primary_key);
-      if (subsidiary_value == NULL) {
-        LCH_JsonDestroy(block);
-        return false;
-      }
-
-      if (!HistoryAppendRecord(instance, table_id, history, block_id, timestamp,
-                               "delete", subsidiary_value)) {
-        LCH_JsonDestroy(block);
-        return false;
-      }
-    } else if (LCH_JsonObjectHasKey(updates, primary_key)) {
-      const LCH_Buffer *const subsidiary_value =
-          LCH_JsonObjectGetString(updates, primary_key);
-      if (subsidiary_value == NULL) {
-        LCH_JsonDestroy(block);
-        return false;
-      }
-
-      if (!HistoryAppendRecord(instance, table_id, history, block_id, timestamp,
-                               "update", subsidiary_value)) {
-        LCH_JsonDestroy(block);
-        return false;
-      }
+    if (!HistoryProbeChanges(instance, histories, table_id, block_id,
+                             timestamp, "insert", inserts) ||
+        !HistoryProbeChanges(instance, histories, table_id, block_id,
+                             timestamp, "delete", deletes) ||
+        !HistoryProbeChanges(instance, histories, table_id, block_id,
+                             timestamp, "update", updates)) {
+      LCH_JsonDestroy(block);
+      return false;
     }
   }
 
-  if (!HistoryFindRecord(instance, history, table_id, primary_key, parent_id,
-                         from, to)) {
-    LCH_JsonDestroy(block);
-    return false;
-  }
-
   LCH_JsonDestroy(block);
   return true;
 }
 
-LCH_Buffer *LCH_History(const char *const work_dir, const char *const table_id,
-                        const LCH_List *const primary_fields, const double from,
+/**
+ * Walk the chain from HEAD, and append the changes within the time range to
+ * the histories, which are indexed by the primary fields of their records
+ * composed as CSV. The chain is walked once, regardless of the number of
+ * histories.
+ */
+static bool HistoryWalk(const LCH_Instance *const instance,
+                        const LCH_Dict *const histories,
+                        const char *const table_id, const double from,
                         const double to) {
-  LCH_Instance *const instance = LCH_InstanceLoad(work_dir);
-  if (instance == NULL) {
-    return NULL;
+  const char *const work_dir = LCH_InstanceGetWorkDirectory(instance);
+
+  char *block_id = LCH_HeadGet("HEAD", work_dir);
+  if (block_id == NULL) {
+    return false;
   }
 
-  LCH_Json *const response = LCH_JsonObjectCreate();
-  if (response == NULL) {
-    LCH_InstanceDestroy(instance);
-    return NULL;
+  while (LCH_BlockExists(instance, block_id)) {
+    /* The header is enough to decide whether the block is within the time
+     * range, hence blocks outside of it are never loaded */
+    char *parent_id;
+    double timestamp;
+    if (!LCH_BlockLoadHeader(instance, block_id, &parent_id, &timestamp)) {
+      free(block_id);
+      return false;
+    }
+
+    if (timestamp < from) {
+      // Base case reached, stop recording history
+      free(parent_id);
+      free(block_id);
+      return true;
+    }
+
+    // Blocks newer than the time range are skipped
+    if (timestamp < to && !HistoryFindRecords(instance, histories, table_id,
+                                              block_id, timestamp)) {
+      free(parent_id);
+      free(block_id);
+      return false;
+    }
+
+    free(block_id);
+    block_id = parent_id;
   }
 
-  LCH_Json *const history = LCH_JsonArrayCreate();
-  if (history == NULL) {
-    LCH_JsonDestroy(response);
-    LCH_InstanceDestroy(instance);
-    return NULL;
+  LCH_LOG_VERBOSE("Reached End-of-Chain with block identifier '%s'", block_id);
+  free(block_id);
+  return true;
+}
+
+/**
+ * Add the primary fields and an (empty) history of a record to a JSON object,
+ * and index the history by the primary fields composed as CSV. Nothing is
+ * added if the record is already indexed.
+ */
+static bool HistoryAddRecord(const LCH_Json *const object,
+                             LCH_Dict *const histories,
+                             const char *const table_id,
+                             const LCH_List *const primary_names,
+                             const LCH_List *const primary_fields,
+                             bool *const added) {
+  const size_t num_fields = LCH_ListLength(primary_fields);
+  if (num_fields != LCH_ListLength(primary_names)) {
+    LCH_LOG_ERROR("Expected %zu primary fields for table '%s', found %zu",
+                  LCH_ListLength(primary_names), table_id, num_fields);
+    return false;
   }
 
-  {
-    const LCH_Buffer key = LCH_BufferStaticFromString("history");
-    if (!LCH_JsonObjectSet(response, &key, history)) {
-      LCH_JsonDestroy(history);
-      LCH_JsonDestroy(response);
-      LCH_InstanceDestroy(instance);
-      return NULL;
-    }
+  LCH_Buffer *key = NULL;
+  if (!LCH_CSVComposeRecord(&key, primary_fields)) {
+    return false;
   }
 
-  {
-    const LCH_TableInfo *const table_info =
-        LCH_InstanceGetTable(instance, table_id);
-    const LCH_List *const primary_names =
-        LCH_TableInfoGetPrimaryFields(table_info);
+  if (LCH_DictHasKey(histories, key)) {
+    LCH_LOG_DEBUG("Ignoring duplicate primary fields '%s'",
+                  LCH_BufferData(key));
+    LCH_BufferDestroy(key);
+    *added = false;
+    return true;
+  }
 
+  {
     LCH_Json *const primary = LCH_JsonObjectCreate();
     if (primary == NULL) {
-      LCH_JsonDestroy(response);
-      LCH_InstanceDestroy(instance);
-      return NULL;
+      LCH_BufferDestroy(key);
+      return false;
     }
 
-    const size_t num_fields = LCH_ListLength(primary_fields);
-    assert(num_fields == LCH_ListLength(primary_names));
-
     for (size_t i = 0; i < num_fields; i++) {
       const LCH_Buffer *const name =
           (LCH_Buffer *)LCH_ListGet(primary_names, i);
@@ -1072,26 +1266,54 @@ LCH_Buffer *LCH_History(const char *const work_dir, const char *const table_id,
 
       if (!LCH_JsonObjectSetStringDuplicate(primary, name, field)) {
         LCH_JsonDestroy(primary);
-        LCH_JsonDestroy(response);
-        LCH_InstanceDestroy(instance);
-        return NULL;
+        LCH_BufferDestroy(key);
+        return false;
       }
     }
 
-    const LCH_Buffer key = LCH_BufferStaticFromString("primary");
-    if (!LCH_JsonObjectSet(response, &key, primary)) {
+    const LCH_Buffer primary_key = LCH_BufferStaticFromString("primary");
+    if (!LCH_JsonObjectSet(object, &primary_key, primary)) {
       LCH_JsonDestroy(primary);
-      LCH_JsonDestroy(response);
-      LCH_InstanceDestroy(instance);
-      return NULL;
+      LCH_BufferDestroy(key);
+      return false;
     }
   }
 
+  LCH_Json *const history = LCH_JsonArrayCreate();
+  if (history == NULL) {
+    LCH_BufferDestroy(key);
+    return false;
+  }
+
+  const LCH_Buffer history_key = LCH_BufferStaticFromString("history");
+  if (!LCH_JsonObjectSet(object, &history_key, history)) {
+    LCH_JsonDestroy(history);
+    LCH_BufferDestroy(key);
+    return false;
+  }
+
+  // The index does not own the history
+  if (!LCH_DictSet(histories, key, history, NULL)) {
+    LCH_BufferDestroy(key);
+    return false;
+  }
+
+  LCH_BufferDestroy(key);
+  *added = true;
+  return true;
+}
+
+static LCH_Json *HistoryCreateResponse(const char *const table_id,
+                                       const double from, const double to) {
+  LCH_Json *const response = LCH_JsonObjectCreate();
+  if (response == NULL) {
+    return NULL;
+  }
+
   {
     const LCH_Buffer key = LCH_BufferStaticFromString("from");
     if (!LCH_JsonObjectSetNumber(response, &key, from)) {
       LCH_JsonDestroy(response);
-      LCH_InstanceDestroy(instance);
       return NULL;
     }
   }
@@ -1100,7 +1322,6 @@ LCH_Buffer *LCH_History(const char *const work_dir, const char *const table_id,
     const LCH_Buffer key = LCH_BufferStaticFromString("to");
     if (!LCH_JsonObjectSetNumber(response, &key, to)) {
       LCH_JsonDestroy(response);
-      LCH_InstanceDestroy(instance);
       return NULL;
     }
   }
@@ -1109,7 +1330,6 @@ LCH_Buffer *LCH_History(const char *const work_dir, const char *const table_id,
     LCH_Buffer *const value = LCH_BufferFromString(table_id);
     if (value == NULL) {
       LCH_JsonDestroy(response);
-      LCH_InstanceDestroy(instance);
       return NULL;
     }
 
@@ -1117,49 +1337,179 @@ LCH_Buffer *LCH_History(const char *const work_dir, const char *const table_id,
     if (!LCH_JsonObjectSetString(response, &key, value)) {
       LCH_BufferDestroy(value);
       LCH_JsonDestroy(response);
-      LCH_InstanceDestroy(instance);
       return NULL;
     }
   }
 
-  char *block_id = LCH_HeadGet("HEAD", work_dir);
-  if (block_id == NULL) {
-    LCH_JsonDestroy(response);
-    LCH_InstanceDestroy(instance);
+  return response;
+}
+
+static const LCH_List *HistoryGetPrimaryNames(
+    const LCH_Instance *const instance, const char *const table_id) {
+  const LCH_TableInfo *const table_info =
+      LCH_InstanceGetTable(instance, table_id);
+  if (table_info == NULL) {
+    LCH_LOG_ERROR("Table with identifier '%s' not found in config file",
+                  table_id);
+    return NULL;
+  }
+  return LCH_TableInfoGetPrimaryFields(table_info);
+}
+
+static LCH_Buffer *History(const LCH_Instance *const instance,
+                           const char *const table_id,
+                           const LCH_List *const primary_fields,
+                           const double from, const double to) {
+  const LCH_List *const primary_names =
+      HistoryGetPrimaryNames(instance, table_id);
+  if (primary_names == NULL) {
+    return NULL;
+  }
+
+  LCH_Json *const response = HistoryCreateResponse(table_id, from, to);
+  if (response == NULL) {
     return NULL;
   }
 
-  LCH_Buffer *primary = NULL;
-  if (!LCH_CSVComposeRecord(&primary, primary_fields)) {
+  LCH_Dict *const histories = LCH_DictCreate();
+  if (histories == NULL) {
     LCH_JsonDestroy(response);
-    LCH_InstanceDestroy(instance);
     return NULL;
   }
 
-  if (!HistoryFindRecord(instance, history, table_id, primary, block_id, from,
-                         to)) {
-    LCH_BufferDestroy(primary);
-    free(block_id);
-    LCH_BufferDestroy(response);
-    LCH_InstanceDestroy(instance);
+  bool added;
+  if (!HistoryAddRecord(response, histories, table_id, primary_names,
+                        primary_fields, &added)) {
+    LCH_DictDestroy(histories);
+    LCH_JsonDestroy(response);
     return NULL;
   }
 
-  LCH_BufferDestroy(primary);
-  free(block_id);
+  if (!HistoryWalk(instance, histories, table_id, from, to)) {
+    LCH_DictDestroy(histories);
+    LCH_JsonDestroy(response);
+    return NULL;
+  }
+  LCH_DictDestroy(histories);
 
   const bool pretty = LCH_InstanceShouldPrettyPrint(instance);
   LCH_Buffer *const buffer = LCH_JsonCompose(response, pretty);
   LCH_JsonDestroy(response);
-  if (buffer == NULL) {
-    LCH_InstanceDestroy(instance);
+  return buffer;
+}
+
+LCH_Buffer *LCH_History(const char *const work_dir, const char *const table_id,
+                        const LCH_List *const primary_fields, const double from,
+                        const double to) {
+  LCH_Instance *const instance = LCH_InstanceLoad(work_dir);
+  if (instance == NULL) {
     return NULL;
   }
 
+  LCH_Buffer *const history =
+      History(instance, table_id, primary_fields, from, to);
   LCH_InstanceDestroy(instance);
+  return history;
+}
+
+static LCH_Buffer *HistoryMany(const LCH_Instance *const instance,
+                               const char *const table_id,
+                               const LCH_List *const primary_records,
+                               const double from, const double to) {
+  const LCH_List *const primary_names =
+      HistoryGetPrimaryNames(instance, table_id);
+  if (primary_names == NULL) {
+    return NULL;
+  }
+
+  LCH_Json *const response = HistoryCreateResponse(table_id, from, to);
+  if (response == NULL) {
+    return NULL;
+  }
+
+  LCH_Json *const entries = LCH_JsonArrayCreate();
+  if (entries == NULL) {
+    LCH_JsonDestroy(response);
+    return NULL;
+  }
+
+  {
+    const LCH_Buffer key = LCH_BufferStaticFromString("histories");
+    if (!LCH_JsonObjectSet(response, &key, entries)) {
+      LCH_JsonDestroy(entries);
+      LCH_JsonDestroy(response);
+      return NULL;
+    }
+  }
+
+  LCH_Dict *const histories = LCH_DictCreate();
+  if (histories == NULL) {
+    LCH_JsonDestroy(response);
+    return NULL;
+  }
+
+  const size_t num_records = LCH_ListLength(primary_records);
+  for (size_t i = 0; i < num_records; i++) {
+    const LCH_List *const primary_fields =
+        (LCH_List *)LCH_ListGet(primary_records, i);
+
+    LCH_Json *const entry = LCH_JsonObjectCreate();
+    if (entry == NULL) {
+      LCH_DictDestroy(histories);
+      LCH_JsonDestroy(response);
+      return NULL;
+    }
+
+    bool added;
+    if (!HistoryAddRecord(entry, histories, table_id, primary_names,
+                          primary_fields, &added)) {
+      LCH_JsonDestroy(entry);
+      LCH_DictDestroy(histories);
+      LCH_JsonDestroy(response);
+      return NULL;
+    }
+
+    if (!added) {
+      LCH_JsonDestroy(entry);
+      continue;
+    }
+
+    if (!LCH_JsonArrayAppend(entries, entry)) {
+      LCH_JsonDestroy(entry);
+      LCH_DictDestroy(histories);
+      LCH_JsonDestroy(response);
+      return NULL;
+    }
+  }
+
+  if (!HistoryWalk(instance, histories, table_id, from, to)) {
+    LCH_DictDestroy(histories);
+    LCH_JsonDestroy(response);
+    return NULL;
+  }
+  LCH_DictDestroy(histories);
+
+  const bool pretty = LCH_InstanceShouldPrettyPrint(instance);
+  LCH_Buffer *const buffer = LCH_JsonCompose(response, pretty);
+  LCH_JsonDestroy(response);
   return buffer;
 }
 
+LCH_Buffer *LCH_HistoryMany(const char *const work_dir,
+                            const char *const table_id,
+                            const LCH_List *const primary_records,
+                            const double from, const double to) {
+  LCH_Instance *const instance = LCH_InstanceLoad(work_dir);
+  if (instance == NULL) {
+    return NULL;
+  }
+
+  LCH_Buffer *const histories =
+      HistoryMany(instance, table_id, primary_records, from, to);
+  LCH_InstanceDestroy(instance);
+  return histories;
+}
+
 static bool Patch(const LCH_Instance *const instance, const char *const field,
                   const char *const value, const char *buffer, size_t size) {
   const char *const work_dir = LCH_InstanceGetWorkDirectory(instance);
@@ -1172,8 +1522,12 @@ static bool Patch(const LCH_Instance *const instance, const char *const field,
       return false;
     }
 
-    if (!LCH_MessageDigest((const unsigned char *)buffer + strlen("SHA1=") + 40,
-                           size - strlen("SHA1=") - 40, checksum)) {
+    const double start = LCH_MetricsStart();
+    const bool digested = LCH_MessageDigest(
+        (const unsigned char *)buffer + strlen("SHA1=") + 40,
+        size - strlen("SHA1=") - 40, checksum);
+    LCH_MetricsStop(LCH_METRICS_PHASE_HASH, start);
+    if (!digested) {
       LCH_LOG_ERROR("Failed to compute message digest for payload");
       LCH_BufferDestroy(checksum);
       return false;
@@ -1190,7 +1544,21 @@ static bool Patch(const LCH_Instance *const instance, const char *const field,
     size -= strlen("SHA1=") + 40;
   }
 
-  LCH_Json *const patch = LCH_PatchParse(buffer, size);
+  LCH_Json *patch = NULL;
+  if (size > 0 && buffer[0] == LCH_COMPRESSION_HEADER_PREFIX) {
+    LCH_LOG_DEBUG("This patch has a codec header attached");
+    LCH_Buffer *const decoded = LCH_CompressionDecode(buffer, size);
+    if (decoded == NULL) {
+      LCH_LOG_ERROR("Failed to decompress patch");
+      return false;
+    }
+
+    patch = LCH_PatchParse(LCH_BufferData(decoded), LCH_BufferLength(decoded));
+    LCH_BufferDestroy(decoded);
+  } else {
+    patch = LCH_PatchParse(buffer, size);
+  }
+
   if (patch == NULL) {
     LCH_LOG_ERROR("Failed to interpret patch");
     return false;
@@ -1260,9 +1628,7 @@ static bool Patch(const LCH_Instance *const instance, const char *const field,
       }
       const char *const table_id = LCH_BufferData(table_id_buf);
 
-      const LCH_TableInfo *const table_info =
-          LCH_InstanceGetTable(instance, table_id);
-      if (table_info == NULL) {
+      if (!LCH_InstanceHasTable(instance, table_id)) {
         LCH_LOG_WARNING(
             "Table with identifer '%s' not found in config file. Skipping "
             "patch...",
@@ -1270,26 +1636,20 @@ static bool Patch(const LCH_Instance *const instance, const char *const field,
         continue;
       }
 
-      const LCH_Json *const inserts = LCH_DeltaGetInserts(delta);
-      if (inserts == NULL) {
-        LCH_JsonDestroy(patch);
-        return false;
-      }
-
-      const LCH_Json *const deletes = LCH_DeltaGetDeletes(delta);
-      if (deletes == NULL) {
-        LCH_JsonDestroy(patch);
-        return false;
-      }
-
-      const LCH_Json *const updates = LCH_DeltaGetUpdates(delta);
-      if (updates == NULL) {
+      const LCH_TableInfo *const table_info =
+          LCH_InstanceGetTable(instance, table_id);
+      if (table_info == NULL) {
+        LCH_LOG_ERROR("Failed to load table definition for table '%s'",
+                      table_id);
         LCH_JsonDestroy(patch);
         return false;
       }
 
-      if (!LCH_TablePatch(table_info, type, field, value, inserts, deletes,
-                          updates)) {
+      const double start = LCH_MetricsStart();
+      const bool patched =
+          LCH_TablePatch(table_info, type, field, value, delta);
+      LCH_MetricsStop(LCH_METRICS_PHASE_PATCH, start);
+      if (!patched) {
         LCH_JsonDestroy(patch);
         return false;
       }
@@ -1316,3 +1676,175 @@ bool LCH_Patch(const char *const work_dir, const char *const field,
   }
   return success;
 }
+
+struct LCH_Session {
+  char *work_dir;
+  LCH_Instance *instance;
+  bool purge_deferred;  // Set by auto purging commits
+};
+
+LCH_Session *LCH_SessionCreate(const char *const work_dir) {
+  assert(work_dir != NULL);
+
+  LCH_Session *const session = (LCH_Session *)malloc(sizeof(LCH_Session));
+  if (session == NULL) {
+    LCH_LOG_ERROR("Failed to allocate memory for session: %s",
+                  strerror(errno));
+    return NULL;
+  }
+  session->instance = NULL;
+  session->purge_deferred = false;
+
+  /* The instance refers to the working directory of the session */
+  session->work_dir = LCH_StringDuplicate(work_dir);
+  if (session->work_dir == NULL) {
+    free(session);
+    return NULL;
+  }
+
+  return session;
+}
+
+void LCH_SessionDestroy(LCH_Session *const session) {
+  if (session != NULL) {
+    if (session->purge_deferred && !LCH_SessionRunDeferred(session)) {
+      LCH_LOG_WARNING("Failed to run deferred purge");
+    }
+    if (session->instance != NULL) {
+      LCH_InstanceDestroy(session->instance);
+    }
+    free(session->work_dir);
+    free(session);
+  }
+}
+
+/**
+ * Get the instance of a session. The instance is loaded on first use, and
+ * reloaded if the configuration file has changed since then.
+ */
+static const LCH_Instance *SessionGetInstance(LCH_Session *const session) {
+  assert(session != NULL);
+
+  if (session->instance != NULL) {
+    if (!LCH_InstanceIsStale(session->instance)) {
+      return session->instance;
+    }
+    LCH_LOG_INFO("Configuration file has changed; reloading instance");
+    LCH_InstanceDestroy(session->instance);
+    session->instance = NULL;
+  }
+
+  LCH_Instance *const instance = LCH_InstanceLoad(session->work_dir);
+  if (instance == NULL) {
+    LCH_LOG_ERROR("Failed to load instance from configuration file");
+    return NULL;
+  }
+
+  if (!LCH_InstanceEnableSnapshotCache(instance)) {
+    LCH_InstanceDestroy(instance);
+    return NULL;
+  }
+
+  session->instance = instance;
+  return instance;
+}
+
+bool LCH_SessionCommit(LCH_Session *const session) {
+  const LCH_Instance *const instance = SessionGetInstance(session);
+  if (instance == NULL) {
+    return false;
+  }
+
+  if (!Commit(instance)) {
+    LCH_LOG_ERROR("Failed to commit state changes");
+    return false;
+  }
+
+  if (LCH_InstanceShouldAutoPurge(instance)) {
+    LCH_LOG_DEBUG("Auto purge is enabled; deferring purge");
+    session->purge_deferred = true;
+  }
+  return true;
+}
+
+LCH_Buffer *LCH_SessionDiff(LCH_Session *const session,
+                            const char *const block_id) {
+  assert(block_id != NULL);
+
+  const LCH_Instance *const instance = SessionGetInstance(session);
+  if (instance == NULL) {
+    return NULL;
+  }
+  return Diff(instance, block_id);
+}
+
+LCH_Buffer *LCH_SessionHistory(LCH_Session *const session,
+                               const char *const table_id,
+                               const LCH_List *const primary_fields,
+                               const double from, const double to) {
+  const LCH_Instance *const instance = SessionGetInstance(session);
+  if (instance == NULL) {
+    return NULL;
+  }
+  return History(instance, table_id, primary_fields, from, to);
+}
+
+LCH_Buffer *LCH_SessionHistoryMany(LCH_Session *const session,
+                                   const char *const table_id,
+                                   const LCH_List *const primary_records,
+                                   const double from, const double to) {
+  const LCH_Instance *const instance = SessionGetInstance(session);
+  if (instance == NULL) {
+    return NULL;
+  }
+  return HistoryMany(instance, table_id, primary_records, from, to);
+}
+
+bool LCH_SessionPatch(LCH_Session *const session, const char *const field,
+                      const char *const value, const char *const patch,
+                      const size_t size) {
+  const LCH_Instance *const instance = SessionGetInstance(session);
+  if (instance == NULL) {
+    return false;
+  }
+
+  const bool success = Patch(instance, field, value, patch, size);
+  if (!success) {
+    LCH_LOG_ERROR("Failed to apply patch");
+  }
+  return success;
+}
+
+bool LCH_SessionPurge(LCH_Session *const session) {
+  const LCH_Instance *const instance = SessionGetInstance(session);
+  if (instance == NULL) {
+    return false;
+  }
+
+  if (!Purge(instance)) {
+    return false;
+  }
+  session->purge_deferred = false;
+  return true;
+}
+
+bool LCH_SessionHasDeferred(const LCH_Session *const session) {
+  assert(session != NULL);
+  return session->purge_deferred;
+}
+
+bool LCH_SessionRunDeferred(LCH_Session *const session) {
+  assert(session != NULL);
+
+  if (!session->purge_deferred) {
+    return true;
+  }
+
+  /* A failed purge is not retried until the next commit */
+  session->purge_deferred = false;
+  const LCH_Instance *const instance = SessionGetInstance(session);
+  if (instance == NULL) {
+    return false;
+  }
+  return Purge(instance);
+}
@@ -48,6 +48,15 @@ LCH_Buffer *LCH_BufferCreate(void);
  */
 bool LCH_BufferAppend(LCH_Buffer *buffer, char byte);
 
+/**
+ * @brief Append bytes to the buffer
+ * @param[in] buffer The byte buffer
+ * @param[in] data The bytes to append
+ * @param[in] length The number of bytes to append
+ * @return False in case of failure
+ */
+bool LCH_BufferAppendBytes(LCH_Buffer *buffer, const void *data, size_t length);
+
 /**
  * @brief Format- and print string to byte buffer
  * @param buffer The byte buffer
@@ -131,14 +140,41 @@ LCH_Buffer *LCH_BufferDuplicate(const LCH_Buffer *buffer);
  */
 bool LCH_BufferReadFile(LCH_Buffer *buffer, const char *filename);
 
+/**
+ * @brief Load the contents of a file into a new byte buffer
+ * @param filename The filename
+ * @return Byte buffer or NULL in case of failure
+ * @note Large regular files are memory mapped instead of read. The mapping is
+ *       private, hence writing to the buffer never modifies the file. Other
+ *       files are read into a buffer sized after the file.
+ * @warning The file must not be truncated while the returned buffer is in use.
+ *          Use LCH_BufferReplaceFile() to rewrite files that may be mapped.
+ */
+LCH_Buffer *LCH_BufferMapFile(const char *filename);
+
 /**
  * @brief Write the contents of a byte buffer into a file
  * @param buffer The byte buffer
  * @param filename The filename
  * @return False in case of failure
+ * @note Existing files are truncated and written in place, hence they keep
+ *       their mode, ownership and hard links.
  */
 bool LCH_BufferWriteFile(const LCH_Buffer *buffer, const char *filename);
 
+/**
+ * @brief Replace a file with the contents of a byte buffer
+ * @param buffer The byte buffer
+ * @param filename The filename
+ * @return False in case of failure
+ * @note The contents are written to a temporary file in the same directory,
+ *       which is then renamed over the file. Hence, readers never see the file
+ *       truncated or partially written, and buffers returned by
+ *       LCH_BufferMapFile() are left intact. The file is created with mode
+ *       0600, so this is meant for files owned by leech.
+ */
+bool LCH_BufferReplaceFile(const LCH_Buffer *buffer, const char *filename);
+
 /****************************************************************************/
 /*  List                                                                    */
 /****************************************************************************/
@@ -154,6 +190,16 @@ typedef struct LCH_List LCH_List;
  */
 LCH_List *LCH_ListCreate(void);
 
+/**
+ * @brief Reserve capacity for a number of elements in the list
+ * @param list The list
+ * @param capacity The total number of elements to make room for
+ * @return False in case of failure
+ * @note Appending up to capacity elements is then guaranteed not to
+ *       reallocate the list
+ */
+bool LCH_ListReserve(LCH_List *list, size_t capacity);
+
 /**
  * @brief Get the number of elements in the list
  * @param list The list
@@ -251,6 +297,77 @@ LCH_List *LCH_ListCopy(const LCH_List *list, LCH_DuplicateFn duplicate_fn,
 bool LCH_ListInsert(LCH_List *list, size_t index, void *element,
                     void (*destroy)(void *));
 
+/****************************************************************************/
+/*  Table                                                                   */
+/****************************************************************************/
+
+/**
+ * @brief Columnar table of byte strings
+ * @note The data of all fields is stored in one contiguous arena, and each
+ *       column refers to its fields by offset. The first row is the table
+ *       header.
+ */
+typedef struct LCH_Table LCH_Table;
+
+/**
+ * @brief Create a table
+ * @param num_columns The number of columns (must be greater than zero)
+ * @return The table or NULL in case of failure
+ */
+LCH_Table *LCH_TableCreate(size_t num_columns);
+
+/**
+ * @brief Reserve memory in a table
+ * @param table The table
+ * @param num_rows The total number of rows to make room for
+ * @param num_bytes The total number of bytes of field data to make room for
+ * @return False in case of failure
+ */
+bool LCH_TableReserve(LCH_Table *table, size_t num_rows, size_t num_bytes);
+
+/**
+ * @brief Append a field to a table
+ * @param table The table
+ * @param data The field data
+ * @param length The length of the field data
+ * @return False in case of failure
+ * @note Fields are appended row by row. A row is complete once a field has
+ *       been appended for each column.
+ */
+bool LCH_TableAppendField(LCH_Table *table, const char *data, size_t length);
+
+/**
+ * @brief Get the number of columns in a table
+ * @param table The table
+ * @return The number of columns
+ */
+size_t LCH_TableGetNumColumns(const LCH_Table *table);
+
+/**
+ * @brief Get the number of complete rows in a table
+ * @param table The table
+ * @return The number of rows including the table header
+ */
+size_t LCH_TableGetNumRows(const LCH_Table *table);
+
+/**
+ * @brief Get a field from a table
+ * @param table The table
+ * @param row The row index
+ * @param column The column index
+ * @param length Variable to store the length of the field or NULL
+ * @return Pointer to the null-byte terminated field data
+ * @warning The returned pointer is invalidated when the table is modified
+ */
+const char *LCH_TableGetField(const LCH_Table *table, size_t row,
+                              size_t column, size_t *length);
+
+/**
+ * @brief Destroy a table
+ * @param table The table
+ */
+void LCH_TableDestroy(void *table);
+
 /****************************************************************************/
 /*  Debug Messenger                                                         */
 /****************************************************************************/
@@ -302,6 +419,82 @@ void LCH_LoggerSeveritySet(unsigned char severity);
  */
 void LCH_LoggerCallbackSet(LCH_LoggerCallbackFn callback);
 
+/**
+ * @brief Keep recent log messages in an in-memory ring buffer
+ * @param capacity The number of messages to keep, or zero to disable the ring
+ *                 buffer
+ * @param severity Zero or more of the LCH_LOG_MESSAGE_TYPE_*_BIT macros bitwise
+ *        or'ed together
+ * @return False in case of failure
+ * @note Only messages that are not enabled with LCH_LoggerSeveritySet() are
+ *       kept. They are passed on to the logger callback right before the next
+ *       error message, or when calling LCH_LoggerRingBufferFlush(). This way
+ *       errors come with debug context, without the cost of printing every
+ *       debug message.
+ */
+bool LCH_LoggerRingBufferSet(size_t capacity, unsigned char severity);
+
+/**
+ * @brief Pass the messages kept in the ring buffer on to the logger callback
+ *        and empty the ring buffer
+ */
+void LCH_LoggerRingBufferFlush(void);
+
+/****************************************************************************/
+/*  Metrics                                                                 */
+/****************************************************************************/
+
+/**
+ * @brief Phases of the main interface functions that are timed
+ */
+typedef enum {
+  LCH_METRICS_PHASE_LOAD_NEW_STATE = 0,  // Loading tables from the source
+  LCH_METRICS_PHASE_LOAD_OLD_STATE,      // Loading snapshots
+  LCH_METRICS_PHASE_DELTA,               // Computing deltas
+  LCH_METRICS_PHASE_STORE_SNAPSHOT,      // Storing snapshots
+  LCH_METRICS_PHASE_BLOCK_COMPOSE,       // Serializing blocks and patches
+  LCH_METRICS_PHASE_HASH,                // Computing block and patch digests
+  LCH_METRICS_PHASE_WRITE,               // Writing blocks
+  LCH_METRICS_PHASE_LOAD_BLOCK,          // Reading and parsing blocks
+  LCH_METRICS_PHASE_MERGE,               // Merging deltas of blocks
+  LCH_METRICS_PHASE_PATCH,               // Applying deltas to the destination
+  LCH_METRICS_PHASE_PURGE,               // Deleting blocks
+  LCH_METRICS_NUM_PHASES,
+} LCH_MetricsPhase;
+
+/**
+ * @brief Timings and counters collected by the library
+ * @note The metrics are accumulated over all calls to the library since the
+ *       start of the process, or since the last call to LCH_MetricsReset().
+ */
+typedef struct {
+  double seconds[LCH_METRICS_NUM_PHASES];  // Time spent in each phase
+  size_t bytes_read;                       // Bytes read from files
+  size_t bytes_written;                    // Bytes written to files
+  size_t rows_loaded;                      // Records loaded from sources
+  size_t rows_patched;  // Records inserted, deleted or updated in destinations
+  size_t allocations;   // Buffer allocations and reallocations
+  size_t statements;    // Calls to module callbacks except (dis)connect
+} LCH_Metrics;
+
+/**
+ * @brief Get a copy of the collected metrics
+ * @param metrics Variable to store the metrics
+ */
+void LCH_MetricsGet(LCH_Metrics *metrics);
+
+/**
+ * @brief Reset all timings and counters to zero
+ */
+void LCH_MetricsReset(void);
+
+/**
+ * @brief Get the name of a phase
+ * @param phase The phase
+ * @return The name of the phase (e.g., "load_new_state")
+ */
+const char *LCH_MetricsPhaseToString(LCH_MetricsPhase phase);
+
 /****************************************************************************/
 /*  Main Interface                                                          */
 /****************************************************************************/
@@ -352,6 +545,25 @@ LCH_Buffer *LCH_Rebase(const char *work_dir);
 LCH_Buffer *LCH_History(const char *work_dir, const char *table_id,
                         const LCH_List *primary_fields, double from, double to);
 
+/**
+ * @brief Retrieve the histories of many records in a given table between a
+ *        given time interval
+ * @param work_dir The leech working directory
+ * @param table_id The table identifier
+ * @param primary_records List of records, each a list of the primary fields
+ *                        that identify the record
+ * @param from Changes older than this timestamp are excluded
+ * @param to Changes at or after this timestamp are excluded
+ * @return A byte buffer containing the histories as a JSON data structure or
+ *         NULL in case of failure
+ * @note The chain is walked once regardless of the number of records, which is
+ *       cheaper than calling LCH_History() for each of them. Records listed
+ *       more than once get a single history.
+ */
+LCH_Buffer *LCH_HistoryMany(const char *work_dir, const char *table_id,
+                            const LCH_List *primary_records, double from,
+                            double to);
+
 /**
  * @brief Patch outdated tables using computed deltas
  * @param work_dir The leech working directory
@@ -373,4 +585,94 @@ bool LCH_Patch(const char *work_dir, const char *uid_field,
  */
 bool LCH_Purge(const char *work_dir);
 
+/**
+ * @brief Move all blocks to the storage configured by the "fan_out_blocks"
+ *        and "pack_blocks" options
+ * @param work_dir The leech working directory
+ * @return False in case of failure
+ * @note Blocks remain readable during the migration, hence it is safe to run
+ *       while other processes use the block chain
+ */
+bool LCH_MigrateBlocks(const char *work_dir);
+
+/****************************************************************************/
+/*  Session                                                                 */
+/****************************************************************************/
+
+/**
+ * A session keeps the instance loaded between calls. That is, the
+ * configuration file is parsed, and the table modules are loaded, only once,
+ * and the table snapshots stored by a commit are kept in memory for the next
+ * commit. Use sessions in long-running processes that call the main interface
+ * repeatedly on the same working directory.
+ */
+typedef struct LCH_Session LCH_Session;
+
+/**
+ * @brief Create a session
+ * @param work_dir The leech working directory
+ * @return The session or NULL in case of failure
+ * @note The instance is reloaded whenever leech.json changes
+ */
+LCH_Session *LCH_SessionCreate(const char *work_dir);
+
+/**
+ * @brief Destroy a session
+ * @param session The session
+ */
+void LCH_SessionDestroy(LCH_Session *session);
+
+/**
+ * @brief Same as LCH_Commit(), but using the instance of a session
+ * @note With auto purging enabled, the purge is deferred until
+ *       LCH_SessionRunDeferred() is called or the session is destroyed. This
+ *       allows a server to respond to the commit before purging.
+ */
+bool LCH_SessionCommit(LCH_Session *session);
+
+/**
+ * @brief Same as LCH_Diff(), but using the instance of a session
+ */
+LCH_Buffer *LCH_SessionDiff(LCH_Session *session, const char *block_id);
+
+/**
+ * @brief Same as LCH_History(), but using the instance of a session
+ */
+LCH_Buffer *LCH_SessionHistory(LCH_Session *session, const char *table_id,
+                               const LCH_List *primary_fields, double from,
+                               double to);
+
+/**
+ * @brief Same as LCH_HistoryMany(), but using the instance of a session
+ */
+LCH_Buffer *LCH_SessionHistoryMany(LCH_Session *session, const char *table_id,
+                                   const LCH_List *primary_records,
+                                   double from, double to);
+
+/**
+ * @brief Same as LCH_Patch(), but using the instance of a session
+ */
+bool LCH_SessionPatch(LCH_Session *session, const char *uid_field,
+                      const char *uid_value, const char *patch, size_t size);
+
+/**
+ * @brief Same as LCH_Purge(), but using the instance of a session
+ */
+bool LCH_SessionPurge(LCH_Session *session);
+
+/**
+ * @brief Check whether a session has deferred work
+ * @param session The session
+ * @return True if LCH_SessionRunDeferred() has work to do
+ */
+bool LCH_SessionHasDeferred(const LCH_Session *session);
+
+/**
+ * @brief Run the work deferred by previous calls (i.e., auto purging)
+ * @param session The session
+ * @return False in case of failure
+ * @note Meant to be called when the process is otherwise idle
+ */
+bool LCH_SessionRunDeferred(LCH_Session *session);
+
 #endif  // _LEECH_LEECH_H
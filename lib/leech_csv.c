@@ -2,8 +2,10 @@
 #include <errno.h>
 #include <stdbool.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include "buffer.h"
+#include "columnar.h"
 #include "csv.h"
 #include "definitions.h"
 #include "files.h"
@@ -17,7 +19,7 @@ extern "C" {
 
 typedef struct {
   char *filename;
-  LCH_List *table;
+  LCH_Table *table;
 } CSVconn;
 
 void *LCH_CallbackConnect(const char *const conn_info) {
@@ -41,7 +43,7 @@ void LCH_CallbackDisconnect(void *const _conn) {
   CSVconn *const conn = (CSVconn *)_conn;
   if (conn != NULL) {
     free(conn->filename);
-    LCH_ListDestroy(conn->table);
+    LCH_TableDestroy(conn->table);
   }
   free(conn);
 }
@@ -61,51 +63,57 @@ bool LCH_CallbackCreateTable(void *const _conn, const char *const table_name,
     return true;
   }
 
-  LCH_List *const header = LCH_ListCopy(
-      primary_columns, (LCH_DuplicateFn)LCH_BufferDuplicate, LCH_BufferDestroy);
-  if (header == NULL) {
+  const size_t num_primary = LCH_ListLength(primary_columns);
+  const size_t num_subsidiary = LCH_ListLength(subsidiary_columns);
+  LCH_Table *const table = LCH_TableCreate(num_primary + num_subsidiary);
+  if (table == NULL) {
     return false;
   }
 
-  const size_t num_subdidiary = LCH_ListLength(subsidiary_columns);
-  for (size_t i = 0; i < num_subdidiary; i++) {
+  for (size_t i = 0; i < num_primary + num_subsidiary; i++) {
     const LCH_Buffer *const column_name =
-        (LCH_Buffer *)LCH_ListGet(subsidiary_columns, i);
-    if (!LCH_ListAppendBufferDuplicate(header, column_name)) {
-      LCH_ListDestroy(header);
+        (i < num_primary)
+            ? (LCH_Buffer *)LCH_ListGet(primary_columns, i)
+            : (LCH_Buffer *)LCH_ListGet(subsidiary_columns, i - num_primary);
+    if (!LCH_TableAppendField(table, LCH_BufferData(column_name),
+                              LCH_BufferLength(column_name))) {
+      LCH_TableDestroy(table);
       return false;
     }
   }
 
-  LCH_List *const table = LCH_ListCreate();
-  if (table == NULL) {
-    LCH_ListDestroy(header);
-    return false;
-  }
-
-  if (!LCH_ListAppend(table, header, LCH_ListDestroy)) {
-    LCH_ListDestroy(table);
-    LCH_ListDestroy(header);
-    return false;
-  }
-
-  if (!LCH_CSVComposeFile(table, conn->filename)) {
-    LCH_ListDestroy(table);
+  if (!LCH_CSVComposeFileColumnar(table, conn->filename)) {
+    LCH_TableDestroy(table);
     return false;
   }
 
   // Print debug info
   LCH_Buffer *csv = NULL;
-  if (LCH_CSVComposeRecord(&csv, header)) {
+  if (LCH_LOG_ENABLED(LCH_LOGGER_MESSAGE_TYPE_DEBUG_BIT) &&
+      LCH_CSVComposeRecordColumnar(&csv, table, 0, NULL, 0)) {
     const char *const str_repr = LCH_BufferData(csv);
     LCH_LOG_DEBUG("Created table with header: \n\t%s", str_repr);
     LCH_BufferDestroy(csv);
   }
 
-  LCH_ListDestroy(table);
+  LCH_TableDestroy(table);
   return true;
 }
 
+/**
+ * Composes a row for debug messages. Returns NULL in case of failure. Check
+ * that debug messages are enabled before calling it, as it is called for each
+ * record that is patched.
+ */
+static LCH_Buffer *RowToString(const LCH_Table *const table,
+                               const size_t row) {
+  LCH_Buffer *str_repr = NULL;
+  if (!LCH_CSVComposeRecordColumnar(&str_repr, table, row, NULL, 0)) {
+    return NULL;
+  }
+  return str_repr;
+}
+
 bool LCH_CallbackTruncateTable(void *const _conn, const char *const table_name,
                                const char *const uq_column,
                                const char *const uq_field) {
@@ -116,15 +124,13 @@ bool LCH_CallbackTruncateTable(void *const _conn, const char *const table_name,
   assert(uq_column != NULL);
   assert(uq_field != NULL);
 
-  size_t num_records = LCH_ListLength(conn->table);
+  const size_t num_records = LCH_TableGetNumRows(conn->table);
   assert(num_records > 0);
 
-  const LCH_List *const table_header = (LCH_List *)LCH_ListGet(conn->table, 0);
   const LCH_Buffer uk_col_key = LCH_BufferStaticFromString(uq_column);
-  const size_t uq_col_idx = LCH_ListIndex(table_header, &uk_col_key,
-                                          (LCH_CompareFn)LCH_BufferCompare);
+  const size_t uq_col_idx = LCH_TableGetColumnIndex(conn->table, &uk_col_key);
 
-  if (uq_col_idx >= LCH_ListLength(table_header)) {
+  if (uq_col_idx >= LCH_TableGetNumColumns(conn->table)) {
     LCH_LOG_ERROR(
         "Missing field name \"%s\" for unique host identifier "
         "in table header of table '%s'",
@@ -132,43 +138,40 @@ bool LCH_CallbackTruncateTable(void *const _conn, const char *const table_name,
     return false;
   }
 
-  for (size_t i = 1; i < num_records;) {
-    const LCH_List *const record = (LCH_List *)LCH_ListGet(conn->table, i);
-    const LCH_Buffer *const field =
-        (LCH_Buffer *)LCH_ListGet(record, uq_col_idx);
-
-    const LCH_Buffer uk_field_key = LCH_BufferStaticFromString(uq_field);
-    if (LCH_BufferEqual(&uk_field_key, field)) {
+  const LCH_Buffer uk_field_key = LCH_BufferStaticFromString(uq_field);
+  for (size_t i = 1; i < num_records; i++) {
+    if (!LCH_TableIsRowRemoved(conn->table, i) &&
+        LCH_TableFieldEqual(conn->table, i, uq_col_idx, &uk_field_key)) {
       // Records with the unqiue host identifier are to be removed
       LCH_LOG_DEBUG(
           "Deleting record %zu form table \"%s\" because unique host "
-          "identifier \"%s\" is '%s' ('%s' == '%s')",
-          i, table_name, uq_column, uq_field, uq_field, LCH_BufferData(field));
-      LCH_List *const removed = (LCH_List *)LCH_ListRemove(conn->table, i);
-
-      LCH_Buffer *str_repr = NULL;
-      if (LCH_CSVComposeRecord(&str_repr, removed)) {
-        LCH_LOG_DEBUG("Deleted record contained: %s", LCH_BufferData(str_repr));
-        LCH_BufferDestroy(str_repr);
+          "identifier \"%s\" is '%s'",
+          i, table_name, uq_column, uq_field);
+
+      if (LCH_LOG_ENABLED(LCH_LOGGER_MESSAGE_TYPE_DEBUG_BIT)) {
+        LCH_Buffer *const str_repr = RowToString(conn->table, i);
+        if (str_repr != NULL) {
+          LCH_LOG_DEBUG("Deleted record contained: %s",
+                        LCH_BufferData(str_repr));
+          LCH_BufferDestroy(str_repr);
+        }
       }
 
-      LCH_ListDestroy(removed);
-      num_records -= 1;
-    } else {
-      i += 1;
+      LCH_TableRemoveRow(conn->table, i);
     }
   }
 
   return true;
 }
 
-LCH_List *LCH_CallbackGetTable(void *const _conn, const char *const table_name,
-                               LCH_UNUSED const LCH_List *const columns) {
+LCH_Table *LCH_CallbackLoadTable(void *const _conn,
+                                 const char *const table_name,
+                                 LCH_UNUSED const LCH_List *const columns) {
   CSVconn *const conn = (CSVconn *)_conn;
   assert(conn != NULL);
   assert(conn->filename != NULL);
 
-  LCH_List *const table = LCH_CSVParseFile(conn->filename);
+  LCH_Table *const table = LCH_CSVParseFileColumnar(conn->filename);
   if (table == NULL) {
     return NULL;
   }
@@ -182,12 +185,66 @@ LCH_List *LCH_CallbackGetTable(void *const _conn, const char *const table_name,
   return table;
 }
 
+LCH_Buffer *LCH_CallbackGetFingerprint(void *const _conn,
+                                       const char *const table_name) {
+  CSVconn *const conn = (CSVconn *)_conn;
+  assert(conn != NULL);
+  assert(conn->filename != NULL);
+
+  struct stat sb;
+  if (stat(conn->filename, &sb) == -1) {
+    LCH_LOG_ERROR("Failed to stat CSV file '%s': %s", conn->filename,
+                  strerror(errno));
+    return NULL;
+  }
+
+  /* The modification time and size alone would miss edits made within the
+   * timestamp resolution that preserve the size. Hence, the content hash. */
+  LCH_Buffer *const content = LCH_BufferMapFile(conn->filename);
+  if (content == NULL) {
+    return NULL;
+  }
+
+  LCH_Buffer *const digest = LCH_BufferCreate();
+  if (digest == NULL) {
+    LCH_BufferDestroy(content);
+    return NULL;
+  }
+
+  if (!LCH_MessageDigest((const unsigned char *)LCH_BufferData(content),
+                         LCH_BufferLength(content), digest)) {
+    LCH_BufferDestroy(digest);
+    LCH_BufferDestroy(content);
+    return NULL;
+  }
+  LCH_BufferDestroy(content);
+
+  LCH_Buffer *const fingerprint = LCH_BufferCreate();
+  if (fingerprint == NULL) {
+    LCH_BufferDestroy(digest);
+    return NULL;
+  }
+
+  if (!LCH_BufferPrintFormat(fingerprint, "%lld:%lld:%s",
+                             (long long)sb.st_size, (long long)sb.st_mtime,
+                             LCH_BufferData(digest))) {
+    LCH_BufferDestroy(fingerprint);
+    LCH_BufferDestroy(digest);
+    return NULL;
+  }
+  LCH_BufferDestroy(digest);
+
+  LCH_LOG_DEBUG("Fingerprint of table \"%s\" in '%s' is '%s'", table_name,
+                conn->filename, LCH_BufferData(fingerprint));
+  return fingerprint;
+}
+
 bool LCH_CallbackBeginTransaction(void *const _conn) {
   CSVconn *const conn = (CSVconn *)_conn;
   assert(conn != NULL);
   assert(conn->filename != NULL);
 
-  LCH_List *const table = LCH_CSVParseFile(conn->filename);
+  LCH_Table *const table = LCH_CSVParseFileColumnar(conn->filename);
   if (table == NULL) {
     return false;
   }
@@ -204,15 +261,18 @@ bool LCH_CallbackCommitTransaction(void *const _conn) {
   assert(conn->filename != NULL);
   assert(conn->table != NULL);
 
-  if (!LCH_CSVComposeFile(conn->table, conn->filename)) {
-    LCH_ListDestroy(conn->table);
+  /* Deleted records are only marked until now */
+  LCH_TableCompact(conn->table);
+
+  if (!LCH_CSVComposeFileColumnar(conn->table, conn->filename)) {
+    LCH_TableDestroy(conn->table);
     conn->table = NULL;
     return false;
   }
 
   LCH_LOG_DEBUG("Wrote table to '%s'", conn->filename);
 
-  LCH_ListDestroy(conn->table);
+  LCH_TableDestroy(conn->table);
   conn->table = NULL;
   return true;
 }
@@ -221,7 +281,7 @@ bool LCH_CallbackRollbackTransaction(void *const _conn) {
   CSVconn *const conn = (CSVconn *)_conn;
   assert(conn != NULL);
 
-  LCH_ListDestroy(conn->table);
+  LCH_TableDestroy(conn->table);
   conn->table = NULL;
 
   LCH_LOG_DEBUG("Destroyed table");
@@ -237,130 +297,136 @@ bool LCH_CallbackInsertRecord(void *const _conn,
   assert(conn != NULL);
   assert(conn->table != NULL);
 
-  LCH_List *const record = LCH_ListCopy(
-      values, (LCH_DuplicateFn)LCH_BufferDuplicate, LCH_BufferDestroy);
-  if (record == NULL) {
-    return false;
-  }
-
-  if (!LCH_ListAppend(conn->table, record, LCH_ListDestroy)) {
-    LCH_ListDestroy(record);
+  if (!LCH_TableAppendRecord(conn->table, values)) {
     return false;
   }
 
-  LCH_Buffer *str_repr = NULL;
-  if (LCH_CSVComposeRecord(&str_repr, record)) {
-    LCH_LOG_DEBUG("Inserted record %zu: '%s'", LCH_ListLength(conn->table) - 1,
-                  LCH_BufferData(str_repr));
-  } else {
-    LCH_LOG_DEBUG("Inserted record %zu", LCH_ListLength(conn->table) - 1);
+  const size_t row = LCH_TableGetNumRows(conn->table) - 1;
+  if (LCH_LOG_ENABLED(LCH_LOGGER_MESSAGE_TYPE_DEBUG_BIT)) {
+    LCH_Buffer *const str_repr = RowToString(conn->table, row);
+    if (str_repr != NULL) {
+      LCH_LOG_DEBUG("Inserted record %zu: '%s'", row, LCH_BufferData(str_repr));
+    } else {
+      LCH_LOG_DEBUG("Inserted record %zu", row);
+    }
+    LCH_BufferDestroy(str_repr);
   }
-  LCH_BufferDestroy(str_repr);
   return true;
 }
 
-bool LCH_CallbackDeleteRecord(void *const _conn,
-                              LCH_UNUSED const char *const table_name,
-                              LCH_UNUSED const LCH_List *const primary_columns,
-                              const LCH_List *const primary_values) {
-  CSVconn *const conn = (CSVconn *)_conn;
-  assert(conn != NULL);
-  assert(conn->table != NULL);
-
-  const size_t num_records = LCH_ListLength(conn->table);
+/**
+ * Find the row whose leading fields are equal to the primary values, skipping
+ * deleted rows. Returns the number of rows if not found.
+ */
+static size_t FindRecord(const LCH_Table *const table,
+                         const LCH_List *const primary_values) {
+  const size_t num_records = LCH_TableGetNumRows(table);
   assert(num_records > 0);
 
+  const size_t num_primary = LCH_ListLength(primary_values);
+  if (num_primary > LCH_TableGetNumColumns(table)) {
+    return num_records;
+  }
+
   for (size_t i = 1 /* Skip header */; i < num_records; i++) {
-    const LCH_List *const record =
-        (const LCH_List *)LCH_ListGet(conn->table, i);
-    bool found = true;
+    if (LCH_TableIsRowRemoved(table, i)) {
+      continue;
+    }
 
-    const size_t num_primary = LCH_ListLength(primary_values);
+    bool found = true;
     for (size_t j = 0; j < num_primary; j++) {
-      const LCH_Buffer *const field = (LCH_Buffer *)LCH_ListGet(record, j);
       const LCH_Buffer *const value =
           (LCH_Buffer *)LCH_ListGet(primary_values, j);
       assert(value != NULL);
 
-      if (!LCH_BufferEqual(field, value)) {
+      if (!LCH_TableFieldEqual(table, i, j, value)) {
         found = false;
         break;
       }
     }
 
     if (found) {
-      LCH_List *const removed = (LCH_List *)LCH_ListRemove(conn->table, i);
-      LCH_Buffer *str_repr = NULL;
-      if (LCH_CSVComposeRecord(&str_repr, removed)) {
-        LCH_LOG_DEBUG("Deleted record %zu: '%s'", i + 1,
-                      LCH_BufferData(str_repr));
-      } else {
-        LCH_LOG_DEBUG("Deleted record %zu", i + 1);
-      }
-      LCH_BufferDestroy(str_repr);
-      LCH_ListDestroy(removed);
-      return true;
+      return i;
     }
   }
 
-  return false;
+  return num_records;
+}
+
+bool LCH_CallbackDeleteRecord(void *const _conn,
+                              LCH_UNUSED const char *const table_name,
+                              LCH_UNUSED const LCH_List *const primary_columns,
+                              const LCH_List *const primary_values) {
+  CSVconn *const conn = (CSVconn *)_conn;
+  assert(conn != NULL);
+  assert(conn->table != NULL);
+
+  const size_t i = FindRecord(conn->table, primary_values);
+  if (i >= LCH_TableGetNumRows(conn->table)) {
+    return false;
+  }
+
+  if (LCH_LOG_ENABLED(LCH_LOGGER_MESSAGE_TYPE_DEBUG_BIT)) {
+    LCH_Buffer *const str_repr = RowToString(conn->table, i);
+    if (str_repr != NULL) {
+      LCH_LOG_DEBUG("Deleted record %zu: '%s'", i + 1, LCH_BufferData(str_repr));
+    } else {
+      LCH_LOG_DEBUG("Deleted record %zu", i + 1);
+    }
+    LCH_BufferDestroy(str_repr);
+  }
+
+  LCH_TableRemoveRow(conn->table, i);
+  return true;
 }
 
 bool LCH_CallbackUpdateRecord(
-    void *const _conn, LCH_UNUSED const char *const table_name,
+    void *const _conn, const char *const table_name,
     LCH_UNUSED const LCH_List *const primary_columns,
     const LCH_List *const primary_values,
-    LCH_UNUSED const LCH_List *const subsidiary_columns,
+    const LCH_List *const subsidiary_columns,
     const LCH_List *const subsidiary_values) {
   CSVconn *const conn = (CSVconn *)_conn;
   assert(conn != NULL);
   assert(conn->table != NULL);
 
-  const size_t num_records = LCH_ListLength(conn->table);
-  assert(num_records > 0);
-
-  for (size_t i = 1 /* Skip header */; i < num_records; i++) {
-    LCH_List *const record = (LCH_List *)LCH_ListGet(conn->table, i);
-    bool found = true;
-
-    size_t j;
-    const size_t num_primary = LCH_ListLength(primary_values);
-    for (j = 0; j < num_primary; j++) {
-      const LCH_Buffer *const field = (LCH_Buffer *)LCH_ListGet(record, j);
-      const LCH_Buffer *const value =
-          (LCH_Buffer *)LCH_ListGet(primary_values, j);
+  const size_t i = FindRecord(conn->table, primary_values);
+  if (i >= LCH_TableGetNumRows(conn->table)) {
+    return false;
+  }
 
-      if (!LCH_BufferEqual(field, value)) {
-        found = false;
-        break;
-      }
+  /* Partial updates may only carry some of the subsidiary columns, hence we
+   * locate each column by name rather than by position */
+  const size_t num_columns = LCH_TableGetNumColumns(conn->table);
+  const size_t num_subsidiary = LCH_ListLength(subsidiary_values);
+  for (size_t k = 0; k < num_subsidiary; k++) {
+    const LCH_Buffer *const column =
+        (LCH_Buffer *)LCH_ListGet(subsidiary_columns, k);
+    const size_t index = LCH_TableGetColumnIndex(conn->table, column);
+    if (index >= num_columns) {
+      LCH_LOG_ERROR("Column '%s' of table \"%s\" not found in header of '%s'",
+                    LCH_BufferData(column), table_name, conn->filename);
+      return false;
     }
 
-    if (found) {
-      const size_t num_subsidiary = LCH_ListLength(subsidiary_values);
-      for (size_t k = 0; k < num_subsidiary; k++) {
-        const LCH_Buffer *const value =
-            (LCH_Buffer *)LCH_ListGet(subsidiary_values, k);
-        LCH_Buffer *const duplicate = LCH_BufferDuplicate(value);
-        if (duplicate == NULL) {
-          return false;
-        }
-        LCH_ListSet(record, j + k, duplicate, LCH_BufferDestroy);
-      }
-
-      LCH_Buffer *str_repr = NULL;
-      if (LCH_CSVComposeRecord(&str_repr, record)) {
-        LCH_LOG_DEBUG("Updated record %zu: '%s'", i + 1,
-                      LCH_BufferData(str_repr));
-      } else {
-        LCH_LOG_DEBUG("Updated record %zu", i + 1);
-      }
-      LCH_BufferDestroy(str_repr);
-      return true;
+    const LCH_Buffer *const value =
+        (LCH_Buffer *)LCH_ListGet(subsidiary_values, k);
+    if (!LCH_TableSetField(conn->table, i, index, LCH_BufferData(value),
+                           LCH_BufferLength(value))) {
+      return false;
     }
   }
 
-  return false;
+  if (LCH_LOG_ENABLED(LCH_LOGGER_MESSAGE_TYPE_DEBUG_BIT)) {
+    LCH_Buffer *const str_repr = RowToString(conn->table, i);
+    if (str_repr != NULL) {
+      LCH_LOG_DEBUG("Updated record %zu: '%s'", i + 1, LCH_BufferData(str_repr));
+    } else {
+      LCH_LOG_DEBUG("Updated record %zu", i + 1);
+    }
+    LCH_BufferDestroy(str_repr);
+  }
+  return true;
 }
 
 #ifdef __cplusplus
@@ -162,7 +162,7 @@ bool LCH_CallbackCreateTable(void *const _conn, const char *const table_name,
     PQfreemem(column_name_escaped);
   }
 
-  if (!LCH_BufferPrintFormat(query_buffer, ") );")) {
+  if (!LCH_BufferAppendBytes(query_buffer, ") );", strlen(") );"))) {
     LCH_BufferDestroy(query_buffer);
     return false;
   }
@@ -227,8 +227,9 @@ bool LCH_CallbackTruncateTable(void *const _conn, const char *const table_name,
   return success;
 }
 
-LCH_List *LCH_CallbackGetTable(void *const _conn, const char *const table_name,
-                               const LCH_List *const columns) {
+LCH_Table *LCH_CallbackLoadTable(void *const _conn,
+                                 const char *const table_name,
+                                 const LCH_List *const columns) {
   PGconn *const conn = (PGconn *)_conn;
 
   LCH_Buffer *const query_buffer = LCH_BufferCreate();
@@ -236,7 +237,7 @@ LCH_List *LCH_CallbackGetTable(void *const _conn, const char *const table_name,
     return NULL;
   }
 
-  if (!LCH_BufferPrintFormat(query_buffer, "SELECT ")) {
+  if (!LCH_BufferAppendBytes(query_buffer, "SELECT ", strlen("SELECT "))) {
     LCH_BufferDestroy(query_buffer);
     return NULL;
   }
@@ -294,84 +295,65 @@ LCH_List *LCH_CallbackGetTable(void *const _conn, const char *const table_name,
   const int n_cols = PQnfields(result);
   LCH_LOG_DEBUG("Query returned %d rows and %d columns", n_rows, n_cols);
 
-  LCH_List *const table = LCH_ListCreate();
-  if (table == NULL) {
+  if (n_cols <= 0) {
+    LCH_LOG_ERROR("Query returned no columns for table '%s'", table_name);
     PQclear(result);
     return NULL;
   }
 
-  LCH_List *const header = LCH_ListCreate();
+  LCH_Table *const table = LCH_TableCreate((size_t)n_cols);
   if (table == NULL) {
-    LCH_ListDestroy(table);
-    PQclear(result);
-    return NULL;
-  }
-
-  if (!LCH_ListAppend(table, header, LCH_ListDestroy)) {
-    LCH_ListDestroy(header);
-    LCH_ListDestroy(table);
     PQclear(result);
     return NULL;
   }
 
+  /* Each field is stored with a terminating NULL-byte, hence the extra byte
+   * per field */
+  size_t num_bytes = 0;
   for (int i = 0; i < n_cols; i++) {
     const char *const field_name = PQfname(result, i);
     if (field_name == NULL) {
       LCH_LOG_ERROR("Failed to get field name at index %d", i);
-      LCH_ListDestroy(table);
-      PQclear(result);
-      return NULL;
-    }
-
-    LCH_Buffer *const buffer = LCH_BufferFromString(field_name);
-    if (buffer == NULL) {
-      LCH_ListDestroy(table);
+      LCH_TableDestroy(table);
       PQclear(result);
       return NULL;
     }
 
-    if (!LCH_ListAppend(header, buffer, LCH_BufferDestroy)) {
-      LCH_BufferDestroy(buffer);
-      LCH_ListDestroy(table);
+    const size_t length = strlen(field_name);
+    if (!LCH_TableAppendField(table, field_name, length)) {
+      LCH_TableDestroy(table);
       PQclear(result);
       return NULL;
     }
+    num_bytes += length + 1;
   }
 
   for (int i = 0; i < n_rows; i++) {
-    LCH_List *const record = LCH_ListCreate();
-    if (record == NULL) {
-      LCH_ListDestroy(table);
-      PQclear(result);
-      return NULL;
+    for (int j = 0; j < n_cols; j++) {
+      num_bytes += (size_t)PQgetlength(result, i, j) + 1;
     }
+  }
 
-    if (!LCH_ListAppend(table, record, LCH_ListDestroy)) {
-      LCH_ListDestroy(record);
-      LCH_ListDestroy(table);
-      PQclear(result);
-      return NULL;
-    }
+  // One row per tuple plus the header
+  if (!LCH_TableReserve(table, (size_t)n_rows + 1, num_bytes)) {
+    LCH_TableDestroy(table);
+    PQclear(result);
+    return NULL;
+  }
 
+  for (int i = 0; i < n_rows; i++) {
     for (int j = 0; j < n_cols; j++) {
       const char *const value = PQgetvalue(result, i, j);
       if (value == NULL) {
         LCH_LOG_ERROR("Failed to get value at index %d:%d", i, j);
-        LCH_ListDestroy(table);
+        LCH_TableDestroy(table);
         PQclear(result);
         return NULL;
       }
 
-      LCH_Buffer *const buffer = LCH_BufferFromString(value);
-      if (buffer == NULL) {
-        LCH_ListDestroy(table);
-        PQclear(result);
-        return NULL;
-      }
-
-      if (!LCH_ListAppend(record, buffer, LCH_BufferDestroy)) {
-        LCH_BufferDestroy(buffer);
-        LCH_ListDestroy(table);
+      if (!LCH_TableAppendField(table, value,
+                                (size_t)PQgetlength(result, i, j))) {
+        LCH_TableDestroy(table);
         PQclear(result);
         return NULL;
       }
@@ -382,6 +364,66 @@ LCH_List *LCH_CallbackGetTable(void *const _conn, const char *const table_name,
   return table;
 }
 
+LCH_Buffer *LCH_CallbackGetFingerprint(void *const _conn,
+                                       const char *const table_name) {
+  PGconn *const conn = (PGconn *)_conn;
+
+  const LCH_Buffer table_name_buf = LCH_BufferStaticFromString(table_name);
+  char *const table_name_escaped = EscapeIdentifier(conn, &table_name_buf);
+  if (table_name_escaped == NULL) {
+    return NULL;
+  }
+
+  /* The aggregate hash is computed by the database server, so that no rows
+   * need to be transferred in order to detect changes */
+  LCH_Buffer *const query_buffer = LCH_BufferCreate();
+  if (query_buffer == NULL) {
+    PQfreemem(table_name_escaped);
+    return NULL;
+  }
+
+  if (!LCH_BufferPrintFormat(
+          query_buffer,
+          "SELECT count(*) || ':' || coalesce(md5(string_agg(md5(t::text), '' "
+          "ORDER BY md5(t::text))), '') FROM %s AS t;",
+          table_name_escaped)) {
+    LCH_BufferDestroy(query_buffer);
+    PQfreemem(table_name_escaped);
+    return NULL;
+  }
+  PQfreemem(table_name_escaped);
+
+  char *const query = LCH_BufferToString(query_buffer);
+  LCH_LOG_DEBUG("Executing query: %s", query);
+
+  PGresult *const result = PQexec(conn, query);
+  free(query);
+  if (result == NULL) {
+    LCH_LOG_ERROR("Failed to execute query: Likely out of memory");
+    return NULL;
+  }
+
+  if (PQresultStatus(result) != PGRES_TUPLES_OK) {
+    LCH_LOG_ERROR("Failed to execute query: %s", PQerrorMessage(conn));
+    PQclear(result);
+    return NULL;
+  }
+
+  if (PQntuples(result) != 1 || PQnfields(result) != 1) {
+    LCH_LOG_ERROR(
+        "Expected query to return a single value, found %d rows and %d "
+        "columns",
+        PQntuples(result), PQnfields(result));
+    PQclear(result);
+    return NULL;
+  }
+
+  LCH_Buffer *const fingerprint =
+      LCH_BufferFromString(PQgetvalue(result, 0, 0));
+  PQclear(result);
+  return fingerprint;
+}
+
 bool LCH_CallbackBeginTransaction(void *const _conn) {
   PGconn *conn = (PGconn *)_conn;
   assert(conn != NULL);
@@ -467,7 +509,7 @@ bool LCH_CallbackInsertRecord(void *const _conn, const char *const table_name,
     PQfreemem(value_escaped);
   }
 
-  if (!LCH_BufferPrintFormat(query_buffer, ");")) {
+  if (!LCH_BufferAppendBytes(query_buffer, ");", strlen(");"))) {
     LCH_BufferDestroy(query_buffer);
     return false;
   }
@@ -535,7 +577,7 @@ bool LCH_CallbackDeleteRecord(void *const _conn, const char *const table_name,
     PQfreemem(column_escaped);
   }
 
-  if (!LCH_BufferPrintFormat(query_buffer, ";")) {
+  if (!LCH_BufferAppendBytes(query_buffer, ";", strlen(";"))) {
     LCH_BufferDestroy(query_buffer);
     return NULL;
   }
@@ -553,6 +595,8 @@ bool LCH_CallbackUpdateRecord(void *const _conn, const char *const table_name,
                               const LCH_List *const subsidiary_values) {
   PGconn *const conn = (PGconn *)_conn;
 
+  /* Only the given subsidiary columns are assigned. Hence, partial updates
+   * result in a narrow UPDATE statement touching just the changed columns. */
   LCH_Buffer *const query_buffer = LCH_BufferCreate();
   if (query_buffer == NULL) {
     return false;
@@ -636,13 +680,14 @@ bool LCH_CallbackUpdateRecord(void *const _conn, const char *const table_name,
     PQfreemem(column_escaped);
   }
 
-  if (!LCH_BufferPrintFormat(query_buffer, ";")) {
+  if (!LCH_BufferAppendBytes(query_buffer, ";", strlen(";"))) {
     LCH_BufferDestroy(query_buffer);
-    return NULL;
+    return false;
   }
 
   char *const query = LCH_BufferToString(query_buffer);
   const bool success = ExecuteCommand(conn, query);
+  free(query);
   return success;
 }
 
@@ -8,21 +8,56 @@
 
 #include "logger.h"
 
-typedef struct ListElement {
-  void *value;
-  void (*destroy)(void *);
-} ListElement;
-
+typedef void (*LCH_DestroyFn)(void *);
+
+/**
+ * Elements are stored inline. All elements usually share the same destroy
+ * function, in which case it is stored once for the entire list. Only if
+ * elements with different destroy functions are mixed, a parallel array of
+ * destroy functions is allocated.
+ */
 struct LCH_List {
   size_t length;
   size_t capacity;
-  ListElement **buffer;
+  void **values;
+  LCH_DestroyFn destroy;
+  LCH_DestroyFn *destroys;  // NULL unless destroy functions are mixed
 };
 
+static bool Resize(LCH_List *const self, const size_t new_capacity) {
+  assert(self != NULL);
+  assert(new_capacity >= self->length);
+
+  void **const new_values =
+      (void **)realloc(self->values, sizeof(void *) * new_capacity);
+  if (new_values == NULL) {
+    LCH_LOG_ERROR("Failed to expand list buffer from %zu to %zu elements: %s",
+                  self->capacity, new_capacity, strerror(errno));
+    return false;
+  }
+  self->values = new_values;
+
+  if (self->destroys != NULL) {
+    LCH_DestroyFn *const new_destroys = (LCH_DestroyFn *)realloc(
+        self->destroys, sizeof(LCH_DestroyFn) * new_capacity);
+    if (new_destroys == NULL) {
+      LCH_LOG_ERROR(
+          "Failed to expand list buffer from %zu to %zu elements: %s",
+          self->capacity, new_capacity, strerror(errno));
+      return false;
+    }
+    self->destroys = new_destroys;
+  }
+
+  self->capacity = new_capacity;
+  return true;
+}
+
 static bool EnsureCapacity(LCH_List *const self, const size_t n_items) {
   assert(self != NULL);
 
-  size_t new_capacity = self->capacity;
+  size_t new_capacity =
+      (self->capacity > 0) ? self->capacity : LCH_LIST_CAPACITY;
   while (new_capacity < self->length + n_items) {
     new_capacity *= 2;
   }
@@ -31,20 +66,62 @@ static bool EnsureCapacity(LCH_List *const self, const size_t n_items) {
     return true;
   }
 
-  ListElement **new_buffer = (ListElement **)realloc(
-      self->buffer, sizeof(ListElement *) * new_capacity);
-  if (new_buffer == NULL) {
-    LCH_LOG_ERROR("Failed to expand list buffer from %zu to %zu elements: %s",
-                  self->capacity, new_capacity, strerror(errno));
-    return false;
+  return Resize(self, new_capacity);
+}
+
+/**
+ * Makes sure that an element with the given destroy function can be stored in
+ * the list. Must be called after ensuring the capacity.
+ */
+static bool PrepareDestroy(LCH_List *const self, const LCH_DestroyFn destroy) {
+  assert(self != NULL);
+
+  if (self->destroys != NULL || destroy == self->destroy) {
+    return true;
   }
 
-  self->capacity = new_capacity;
-  self->buffer = new_buffer;
+  if (self->length == 0) {
+    self->destroy = destroy;
+    return true;
+  }
 
+  /* Elements with different destroy functions are mixed. Hence, we need to
+   * keep track of them for each element. */
+  LCH_DestroyFn *const destroys =
+      (LCH_DestroyFn *)malloc(sizeof(LCH_DestroyFn) * self->capacity);
+  if (destroys == NULL) {
+    LCH_LOG_ERROR("Failed to allocate memory for list buffer: %s",
+                  strerror(errno));
+    return false;
+  }
+
+  for (size_t i = 0; i < self->length; i++) {
+    destroys[i] = self->destroy;
+  }
+  self->destroys = destroys;
   return true;
 }
 
+static LCH_DestroyFn GetDestroy(const LCH_List *const self,
+                                const size_t index) {
+  assert(self != NULL);
+  assert(index < self->capacity);
+
+  return (self->destroys != NULL) ? self->destroys[index] : self->destroy;
+}
+
+static void SetDestroy(LCH_List *const self, const size_t index,
+                       const LCH_DestroyFn destroy) {
+  assert(self != NULL);
+  assert(index < self->capacity);
+
+  if (self->destroys != NULL) {
+    self->destroys[index] = destroy;
+  } else {
+    assert(destroy == self->destroy);
+  }
+}
+
 static LCH_List *LCH_ListCreateWithCapacity(const size_t capacity) {
   LCH_List *self = (LCH_List *)malloc(sizeof(LCH_List));
   if (self == NULL) {
@@ -53,12 +130,12 @@ static LCH_List *LCH_ListCreateWithCapacity(const size_t capacity) {
   }
 
   self->length = 0;
-  self->capacity = capacity;
-  self->buffer = (ListElement **)calloc(self->capacity, sizeof(ListElement *));
+  self->capacity = 0;
+  self->values = NULL;
+  self->destroy = NULL;
+  self->destroys = NULL;
 
-  if (self->buffer == NULL) {
-    LCH_LOG_ERROR("Failed to allocate memory for list buffer: %s",
-                  strerror(errno));
+  if (capacity > 0 && !Resize(self, capacity)) {
     free(self);
     return NULL;
   }
@@ -67,7 +144,19 @@ static LCH_List *LCH_ListCreateWithCapacity(const size_t capacity) {
 }
 
 LCH_List *LCH_ListCreate() {
-  return LCH_ListCreateWithCapacity(LCH_LIST_CAPACITY);
+  /* Memory for the elements is allocated on first use, so that the capacity
+   * can be reserved up front without reallocating. */
+  return LCH_ListCreateWithCapacity(0);
+}
+
+bool LCH_ListReserve(LCH_List *const self, const size_t capacity) {
+  assert(self != NULL);
+
+  if (capacity <= self->capacity) {
+    return true;
+  }
+
+  return Resize(self, capacity);
 }
 
 size_t LCH_ListLength(const LCH_List *const self) {
@@ -78,38 +167,28 @@ size_t LCH_ListLength(const LCH_List *const self) {
 bool LCH_ListAppend(LCH_List *const self, void *const value,
                     void (*destroy)(void *)) {
   assert(self != NULL);
-  assert(self->buffer != NULL);
   assert(self->capacity >= self->length);
 
   if (!EnsureCapacity(self, 1)) {
     return false;
   }
 
-  // Create item
-  ListElement *item = (ListElement *)calloc(1, sizeof(ListElement));
-  if (item == NULL) {
-    LCH_LOG_ERROR("Failed to allocate memory for list element: %s",
-                  strerror(errno));
+  if (!PrepareDestroy(self, destroy)) {
     return false;
   }
-  item->value = value;
-  item->destroy = destroy;
 
-  // Insert item into buffer
   const size_t index = self->length;
-  self->buffer[index] = item;
+  self->values[index] = value;
+  SetDestroy(self, index, destroy);
   self->length += 1;
   return true;
 }
 
 void *LCH_ListGet(const LCH_List *const self, const size_t index) {
   assert(self != NULL);
-  assert(self->buffer != NULL);
   assert(index < self->length);
 
-  ListElement *item = self->buffer[index];
-  assert(item != NULL);
-  return item->value;
+  return self->values[index];
 }
 
 void LCH_ListSet(LCH_List *const self, const size_t index, void *const value,
@@ -117,9 +196,24 @@ void LCH_ListSet(LCH_List *const self, const size_t index, void *const value,
   assert(self != NULL);
   assert(index < self->length);
 
-  self->buffer[index]->destroy(self->buffer[index]->value);
-  self->buffer[index]->value = value;
-  self->buffer[index]->destroy = destroy;
+  const LCH_DestroyFn old_destroy = GetDestroy(self, index);
+
+  if (destroy != self->destroy && self->destroys == NULL) {
+    if (self->length == 1) {
+      self->destroy = destroy;
+    } else if (!PrepareDestroy(self, destroy)) {
+      /* We cannot fail here. Rather leak the element than destroy it with the
+       * wrong function. */
+      LCH_LOG_ERROR("Failed to assign element at index %zu in list", index);
+      return;
+    }
+  }
+
+  if (old_destroy != NULL) {
+    old_destroy(self->values[index]);
+  }
+  self->values[index] = value;
+  SetDestroy(self, index, destroy);
 }
 
 size_t LCH_ListIndex(const LCH_List *const self, const void *const value,
@@ -142,9 +236,15 @@ static void Swap(LCH_List *const list, const ssize_t a, const ssize_t b) {
   assert(b >= 0);
   assert(b < (ssize_t)list->length);
 
-  ListElement *tmp = list->buffer[a];
-  list->buffer[a] = list->buffer[b];
-  list->buffer[b] = tmp;
+  void *tmp = list->values[a];
+  list->values[a] = list->values[b];
+  list->values[b] = tmp;
+
+  if (list->destroys != NULL) {
+    LCH_DestroyFn tmp_destroy = list->destroys[a];
+    list->destroys[a] = list->destroys[b];
+    list->destroys[b] = tmp_destroy;
+  }
 }
 
 static size_t Partition(LCH_List *const list, const ssize_t low,
@@ -185,32 +285,35 @@ void LCH_ListDestroy(void *const self) {
     return;
   }
 
-  assert(list->buffer != NULL);
-
-  for (size_t i = 0; i < list->length; i++) {
-    ListElement *item = list->buffer[i];
-    assert(item != NULL);
-    if (item->destroy != NULL) {
-      item->destroy(item->value);
+  if (list->destroys != NULL) {
+    for (size_t i = 0; i < list->length; i++) {
+      if (list->destroys[i] != NULL) {
+        list->destroys[i](list->values[i]);
+      }
+    }
+  } else if (list->destroy != NULL) {
+    for (size_t i = 0; i < list->length; i++) {
+      list->destroy(list->values[i]);
     }
-    free(item);
   }
-  free(list->buffer);
+
+  free(list->destroys);
+  free(list->values);
   free(list);
 }
 
 void *LCH_ListRemove(LCH_List *const list, const size_t index) {
   assert(list != NULL);
-  assert(list->buffer != NULL);
   assert(list->length > index);
 
-  ListElement *const element = list->buffer[index];
-  void *value = element->value;
-  free(element);
+  void *value = list->values[index];
 
   list->length -= 1;
-  for (size_t i = index; i < list->length; i++) {
-    list->buffer[i] = list->buffer[i + 1];
+  memmove(list->values + index, list->values + index + 1,
+          (list->length - index) * sizeof(void *));
+  if (list->destroys != NULL) {
+    memmove(list->destroys + index, list->destroys + index + 1,
+            (list->length - index) * sizeof(LCH_DestroyFn));
   }
   return value;
 }
@@ -218,7 +321,6 @@ void *LCH_ListRemove(LCH_List *const list, const size_t index) {
 LCH_List *LCH_ListCopy(const LCH_List *const original, LCH_DuplicateFn copy_fn,
                        void (*destroy_fn)(void *)) {
   assert(original != NULL);
-  assert(original->buffer != NULL);
 
   LCH_List *const copy = LCH_ListCreateWithCapacity(original->length);
   if (copy == NULL) {
@@ -245,24 +347,24 @@ LCH_List *LCH_ListCopy(const LCH_List *const original, LCH_DuplicateFn copy_fn,
 
 bool LCH_ListInsert(LCH_List *const list, const size_t index, void *const value,
                     void (*destroy)(void *)) {
-  assert(list->buffer != NULL);
   assert(list->length >= index);
 
   if (!EnsureCapacity(list, 1)) {
     return false;
   }
 
-  ListElement *const element = (ListElement *)malloc(sizeof(ListElement));
-  if (element == NULL) {
-    LCH_LOG_ERROR("malloc(3): Failed to allocate memory: %s", strerror(errno));
+  if (!PrepareDestroy(list, destroy)) {
     return false;
   }
-  element->value = value;
-  element->destroy = destroy;
 
-  memmove(list->buffer + index + 1, list->buffer + index,
-          (list->length - index) * sizeof(ListElement *));
-  list->buffer[index] = element;
+  memmove(list->values + index + 1, list->values + index,
+          (list->length - index) * sizeof(void *));
+  if (list->destroys != NULL) {
+    memmove(list->destroys + index + 1, list->destroys + index,
+            (list->length - index) * sizeof(LCH_DestroyFn));
+  }
+  list->values[index] = value;
+  SetDestroy(list, index, destroy);
   list->length += 1;
   return true;
 }
@@ -271,8 +373,6 @@ void LCH_ListReverse(LCH_List *const list) {
   assert(list != NULL);
 
   for (size_t i = 0; i < (list->length / 2); i++) {
-    ListElement *tmp = list->buffer[i];
-    list->buffer[i] = list->buffer[list->length - 1 - i];
-    list->buffer[list->length - 1 - i] = tmp;
+    Swap(list, (ssize_t)i, (ssize_t)(list->length - 1 - i));
   }
 }
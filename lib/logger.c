@@ -3,8 +3,11 @@
 #include "logger.h"
 
 #include <assert.h>
+#include <errno.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "leech.h"
 
@@ -24,9 +27,24 @@
 #define LCH_COLOR_RESET ""
 #endif
 
+/**
+ * Messages that are not passed to the callback right away can be kept in a
+ * ring buffer of fixed size slots. Once full, the oldest message is
+ * overwritten.
+ */
+struct LoggerRing {
+  unsigned char severity;  // Severities of the messages to keep
+  size_t capacity;         // Number of slots
+  size_t first;            // Slot of the oldest message
+  size_t length;           // Number of messages kept
+  unsigned char *severities;
+  char (*messages)[LCH_BUFFER_SIZE];
+};
+
 struct Logger {
   unsigned char severity;
   void (*messageCallback)(unsigned char, const char *);
+  struct LoggerRing ring;
 };
 
 static void LoggerCallbackDefault(unsigned char severity, const char *message);
@@ -36,29 +54,124 @@ static struct Logger LOGGER = {.severity = LCH_LOGGER_MESSAGE_TYPE_ERROR_BIT |
                                            LCH_LOGGER_MESSAGE_TYPE_INFO_BIT,
                                .messageCallback = LoggerCallbackDefault};
 
+unsigned char LCH_LOGGER_ENABLED = LCH_LOGGER_MESSAGE_TYPE_ERROR_BIT |
+                                   LCH_LOGGER_MESSAGE_TYPE_WARNING_BIT |
+                                   LCH_LOGGER_MESSAGE_TYPE_INFO_BIT;
+
+static void UpdateEnabled(void) {
+  LCH_LOGGER_ENABLED = LOGGER.severity;
+  if (LOGGER.ring.capacity > 0) {
+    LCH_LOGGER_ENABLED |= LOGGER.ring.severity;
+  }
+}
+
 void LCH_LoggerSeveritySet(const unsigned char severity) {
   LOGGER.severity = severity;
+  UpdateEnabled();
 }
 
 void LCH_LoggerCallbackSet(LCH_LoggerCallbackFn callback) {
   LOGGER.messageCallback = callback;
 }
 
+bool LCH_LoggerRingBufferSet(const size_t capacity,
+                             const unsigned char severity) {
+  struct LoggerRing *const ring = &LOGGER.ring;
+  free(ring->severities);
+  free(ring->messages);
+  ring->capacity = 0;
+  ring->first = 0;
+  ring->length = 0;
+  ring->severities = NULL;
+  ring->messages = NULL;
+
+  if (capacity > 0) {
+    ring->severities = (unsigned char *)malloc(capacity);
+    ring->messages =
+        (char(*)[LCH_BUFFER_SIZE])malloc(capacity * LCH_BUFFER_SIZE);
+    if (ring->severities == NULL || ring->messages == NULL) {
+      free(ring->severities);
+      free(ring->messages);
+      ring->severities = NULL;
+      ring->messages = NULL;
+      UpdateEnabled();
+      LCH_LOG_ERROR("Failed to allocate memory for log ring buffer: %s",
+                    strerror(errno));
+      return false;
+    }
+    ring->capacity = capacity;
+  }
+
+  ring->severity = severity;
+  UpdateEnabled();
+  return true;
+}
+
+void LCH_LoggerRingBufferFlush(void) {
+  struct LoggerRing *const ring = &LOGGER.ring;
+  for (size_t i = 0; i < ring->length; i++) {
+    const size_t slot = (ring->first + i) % ring->capacity;
+    if (LOGGER.messageCallback != NULL) {
+      LOGGER.messageCallback(ring->severities[slot], ring->messages[slot]);
+    }
+  }
+  ring->first = 0;
+  ring->length = 0;
+}
+
+/**
+ * Returns the slot for the next message, overwriting the oldest message if the
+ * ring is full.
+ */
+static size_t RingPush(struct LoggerRing *const ring,
+                       const unsigned char severity) {
+  assert(ring->capacity > 0);
+
+  size_t slot;
+  if (ring->length < ring->capacity) {
+    slot = (ring->first + ring->length) % ring->capacity;
+    ring->length += 1;
+  } else {
+    slot = ring->first;
+    ring->first = (ring->first + 1) % ring->capacity;
+  }
+
+  ring->severities[slot] = severity;
+  return slot;
+}
+
 void LCH_LoggerLogMessage(unsigned char severity, const char *format, ...) {
-  if ((LOGGER.severity & severity) == 0 || LOGGER.messageCallback == NULL) {
+  const bool print =
+      (LOGGER.severity & severity) != 0 && LOGGER.messageCallback != NULL;
+  const bool keep = !print && (LOGGER.ring.severity & severity) != 0 &&
+                    LOGGER.ring.capacity > 0;
+  if (!print && !keep) {
     return;
   }
 
+  /* Kept messages are formatted directly into their slot, which avoids any
+   * I/O until the ring buffer is flushed */
+  char buffer[LCH_BUFFER_SIZE];
+  char *const message =
+      keep ? LOGGER.ring.messages[RingPush(&LOGGER.ring, severity)] : buffer;
+
   va_list ap;
   va_start(ap, format);
-  char message[LCH_BUFFER_SIZE];
-  int size = vsnprintf(message, sizeof(message), format, ap);
+  int size = vsnprintf(message, LCH_BUFFER_SIZE, format, ap);
   if (size < 0 || (size_t)size >= LCH_BUFFER_SIZE) {
     LCH_LOG_WARNING("Log message trucated: Too long (%d >= %d)", size,
                     LCH_BUFFER_SIZE);
   }
   va_end(ap);
 
+  if (keep) {
+    return;
+  }
+
+  /* Give context to errors by first passing on the messages leading up to it */
+  if (severity == LCH_LOGGER_MESSAGE_TYPE_ERROR_BIT) {
+    LCH_LoggerRingBufferFlush();
+  }
   LOGGER.messageCallback(severity, message);
 }
 
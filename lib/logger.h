@@ -3,16 +3,37 @@
 
 #include "leech.h"
 
+/**
+ * Severity bits of the messages that are either passed to the logger callback
+ * or kept in the ring buffer. Use LCH_LOG_ENABLED() rather than reading it
+ * directly.
+ */
+extern unsigned char LCH_LOGGER_ENABLED;
+
+/**
+ * Check whether messages of a given severity are logged. Use it to skip
+ * preparing arguments that are only needed for a log message. The LCH_LOG_*
+ * macros already perform this check before evaluating their arguments.
+ */
+#define LCH_LOG_ENABLED(severity) ((LCH_LOGGER_ENABLED & (severity)) != 0)
+
+#define LCH_LOG(severity, ...)                     \
+  do {                                             \
+    if (LCH_LOG_ENABLED(severity)) {               \
+      LCH_LoggerLogMessage(severity, __VA_ARGS__); \
+    }                                              \
+  } while (0)
+
 #define LCH_LOG_DEBUG(...) \
-  LCH_LoggerLogMessage(LCH_LOGGER_MESSAGE_TYPE_DEBUG_BIT, __VA_ARGS__)
+  LCH_LOG(LCH_LOGGER_MESSAGE_TYPE_DEBUG_BIT, __VA_ARGS__)
 #define LCH_LOG_VERBOSE(...) \
-  LCH_LoggerLogMessage(LCH_LOGGER_MESSAGE_TYPE_VERBOSE_BIT, __VA_ARGS__)
+  LCH_LOG(LCH_LOGGER_MESSAGE_TYPE_VERBOSE_BIT, __VA_ARGS__)
 #define LCH_LOG_INFO(...) \
-  LCH_LoggerLogMessage(LCH_LOGGER_MESSAGE_TYPE_INFO_BIT, __VA_ARGS__)
+  LCH_LOG(LCH_LOGGER_MESSAGE_TYPE_INFO_BIT, __VA_ARGS__)
 #define LCH_LOG_WARNING(...) \
-  LCH_LoggerLogMessage(LCH_LOGGER_MESSAGE_TYPE_WARNING_BIT, __VA_ARGS__)
+  LCH_LOG(LCH_LOGGER_MESSAGE_TYPE_WARNING_BIT, __VA_ARGS__)
 #define LCH_LOG_ERROR(...) \
-  LCH_LoggerLogMessage(LCH_LOGGER_MESSAGE_TYPE_ERROR_BIT, __VA_ARGS__)
+  LCH_LOG(LCH_LOGGER_MESSAGE_TYPE_ERROR_BIT, __VA_ARGS__)
 
 void LCH_LoggerLogMessage(unsigned char severity, const char *format, ...);
 
@@ -0,0 +1,56 @@
+#include "metrics.h"
+
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+
+static LCH_Metrics METRICS;
+
+static const char *const PHASE_NAMES[LCH_METRICS_NUM_PHASES] = {
+    "load_new_state", "load_old_state", "delta",      "store_snapshot",
+    "block_compose",  "hash",           "write",      "load_block",
+    "merge",          "patch",          "purge",
+};
+
+void LCH_MetricsGet(LCH_Metrics *const metrics) {
+  assert(metrics != NULL);
+  *metrics = METRICS;
+}
+
+void LCH_MetricsReset(void) { memset(&METRICS, 0, sizeof(METRICS)); }
+
+const char *LCH_MetricsPhaseToString(const LCH_MetricsPhase phase) {
+  assert(phase < LCH_METRICS_NUM_PHASES);
+  return PHASE_NAMES[phase];
+}
+
+double LCH_MetricsStart(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + ((double)ts.tv_nsec / 1e9);
+}
+
+void LCH_MetricsStop(const LCH_MetricsPhase phase, const double start) {
+  assert(phase < LCH_METRICS_NUM_PHASES);
+  METRICS.seconds[phase] += LCH_MetricsStart() - start;
+}
+
+void LCH_MetricsCountBytesRead(const size_t bytes) {
+  METRICS.bytes_read += bytes;
+}
+
+void LCH_MetricsCountBytesWritten(const size_t bytes) {
+  METRICS.bytes_written += bytes;
+}
+
+void LCH_MetricsCountRowsLoaded(const size_t rows) {
+  METRICS.rows_loaded += rows;
+}
+
+void LCH_MetricsCountRowsPatched(const size_t rows) {
+  METRICS.rows_patched += rows;
+}
+
+void LCH_MetricsCountAllocation(void) { METRICS.allocations += 1; }
+
+void LCH_MetricsCountStatement(void) { METRICS.statements += 1; }
@@ -0,0 +1,55 @@
+#ifndef _LEECH_METRICS_H
+#define _LEECH_METRICS_H
+
+#include <stddef.h>
+
+#include "leech.h"
+
+/**
+ * @brief Start timing a phase
+ * @return The current time from a monotonic clock
+ */
+double LCH_MetricsStart(void);
+
+/**
+ * @brief Stop timing a phase and add the elapsed time to it
+ * @param phase The phase
+ * @param start The time returned by LCH_MetricsStart()
+ */
+void LCH_MetricsStop(LCH_MetricsPhase phase, double start);
+
+/**
+ * @brief Count bytes read from files
+ * @param bytes Number of bytes
+ */
+void LCH_MetricsCountBytesRead(size_t bytes);
+
+/**
+ * @brief Count bytes written to files
+ * @param bytes Number of bytes
+ */
+void LCH_MetricsCountBytesWritten(size_t bytes);
+
+/**
+ * @brief Count records loaded from source tables
+ * @param rows Number of records
+ */
+void LCH_MetricsCountRowsLoaded(size_t rows);
+
+/**
+ * @brief Count records inserted, deleted or updated in destination tables
+ * @param rows Number of records
+ */
+void LCH_MetricsCountRowsPatched(size_t rows);
+
+/**
+ * @brief Count one buffer allocation or reallocation
+ */
+void LCH_MetricsCountAllocation(void);
+
+/**
+ * @brief Count one call to a table module callback
+ */
+void LCH_MetricsCountStatement(void);
+
+#endif  // _LEECH_METRICS_H
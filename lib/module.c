@@ -1,5 +1,6 @@
 #include "module.h"
 
+#include <assert.h>
 #include <stdlib.h>
 
 #if HAVE_DLFCN_H
@@ -33,6 +34,27 @@ void *LCH_ModuleLoad(const char *const path) {
 #endif
 }
 
+void *LCH_ModuleLoadShared(LCH_Dict *const modules, const char *const path) {
+  assert(modules != NULL);
+  assert(path != NULL);
+
+  const LCH_Buffer key = LCH_BufferStaticFromString(path);
+  if (LCH_DictHasKey(modules, &key)) {
+    return (void *)LCH_DictGet(modules, &key);
+  }
+
+  void *const handle = LCH_ModuleLoad(path);
+  if (handle == NULL) {
+    return NULL;
+  }
+
+  if (!LCH_DictSet(modules, &key, handle, LCH_ModuleDestroy)) {
+    LCH_ModuleDestroy(handle);
+    return NULL;
+  }
+  return handle;
+}
+
 void *LCH_ModuleGetSymbol(void *const handle, const char *const symbol) {
   LCH_LOG_DEBUG("Obtaining address of symbol '%s'", symbol);
 #if HAVE_DLFCN_H
@@ -56,6 +78,29 @@ void *LCH_ModuleGetSymbol(void *const handle, const char *const symbol) {
 #endif
 }
 
+void *LCH_ModuleGetOptionalSymbol(void *const handle,
+                                  const char *const symbol) {
+  LCH_LOG_DEBUG("Obtaining address of optional symbol '%s'", symbol);
+#if HAVE_DLFCN_H
+  void *address = dlsym(handle, symbol);
+  if (address == NULL) {
+    LCH_LOG_DEBUG("Optional symbol '%s' is not available: %s", symbol,
+                  dlerror());
+  }
+  return address;
+#elif defined(_WIN32)
+  void *address = GetProcAddress(handle, symbol);
+  if (address == NULL) {
+    LCH_LOG_DEBUG("Optional symbol '%s' is not available: Error code %lu",
+                  symbol, GetLastError());
+  }
+  return address;
+#else
+  LCH_LOG_DEBUG("Optional symbol '%s' is not available", symbol);
+  return NULL;
+#endif
+}
+
 void LCH_ModuleDestroy(void *const handle) {
   if (handle == NULL) {
     return;
@@ -3,10 +3,31 @@
 
 #include <stdbool.h>
 
+#include "dict.h"
+
 void *LCH_ModuleLoad(const char *path);
 
+/**
+ * @brief Load a dynamic shared library unless it is already loaded
+ * @param modules Dictionary of loaded modules indexed by path
+ * @param path Path to the dynamic shared library
+ * @return The handle of the dynamic shared library or NULL in case of failure
+ * @note The handle is owned by the dictionary, and released with
+ *       LCH_ModuleDestroy() when the dictionary is destroyed
+ */
+void *LCH_ModuleLoadShared(LCH_Dict *modules, const char *path);
+
 void *LCH_ModuleGetSymbol(void *handle, const char *const symbol);
 
+/**
+ * @brief Get the address of a symbol that modules may choose not to implement
+ * @param handle The handle of the dynamic shared library
+ * @param symbol The name of the symbol
+ * @return The address of the symbol or NULL if it is not available
+ * @note Unlike LCH_ModuleGetSymbol(), a missing symbol is not an error.
+ */
+void *LCH_ModuleGetOptionalSymbol(void *handle, const char *const symbol);
+
 void LCH_ModuleDestroy(void *handle);
 
 #endif  // _LEECH_MODULE_H
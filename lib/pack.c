@@ -0,0 +1,988 @@
+#include "pack.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "definitions.h"
+#include "files.h"
+#include "logger.h"
+#include "metrics.h"
+#include "string_lib.h"
+
+/* A new segment is started once the last one grows beyond this size */
+#define MAX_SEGMENT_SIZE LCH_MEBIBYTE(16)
+
+#define BLOCK_ID_LENGTH (sizeof(LCH_GENISIS_BLOCK_ID) - 1)
+
+/* Record headers are "<block identifier> <length>\n", where the length is a
+ * zero-padded decimal number */
+#define LENGTH_DIGITS 20
+#define HEADER_SIZE (BLOCK_ID_LENGTH + 1 + LENGTH_DIGITS + 1)
+
+/* Segments are named after a zero-padded sequence number */
+#define SEGMENT_DIGITS 8
+#define SEGMENT_SUFFIX ".pack"
+#define SEGMENT_NAME_LENGTH (SEGMENT_DIGITS + sizeof(SEGMENT_SUFFIX) - 1)
+
+typedef struct {
+  char block_id[BLOCK_ID_LENGTH + 1];
+  size_t segment;  // Sequence number of the segment
+  size_t offset;   // Offset of the block, i.e., right after the header
+  size_t length;   // Length of the block
+} PackRecord;
+
+struct LCH_Pack {
+  char *packs_dir;
+  LCH_Dict *entries;    // Block identifier to record, NULL until loaded
+  LCH_FileStamp stamp;  // Stamp of the packs directory the entries reflect
+  size_t last_segment;  // Sequence number of the last segment, or 0 if none
+  size_t last_end;      // End of the last complete record in the last segment
+};
+
+LCH_Pack *LCH_PackCreate(const char *const work_dir) {
+  assert(work_dir != NULL);
+
+  char packs_dir[PATH_MAX];
+  if (!LCH_FilePathJoin(packs_dir, PATH_MAX, 2, work_dir, "packs")) {
+    return NULL;
+  }
+
+  LCH_Pack *const pack = (LCH_Pack *)malloc(sizeof(LCH_Pack));
+  if (pack == NULL) {
+    LCH_LOG_ERROR("Failed to allocate memory for pack: %s", strerror(errno));
+    return NULL;
+  }
+
+  pack->packs_dir = LCH_StringDuplicate(packs_dir);
+  if (pack->packs_dir == NULL) {
+    free(pack);
+    return NULL;
+  }
+  pack->entries = NULL;
+  memset(&pack->stamp, 0, sizeof(LCH_FileStamp));
+  pack->last_segment = 0;
+  pack->last_end = 0;
+
+  return pack;
+}
+
+void LCH_PackDestroy(void *const _pack) {
+  LCH_Pack *const pack = (LCH_Pack *)_pack;
+  if (pack != NULL) {
+    LCH_DictDestroy(pack->entries);
+    free(pack->packs_dir);
+    free(pack);
+  }
+}
+
+static bool SegmentPath(const LCH_Pack *const pack, char *const path,
+                        const size_t path_max, const size_t segment) {
+  char filename[SEGMENT_NAME_LENGTH + 1];
+  const int ret = snprintf(filename, sizeof(filename), "%0*zu" SEGMENT_SUFFIX,
+                           SEGMENT_DIGITS, segment);
+  if (ret < 0 || (size_t)ret >= sizeof(filename)) {
+    LCH_LOG_ERROR("Segment sequence number %zu is out of range", segment);
+    return false;
+  }
+  return LCH_FilePathJoin(path, path_max, 2, pack->packs_dir, filename);
+}
+
+static bool ParseSegmentName(const char *const filename,
+                             size_t *const segment) {
+  if (strlen(filename) != SEGMENT_NAME_LENGTH ||
+      !LCH_StringEqual(filename + SEGMENT_DIGITS, SEGMENT_SUFFIX)) {
+    return false;
+  }
+
+  size_t value = 0;
+  for (size_t i = 0; i < SEGMENT_DIGITS; i++) {
+    if (filename[i] < '0' || filename[i] > '9') {
+      return false;
+    }
+    value = (value * 10) + (size_t)(filename[i] - '0');
+  }
+
+  *segment = value;
+  return value > 0;
+}
+
+static int CompareFilenames(const void *const left, const void *const right) {
+  return strcmp((const char *)left, (const char *)right);
+}
+
+/**
+ * List the file names of the segments ordered by their sequence number. Any
+ * other files (e.g., left behind by an interrupted LCH_PackRetain()) are
+ * ignored.
+ */
+static LCH_List *ListSegments(const LCH_Pack *const pack) {
+  if (!LCH_FileIsDirectory(pack->packs_dir)) {
+    return LCH_ListCreate();
+  }
+
+  LCH_List *const filenames = LCH_FileListDirectory(pack->packs_dir, true);
+  if (filenames == NULL) {
+    LCH_LOG_ERROR("Failed to list directory '%s'", pack->packs_dir);
+    return NULL;
+  }
+
+  for (size_t i = LCH_ListLength(filenames); i > 0; i--) {
+    const char *const filename = (char *)LCH_ListGet(filenames, i - 1);
+    size_t segment;
+    if (!ParseSegmentName(filename, &segment)) {
+      LCH_LOG_DEBUG("Ignoring file '%s%c%s'", pack->packs_dir, LCH_PATH_SEP,
+                    filename);
+      free(LCH_ListRemove(filenames, i - 1));
+    }
+  }
+
+  /* The sequence numbers are zero-padded, hence they sort lexicographically */
+  LCH_ListSort(filenames, CompareFilenames);
+  return filenames;
+}
+
+static bool ParseHeader(const char *const header, char *const block_id,
+                        size_t *const length) {
+  for (size_t i = 0; i < BLOCK_ID_LENGTH; i++) {
+    if (!(header[i] >= '0' && header[i] <= '9') &&
+        !(header[i] >= 'a' && header[i] <= 'f')) {
+      return false;
+    }
+  }
+
+  if (header[BLOCK_ID_LENGTH] != ' ' || header[HEADER_SIZE - 1] != '\n') {
+    return false;
+  }
+
+  size_t value = 0;
+  for (size_t i = BLOCK_ID_LENGTH + 1; i < HEADER_SIZE - 1; i++) {
+    if (header[i] < '0' || header[i] > '9') {
+      return false;
+    }
+    const size_t digit = (size_t)(header[i] - '0');
+    if (value > (SIZE_MAX - digit) / 10) {
+      return false;
+    }
+    value = (value * 10) + digit;
+  }
+
+  memcpy(block_id, header, BLOCK_ID_LENGTH);
+  block_id[BLOCK_ID_LENGTH] = '\0';
+  *length = value;
+  return true;
+}
+
+/**
+ * Read until count bytes are read or End-of-File is reached.
+ */
+static bool ReadAt(const int fd, const char *const path, char *const buf,
+                   const size_t count, const size_t offset,
+                   size_t *const num_read) {
+  size_t total = 0;
+  while (total < count) {
+    const ssize_t n = pread(fd, buf + total, count - total,
+                            (off_t)(offset + total));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LCH_LOG_ERROR("Failed to read from file '%s': %s", path,
+                    strerror(errno));
+      return false;
+    }
+    if (n == 0) {
+      break;
+    }
+    total += (size_t)n;
+  }
+
+  LCH_MetricsCountBytesRead(total);
+  *num_read = total;
+  return true;
+}
+
+static bool WriteAt(const int fd, const char *const path,
+                    const char *const buf, const size_t count,
+                    const size_t offset) {
+  size_t total = 0;
+  while (total < count) {
+    const ssize_t n = pwrite(fd, buf + total, count - total,
+                             (off_t)(offset + total));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LCH_LOG_ERROR("Failed to write to file '%s': %s", path,
+                    strerror(errno));
+      return false;
+    }
+    total += (size_t)n;
+  }
+
+  LCH_MetricsCountBytesWritten(total);
+  return true;
+}
+
+static bool WriteRecord(const int fd, const char *const path,
+                        const size_t offset, const char *const block_id,
+                        const char *const data, const size_t length) {
+  char header[HEADER_SIZE + 1];
+  const int ret LCH_NDEBUG_UNUSED = snprintf(
+      header, sizeof(header), "%s %0*zu\n", block_id, LENGTH_DIGITS, length);
+  assert(ret == (int)HEADER_SIZE);
+
+  return WriteAt(fd, path, header, HEADER_SIZE, offset) &&
+         WriteAt(fd, path, data, length, offset + HEADER_SIZE);
+}
+
+typedef bool (*VisitRecordFn)(const PackRecord *record, void *data);
+
+/**
+ * Call the visit function on each complete record of a segment, starting at
+ * the given offset. The end of the last complete record is stored in the end
+ * variable. Anything past it is an incomplete record, e.g., one that is being
+ * appended by another process.
+ */
+static bool ScanSegment(const LCH_Pack *const pack, const size_t segment,
+                        size_t offset, const VisitRecordFn visit,
+                        void *const data, size_t *const end) {
+  char path[PATH_MAX];
+  if (!SegmentPath(pack, path, PATH_MAX, segment)) {
+    return false;
+  }
+
+  const int fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    LCH_LOG_ERROR("Failed to open file '%s' for reading: %s", path,
+                  strerror(errno));
+    return false;
+  }
+
+  struct stat sb;
+  if (fstat(fd, &sb) != 0) {
+    LCH_LOG_ERROR("Failed to get status of file '%s': %s", path,
+                  strerror(errno));
+    close(fd);
+    return false;
+  }
+  const size_t size = (size_t)sb.st_size;
+
+  while (offset < size && size - offset >= HEADER_SIZE) {
+    char header[HEADER_SIZE];
+    size_t num_read;
+    if (!ReadAt(fd, path, header, HEADER_SIZE, offset, &num_read)) {
+      close(fd);
+      return false;
+    }
+
+    PackRecord record;
+    if (num_read < HEADER_SIZE ||
+        !ParseHeader(header, record.block_id, &record.length)) {
+      break;
+    }
+    record.segment = segment;
+    record.offset = offset + HEADER_SIZE;
+    if (record.length > size - record.offset) {
+      break;
+    }
+
+    if (!visit(&record, data)) {
+      close(fd);
+      return false;
+    }
+    offset = record.offset + record.length;
+  }
+  close(fd);
+
+  if (offset < size) {
+    LCH_LOG_DEBUG("Ignoring incomplete record at offset %zu in file '%s'",
+                  offset, path);
+  }
+  *end = offset;
+  return true;
+}
+
+static PackRecord *DuplicateRecord(const PackRecord *const record) {
+  PackRecord *const duplicate = (PackRecord *)malloc(sizeof(PackRecord));
+  if (duplicate == NULL) {
+    LCH_LOG_ERROR("Failed to allocate memory: %s", strerror(errno));
+    return NULL;
+  }
+  memcpy(duplicate, record, sizeof(PackRecord));
+  return duplicate;
+}
+
+static bool IndexRecord(const PackRecord *const record, void *const data) {
+  LCH_Dict *const entries = (LCH_Dict *)data;
+
+  PackRecord *const entry = DuplicateRecord(record);
+  if (entry == NULL) {
+    return false;
+  }
+
+  const LCH_Buffer key = LCH_BufferStaticFromString(entry->block_id);
+  if (!LCH_DictSet(entries, &key, entry, free)) {
+    free(entry);
+    return false;
+  }
+  return true;
+}
+
+static bool CollectRecord(const PackRecord *const record, void *const data) {
+  LCH_List *const records = (LCH_List *)data;
+
+  PackRecord *const duplicate = DuplicateRecord(record);
+  if (duplicate == NULL) {
+    return false;
+  }
+
+  if (!LCH_ListAppend(records, duplicate, free)) {
+    free(duplicate);
+    return false;
+  }
+  return true;
+}
+
+static void Invalidate(LCH_Pack *const pack) {
+  LCH_DictDestroy(pack->entries);
+  pack->entries = NULL;
+}
+
+/**
+ * Update the stamp after the process itself has added or removed segments.
+ * In case of failure, the entries are dropped and loaded on the next lookup.
+ */
+static void UpdateStamp(LCH_Pack *const pack) {
+  if (!LCH_FileGetStamp(pack->packs_dir, &pack->stamp)) {
+    Invalidate(pack);
+  }
+}
+
+static bool Load(LCH_Pack *const pack) {
+  Invalidate(pack);
+
+  /* The stamp is obtained before listing the directory, such that segments
+   * added or removed in between cause another load on the next refresh */
+  if (!LCH_FileGetStamp(pack->packs_dir, &pack->stamp)) {
+    return false;
+  }
+
+  LCH_List *const filenames = ListSegments(pack);
+  if (filenames == NULL) {
+    return false;
+  }
+
+  LCH_Dict *const entries = LCH_DictCreate();
+  if (entries == NULL) {
+    LCH_ListDestroy(filenames);
+    return false;
+  }
+
+  size_t last_segment = 0;
+  size_t last_end = 0;
+  const size_t num_segments = LCH_ListLength(filenames);
+  for (size_t i = 0; i < num_segments; i++) {
+    const char *const filename = (char *)LCH_ListGet(filenames, i);
+    if (!ParseSegmentName(filename, &last_segment) ||
+        !ScanSegment(pack, last_segment, 0, IndexRecord, entries, &last_end)) {
+      LCH_DictDestroy(entries);
+      LCH_ListDestroy(filenames);
+      return false;
+    }
+  }
+  LCH_ListDestroy(filenames);
+
+  pack->entries = entries;
+  pack->last_segment = last_segment;
+  pack->last_end = last_end;
+  LCH_LOG_DEBUG("Indexed %zu packed blocks in %zu segments in '%s'",
+                LCH_DictLength(entries), num_segments, pack->packs_dir);
+  return true;
+}
+
+/**
+ * Pick up changes made by other processes. Segments other than the last one
+ * are never appended to, so unless segments were added or removed, only the
+ * records past the end of the last one need to be read.
+ */
+static bool Refresh(LCH_Pack *const pack) {
+  LCH_FileStamp stamp;
+  if (!LCH_FileGetStamp(pack->packs_dir, &stamp)) {
+    return false;
+  }
+
+  if (pack->entries == NULL || !LCH_FileStampEqual(&stamp, &pack->stamp)) {
+    return Load(pack);
+  }
+
+  if (pack->last_segment == 0) {
+    return true;
+  }
+
+  return ScanSegment(pack, pack->last_segment, pack->last_end, IndexRecord,
+                     pack->entries, &pack->last_end);
+}
+
+static bool Lookup(LCH_Pack *const pack, const char *const block_id,
+                   const PackRecord **const record) {
+  if (pack->entries == NULL && !Load(pack)) {
+    return false;
+  }
+
+  const LCH_Buffer key = LCH_BufferStaticFromString(block_id);
+  if (!LCH_DictHasKey(pack->entries, &key)) {
+    if (!Refresh(pack)) {
+      return false;
+    }
+    if (!LCH_DictHasKey(pack->entries, &key)) {
+      *record = NULL;
+      return true;
+    }
+  }
+
+  *record = (const PackRecord *)LCH_DictGet(pack->entries, &key);
+  return true;
+}
+
+/**
+ * Read the block of a record. The record is stale if the segment was removed
+ * or rewritten since the entries were loaded, in which case no buffer is
+ * returned.
+ */
+static bool ReadRecord(const LCH_Pack *const pack,
+                       const PackRecord *const record,
+                       LCH_Buffer **const buffer, bool *const stale) {
+  *buffer = NULL;
+  *stale = false;
+
+  char path[PATH_MAX];
+  if (!SegmentPath(pack, path, PATH_MAX, record->segment)) {
+    return false;
+  }
+
+  const int fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    if (errno == ENOENT) {
+      *stale = true;
+      return true;
+    }
+    LCH_LOG_ERROR("Failed to open file '%s' for reading: %s", path,
+                  strerror(errno));
+    return false;
+  }
+
+  char header[HEADER_SIZE];
+  size_t num_read;
+  if (!ReadAt(fd, path, header, HEADER_SIZE, record->offset - HEADER_SIZE,
+              &num_read)) {
+    close(fd);
+    return false;
+  }
+
+  char block_id[BLOCK_ID_LENGTH + 1];
+  size_t length;
+  if (num_read < HEADER_SIZE || !ParseHeader(header, block_id, &length) ||
+      !LCH_StringEqual(block_id, record->block_id) ||
+      length != record->length) {
+    close(fd);
+    *stale = true;
+    return true;
+  }
+
+  LCH_Buffer *const data = LCH_BufferCreate();
+  if (data == NULL) {
+    close(fd);
+    return false;
+  }
+
+  size_t offset;
+  if (!LCH_BufferAllocate(data, length, &offset)) {
+    LCH_BufferDestroy(data);
+    close(fd);
+    return false;
+  }
+
+  if (!ReadAt(fd, path, data->buffer + offset, length, record->offset,
+              &num_read)) {
+    LCH_BufferDestroy(data);
+    close(fd);
+    return false;
+  }
+  close(fd);
+
+  if (num_read < length) {
+    LCH_BufferDestroy(data);
+    *stale = true;
+    return true;
+  }
+
+  *buffer = data;
+  return true;
+}
+
+bool LCH_PackContains(LCH_Pack *const pack, const char *const block_id,
+                      bool *const found) {
+  assert(pack != NULL);
+  assert(block_id != NULL);
+  assert(found != NULL);
+
+  const PackRecord *record;
+  if (!Lookup(pack, block_id, &record)) {
+    return false;
+  }
+
+  *found = (record != NULL);
+  return true;
+}
+
+bool LCH_PackRead(LCH_Pack *const pack, const char *const block_id,
+                  LCH_Buffer **const buffer) {
+  assert(pack != NULL);
+  assert(block_id != NULL);
+  assert(buffer != NULL);
+
+  /* A stale record means that another process rewrote the segment while
+   * deleting blocks, in which case we reload and try once more */
+  for (int attempt = 0; attempt < 2; attempt++) {
+    const PackRecord *record;
+    if (!Lookup(pack, block_id, &record)) {
+      return false;
+    }
+
+    if (record == NULL) {
+      *buffer = NULL;
+      return true;
+    }
+
+    bool stale;
+    if (!ReadRecord(pack, record, buffer, &stale)) {
+      return false;
+    }
+    if (!stale) {
+      LCH_LOG_DEBUG("Read packed block %.7s from segment %zu at offset %zu",
+                    block_id, record->segment, record->offset);
+      return true;
+    }
+
+    if (!Load(pack)) {
+      return false;
+    }
+  }
+
+  LCH_LOG_ERROR("Failed to read packed block with identifier %.7s", block_id);
+  return false;
+}
+
+bool LCH_PackAppend(LCH_Pack *const pack, const char *const block_id,
+                    const LCH_Buffer *const buffer) {
+  assert(pack != NULL);
+  assert(block_id != NULL);
+  assert(strlen(block_id) == BLOCK_ID_LENGTH);
+  assert(buffer != NULL);
+
+  /* A lookup that misses reads any records appended since, hence we also
+   * know where the last segment ends */
+  const PackRecord *existing;
+  if (!Lookup(pack, block_id, &existing)) {
+    return false;
+  }
+  if (existing != NULL) {
+    LCH_LOG_DEBUG("Block %.7s is already packed", block_id);
+    return true;
+  }
+
+  char path[PATH_MAX];
+  size_t segment = pack->last_segment;
+  size_t offset = pack->last_end;
+  int fd = -1;
+
+  if (segment > 0 && offset < MAX_SEGMENT_SIZE) {
+    if (!SegmentPath(pack, path, PATH_MAX, segment)) {
+      return false;
+    }
+
+    fd = open(path, O_WRONLY);
+    if (fd == -1) {
+      LCH_LOG_ERROR("Failed to open file '%s' for writing: %s", path,
+                    strerror(errno));
+      return false;
+    }
+
+    struct stat sb;
+    if (fstat(fd, &sb) != 0) {
+      LCH_LOG_ERROR("Failed to get status of file '%s': %s", path,
+                    strerror(errno));
+      close(fd);
+      return false;
+    }
+
+    /* Never append after an incomplete record, as it would hide the records
+     * that follow */
+    if ((size_t)sb.st_size != offset) {
+      LCH_LOG_WARNING(
+          "File '%s' ends with an incomplete record; starting a new segment",
+          path);
+      close(fd);
+      fd = -1;
+    }
+  }
+
+  if (fd == -1) {
+    segment += 1;
+    offset = 0;
+    if (!SegmentPath(pack, path, PATH_MAX, segment) ||
+        !LCH_FileCreateParentDirectories(path)) {
+      return false;
+    }
+
+    fd = open(path, O_WRONLY | O_CREAT | O_EXCL, (mode_t)0600);
+    if (fd == -1) {
+      LCH_LOG_ERROR("Failed to create file '%s': %s", path, strerror(errno));
+      return false;
+    }
+  }
+
+  const size_t length = LCH_BufferLength(buffer);
+  if (!WriteRecord(fd, path, offset, block_id, LCH_BufferData(buffer),
+                   length)) {
+    close(fd);
+    return false;
+  }
+  close(fd);
+
+  PackRecord record;
+  strcpy(record.block_id, block_id);
+  record.segment = segment;
+  record.offset = offset + HEADER_SIZE;
+  record.length = length;
+
+  pack->last_segment = segment;
+  pack->last_end = record.offset + length;
+  if (offset == 0) {
+    UpdateStamp(pack);
+  }
+  if (pack->entries != NULL && !IndexRecord(&record, pack->entries)) {
+    Invalidate(pack);
+  }
+
+  LCH_LOG_DEBUG("Appended block %.7s to '%s' at offset %zu", block_id, path,
+                offset);
+  return true;
+}
+
+LCH_List *LCH_PackList(LCH_Pack *const pack) {
+  assert(pack != NULL);
+
+  if (!Refresh(pack)) {
+    return NULL;
+  }
+
+  LCH_List *const keys = LCH_DictGetKeys(pack->entries);
+  if (keys == NULL) {
+    return NULL;
+  }
+
+  LCH_List *const block_ids = LCH_ListCreate();
+  if (block_ids == NULL) {
+    LCH_ListDestroy(keys);
+    return NULL;
+  }
+
+  const size_t num_keys = LCH_ListLength(keys);
+  for (size_t i = 0; i < num_keys; i++) {
+    const LCH_Buffer *const key = (LCH_Buffer *)LCH_ListGet(keys, i);
+    char *const block_id = LCH_StringDuplicate(LCH_BufferData(key));
+    if (block_id == NULL) {
+      LCH_ListDestroy(block_ids);
+      LCH_ListDestroy(keys);
+      return NULL;
+    }
+
+    if (!LCH_ListAppend(block_ids, block_id, free)) {
+      free(block_id);
+      LCH_ListDestroy(block_ids);
+      LCH_ListDestroy(keys);
+      return NULL;
+    }
+  }
+
+  LCH_ListDestroy(keys);
+  return block_ids;
+}
+
+/**
+ * Determine whether a segment is obsolete, i.e., whether it has any blocks
+ * that are not whitelisted, or that are already kept in a previous segment.
+ * The whitelisted blocks of obsolete segments are appended to the list of
+ * records to move.
+ */
+static bool ClassifySegment(const LCH_Pack *const pack, const size_t segment,
+                            const LCH_Dict *const whitelist,
+                            LCH_Dict *const kept, LCH_List *const moved,
+                            bool *const obsolete) {
+  LCH_List *const records = LCH_ListCreate();
+  if (records == NULL) {
+    return false;
+  }
+
+  size_t end;
+  if (!ScanSegment(pack, segment, 0, CollectRecord, records, &end)) {
+    LCH_ListDestroy(records);
+    return false;
+  }
+
+  size_t num_live = 0;
+  const size_t num_records = LCH_ListLength(records);
+  for (size_t i = 0; i < num_records; i++) {
+    const PackRecord *const record =
+        (const PackRecord *)LCH_ListGet(records, i);
+    const LCH_Buffer key = LCH_BufferStaticFromString(record->block_id);
+    if (LCH_DictHasKey(whitelist, &key) && !LCH_DictHasKey(kept, &key)) {
+      num_live += 1;
+    }
+  }
+  *obsolete = (num_live < num_records);
+
+  for (size_t i = 0; i < num_records; i++) {
+    const PackRecord *const record =
+        (const PackRecord *)LCH_ListGet(records, i);
+    const LCH_Buffer key = LCH_BufferStaticFromString(record->block_id);
+    if (!LCH_DictHasKey(whitelist, &key) || LCH_DictHasKey(kept, &key)) {
+      continue;
+    }
+
+    if (!LCH_DictSet(kept, &key, NULL, NULL)) {
+      LCH_ListDestroy(records);
+      return false;
+    }
+
+    if (*obsolete && !CollectRecord(record, moved)) {
+      LCH_ListDestroy(records);
+      return false;
+    }
+  }
+
+  LCH_ListDestroy(records);
+  return true;
+}
+
+/**
+ * Move a segment written to a temporary file into place.
+ */
+static bool SealSegment(const int fd, const char *const tmp_path,
+                        const char *const path) {
+  close(fd);
+  if (rename(tmp_path, path) != 0) {
+    LCH_LOG_ERROR("Failed to move file '%s' to '%s': %s", tmp_path, path,
+                  strerror(errno));
+    unlink(tmp_path);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Copy records to new segments following the last one. Each segment is
+ * written to a temporary file first, such that other processes never see it
+ * incomplete.
+ */
+static bool WriteSegments(const LCH_Pack *const pack,
+                          const LCH_List *const records,
+                          size_t *const num_written) {
+  char path[PATH_MAX];
+  char tmp_path[PATH_MAX];
+  size_t segment = pack->last_segment;
+  size_t offset = 0;
+  int fd = -1;
+  *num_written = 0;
+
+  const size_t num_records = LCH_ListLength(records);
+  for (size_t i = 0; i < num_records; i++) {
+    const PackRecord *const record =
+        (const PackRecord *)LCH_ListGet(records, i);
+
+    if (fd == -1) {
+      segment += 1;
+      offset = 0;
+      if (!SegmentPath(pack, path, PATH_MAX, segment)) {
+        return false;
+      }
+
+      const int ret = snprintf(tmp_path, PATH_MAX, "%s.tmp", path);
+      if (ret < 0 || (size_t)ret >= PATH_MAX) {
+        LCH_LOG_ERROR("Failed to create temporary file path: Path too long");
+        return false;
+      }
+
+      fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, (mode_t)0600);
+      if (fd == -1) {
+        LCH_LOG_ERROR("Failed to create file '%s': %s", tmp_path,
+                      strerror(errno));
+        return false;
+      }
+      *num_written += 1;
+    }
+
+    LCH_Buffer *buffer;
+    bool stale;
+    if (!ReadRecord(pack, record, &buffer, &stale) || stale) {
+      if (stale) {
+        LCH_LOG_ERROR("Block %.7s was moved by another process",
+                      record->block_id);
+      }
+      close(fd);
+      unlink(tmp_path);
+      return false;
+    }
+
+    if (!WriteRecord(fd, tmp_path, offset, record->block_id,
+                     LCH_BufferData(buffer), record->length)) {
+      LCH_BufferDestroy(buffer);
+      close(fd);
+      unlink(tmp_path);
+      return false;
+    }
+    LCH_BufferDestroy(buffer);
+    offset += HEADER_SIZE + record->length;
+
+    if (offset >= MAX_SEGMENT_SIZE) {
+      if (!SealSegment(fd, tmp_path, path)) {
+        return false;
+      }
+      fd = -1;
+    }
+  }
+
+  if (fd != -1 && !SealSegment(fd, tmp_path, path)) {
+    return false;
+  }
+  return true;
+}
+
+bool LCH_PackRetain(LCH_Pack *const pack, const LCH_Dict *const whitelist) {
+  assert(pack != NULL);
+  assert(whitelist != NULL);
+
+  if (!Load(pack)) {
+    return false;
+  }
+
+  LCH_List *const filenames = ListSegments(pack);
+  if (filenames == NULL) {
+    return false;
+  }
+
+  LCH_Dict *const kept = LCH_DictCreate();
+  if (kept == NULL) {
+    LCH_ListDestroy(filenames);
+    return false;
+  }
+
+  LCH_List *const moved = LCH_ListCreate();
+  if (moved == NULL) {
+    LCH_DictDestroy(kept);
+    LCH_ListDestroy(filenames);
+    return false;
+  }
+
+  /* Obsolete segments are deleted from the list of file names, such that
+   * only those that are kept as is remain */
+  LCH_List *const obsolete = LCH_ListCreate();
+  if (obsolete == NULL) {
+    LCH_ListDestroy(moved);
+    LCH_DictDestroy(kept);
+    LCH_ListDestroy(filenames);
+    return false;
+  }
+
+  const size_t num_segments = LCH_ListLength(filenames);
+  for (size_t i = 0; i < num_segments; i++) {
+    char *const filename = (char *)LCH_ListGet(filenames, i);
+    size_t segment;
+    bool is_obsolete;
+    if (!ParseSegmentName(filename, &segment) ||
+        !ClassifySegment(pack, segment, whitelist, kept, moved,
+                         &is_obsolete)) {
+      LCH_ListDestroy(obsolete);
+      LCH_ListDestroy(moved);
+      LCH_DictDestroy(kept);
+      LCH_ListDestroy(filenames);
+      return false;
+    }
+
+    if (is_obsolete) {
+      char path[PATH_MAX];
+      if (!LCH_FilePathJoin(path, PATH_MAX, 2, pack->packs_dir, filename)) {
+        LCH_ListDestroy(obsolete);
+        LCH_ListDestroy(moved);
+        LCH_DictDestroy(kept);
+        LCH_ListDestroy(filenames);
+        return false;
+      }
+
+      char *const duplicate = LCH_StringDuplicate(path);
+      if (duplicate == NULL) {
+        LCH_ListDestroy(obsolete);
+        LCH_ListDestroy(moved);
+        LCH_DictDestroy(kept);
+        LCH_ListDestroy(filenames);
+        return false;
+      }
+
+      if (!LCH_ListAppend(obsolete, duplicate, free)) {
+        free(duplicate);
+        LCH_ListDestroy(obsolete);
+        LCH_ListDestroy(moved);
+        LCH_DictDestroy(kept);
+        LCH_ListDestroy(filenames);
+        return false;
+      }
+    }
+  }
+  LCH_DictDestroy(kept);
+  LCH_ListDestroy(filenames);
+
+  const size_t num_obsolete = LCH_ListLength(obsolete);
+  if (num_obsolete == 0) {
+    LCH_LOG_DEBUG("No segments in '%s' need to be rewritten",
+                  pack->packs_dir);
+    LCH_ListDestroy(obsolete);
+    LCH_ListDestroy(moved);
+    return true;
+  }
+
+  /* The blocks that are kept are written to new segments before the old ones
+   * are deleted, hence they remain readable throughout */
+  size_t num_written;
+  if (!WriteSegments(pack, moved, &num_written)) {
+    LCH_ListDestroy(obsolete);
+    LCH_ListDestroy(moved);
+    return false;
+  }
+
+  for (size_t i = 0; i < num_obsolete; i++) {
+    const char *const path = (char *)LCH_ListGet(obsolete, i);
+    if (!LCH_FileDelete(path)) {
+      LCH_ListDestroy(obsolete);
+      LCH_ListDestroy(moved);
+      Invalidate(pack);
+      return false;
+    }
+  }
+
+  LCH_LOG_VERBOSE("Rewrote %zu segments into %zu, keeping %zu blocks",
+                  num_obsolete, num_written, LCH_ListLength(moved));
+  LCH_ListDestroy(obsolete);
+  LCH_ListDestroy(moved);
+  Invalidate(pack);
+  return true;
+}
@@ -0,0 +1,90 @@
+#ifndef _LEECH_PACK_H
+#define _LEECH_PACK_H
+
+#include <stdbool.h>
+
+#include "dict.h"
+#include "leech.h"
+
+/**
+ * Packed blocks are appended to segment files in the packs directory (i.e.,
+ * packs/00000001.pack, packs/00000002.pack, ...), rather than being stored in
+ * a file each. Each record in a segment consists of a fixed size header with
+ * the block identifier and the length of the block, followed by the block
+ * itself. Only the last segment is appended to, and a new segment is started
+ * once it grows beyond a size limit.
+ *
+ * The index mapping block identifiers to their segment, offset and length is
+ * built from the record headers on first lookup. A lookup that misses picks
+ * up records appended by other processes in the meantime, and the index is
+ * rebuilt if segments are added or removed. Deleting blocks rewrites the
+ * segments containing them.
+ */
+typedef struct LCH_Pack LCH_Pack;
+
+/**
+ * @brief Create an (empty) pack
+ * @param work_dir Leech work directory
+ * @return The pack or NULL in case of failure
+ * @note The segments are not read until the first lookup
+ */
+LCH_Pack *LCH_PackCreate(const char *work_dir);
+
+/**
+ * @brief Destroy a pack
+ * @param pack The pack
+ */
+void LCH_PackDestroy(void *pack);
+
+/**
+ * @brief Check whether a block is packed
+ * @param pack The pack
+ * @param block_id The block identifier
+ * @param found The variable in which to store whether the block is packed
+ * @return False in case of failure
+ */
+bool LCH_PackContains(LCH_Pack *pack, const char *block_id, bool *found);
+
+/**
+ * @brief Read a packed block
+ * @param pack The pack
+ * @param block_id The block identifier
+ * @param buffer The variable in which to store the block as it was appended,
+ *               or NULL if the block is not packed
+ * @return False in case of failure
+ */
+bool LCH_PackRead(LCH_Pack *pack, const char *block_id, LCH_Buffer **buffer);
+
+/**
+ * @brief Append a block to the last segment
+ * @param pack The pack
+ * @param block_id The block identifier
+ * @param buffer The block
+ * @return False in case of failure
+ * @note Appending a block that is already packed does nothing
+ */
+bool LCH_PackAppend(LCH_Pack *pack, const char *block_id,
+                    const LCH_Buffer *buffer);
+
+/**
+ * @brief List the identifiers of all packed blocks
+ * @param pack The pack
+ * @return List of block identifiers in no particular order, or NULL in case
+ *         of failure
+ */
+LCH_List *LCH_PackList(LCH_Pack *pack);
+
+/**
+ * @brief Delete all packed blocks that are not whitelisted
+ * @param pack The pack
+ * @param whitelist Dictionary with the identifiers of the blocks to keep as
+ *                  keys
+ * @return False in case of failure
+ * @note Segments without any whitelisted blocks are deleted. Segments with
+ *       some are rewritten, by copying the whitelisted blocks to new segments
+ *       before deleting the old ones. Hence, blocks that are kept can be read
+ *       by other processes at any time.
+ */
+bool LCH_PackRetain(LCH_Pack *pack, const LCH_Dict *whitelist);
+
+#endif  // _LEECH_PACK_H
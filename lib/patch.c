@@ -4,6 +4,7 @@
 #include <time.h>
 
 #include "definitions.h"
+#include "encoding.h"
 #include "files.h"
 #include "head.h"
 #include "logger.h"
@@ -25,7 +26,8 @@ bool LCH_PatchGetVersion(const LCH_Json *const patch, size_t *const version) {
 
 LCH_Json *LCH_PatchParse(const char *const raw_buffer,
                          const size_t raw_length) {
-  LCH_Json *const patch = LCH_JsonParse(raw_buffer, raw_length);
+  /* Records are only applied, so there is no need to compose them into CSV */
+  LCH_Json *const patch = LCH_EncodingParseFields(raw_buffer, raw_length);
   if (patch == NULL) {
     return NULL;
   }
@@ -46,14 +48,19 @@ LCH_Json *LCH_PatchParse(const char *const raw_buffer,
   return patch;
 }
 
-LCH_Json *LCH_PatchCreate(const char *const lastknown) {
+LCH_Json *LCH_PatchCreate(const char *const lastknown,
+                          const LCH_Encoding encoding) {
   LCH_Json *const patch = LCH_JsonObjectCreate();
   if (patch == NULL) {
     return NULL;
   }
 
   {
-    LCH_Json *const value = LCH_JsonNumberCreate((double)LCH_PATCH_VERSION);
+    /* Only binary encoded patches need a version older peers reject */
+    const size_t version = (encoding == LCH_ENCODING_BINARY)
+                               ? LCH_PATCH_VERSION
+                               : LCH_PATCH_VERSION_JSON;
+    LCH_Json *const value = LCH_JsonNumberCreate((double)version);
     if (value == NULL) {
       LCH_JsonDestroy(patch);
       return NULL;
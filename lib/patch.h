@@ -3,13 +3,14 @@
 
 #include <stdbool.h>
 
+#include "encoding.h"
 #include "json.h"
 
 bool LCH_PatchGetVersion(const LCH_Json *patch, size_t *version);
 
 LCH_Json *LCH_PatchParse(const char *raw_buffer, size_t raw_length);
 
-LCH_Json *LCH_PatchCreate(const char *lastseen);
+LCH_Json *LCH_PatchCreate(const char *lastseen, LCH_Encoding encoding);
 
 bool LCH_PatchAppendBlock(const LCH_Json *patch, LCH_Json *block);
 
@@ -2,17 +2,30 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include "columnar.h"
+#include "compression.h"
 #include "csv.h"
+#include "definitions.h"
+#include "delta.h"
+#include "dict.h"
 #include "files.h"
 #include "list.h"
 #include "logger.h"
+#include "metrics.h"
 #include "module.h"
 #include "string_lib.h"
 #include "utils.h"
 
+#define LCH_FINGERPRINT_SUFFIX ".fingerprint"
+#define LCH_SNAPSHOT_LOG_SUFFIX ".log"
+
 typedef void *(*LCH_CallbackConnect)(const char *conn_info);
 typedef void (*LCH_CallbackDisconnect)(void *conn);
 typedef bool (*LCH_CallbackCreateTable)(void *conn, const char *table_name,
@@ -23,6 +36,10 @@ typedef bool (*LCH_CallbackTruncateTable)(void *conn, const char *table_name,
                                           const char *const value);
 typedef LCH_List *(*LCH_CallbackGetTable)(void *conn, const char *table_name,
                                           const LCH_List *columns);
+typedef LCH_Table *(*LCH_CallbackLoadTable)(void *conn, const char *table_name,
+                                            const LCH_List *columns);
+typedef LCH_Buffer *(*LCH_CallbackGetFingerprint)(void *conn,
+                                                  const char *table_name);
 typedef bool (*LCH_CallbackBeginTransaction)(void *conn);
 typedef bool (*LCH_CallbackCommitTransaction)(void *conn);
 typedef bool (*LCH_CallbackRollbackTransaction)(void *conn);
@@ -38,38 +55,53 @@ typedef bool (*LCH_CallbackUpdateRecord)(void *conn, const char *table_name,
                                          const LCH_List *subsidiary_columns,
                                          const LCH_List *subsidiary_values);
 
+/* Callbacks of the source module. They are resolved on first use, such that
+ * modules are only loaded for the tables that are actually used. */
+typedef struct {
+  char *path;
+  bool resolved;
+  LCH_CallbackConnect connect;
+  LCH_CallbackDisconnect disconnect;
+  LCH_CallbackCreateTable create_table;
+  LCH_CallbackGetTable get_table;              // Required unless load_table
+  LCH_CallbackLoadTable load_table;            // Optional
+  LCH_CallbackGetFingerprint get_fingerprint;  // Optional
+} SourceCallbacks;
+
+/* Callbacks of the destination module, also resolved on first use */
+typedef struct {
+  char *path;
+  bool resolved;
+  LCH_CallbackConnect connect;
+  LCH_CallbackDisconnect disconnect;
+  LCH_CallbackCreateTable create_table;
+  LCH_CallbackTruncateTable truncate_table;
+  LCH_CallbackBeginTransaction begin_tx;
+  LCH_CallbackCommitTransaction commit_tx;
+  LCH_CallbackRollbackTransaction rollback_tx;
+  LCH_CallbackInsertRecord insert_record;
+  LCH_CallbackDeleteRecord delete_record;
+  LCH_CallbackUpdateRecord update_record;
+} DestinationCallbacks;
+
 struct LCH_TableInfo {
   char *identifier;
   LCH_List *all_fields;
   LCH_List *primary_fields;
   LCH_List *subsidiary_fields;
   bool merge_blocks;
+  bool partial_updates;
+  LCH_Dict *modules;  // Module handles shared with other tables
 
-  void *src_dlib_handle;
   char *src_params;
   char *src_schema;
   char *src_table_name;
+  SourceCallbacks *src;
 
-  void *dst_dlib_handle;
   char *dst_params;
   char *dst_schema;
   char *dst_table_name;
-
-  LCH_CallbackConnect src_connect;
-  LCH_CallbackDisconnect src_disconnect;
-  LCH_CallbackCreateTable src_create_table;
-  LCH_CallbackGetTable src_get_table;
-
-  LCH_CallbackConnect dst_connect;
-  LCH_CallbackDisconnect dst_disconnect;
-  LCH_CallbackCreateTable dst_create_table;
-  LCH_CallbackTruncateTable dst_truncate_table;
-  LCH_CallbackBeginTransaction dst_begin_tx;
-  LCH_CallbackCommitTransaction dst_commit_tx;
-  LCH_CallbackRollbackTransaction dst_rollback_tx;
-  LCH_CallbackInsertRecord dst_insert_record;
-  LCH_CallbackDeleteRecord dst_delete_record;
-  LCH_CallbackUpdateRecord dst_update_record;
+  DestinationCallbacks *dst;
 };
 
 void LCH_TableInfoDestroy(void *const _info) {
@@ -87,20 +119,28 @@ void LCH_TableInfoDestroy(void *const _info) {
   free(info->src_table_name);
   free(info->src_params);
   free(info->src_schema);
-  LCH_ModuleDestroy(info->src_dlib_handle);
+  if (info->src != NULL) {
+    free(info->src->path);
+    free(info->src);
+  }
 
   free(info->dst_table_name);
   free(info->dst_params);
   free(info->dst_schema);
-  LCH_ModuleDestroy(info->dst_dlib_handle);
+  if (info->dst != NULL) {
+    free(info->dst->path);
+    free(info->dst);
+  }
 
   free(info);
 }
 
 LCH_TableInfo *LCH_TableInfoLoad(const char *const identifer,
-                                 const LCH_Json *const definition) {
+                                 const LCH_Json *const definition,
+                                 LCH_Dict *const modules) {
   assert(identifer != NULL);
   assert(definition != NULL);
+  assert(modules != NULL);
   assert(LCH_JsonGetType(definition) == LCH_JSON_TYPE_OBJECT);
 
   LCH_TableInfo *const info = (LCH_TableInfo *)malloc(sizeof(LCH_TableInfo));
@@ -110,6 +150,15 @@ LCH_TableInfo *LCH_TableInfoLoad(const char *const identifer,
   }
 
   memset(info, 0, sizeof(LCH_TableInfo));
+  info->modules = modules;
+
+  info->src = (SourceCallbacks *)calloc(1, sizeof(SourceCallbacks));
+  info->dst = (DestinationCallbacks *)calloc(1, sizeof(DestinationCallbacks));
+  if (info->src == NULL || info->dst == NULL) {
+    LCH_LOG_ERROR("calloc(3): Failed to allocate memory: %s", strerror(errno));
+    LCH_TableInfoDestroy(info);
+    return NULL;
+  }
 
   info->identifier = LCH_StringDuplicate(identifer);
   if (info->identifier == NULL) {
@@ -143,6 +192,14 @@ LCH_TableInfo *LCH_TableInfoLoad(const char *const identifer,
     }
   }
 
+  info->partial_updates = false;
+  {
+    const LCH_Buffer key = LCH_BufferStaticFromString("partial_updates");
+    if (LCH_JsonObjectHasKey(definition, &key)) {
+      info->partial_updates = LCH_JsonObjectChildIsTrue(definition, &key);
+    }
+  }
+
   const LCH_Buffer primary_fields_key =
       LCH_BufferStaticFromString("primary_fields");
   const LCH_Json *const primary_array =
@@ -199,7 +256,6 @@ LCH_TableInfo *LCH_TableInfoLoad(const char *const identifer,
     }
   }
 
-  LCH_LOG_VERBOSE("Loading callback functions for table '%s'", identifer);
   const LCH_Buffer params_key = LCH_BufferStaticFromString("params");
   const LCH_Buffer schema_key = LCH_BufferStaticFromString("schema");
   const LCH_Buffer table_name_key = LCH_BufferStaticFromString("table_name");
@@ -253,42 +309,8 @@ LCH_TableInfo *LCH_TableInfoLoad(const char *const identifer,
       LCH_TableInfoDestroy(info);
       return NULL;
     }
-    const char *const dlib_path = LCH_BufferData(callbacks);
-    if (dlib_path == NULL) {
-      LCH_TableInfoDestroy(info);
-      return NULL;
-    }
-
-    info->src_dlib_handle = LCH_ModuleLoad(dlib_path);
-    if (info->src_dlib_handle == NULL) {
-      LCH_TableInfoDestroy(info);
-      return NULL;
-    }
-
-    info->src_connect = (LCH_CallbackConnect)LCH_ModuleGetSymbol(
-        info->src_dlib_handle, "LCH_CallbackConnect");
-    if (info->src_connect == NULL) {
-      LCH_TableInfoDestroy(info);
-      return NULL;
-    }
-
-    info->src_disconnect = (LCH_CallbackDisconnect)LCH_ModuleGetSymbol(
-        info->src_dlib_handle, "LCH_CallbackDisconnect");
-    if (info->src_disconnect == NULL) {
-      LCH_TableInfoDestroy(info);
-      return NULL;
-    }
-
-    info->src_create_table = (LCH_CallbackCreateTable)LCH_ModuleGetSymbol(
-        info->src_dlib_handle, "LCH_CallbackCreateTable");
-    if (info->src_create_table == NULL) {
-      LCH_TableInfoDestroy(info);
-      return NULL;
-    }
-
-    info->src_get_table = (LCH_CallbackGetTable)LCH_ModuleGetSymbol(
-        info->src_dlib_handle, "LCH_CallbackGetTable");
-    if (info->src_create_table == NULL) {
+    info->src->path = LCH_StringDuplicate(LCH_BufferData(callbacks));
+    if (info->src->path == NULL) {
       LCH_TableInfoDestroy(info);
       return NULL;
     }
@@ -337,89 +359,145 @@ LCH_TableInfo *LCH_TableInfoLoad(const char *const identifer,
 
   const LCH_Buffer *const callbacks =
       LCH_JsonObjectGetString(dst, &callbacks_key);
-  const char *const dlib_path = LCH_BufferData(callbacks);
-  if (dlib_path == NULL) {
+  if (callbacks == NULL) {
     LCH_TableInfoDestroy(info);
     return NULL;
   }
-
-  info->dst_dlib_handle = LCH_ModuleLoad(dlib_path);
-  if (info->dst_dlib_handle == NULL) {
+  info->dst->path = LCH_StringDuplicate(LCH_BufferData(callbacks));
+  if (info->dst->path == NULL) {
     LCH_TableInfoDestroy(info);
     return NULL;
   }
 
-  info->dst_connect = (LCH_CallbackConnect)LCH_ModuleGetSymbol(
-      info->dst_dlib_handle, "LCH_CallbackConnect");
-  if (info->dst_connect == NULL) {
-    LCH_TableInfoDestroy(info);
-    return NULL;
+  return info;
+}
+
+static bool ResolveSourceCallbacks(const LCH_TableInfo *const info) {
+  SourceCallbacks *const src = info->src;
+  if (src->resolved) {
+    return true;
   }
 
-  info->dst_disconnect = (LCH_CallbackDisconnect)LCH_ModuleGetSymbol(
-      info->dst_dlib_handle, "LCH_CallbackDisconnect");
-  if (info->dst_disconnect == NULL) {
-    LCH_TableInfoDestroy(info);
-    return NULL;
+  LCH_LOG_VERBOSE("Loading source callback functions for table '%s'",
+                  info->identifier);
+  void *const handle = LCH_ModuleLoadShared(info->modules, src->path);
+  if (handle == NULL) {
+    return false;
   }
 
-  info->dst_create_table = (LCH_CallbackCreateTable)LCH_ModuleGetSymbol(
-      info->dst_dlib_handle, "LCH_CallbackCreateTable");
-  if (info->dst_create_table == NULL) {
-    LCH_TableInfoDestroy(info);
-    return NULL;
+  src->connect =
+      (LCH_CallbackConnect)LCH_ModuleGetSymbol(handle, "LCH_CallbackConnect");
+  if (src->connect == NULL) {
+    return false;
   }
 
-  info->dst_truncate_table = (LCH_CallbackTruncateTable)LCH_ModuleGetSymbol(
-      info->dst_dlib_handle, "LCH_CallbackTruncateTable");
-  if (info->dst_truncate_table == NULL) {
-    LCH_TableInfoDestroy(info);
-    return NULL;
+  src->disconnect = (LCH_CallbackDisconnect)LCH_ModuleGetSymbol(
+      handle, "LCH_CallbackDisconnect");
+  if (src->disconnect == NULL) {
+    return false;
   }
 
-  info->dst_begin_tx = (LCH_CallbackBeginTransaction)LCH_ModuleGetSymbol(
-      info->dst_dlib_handle, "LCH_CallbackBeginTransaction");
-  if (info->dst_begin_tx == NULL) {
-    LCH_TableInfoDestroy(info);
-    return NULL;
+  src->create_table = (LCH_CallbackCreateTable)LCH_ModuleGetSymbol(
+      handle, "LCH_CallbackCreateTable");
+  if (src->create_table == NULL) {
+    return false;
   }
 
-  info->dst_commit_tx = (LCH_CallbackCommitTransaction)LCH_ModuleGetSymbol(
-      info->dst_dlib_handle, "LCH_CallbackCommitTransaction");
-  if (info->dst_commit_tx == NULL) {
-    LCH_TableInfoDestroy(info);
-    return NULL;
+  /* Modules returning columnar tables do not need to implement the list based
+   * callback */
+  src->load_table = (LCH_CallbackLoadTable)LCH_ModuleGetOptionalSymbol(
+      handle, "LCH_CallbackLoadTable");
+  if (src->load_table == NULL) {
+    src->get_table = (LCH_CallbackGetTable)LCH_ModuleGetSymbol(
+        handle, "LCH_CallbackGetTable");
+    if (src->get_table == NULL) {
+      return false;
+    }
   }
 
-  info->dst_rollback_tx = (LCH_CallbackRollbackTransaction)LCH_ModuleGetSymbol(
-      info->dst_dlib_handle, "LCH_CallbackRollbackTransaction");
-  if (info->dst_rollback_tx == NULL) {
-    LCH_TableInfoDestroy(info);
-    return NULL;
+  src->get_fingerprint =
+      (LCH_CallbackGetFingerprint)LCH_ModuleGetOptionalSymbol(
+          handle, "LCH_CallbackGetFingerprint");
+
+  src->resolved = true;
+  return true;
+}
+
+static bool ResolveDestinationCallbacks(const LCH_TableInfo *const info) {
+  DestinationCallbacks *const dst = info->dst;
+  if (dst->resolved) {
+    return true;
   }
 
-  info->dst_insert_record = (LCH_CallbackInsertRecord)LCH_ModuleGetSymbol(
-      info->dst_dlib_handle, "LCH_CallbackInsertRecord");
-  if (info->dst_insert_record == NULL) {
-    LCH_TableInfoDestroy(info);
-    return NULL;
+  LCH_LOG_VERBOSE("Loading destination callback functions for table '%s'",
+                  info->identifier);
+  void *const handle = LCH_ModuleLoadShared(info->modules, dst->path);
+  if (handle == NULL) {
+    return false;
   }
 
-  info->dst_delete_record = (LCH_CallbackDeleteRecord)LCH_ModuleGetSymbol(
-      info->dst_dlib_handle, "LCH_CallbackDeleteRecord");
-  if (info->dst_delete_record == NULL) {
-    LCH_TableInfoDestroy(info);
-    return NULL;
+  dst->connect =
+      (LCH_CallbackConnect)LCH_ModuleGetSymbol(handle, "LCH_CallbackConnect");
+  if (dst->connect == NULL) {
+    return false;
   }
 
-  info->dst_update_record = (LCH_CallbackUpdateRecord)LCH_ModuleGetSymbol(
-      info->dst_dlib_handle, "LCH_CallbackUpdateRecord");
-  if (info->dst_update_record == NULL) {
-    LCH_TableInfoDestroy(info);
-    return NULL;
+  dst->disconnect = (LCH_CallbackDisconnect)LCH_ModuleGetSymbol(
+      handle, "LCH_CallbackDisconnect");
+  if (dst->disconnect == NULL) {
+    return false;
   }
 
-  return info;
+  dst->create_table = (LCH_CallbackCreateTable)LCH_ModuleGetSymbol(
+      handle, "LCH_CallbackCreateTable");
+  if (dst->create_table == NULL) {
+    return false;
+  }
+
+  dst->truncate_table = (LCH_CallbackTruncateTable)LCH_ModuleGetSymbol(
+      handle, "LCH_CallbackTruncateTable");
+  if (dst->truncate_table == NULL) {
+    return false;
+  }
+
+  dst->begin_tx = (LCH_CallbackBeginTransaction)LCH_ModuleGetSymbol(
+      handle, "LCH_CallbackBeginTransaction");
+  if (dst->begin_tx == NULL) {
+    return false;
+  }
+
+  dst->commit_tx = (LCH_CallbackCommitTransaction)LCH_ModuleGetSymbol(
+      handle, "LCH_CallbackCommitTransaction");
+  if (dst->commit_tx == NULL) {
+    return false;
+  }
+
+  dst->rollback_tx = (LCH_CallbackRollbackTransaction)LCH_ModuleGetSymbol(
+      handle, "LCH_CallbackRollbackTransaction");
+  if (dst->rollback_tx == NULL) {
+    return false;
+  }
+
+  dst->insert_record = (LCH_CallbackInsertRecord)LCH_ModuleGetSymbol(
+      handle, "LCH_CallbackInsertRecord");
+  if (dst->insert_record == NULL) {
+    return false;
+  }
+
+  dst->delete_record = (LCH_CallbackDeleteRecord)LCH_ModuleGetSymbol(
+      handle, "LCH_CallbackDeleteRecord");
+  if (dst->delete_record == NULL) {
+    return false;
+  }
+
+  dst->update_record = (LCH_CallbackUpdateRecord)LCH_ModuleGetSymbol(
+      handle, "LCH_CallbackUpdateRecord");
+  if (dst->update_record == NULL) {
+    return false;
+  }
+
+  dst->resolved = true;
+  return true;
 }
 
 const char *LCH_TableInfoGetIdentifier(const LCH_TableInfo *const table_info) {
@@ -432,38 +510,195 @@ bool LCH_TableInfoShouldMergeTable(const LCH_TableInfo *const table_info) {
   return table_info->merge_blocks;
 }
 
+bool LCH_TableInfoShouldUsePartialUpdates(
+    const LCH_TableInfo *const table_info) {
+  assert(table_info != NULL);
+  return table_info->partial_updates;
+}
+
 LCH_Json *LCH_TableInfoLoadNewState(const LCH_TableInfo *const table_info) {
   assert(table_info != NULL);
 
-  void *const conn = table_info->src_connect(table_info->src_params);
+  if (!ResolveSourceCallbacks(table_info)) {
+    LCH_LOG_ERROR("Failed to load source callbacks for table '%s'",
+                  table_info->identifier);
+    return NULL;
+  }
+
+  void *const conn = table_info->src->connect(table_info->src_params);
   if (conn == NULL) {
     LCH_LOG_ERROR("Failed to connect '%s'", table_info->src_params);
     return NULL;
   }
 
-  if (!table_info->src_create_table(conn, table_info->src_table_name,
+  LCH_MetricsCountStatement();
+  if (!table_info->src->create_table(conn, table_info->src_table_name,
                                     table_info->primary_fields,
                                     table_info->subsidiary_fields)) {
     LCH_LOG_ERROR("Failed to create table '%s'", table_info->src_table_name);
-    table_info->src_disconnect(conn);
+    table_info->src->disconnect(conn);
     return NULL;
   }
 
-  LCH_List *table = table_info->src_get_table(conn, table_info->src_table_name,
-                                              table_info->all_fields);
+  LCH_Table *table = NULL;
+  LCH_MetricsCountStatement();
+  if (table_info->src->load_table != NULL) {
+    table = table_info->src->load_table(conn, table_info->src_table_name,
+                                       table_info->all_fields);
+  } else {
+    LCH_List *const list = table_info->src->get_table(
+        conn, table_info->src_table_name, table_info->all_fields);
+    if (list != NULL) {
+      table = LCH_TableFromList(list);
+      LCH_ListDestroy(list);
+    }
+  }
+
+  table_info->src->disconnect(conn);
   if (table == NULL) {
-    table_info->src_disconnect(conn);
     return NULL;
   }
-
-  table_info->src_disconnect(conn);
+  LCH_MetricsCountRowsLoaded(LCH_TableGetNumRows(table) - 1);  // Minus header
 
   LCH_Json *const state = LCH_TableToJsonObject(
       table, table_info->primary_fields, table_info->subsidiary_fields);
-  LCH_ListDestroy(table);
+  LCH_TableDestroy(table);
   return state;
 }
 
+/**
+ * Compose the path of a file stored next to the snapshot of a table, i.e., the
+ * snapshot path followed by the given suffix.
+ */
+static bool SnapshotSiblingPath(char *const path, const size_t path_max,
+                                const char *const work_dir,
+                                const char *const table_id,
+                                const char *const suffix) {
+  if (!LCH_FilePathJoin(path, path_max, 3, work_dir, "snapshot", table_id)) {
+    return false;
+  }
+
+  const size_t length = strlen(path);
+  const int ret = snprintf(path + length, path_max - length, "%s", suffix);
+  if (ret < 0 || (size_t)ret >= path_max - length) {
+    LCH_LOG_ERROR("Failed to compose path '%s%s': Too long (%d >= %zu)", path,
+                  suffix, ret, path_max - length);
+    return false;
+  }
+
+  return true;
+}
+
+bool LCH_TableSnapshotLogPath(char *const path, const size_t path_max,
+                              const char *const work_dir,
+                              const char *const table_id) {
+  return SnapshotSiblingPath(path, path_max, work_dir, table_id,
+                             LCH_SNAPSHOT_LOG_SUFFIX);
+}
+
+/**
+ * Apply a record of the snapshot log to a state. The record maps the primary
+ * key of each changed row to its new subsidiary value, or to null if the row
+ * was deleted. Applying the same record twice changes nothing.
+ */
+static bool ApplySnapshotLogRecord(const LCH_Json *const state,
+                                   const LCH_Json *const record) {
+  LCH_List *const keys = LCH_JsonObjectGetKeys(record);
+  if (keys == NULL) {
+    return false;
+  }
+
+  const size_t num_keys = LCH_ListLength(keys);
+  for (size_t i = 0; i < num_keys; i++) {
+    const LCH_Buffer *const key = (LCH_Buffer *)LCH_ListGet(keys, i);
+    LCH_Json *const value = LCH_JsonObjectRemove(record, key);
+
+    if (LCH_JsonIsNull(value)) {
+      LCH_JsonDestroy(value);
+      if (LCH_JsonObjectHasKey(state, key)) {
+        LCH_JsonDestroy(LCH_JsonObjectRemove(state, key));
+      }
+      continue;
+    }
+
+    if (!LCH_JsonIsString(value)) {
+      LCH_LOG_ERROR(
+          "Illegal value in snapshot log: Expected type string or null, "
+          "found %s",
+          LCH_JsonGetTypeAsString(value));
+      LCH_JsonDestroy(value);
+      LCH_ListDestroy(keys);
+      return false;
+    }
+
+    if (!LCH_JsonObjectSet(state, key, value)) {
+      LCH_JsonDestroy(value);
+      LCH_ListDestroy(keys);
+      return false;
+    }
+  }
+
+  LCH_ListDestroy(keys);
+  return true;
+}
+
+static bool ReplaySnapshotLog(const char *const path,
+                              const LCH_Json *const state) {
+  if (!LCH_FileExists(path)) {
+    return true;
+  }
+
+  LCH_Buffer *const log = LCH_BufferCreate();
+  if (log == NULL) {
+    return false;
+  }
+
+  if (!LCH_BufferReadFile(log, path)) {
+    LCH_BufferDestroy(log);
+    return false;
+  }
+
+  const char *const data = LCH_BufferData(log);
+  const size_t length = LCH_BufferLength(log);
+  size_t offset = 0, num_records = 0;
+
+  while (offset < length) {
+    const char *const begin = data + offset;
+    const char *const end = (const char *)memchr(begin, '\n', length - offset);
+    if (end == NULL) {
+      /* Left behind by an interrupted commit, which never got to store the
+       * block with these changes */
+      LCH_LOG_WARNING("Ignoring incomplete record at end of snapshot log '%s'",
+                      path);
+      break;
+    }
+
+    LCH_Json *const record = LCH_JsonParse(begin, (size_t)(end - begin));
+    if (record == NULL || !LCH_JsonIsObject(record)) {
+      LCH_LOG_ERROR("Failed to parse record at offset %zu in snapshot log '%s'",
+                    offset, path);
+      LCH_JsonDestroy(record);
+      LCH_BufferDestroy(log);
+      return false;
+    }
+
+    if (!ApplySnapshotLogRecord(state, record)) {
+      LCH_JsonDestroy(record);
+      LCH_BufferDestroy(log);
+      return false;
+    }
+
+    LCH_JsonDestroy(record);
+    num_records += 1;
+    offset = (size_t)(end - data) + 1;
+  }
+
+  LCH_BufferDestroy(log);
+  LCH_LOG_DEBUG("Replayed %zu records from snapshot log '%s'", num_records,
+                path);
+  return true;
+}
+
 LCH_Json *LCH_TableInfoLoadOldState(const LCH_TableInfo *const table_info,
                                     const char *const work_dir) {
   assert(table_info != NULL);
@@ -481,12 +716,29 @@ LCH_Json *LCH_TableInfoLoadOldState(const LCH_TableInfo *const table_info,
     return state;
   }
 
-  LCH_Json *const state = LCH_JsonParseFile(path);
+  LCH_Buffer *const buffer = LCH_CompressionReadFile(path);
+  if (buffer == NULL) {
+    return NULL;
+  }
+
+  LCH_Json *const state = LCH_JsonParseBuffer(buffer);
+  if (state == NULL) {
+    return NULL;
+  }
+
+  if (!LCH_TableSnapshotLogPath(path, sizeof(path), work_dir,
+                                table_info->identifier) ||
+      !ReplaySnapshotLog(path, state)) {
+    LCH_JsonDestroy(state);
+    return NULL;
+  }
+
   return state;
 }
 
 bool LCH_TableStoreNewState(const LCH_TableInfo *const self,
                             const char *const work_dir, const bool pretty_print,
+                            const LCH_Compression compression,
                             const LCH_Json *const state) {
   char path[PATH_MAX];
   if (!LCH_FilePathJoin(path, sizeof(path), 3, work_dir, "snapshot",
@@ -494,93 +746,488 @@ bool LCH_TableStoreNewState(const LCH_TableInfo *const self,
     return false;
   }
 
-  return LCH_JsonComposeFile(state, path, pretty_print);
+  LCH_Buffer *const buffer = LCH_JsonCompose(state, pretty_print);
+  if (buffer == NULL) {
+    return false;
+  }
+
+  if (!LCH_CompressionWriteFile(buffer, path, compression)) {
+    LCH_BufferDestroy(buffer);
+    return false;
+  }
+
+  LCH_BufferDestroy(buffer);
+
+  /* The snapshot now includes the changes recorded in the log. If we are
+   * interrupted before the log is removed, replaying it onto the new snapshot
+   * changes nothing. */
+  if (!LCH_TableSnapshotLogPath(path, sizeof(path), work_dir,
+                                self->identifier)) {
+    return false;
+  }
+
+  return !LCH_FileExists(path) || LCH_FileDelete(path);
 }
 
-static LCH_List *ConcatenateFields(const LCH_List *const left,
-                                   const LCH_List *const right) {
-  LCH_List *const record = LCH_ListCreate();
+static bool SnapshotLogRecordSetValues(const LCH_Json *const record,
+                                       const LCH_Json *const rows,
+                                       const LCH_Json *const state) {
+  LCH_List *const keys = LCH_JsonObjectGetKeys(rows);
+  if (keys == NULL) {
+    return false;
+  }
+
+  const size_t num_keys = LCH_ListLength(keys);
+  for (size_t i = 0; i < num_keys; i++) {
+    const LCH_Buffer *const key = (LCH_Buffer *)LCH_ListGet(keys, i);
+
+    /* The delta may hold partial updates or resolved digests, whereas the log
+     * must hold the values as stored in the snapshot */
+    const LCH_Buffer *const value = LCH_JsonObjectGetString(state, key);
+    if (value == NULL ||
+        !LCH_JsonObjectSetStringDuplicate(record, key, value)) {
+      LCH_ListDestroy(keys);
+      return false;
+    }
+  }
+
+  LCH_ListDestroy(keys);
+  return true;
+}
+
+static LCH_Json *SnapshotLogRecord(const LCH_Json *const delta,
+                                   const LCH_Json *const state) {
+  const LCH_Json *const inserts = LCH_DeltaGetInserts(delta);
+  const LCH_Json *const deletes = LCH_DeltaGetDeletes(delta);
+  const LCH_Json *const updates = LCH_DeltaGetUpdates(delta);
+  if (inserts == NULL || deletes == NULL || updates == NULL) {
+    return NULL;
+  }
+
+  LCH_Json *const record = LCH_JsonObjectCreate();
   if (record == NULL) {
     return NULL;
   }
 
-  size_t length = LCH_ListLength(left);
-  for (size_t i = 0; i < length; i++) {
-    const LCH_Buffer *const field = (LCH_Buffer *)LCH_ListGet(left, i);
-    if (!LCH_ListAppendBufferDuplicate(record, field)) {
-      LCH_ListDestroy(record);
+  if (!SnapshotLogRecordSetValues(record, inserts, state) ||
+      !SnapshotLogRecordSetValues(record, updates, state)) {
+    LCH_JsonDestroy(record);
+    return NULL;
+  }
+
+  LCH_List *const keys = LCH_JsonObjectGetKeys(deletes);
+  if (keys == NULL) {
+    LCH_JsonDestroy(record);
+    return NULL;
+  }
+
+  const size_t num_keys = LCH_ListLength(keys);
+  for (size_t i = 0; i < num_keys; i++) {
+    const LCH_Buffer *const key = (LCH_Buffer *)LCH_ListGet(keys, i);
+
+    LCH_Json *const null = LCH_JsonNullCreate();
+    if (null == NULL) {
+      LCH_ListDestroy(keys);
+      LCH_JsonDestroy(record);
       return NULL;
     }
-  }
 
-  length = LCH_ListLength(right);
-  for (size_t i = 0; i < length; i++) {
-    const LCH_Buffer *const field = (LCH_Buffer *)LCH_ListGet(right, i);
-    if (!LCH_ListAppendBufferDuplicate(record, field)) {
-      LCH_ListDestroy(record);
+    if (!LCH_JsonObjectSet(record, key, null)) {
+      LCH_JsonDestroy(null);
+      LCH_ListDestroy(keys);
+      LCH_JsonDestroy(record);
       return NULL;
     }
   }
 
+  LCH_ListDestroy(keys);
   return record;
 }
 
-static LCH_List *ParseConcatenateFields(const LCH_Buffer *const left_csv,
-                                        const LCH_Buffer *const right_csv) {
-  const LCH_Buffer empty_str = LCH_BufferStaticFromString("");
-  LCH_List *const left_lst =
-      (LCH_BufferEqual(left_csv, &empty_str))
-          ? LCH_ListCreate()
-          : LCH_CSVParseRecord(LCH_BufferData(left_csv),
-                               LCH_BufferLength(left_csv));
-  if (left_lst == NULL) {
+bool LCH_TableAppendNewState(const LCH_TableInfo *const self,
+                             const char *const work_dir,
+                             const size_t log_limit,
+                             const LCH_Json *const delta,
+                             const LCH_Json *const state,
+                             bool *const appended) {
+  assert(self != NULL);
+  assert(work_dir != NULL);
+  assert(delta != NULL);
+  assert(state != NULL);
+  assert(appended != NULL);
+
+  *appended = false;
+
+  char path[PATH_MAX];
+  if (!LCH_FilePathJoin(path, sizeof(path), 3, work_dir, "snapshot",
+                        self->identifier)) {
+    return false;
+  }
+
+  /* The log records changes relative to the snapshot */
+  LCH_FileStamp snapshot;
+  if (!LCH_FileGetStamp(path, &snapshot)) {
+    return false;
+  }
+  if (!snapshot.exists) {
+    return true;
+  }
+
+  LCH_Json *const record = SnapshotLogRecord(delta, state);
+  if (record == NULL) {
+    LCH_LOG_ERROR("Failed to create snapshot log record for table '%s'",
+                  self->identifier);
+    return false;
+  }
+
+  LCH_Buffer *const buffer = LCH_JsonCompose(record, false);
+  LCH_JsonDestroy(record);
+  if (buffer == NULL) {
+    return false;
+  }
+
+  if (!LCH_BufferAppend(buffer, '\n')) {
+    LCH_BufferDestroy(buffer);
+    return false;
+  }
+
+  if (!LCH_TableSnapshotLogPath(path, sizeof(path), work_dir,
+                                self->identifier)) {
+    LCH_BufferDestroy(buffer);
+    return false;
+  }
+
+  LCH_FileStamp log;
+  if (!LCH_FileGetStamp(path, &log)) {
+    LCH_BufferDestroy(buffer);
+    return false;
+  }
+
+  const size_t length = LCH_BufferLength(buffer);
+  if ((log.size + length) * 100 > snapshot.size * log_limit) {
+    LCH_LOG_DEBUG(
+        "Snapshot log '%s' would exceed %zu%% of the snapshot size; "
+        "compacting",
+        path, log_limit);
+    LCH_BufferDestroy(buffer);
+    return true;
+  }
+
+  const int fd = open(path, O_RDWR | O_CREAT | O_APPEND, (mode_t)0600);
+  if (fd == -1) {
+    LCH_LOG_ERROR("Failed to open snapshot log '%s': %s", path,
+                  strerror(errno));
+    LCH_BufferDestroy(buffer);
+    return false;
+  }
+
+  struct stat sb;
+  if (fstat(fd, &sb) != 0) {
+    LCH_LOG_ERROR("Failed to get status of snapshot log '%s': %s", path,
+                  strerror(errno));
+    close(fd);
+    LCH_BufferDestroy(buffer);
+    return false;
+  }
+  const size_t log_size = (size_t)sb.st_size;
+
+  /* Never append after an incomplete record. The snapshot is rewritten
+   * instead, which removes the log. */
+  if (log_size > 0) {
+    char last;
+    if (pread(fd, &last, 1, (off_t)(log_size - 1)) != 1) {
+      LCH_LOG_ERROR("Failed to read snapshot log '%s': %s", path,
+                    strerror(errno));
+      close(fd);
+      LCH_BufferDestroy(buffer);
+      return false;
+    }
+    if (last != '\n') {
+      LCH_LOG_DEBUG("Snapshot log '%s' ends with an incomplete record", path);
+      close(fd);
+      LCH_BufferDestroy(buffer);
+      return true;
+    }
+  }
+
+  const char *const data = LCH_BufferData(buffer);
+  size_t tot_written = 0;
+  while (tot_written < length) {
+    const ssize_t n_written =
+        write(fd, data + tot_written, length - tot_written);
+    if (n_written < 0) {
+      LCH_LOG_ERROR("Failed to write to snapshot log '%s': %s", path,
+                    strerror(errno));
+      close(fd);
+      LCH_BufferDestroy(buffer);
+      return false;
+    }
+    tot_written += (size_t)n_written;
+  }
+
+  close(fd);
+  LCH_BufferDestroy(buffer);
+  LCH_MetricsCountBytesWritten(tot_written);
+  LCH_LOG_DEBUG("Appended %zu bytes to snapshot log '%s'", tot_written, path);
+
+  *appended = true;
+  return true;
+}
+
+LCH_Buffer *LCH_TableInfoLoadFingerprint(const LCH_TableInfo *const table_info) {
+  assert(table_info != NULL);
+
+  if (!ResolveSourceCallbacks(table_info) ||
+      table_info->src->get_fingerprint == NULL) {
     return NULL;
   }
 
-  LCH_List *const right_lst = LCH_CSVParseRecord(LCH_BufferData(right_csv),
-                                                 LCH_BufferLength(right_csv));
-  if (right_lst == NULL) {
-    LCH_ListDestroy(left_lst);
+  void *const conn = table_info->src->connect(table_info->src_params);
+  if (conn == NULL) {
+    LCH_LOG_WARNING("Failed to connect '%s'", table_info->src_params);
     return NULL;
   }
 
-  LCH_List *fields = ConcatenateFields(left_lst, right_lst);
-  LCH_ListDestroy(left_lst);
-  LCH_ListDestroy(right_lst);
-  return fields;
+  LCH_MetricsCountStatement();
+  LCH_Buffer *const fingerprint =
+      table_info->src->get_fingerprint(conn, table_info->src_table_name);
+  table_info->src->disconnect(conn);
+
+  if (fingerprint == NULL) {
+    LCH_LOG_WARNING("Failed to get fingerprint of table '%s'",
+                    table_info->src_table_name);
+    return NULL;
+  }
+
+  return fingerprint;
 }
 
-static bool TablePatchInserts(const LCH_TableInfo *const table_info,
-                              const LCH_List *const all_fields,
-                              const char *const host_id,
-                              const LCH_Json *const inserts, void *const conn) {
-  LCH_List *const keys = LCH_JsonObjectGetKeys(inserts);
-  if (keys == NULL) {
+bool LCH_TableFingerprintMatches(const LCH_TableInfo *const table_info,
+                                 const char *const work_dir,
+                                 const LCH_Buffer *const fingerprint) {
+  assert(table_info != NULL);
+  assert(work_dir != NULL);
+  assert(fingerprint != NULL);
+
+  char path[PATH_MAX];
+  if (!LCH_FilePathJoin(path, sizeof(path), 3, work_dir, "snapshot",
+                        table_info->identifier)) {
+    return false;
+  }
+
+  /* Without a snapshot, there is nothing to compare the table with */
+  if (!LCH_FileExists(path)) {
+    return false;
+  }
+
+  if (!SnapshotSiblingPath(path, sizeof(path), work_dir,
+                           table_info->identifier, LCH_FINGERPRINT_SUFFIX)) {
+    return false;
+  }
+
+  if (!LCH_FileExists(path)) {
+    return false;
+  }
+
+  LCH_Buffer *const stored = LCH_BufferCreate();
+  if (stored == NULL) {
+    return false;
+  }
+
+  if (!LCH_BufferReadFile(stored, path)) {
+    LCH_BufferDestroy(stored);
+    return false;
+  }
+
+  const bool matches = LCH_BufferEqual(stored, fingerprint);
+  LCH_BufferDestroy(stored);
+  return matches;
+}
+
+bool LCH_TableStoreFingerprint(const LCH_TableInfo *const table_info,
+                               const char *const work_dir,
+                               const LCH_Buffer *const fingerprint) {
+  assert(table_info != NULL);
+  assert(work_dir != NULL);
+
+  char path[PATH_MAX];
+  if (!SnapshotSiblingPath(path, sizeof(path), work_dir,
+                           table_info->identifier, LCH_FINGERPRINT_SUFFIX)) {
     return false;
   }
 
+  if (fingerprint == NULL) {
+    return !LCH_FileExists(path) || LCH_FileDelete(path);
+  }
+
+  return LCH_BufferReplaceFile(fingerprint, path);
+}
+
+LCH_Json *LCH_TableStateDigest(const LCH_Json *const state) {
+  assert(state != NULL);
+
+  LCH_Json *const digests = LCH_JsonObjectCreate();
+  if (digests == NULL) {
+    return NULL;
+  }
+
+  LCH_List *const keys = LCH_JsonObjectGetKeys(state);
+  if (keys == NULL) {
+    LCH_JsonDestroy(digests);
+    return NULL;
+  }
+
   const size_t num_keys = LCH_ListLength(keys);
   for (size_t i = 0; i < num_keys; i++) {
     const LCH_Buffer *const key = (LCH_Buffer *)LCH_ListGet(keys, i);
-    assert(key != NULL);
 
-    const LCH_Buffer *const value = LCH_JsonObjectGetString(inserts, key);
+    const LCH_Buffer *const value = LCH_JsonObjectGetString(state, key);
     if (value == NULL) {
       LCH_ListDestroy(keys);
-      return false;
+      LCH_JsonDestroy(digests);
+      return NULL;
+    }
+
+    LCH_Buffer *const digest = LCH_BufferCreate();
+    if (digest == NULL) {
+      LCH_ListDestroy(keys);
+      LCH_JsonDestroy(digests);
+      return NULL;
     }
 
-    LCH_List *const values =
-        (LCH_ListLength(table_info->subsidiary_fields) == 0)
-            ? LCH_CSVParseRecord(LCH_BufferData(key), LCH_BufferLength(key))
-            : ParseConcatenateFields(key, value);
+    if (!LCH_MessageDigest((const unsigned char *)LCH_BufferData(value),
+                           LCH_BufferLength(value), digest)) {
+      LCH_BufferDestroy(digest);
+      LCH_ListDestroy(keys);
+      LCH_JsonDestroy(digests);
+      return NULL;
+    }
+    LCH_BufferChop(digest, LCH_ROW_DIGEST_LENGTH);
+
+    if (!LCH_JsonObjectSetString(digests, key, digest)) {
+      LCH_BufferDestroy(digest);
+      LCH_ListDestroy(keys);
+      LCH_JsonDestroy(digests);
+      return NULL;
+    }
+  }
+
+  LCH_ListDestroy(keys);
+  return digests;
+}
+
+/**
+ * Gets a section of the delta to patch. Sections are objects mapping CSV
+ * records to values, unless the delta was binary encoded. In that case they
+ * are arrays of [key, value] pairs with the records already split into fields
+ * (see LCH_EncodingParseFields()).
+ */
+static const LCH_Json *GetSection(const LCH_Json *const delta,
+                                  const char *const name) {
+  const LCH_Buffer key = LCH_BufferStaticFromString(name);
+  const LCH_Json *const section = LCH_JsonObjectGet(delta, &key);
+  if (section == NULL) {
+    LCH_LOG_ERROR("Failed to extract %s from delta", name);
+    return NULL;
+  }
+
+  if (!LCH_JsonIsObject(section) && !LCH_JsonIsArray(section)) {
+    LCH_LOG_ERROR("Expected %s to be of type object or array, found type %s",
+                  name, LCH_JsonGetTypeAsString(section));
+    return NULL;
+  }
+
+  return section;
+}
+
+/**
+ * Gets the keys of a section. They are NULL if the section is an array.
+ */
+static bool GetSectionKeys(const LCH_Json *const section, LCH_List **const keys,
+                           size_t *const num_records) {
+  if (LCH_JsonIsArray(section)) {
+    *keys = NULL;
+    *num_records = LCH_JsonArrayLength(section);
+    return true;
+  }
+
+  *keys = LCH_JsonObjectGetKeys(section);
+  if (*keys == NULL) {
+    return false;
+  }
+  *num_records = LCH_ListLength(*keys);
+  return true;
+}
+
+/**
+ * Gets the fields of the primary key and the value of the record at the given
+ * index in a section (see LCH_DeltaGetRecordFields()).
+ */
+static LCH_List *GetSectionRecord(const LCH_Json *const section,
+                                  const LCH_List *const keys,
+                                  const size_t index,
+                                  const LCH_Json **const value) {
+  if (keys != NULL) {
+    const LCH_Buffer *const key = (LCH_Buffer *)LCH_ListGet(keys, index);
+    assert(key != NULL);
+    *value = LCH_JsonObjectGet(section, key);
+    assert(*value != NULL);
+    return LCH_CSVParseRecord(LCH_BufferData(key), LCH_BufferLength(key));
+  }
+
+  const LCH_Json *const record = LCH_JsonArrayGet(section, index);
+  if (!LCH_JsonIsArray(record) || LCH_JsonArrayLength(record) != 2) {
+    LCH_LOG_ERROR("Expected record at index %zu to be a [key, value] pair",
+                  index);
+    return NULL;
+  }
+
+  *value = LCH_JsonArrayGet(record, 1);
+  return LCH_DeltaGetRecordFields(LCH_JsonArrayGet(record, 0));
+}
+
+static bool TablePatchInserts(const LCH_TableInfo *const table_info,
+                              const LCH_List *const all_fields,
+                              const char *const host_id,
+                              const LCH_Json *const inserts, void *const conn) {
+  LCH_List *keys;
+  size_t num_records;
+  if (!GetSectionKeys(inserts, &keys, &num_records)) {
+    return false;
+  }
+
+  for (size_t i = 0; i < num_records; i++) {
+    const LCH_Json *value;
+    LCH_List *const values = GetSectionRecord(inserts, keys, i, &value);
     if (values == NULL) {
       LCH_ListDestroy(keys);
       return false;
     }
 
+    /* The subsidiary fields are borrowed by the list of values */
+    LCH_List *subsidiary_values = NULL;
+    if (LCH_ListLength(table_info->subsidiary_fields) > 0) {
+      subsidiary_values = LCH_DeltaGetRecordFields(value);
+      if (subsidiary_values == NULL) {
+        LCH_ListDestroy(values);
+        LCH_ListDestroy(keys);
+        return false;
+      }
+
+      const size_t num_values = LCH_ListLength(subsidiary_values);
+      for (size_t j = 0; j < num_values; j++) {
+        if (!LCH_ListAppend(values, LCH_ListGet(subsidiary_values, j), NULL)) {
+          LCH_ListDestroy(subsidiary_values);
+          LCH_ListDestroy(values);
+          LCH_ListDestroy(keys);
+          return false;
+        }
+      }
+    }
+
     LCH_Buffer *const buffer = LCH_BufferFromString(host_id);
     if (buffer == NULL) {
+      LCH_ListDestroy(subsidiary_values);
       LCH_ListDestroy(values);
       LCH_ListDestroy(keys);
       return false;
@@ -588,18 +1235,23 @@ static bool TablePatchInserts(const LCH_TableInfo *const table_info,
 
     if (!LCH_ListInsert(values, 0, buffer, LCH_BufferDestroy)) {
       LCH_BufferDestroy(buffer);
+      LCH_ListDestroy(subsidiary_values);
       LCH_ListDestroy(values);
       LCH_ListDestroy(keys);
       return false;
     }
 
-    if (!table_info->dst_insert_record(conn, table_info->dst_table_name,
+    LCH_MetricsCountStatement();
+    if (!table_info->dst->insert_record(conn, table_info->dst_table_name,
                                        all_fields, values)) {
+      LCH_ListDestroy(subsidiary_values);
       LCH_ListDestroy(values);
       LCH_ListDestroy(keys);
       return false;
     }
+    LCH_MetricsCountRowsPatched(1);
 
+    LCH_ListDestroy(subsidiary_values);
     LCH_ListDestroy(values);
   }
 
@@ -611,18 +1263,15 @@ static bool TablePatchDeletes(const LCH_TableInfo *const table_info,
                               const LCH_List *const primary_fields,
                               const char *const host_id,
                               const LCH_Json *const deletes, void *const conn) {
-  LCH_List *const keys = LCH_JsonObjectGetKeys(deletes);
-  if (keys == NULL) {
+  LCH_List *keys;
+  size_t num_records;
+  if (!GetSectionKeys(deletes, &keys, &num_records)) {
     return false;
   }
 
-  const size_t num_keys = LCH_ListLength(keys);
-  for (size_t i = 0; i < num_keys; i++) {
-    const LCH_Buffer *const key = (LCH_Buffer *)LCH_ListGet(keys, i);
-    assert(key != NULL);
-
-    LCH_List *const primary_values =
-        LCH_CSVParseRecord(LCH_BufferData(key), LCH_BufferLength(key));
+  for (size_t i = 0; i < num_records; i++) {
+    const LCH_Json *value;
+    LCH_List *const primary_values = GetSectionRecord(deletes, keys, i, &value);
     if (primary_values == NULL) {
       LCH_ListDestroy(keys);
       return false;
@@ -642,12 +1291,14 @@ static bool TablePatchDeletes(const LCH_TableInfo *const table_info,
       return false;
     }
 
-    if (!table_info->dst_delete_record(conn, table_info->dst_table_name,
+    LCH_MetricsCountStatement();
+    if (!table_info->dst->delete_record(conn, table_info->dst_table_name,
                                        primary_fields, primary_values)) {
       LCH_ListDestroy(primary_values);
       LCH_ListDestroy(keys);
       return false;
     }
+    LCH_MetricsCountRowsPatched(1);
 
     LCH_ListDestroy(primary_values);
   }
@@ -660,18 +1311,15 @@ static bool TablePatchUpdates(const LCH_TableInfo *const table_info,
                               const LCH_List *primary_fields,
                               const char *const host_value,
                               const LCH_Json *const updates, void *const conn) {
-  LCH_List *const keys = LCH_JsonObjectGetKeys(updates);
-  if (keys == NULL) {
+  LCH_List *keys;
+  size_t num_records;
+  if (!GetSectionKeys(updates, &keys, &num_records)) {
     return false;
   }
 
-  const size_t num_keys = LCH_ListLength(keys);
-  for (size_t i = 0; i < num_keys; i++) {
-    const LCH_Buffer *const key = (LCH_Buffer *)LCH_ListGet(keys, i);
-    assert(key != NULL);
-
-    LCH_List *primary_values =
-        LCH_CSVParseRecord(LCH_BufferData(key), LCH_BufferLength(key));
+  for (size_t i = 0; i < num_records; i++) {
+    const LCH_Json *value;
+    LCH_List *const primary_values = GetSectionRecord(updates, keys, i, &value);
     if (primary_values == NULL) {
       LCH_ListDestroy(keys);
       return false;
@@ -691,31 +1339,30 @@ static bool TablePatchUpdates(const LCH_TableInfo *const table_info,
       return false;
     }
 
-    const LCH_Buffer *const value = LCH_JsonObjectGetString(updates, key);
-    if (value == NULL) {
-      LCH_ListDestroy(primary_values);
-      LCH_ListDestroy(keys);
-      return false;
-    }
-
-    LCH_List *subsidiary_values =
-        LCH_CSVParseRecord(LCH_BufferData(value), LCH_BufferLength(value));
-    if (subsidiary_values == NULL) {
+    /* Partial updates only carry the changed fields, so that the destination
+     * only needs to touch those columns */
+    LCH_List *subsidiary_fields, *subsidiary_values;
+    if (!LCH_DeltaGetUpdatedFields(value, table_info->subsidiary_fields,
+                                   &subsidiary_fields, &subsidiary_values)) {
       LCH_ListDestroy(primary_values);
       LCH_ListDestroy(keys);
       return false;
     }
 
-    if (!table_info->dst_update_record(
+    LCH_MetricsCountStatement();
+    if (!table_info->dst->update_record(
             conn, table_info->dst_table_name, primary_fields, primary_values,
-            table_info->subsidiary_fields, subsidiary_values)) {
+            subsidiary_fields, subsidiary_values)) {
       LCH_ListDestroy(subsidiary_values);
+      LCH_ListDestroy(subsidiary_fields);
       LCH_ListDestroy(primary_values);
       LCH_ListDestroy(keys);
       return false;
     }
+    LCH_MetricsCountRowsPatched(1);
 
     LCH_ListDestroy(subsidiary_values);
+    LCH_ListDestroy(subsidiary_fields);
     LCH_ListDestroy(primary_values);
   }
 
@@ -725,18 +1372,35 @@ static bool TablePatchUpdates(const LCH_TableInfo *const table_info,
 
 bool LCH_TablePatch(const LCH_TableInfo *const table_info,
                     const char *const type, const char *const field,
-                    const char *const value, const LCH_Json *const inserts,
-                    const LCH_Json *const deletes,
-                    const LCH_Json *const updates) {
+                    const char *const value, const LCH_Json *const delta) {
   assert(table_info != NULL);
   assert(type != NULL);
   assert(field != NULL);
   assert(value != NULL);
-  assert(inserts != NULL);
-  assert(deletes != NULL);
-  assert(updates != NULL);
+  assert(delta != NULL);
+
+  const LCH_Json *const inserts = GetSection(delta, "inserts");
+  if (inserts == NULL) {
+    return false;
+  }
+
+  const LCH_Json *const deletes = GetSection(delta, "deletes");
+  if (deletes == NULL) {
+    return false;
+  }
+
+  const LCH_Json *const updates = GetSection(delta, "updates");
+  if (updates == NULL) {
+    return false;
+  }
+
+  if (!ResolveDestinationCallbacks(table_info)) {
+    LCH_LOG_ERROR("Failed to load destination callbacks for table '%s'",
+                  table_info->identifier);
+    return false;
+  }
 
-  void *const conn = table_info->dst_connect(table_info->dst_params);
+  void *const conn = table_info->dst->connect(table_info->dst_params);
   if (conn == NULL) {
     LCH_LOG_ERROR("Failed to connect with parameters '%s'",
                   table_info->dst_params);
@@ -747,38 +1411,40 @@ bool LCH_TablePatch(const LCH_TableInfo *const table_info,
       LCH_ListCopy(table_info->primary_fields,
                    (LCH_DuplicateFn)LCH_BufferDuplicate, LCH_BufferDestroy);
   if (primary_fields == NULL) {
-    table_info->dst_disconnect(conn);
+    table_info->dst->disconnect(conn);
     return false;
   }
 
   {
     LCH_Buffer *const buffer = LCH_BufferFromString(field);
     if (buffer == NULL) {
-      table_info->dst_disconnect(conn);
+      table_info->dst->disconnect(conn);
       LCH_ListDestroy(primary_fields);
       return false;
     }
 
     if (!LCH_ListInsert(primary_fields, 0, buffer, LCH_BufferDestroy)) {
-      table_info->dst_disconnect(conn);
+      table_info->dst->disconnect(conn);
       LCH_BufferDestroy(buffer);
       LCH_ListDestroy(primary_fields);
       return false;
     }
   }
 
-  if (!table_info->dst_create_table(conn, table_info->dst_table_name,
+  LCH_MetricsCountStatement();
+  if (!table_info->dst->create_table(conn, table_info->dst_table_name,
                                     primary_fields,
                                     table_info->subsidiary_fields)) {
     LCH_LOG_ERROR("Failed to create table '%s'", table_info->dst_table_name);
-    table_info->dst_disconnect(conn);
+    table_info->dst->disconnect(conn);
     LCH_ListDestroy(primary_fields);
     return false;
   }
 
-  if (!table_info->dst_begin_tx(conn)) {
+  LCH_MetricsCountStatement();
+  if (!table_info->dst->begin_tx(conn)) {
     LCH_LOG_ERROR("Failed to begin transaction");
-    table_info->dst_disconnect(conn);
+    table_info->dst->disconnect(conn);
     LCH_ListDestroy(primary_fields);
     return false;
   }
@@ -786,10 +1452,11 @@ bool LCH_TablePatch(const LCH_TableInfo *const table_info,
   if (LCH_StringEqual(type, "rebase")) {
     LCH_LOG_INFO("Patch type is 'rebase': Truncating table '%s'",
                  table_info->dst_table_name);
-    if (!table_info->dst_truncate_table(conn, table_info->dst_table_name, field,
+    LCH_MetricsCountStatement();
+    if (!table_info->dst->truncate_table(conn, table_info->dst_table_name, field,
                                         value)) {
       LCH_LOG_ERROR("Failed to truncate table");
-      table_info->dst_disconnect(conn);
+      table_info->dst->disconnect(conn);
       LCH_ListDestroy(primary_fields);
       return false;
     }
@@ -798,10 +1465,11 @@ bool LCH_TablePatch(const LCH_TableInfo *const table_info,
   if (!TablePatchDeletes(table_info, primary_fields, value, deletes, conn)) {
     LCH_LOG_INFO("Performing rollback of transactions for table '%s'",
                  table_info->dst_table_name);
-    if (!table_info->dst_rollback_tx(conn)) {
+    LCH_MetricsCountStatement();
+    if (!table_info->dst->rollback_tx(conn)) {
       LCH_LOG_ERROR("Failed to rollback transactions");
     }
-    table_info->dst_disconnect(conn);
+    table_info->dst->disconnect(conn);
     LCH_ListDestroy(primary_fields);
     return false;
   }
@@ -809,10 +1477,11 @@ bool LCH_TablePatch(const LCH_TableInfo *const table_info,
   if (!TablePatchUpdates(table_info, primary_fields, value, updates, conn)) {
     LCH_LOG_INFO("Performing rollback of transactions for table '%s'",
                  table_info->dst_table_name);
-    if (!table_info->dst_rollback_tx(conn)) {
+    LCH_MetricsCountStatement();
+    if (!table_info->dst->rollback_tx(conn)) {
       LCH_LOG_ERROR("Failed to rollback transactions");
     }
-    table_info->dst_disconnect(conn);
+    table_info->dst->disconnect(conn);
     LCH_ListDestroy(primary_fields);
     return false;
   }
@@ -823,18 +1492,18 @@ bool LCH_TablePatch(const LCH_TableInfo *const table_info,
       LCH_ListCopy(table_info->all_fields, (LCH_DuplicateFn)LCH_BufferDuplicate,
                    LCH_BufferDestroy);
   if (all_fields == NULL) {
-    table_info->dst_disconnect(conn);
+    table_info->dst->disconnect(conn);
     return false;
   }
 
   LCH_Buffer *const buffer = LCH_BufferFromString(field);
   if (buffer == NULL) {
-    table_info->dst_disconnect(conn);
+    table_info->dst->disconnect(conn);
     return false;
   }
 
   if (!LCH_ListInsert(all_fields, 0, buffer, LCH_BufferDestroy)) {
-    table_info->dst_disconnect(conn);
+    table_info->dst->disconnect(conn);
     LCH_BufferDestroy(buffer);
     LCH_ListDestroy(all_fields);
     return false;
@@ -843,23 +1512,25 @@ bool LCH_TablePatch(const LCH_TableInfo *const table_info,
   if (!TablePatchInserts(table_info, all_fields, value, inserts, conn)) {
     LCH_LOG_INFO("Performing rollback of transactions for table '%s'",
                  table_info->dst_table_name);
-    if (!table_info->dst_rollback_tx(conn)) {
+    LCH_MetricsCountStatement();
+    if (!table_info->dst->rollback_tx(conn)) {
       LCH_LOG_ERROR("Failed to rollback transactions");
     }
-    table_info->dst_disconnect(conn);
+    table_info->dst->disconnect(conn);
     LCH_ListDestroy(all_fields);
     return false;
   }
 
   LCH_ListDestroy(all_fields);
 
-  if (!table_info->dst_commit_tx(conn)) {
+  LCH_MetricsCountStatement();
+  if (!table_info->dst->commit_tx(conn)) {
     LCH_LOG_ERROR("Failed to commit transaction");
-    table_info->dst_disconnect(conn);
+    table_info->dst->disconnect(conn);
     return false;
   }
 
-  table_info->dst_disconnect(conn);
+  table_info->dst->disconnect(conn);
   return true;
 }
 
@@ -4,6 +4,8 @@
 #include <stdbool.h>
 #include <stdlib.h>
 
+#include "compression.h"
+#include "dict.h"
 #include "json.h"
 #include "list.h"
 
@@ -11,8 +13,19 @@ typedef struct LCH_TableInfo LCH_TableInfo;
 
 void LCH_TableInfoDestroy(void *info);
 
+/**
+ * @brief Load a table definition
+ * @param identifer Unique table identifier
+ * @param table_info The table definition from the configuration file
+ * @param modules Dictionary in which handles of loaded modules are kept
+ * @return The table definition or NULL in case of failure
+ * @note The source and destination modules are not loaded until they are
+ *       needed. The modules dictionary is shared between tables and must
+ *       outlive the table definition.
+ */
 LCH_TableInfo *LCH_TableInfoLoad(const char *identifer,
-                                 const LCH_Json *table_info);
+                                 const LCH_Json *table_info,
+                                 LCH_Dict *modules);
 
 const char *LCH_TableInfoGetIdentifier(const LCH_TableInfo *table_info);
 
@@ -23,6 +36,14 @@ const char *LCH_TableInfoGetIdentifier(const LCH_TableInfo *table_info);
  */
 bool LCH_TableInfoShouldMergeTable(const LCH_TableInfo *table_info);
 
+/**
+ * @brief Whether or not the "partial_updates" field is set for this table
+ * @param table_info The table definition
+ * @return True if update operations should only contain the changed fields,
+ *         otherwise false
+ */
+bool LCH_TableInfoShouldUsePartialUpdates(const LCH_TableInfo *table_info);
+
 LCH_Json *LCH_TableInfoLoadNewState(const LCH_TableInfo *table_info);
 
 LCH_Json *LCH_TableInfoLoadOldState(const LCH_TableInfo *table_info,
@@ -30,12 +51,96 @@ LCH_Json *LCH_TableInfoLoadOldState(const LCH_TableInfo *table_info,
 
 bool LCH_TableStoreNewState(const LCH_TableInfo *table_info,
                             const char *work_dir, bool pretty_print,
+                            LCH_Compression compression,
                             const LCH_Json *new_state);
 
+/**
+ * @brief Record the changes of a delta in the snapshot log
+ * @param table_info The table definition
+ * @param work_dir The work directory
+ * @param log_limit Maximum size of the log in percent of the snapshot size
+ * @param delta The delta between the stored snapshot and the new state
+ * @param new_state The new state as it would be stored in the snapshot
+ * @param appended The variable in which to store whether the changes were
+ *                 appended to the log
+ * @return False in case of failure
+ * @note Nothing is appended if there is no snapshot yet, or if the log would
+ *       grow beyond the limit. The caller must then store the complete state
+ *       with LCH_TableStoreNewState(), which also removes the log.
+ */
+bool LCH_TableAppendNewState(const LCH_TableInfo *table_info,
+                             const char *work_dir, size_t log_limit,
+                             const LCH_Json *delta, const LCH_Json *new_state,
+                             bool *appended);
+
+/**
+ * @brief Compose the path of the snapshot log of a table
+ * @param path The buffer in which to store the path
+ * @param path_max The size of the buffer
+ * @param work_dir The work directory
+ * @param table_id The table identifier
+ * @return False in case of failure
+ */
+bool LCH_TableSnapshotLogPath(char *path, size_t path_max, const char *work_dir,
+                              const char *table_id);
+
+/**
+ * @brief Get a cheap fingerprint of the table from the source
+ * @param table_info The table definition
+ * @return The fingerprint or NULL if not available
+ * @note The fingerprint is only available if the source module implements the
+ *       optional LCH_CallbackGetFingerprint() function. A failure to obtain the
+ *       fingerprint is not fatal, as the table can still be loaded.
+ */
+LCH_Buffer *LCH_TableInfoLoadFingerprint(const LCH_TableInfo *table_info);
+
+/**
+ * @brief Check whether a fingerprint matches the one stored with the snapshot
+ * @param table_info The table definition
+ * @param work_dir The work directory
+ * @param fingerprint The fingerprint of the current table
+ * @return True if the table is known to be unchanged since the last snapshot
+ */
+bool LCH_TableFingerprintMatches(const LCH_TableInfo *table_info,
+                                 const char *work_dir,
+                                 const LCH_Buffer *fingerprint);
+
+/**
+ * @brief Store the fingerprint next to the snapshot
+ * @param table_info The table definition
+ * @param work_dir The work directory
+ * @param fingerprint The fingerprint or NULL to remove any stored fingerprint
+ * @return False in case of failure
+ */
+bool LCH_TableStoreFingerprint(const LCH_TableInfo *table_info,
+                               const char *work_dir,
+                               const LCH_Buffer *fingerprint);
+
+/**
+ * @brief Create a copy of a table state holding row digests instead of values
+ * @param state The table state
+ * @return The digested state or NULL in case of failure
+ * @note The subsidiary value of each row is replaced by the first
+ *       LCH_ROW_DIGEST_LENGTH hex characters of its SHA-1 digest. This is
+ *       enough to detect updates, but not to recover the value.
+ */
+LCH_Json *LCH_TableStateDigest(const LCH_Json *state);
+
+/**
+ * @brief Apply a delta to the destination table
+ * @param table_info The table definition
+ * @param type The type of the delta (i.e., "delta" or "rebase")
+ * @param field The name of the column identifying the source host
+ * @param value The value identifying the source host
+ * @param delta The delta
+ * @return False in case of failure
+ * @note Records in the delta sections are either CSV strings, or already
+ *       split into fields (see LCH_EncodingParseFields()). Split fields are
+ *       passed on to the destination callbacks without copying them.
+ */
 bool LCH_TablePatch(const LCH_TableInfo *table_info, const char *type,
                     const char *field, const char *value,
-                    const LCH_Json *inserts, const LCH_Json *deletes,
-                    const LCH_Json *updates);
+                    const LCH_Json *delta);
 
 const LCH_List *LCH_TableInfoGetPrimaryFields(const LCH_TableInfo *table_info);
 
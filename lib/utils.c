@@ -17,12 +17,12 @@
 
 static bool IndicesOfFieldsInHeader(size_t *const indices,
                                     const LCH_List *const fields,
-                                    const LCH_List *const header) {
+                                    const LCH_Table *const table) {
   assert(indices != NULL);
   assert(fields != NULL);
-  assert(header != NULL);
+  assert(table != NULL);
 
-  const size_t header_len = LCH_ListLength(header);
+  const size_t num_columns = LCH_TableGetNumColumns(table);
 
   const size_t num_fields = LCH_ListLength(fields);
   for (size_t i = 0; i < num_fields; i++) {
@@ -31,10 +31,10 @@ static bool IndicesOfFieldsInHeader(size_t *const indices,
       return false;
     }
 
-    const size_t index =
-        LCH_ListIndex(header, field, (LCH_CompareFn)LCH_BufferCompare);
-    if (index >= header_len) {
-      LCH_LOG_ERROR("Field '%s' not found in table header");
+    const size_t index = LCH_TableGetColumnIndex(table, field);
+    if (index >= num_columns) {
+      LCH_LOG_ERROR("Field '%s' not found in table header",
+                    LCH_BufferData(field));
       return false;
     }
     indices[i] = index;
@@ -44,49 +44,25 @@ static bool IndicesOfFieldsInHeader(size_t *const indices,
 
 /******************************************************************************/
 
-static LCH_List *FieldsInRecordAtIndices(const size_t *const indices,
-                                         const size_t num_indices,
-                                         const LCH_List *const record) {
-  LCH_List *fields = LCH_ListCreate();
-  if (fields == NULL) {
-    return NULL;
-  }
-
-  for (size_t i = 0; i < num_indices; i++) {
-    const size_t index = indices[i];
-    LCH_Buffer *const field = (LCH_Buffer *)LCH_ListGet(record, index);
-    assert(field != NULL);
-
-    if (!LCH_ListAppend(fields, field, NULL)) {
-      LCH_ListDestroy(fields);
-      return NULL;
-    }
-  }
-
-  return fields;
-}
-
-/******************************************************************************/
-
-LCH_Json *LCH_TableToJsonObject(const LCH_List *const table,
+LCH_Json *LCH_TableToJsonObject(const LCH_Table *const table,
                                 const LCH_List *const primary_fields,
                                 const LCH_List *const subsidiary_fields) {
-  const size_t num_records = LCH_ListLength(table);
+  const size_t num_records = LCH_TableGetNumRows(table);
   assert(num_records >= 1);  // Require at least a table header
-  const LCH_List *const header = (LCH_List *)LCH_ListGet(table, 0);
 
   const size_t num_primary = LCH_ListLength(primary_fields);
   const size_t num_subsidiary = LCH_ListLength(subsidiary_fields);
   assert(num_primary > 0);  // Require at least one primary field
-  assert(LCH_ListLength(header) == num_primary + num_subsidiary);
+  assert(LCH_TableGetNumColumns(table) == num_primary + num_subsidiary);
 
   size_t primary_indices[num_primary];
-  if (!IndicesOfFieldsInHeader(primary_indices, primary_fields, header)) {
+  if (!IndicesOfFieldsInHeader(primary_indices, primary_fields, table)) {
     return NULL;
   }
 
-  size_t subsidiary_indices[num_subsidiary];
-  if (!IndicesOfFieldsInHeader(subsidiary_indices, subsidiary_fields, header)) {
+  /* Variable length arrays of size zero are undefined behavior */
+  size_t subsidiary_indices[num_subsidiary + 1];
+  if (!IndicesOfFieldsInHeader(subsidiary_indices, subsidiary_fields, table)) {
     return NULL;
   }
 
@@ -96,47 +72,21 @@ LCH_Json *LCH_TableToJsonObject(const LCH_List *const table,
   }
 
   for (size_t i = 1; i < num_records; i++) {
-    const LCH_List *const record = (LCH_List *)LCH_ListGet(table, i);
-    assert(record != NULL);
-    assert(LCH_ListLength(header) == LCH_ListLength(record));
-
     // Create key from primary fields
     LCH_Buffer *key = NULL;
-    {
-      LCH_List *const list =
-          FieldsInRecordAtIndices(primary_indices, num_primary, record);
-      if (list == NULL) {
-        LCH_JsonDestroy(object);
-        return NULL;
-      }
-
-      if (!LCH_CSVComposeRecord(&key, list)) {
-        LCH_ListDestroy(list);
-        LCH_JsonDestroy(object);
-        return NULL;
-      }
-
-      LCH_ListDestroy(list);
+    if (!LCH_CSVComposeRecordColumnar(&key, table, i, primary_indices,
+                                      num_primary)) {
+      LCH_JsonDestroy(object);
+      return NULL;
     }
 
     // Create value from subsidiary fields
     LCH_Buffer *value = NULL;
-    {
-      LCH_List *const list =
-          FieldsInRecordAtIndices(subsidiary_indices, num_subsidiary, record);
-      if (list == NULL) {
-        LCH_BufferDestroy(key);
-        LCH_JsonDestroy(object);
-        return NULL;
-      }
-
-      if (!LCH_CSVComposeRecord(&value, list)) {
-        LCH_ListDestroy(list);
-        LCH_BufferDestroy(key);
-        LCH_JsonDestroy(object);
-        return NULL;
-      }
-      LCH_ListDestroy(list);
+    if (!LCH_CSVComposeRecordColumnar(&value, table, i, subsidiary_indices,
+                                      num_subsidiary)) {
+      LCH_BufferDestroy(key);
+      LCH_JsonDestroy(object);
+      return NULL;
     }
 
     assert(key != NULL);
@@ -5,10 +5,11 @@
 #include <stdio.h>
 
 #include "buffer.h"
+#include "columnar.h"
 #include "json.h"
 #include "list.h"
 
-LCH_Json *LCH_TableToJsonObject(const LCH_List *table,
+LCH_Json *LCH_TableToJsonObject(const LCH_Table *table,
                                 const LCH_List *primary_fields,
                                 const LCH_List *subsidiary_fields);
 
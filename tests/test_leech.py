@@ -3,6 +3,8 @@ import os
 import json
 import csv
 import psycopg2
+import signal
+import socket
 import time
 
 
@@ -732,6 +734,298 @@ def test_leech_csv_binary(tmp_path):
     assert execute(command, True) == 0
 
 
+def test_leech_csv_binary_encoding(tmp_path):
+    bin_path = os.path.join("bin", "leech")
+    leech_conf_path = os.path.join(tmp_path, "leech.json")
+    table_src_path = os.path.join(tmp_path, "beatles.src.csv")
+    table_dst_path = os.path.join(tmp_path, "beatles.dst.csv")
+
+    config = {
+        "version": "0.1.0",
+        "encoding": "binary",
+        "tables": {
+            "BTL": {
+                "primary_fields": ["first_name", "last_name"],
+                "subsidiary_fields": ["born", "band"],
+                "source": {
+                    "params": table_src_path,
+                    "schema": "leech",
+                    "table_name": "beatles",
+                    "callbacks": "lib/.libs/leech_csv.so",
+                },
+                "destination": {
+                    "params": table_dst_path,
+                    "schema": "leech",
+                    "table_name": "beatles",
+                    "callbacks": "lib/.libs/leech_csv.so",
+                },
+            }
+        },
+    }
+    with open(leech_conf_path, "w") as f:
+        json.dump(config, f, indent=2)
+
+    tables = [
+        [
+            ["first_name", "last_name", "born", "band"],
+            ["Paul", "McCartney", "1942", "The Beatles"],
+            ["Ringo", "Starr", "1940", "The Beatles"],
+            ["John", "Lennon", "1940", 'The "Fab" Four'],
+        ],
+        [
+            ["first_name", "last_name", "born", "band"],
+            ["Paul", "McCartney", "1942", "Wings, The Beatles"],
+            ["John", "Lennon", "1940", 'The "Fab" Four'],
+            ["Janis", "Joplin", "1943", ""],
+        ],
+    ]
+
+    lastknown = "0000000000000000000000000000000000000000"
+    for table in tables:
+        with open(table_src_path, "w", newline="") as f:
+            writer = csv.writer(f)
+            writer.writerows(table)
+
+        command = [bin_path, "--debug", f"--workdir={tmp_path}", "commit"]
+        assert execute(command, True) == 0
+
+        # Records are split into fields when applying binary encoded patches
+        patchfile = os.path.join(tmp_path, "patchfile")
+        command = [
+            bin_path,
+            "--debug",
+            f"--workdir={tmp_path}",
+            "diff",
+            f"--block={lastknown}",
+            f"--file={patchfile}",
+        ]
+        assert execute(command, True) == 0
+
+        command = [
+            bin_path,
+            "--debug",
+            f"--workdir={tmp_path}",
+            "patch",
+            "--field=host_id",
+            "--value=SHA=123",
+            f"--file={patchfile}",
+        ]
+        assert execute(command, True) == 0
+
+        with open(table_dst_path, "r", newline="") as f:
+            rows = list(csv.reader(f))
+        assert rows[0] == ["host_id"] + table[0]
+        assert sorted(rows[1:]) == sorted(["SHA=123"] + row for row in table[1:])
+
+        with open(os.path.join(tmp_path, "SHA=123"), "r") as f:
+            lastknown = f.read().strip()
+
+
+def test_leech_csv_fingerprint_skip(tmp_path):
+    bin_path = os.path.join("bin", "leech")
+    leech_conf_path = os.path.join(tmp_path, "leech.json")
+
+    tables = {}
+    for table_id in ["BTL", "STN"]:
+        tables[table_id] = {
+            "primary_fields": ["first_name", "last_name"],
+            "subsidiary_fields": ["born"],
+            "source": {
+                "params": os.path.join(tmp_path, f"{table_id}.src.csv"),
+                "schema": "leech",
+                "table_name": table_id,
+                "callbacks": "lib/.libs/leech_csv.so",
+            },
+            "destination": {
+                "params": os.path.join(tmp_path, f"{table_id}.dst.csv"),
+                "schema": "leech",
+                "table_name": table_id,
+                "callbacks": "lib/.libs/leech_csv.so",
+            },
+        }
+    config = {"version": "0.1.0", "tables": tables}
+    with open(leech_conf_path, "w") as f:
+        json.dump(config, f, indent=2)
+
+    contents = {
+        "BTL": [
+            ["first_name", "last_name", "born"],
+            ["Paul", "McCartney", "1942"],
+        ],
+        "STN": [
+            ["first_name", "last_name", "born"],
+            ["Mick", "Jagger", "1943"],
+        ],
+    }
+
+    def write_table(table_id):
+        with open(tables[table_id]["source"]["params"], "w", newline="") as f:
+            writer = csv.writer(f)
+            writer.writerows(contents[table_id])
+
+    def commit():
+        command = [bin_path, "--debug", f"--workdir={tmp_path}", "commit"]
+        proc = subprocess.run(command, capture_output=True)
+        output = proc.stdout.decode(errors="ignore")
+        output += proc.stderr.decode(errors="ignore")
+        print(output, end="")
+        assert proc.returncode == 0
+        return output
+
+    write_table("BTL")
+    write_table("STN")
+    commit()
+
+    # Change the tables in alternate commits, such that each block leaves out
+    # the table skipped by its fingerprint
+    contents["BTL"].append(["John", "Lennon", "1940"])
+    write_table("BTL")
+    assert "Fingerprint of table 'STN' is unchanged" in commit()
+
+    contents["STN"].append(["Keith", "Richards", "1943"])
+    write_table("STN")
+    assert "Fingerprint of table 'BTL' is unchanged" in commit()
+
+    patchfile = os.path.join(tmp_path, "patchfile")
+    command = [
+        bin_path,
+        "--debug",
+        f"--workdir={tmp_path}",
+        "diff",
+        "--block=0000000000000000000000000000000000000000",
+        f"--file={patchfile}",
+    ]
+    assert execute(command, True) == 0
+
+    command = [
+        bin_path,
+        "--debug",
+        f"--workdir={tmp_path}",
+        "patch",
+        "--field=host_id",
+        "--value=SHA=123",
+        f"--file={patchfile}",
+    ]
+    assert execute(command, True) == 0
+
+    for table_id, table in contents.items():
+        with open(tables[table_id]["destination"]["params"], "r") as f:
+            rows = list(csv.reader(f))
+        assert rows[0] == ["host_id"] + table[0]
+        expected = [["SHA=123"] + row for row in table[1:]]
+        assert sorted(rows[1:]) == sorted(expected)
+
+
+def test_leech_csv_update_by_column_name(tmp_path):
+    bin_path = os.path.join("bin", "leech")
+    leech_conf_path = os.path.join(tmp_path, "leech.json")
+    table_src_path = os.path.join(tmp_path, "BTL.src.csv")
+    table_dst_path = os.path.join(tmp_path, "BTL.dst.csv")
+
+    config = {
+        "version": "0.1.0",
+        "tables": {
+            "BTL": {
+                "primary_fields": ["first_name", "last_name"],
+                "subsidiary_fields": ["born", "band"],
+                "source": {
+                    "params": table_src_path,
+                    "schema": "leech",
+                    "table_name": "BTL",
+                    "callbacks": "lib/.libs/leech_csv.so",
+                },
+                "destination": {
+                    "params": table_dst_path,
+                    "schema": "leech",
+                    "table_name": "BTL",
+                    "callbacks": "lib/.libs/leech_csv.so",
+                },
+            }
+        },
+    }
+    with open(leech_conf_path, "w") as f:
+        json.dump(config, f, indent=2)
+
+    table = [
+        ["first_name", "last_name", "born", "band"],
+        ["Paul", "McCartney", "1942", "The Beatles"],
+        ["John", "Lennon", "1940", "The Beatles"],
+    ]
+
+    lastknown = "0000000000000000000000000000000000000000"
+
+    def commit_and_patch():
+        with open(table_src_path, "w", newline="") as f:
+            writer = csv.writer(f)
+            writer.writerows(table)
+
+        command = [bin_path, "--debug", f"--workdir={tmp_path}", "commit"]
+        assert execute(command, True) == 0
+
+        patchfile = os.path.join(tmp_path, "patchfile")
+        command = [
+            bin_path,
+            "--debug",
+            f"--workdir={tmp_path}",
+            "diff",
+            f"--block={lastknown}",
+            f"--file={patchfile}",
+        ]
+        assert execute(command, True) == 0
+
+        command = [
+            bin_path,
+            "--debug",
+            f"--workdir={tmp_path}",
+            "patch",
+            "--field=host_id",
+            "--value=SHA=123",
+            f"--file={patchfile}",
+        ]
+        return execute(command, True)
+
+    assert commit_and_patch() == 0
+    with open(os.path.join(tmp_path, "SHA=123"), "r") as f:
+        lastknown = f.read().strip()
+
+    # Swap the subsidiary columns of the destination, such that updates only
+    # end up in the right column if it is located by name
+    with open(table_dst_path, "r", newline="") as f:
+        rows = list(csv.reader(f))
+    rows = [row[:3] + [row[4], row[3]] for row in rows]
+    with open(table_dst_path, "w", newline="") as f:
+        writer = csv.writer(f)
+        writer.writerows(rows)
+
+    table[1][3] = "Wings"
+    assert commit_and_patch() == 0
+    with open(os.path.join(tmp_path, "SHA=123"), "r") as f:
+        lastknown = f.read().strip()
+
+    with open(table_dst_path, "r", newline="") as f:
+        rows = list(csv.reader(f))
+    assert rows[0] == ["host_id", "first_name", "last_name", "band", "born"]
+    assert sorted(rows[1:]) == sorted(
+        [
+            ["SHA=123", "Paul", "McCartney", "Wings", "1942"],
+            ["SHA=123", "John", "Lennon", "The Beatles", "1940"],
+        ]
+    )
+
+    # Updating a column missing from the header of the destination fails,
+    # rather than writing the value into another column
+    rows[0][3] = "group"
+    with open(table_dst_path, "w", newline="") as f:
+        writer = csv.writer(f)
+        writer.writerows(rows)
+
+    table[2][3] = "Plastic Ono Band"
+    assert commit_and_patch() != 0
+
+    with open(table_dst_path, "r", newline="") as f:
+        assert list(csv.reader(f)) == rows
+
+
 def test_leech_purge(tmp_path):
     ##########################################################################
     # Create config
@@ -828,6 +1122,262 @@ def test_leech_auto_purge(tmp_path):
     assert len(os.listdir(os.path.join(tmp_path, "blocks"))) == 3
 
 
+def test_leech_fan_out_blocks(tmp_path):
+    ##########################################################################
+    # Create config
+    ##########################################################################
+
+    bin_path = os.path.join("bin", "leech")
+    leech_conf_path = os.path.join(tmp_path, "leech.json")
+    table_src_path = os.path.join(tmp_path, "beatles.src.csv")
+    table_dst_path = os.path.join(tmp_path, "beatles.dst.csv")
+    blocks_path = os.path.join(tmp_path, "blocks")
+
+    config = {
+        "version": "0.1.0",
+        "fan_out_blocks": True,
+        "chain_length": 3,
+        "tables": {
+            "BTL": {
+                "primary_fields": ["first_name", "last_name"],
+                "subsidiary_fields": ["born"],
+                "source": {
+                    "params": table_src_path,
+                    "schema": "leech",
+                    "table_name": "beatles",
+                    "callbacks": "lib/.libs/leech_csv.so",
+                },
+                "destination": {
+                    "params": table_dst_path,
+                    "schema": "leech",
+                    "table_name": "beatles",
+                    "callbacks": "lib/.libs/leech_csv.so",
+                },
+            }
+        },
+    }
+    with open(leech_conf_path, "w") as f:
+        json.dump(config, f, indent=2)
+    print(f"Created leech config '{leech_conf_path}' with content:")
+    with open(leech_conf_path, "r") as f:
+        print(f.read())
+
+    def count_blocks():
+        flat, fan_out = 0, 0
+        for entry in os.listdir(blocks_path):
+            path = os.path.join(blocks_path, entry)
+            if os.path.isdir(path):
+                fan_out += len(os.listdir(path))
+            else:
+                flat += 1
+        return flat, fan_out
+
+    for _ in range(5):
+        command = [bin_path, "--debug", f"--workdir={tmp_path}", "commit"]
+        assert execute(command, True) == 0
+
+    assert count_blocks() == (0, 5)
+
+    command = [bin_path, "--debug", f"--workdir={tmp_path}", "purge"]
+    assert execute(command, True) == 0
+
+    assert count_blocks() == (0, 3)
+
+    ##########################################################################
+    # Migrate to the flat layout
+    ##########################################################################
+
+    config["fan_out_blocks"] = False
+    with open(leech_conf_path, "w") as f:
+        json.dump(config, f, indent=2)
+
+    command = [bin_path, "--debug", f"--workdir={tmp_path}", "migrate"]
+    assert execute(command, True) == 0
+
+    assert count_blocks() == (3, 0)
+
+    command = [bin_path, "--debug", f"--workdir={tmp_path}", "commit"]
+    assert execute(command, True) == 0
+
+    assert count_blocks() == (4, 0)
+
+
+def test_leech_pack_blocks(tmp_path):
+    ##########################################################################
+    # Create config
+    ##########################################################################
+
+    bin_path = os.path.join("bin", "leech")
+    leech_conf_path = os.path.join(tmp_path, "leech.json")
+    table_src_path = os.path.join(tmp_path, "beatles.src.csv")
+    table_dst_path = os.path.join(tmp_path, "beatles.dst.csv")
+    blocks_path = os.path.join(tmp_path, "blocks")
+    packs_path = os.path.join(tmp_path, "packs")
+
+    config = {
+        "version": "0.1.0",
+        "pack_blocks": True,
+        "chain_length": 3,
+        "tables": {
+            "BTL": {
+                "primary_fields": ["first_name", "last_name"],
+                "subsidiary_fields": ["born"],
+                "source": {
+                    "params": table_src_path,
+                    "schema": "leech",
+                    "table_name": "beatles",
+                    "callbacks": "lib/.libs/leech_csv.so",
+                },
+                "destination": {
+                    "params": table_dst_path,
+                    "schema": "leech",
+                    "table_name": "beatles",
+                    "callbacks": "lib/.libs/leech_csv.so",
+                },
+            }
+        },
+    }
+    with open(leech_conf_path, "w") as f:
+        json.dump(config, f, indent=2)
+    print(f"Created leech config '{leech_conf_path}' with content:")
+    with open(leech_conf_path, "r") as f:
+        print(f.read())
+
+    for _ in range(5):
+        command = [bin_path, "--debug", f"--workdir={tmp_path}", "commit"]
+        assert execute(command, True) == 0
+
+    assert os.listdir(blocks_path) == []
+    assert os.listdir(packs_path) == ["00000001.pack"]
+
+    command = [bin_path, "--debug", f"--workdir={tmp_path}", "purge"]
+    assert execute(command, True) == 0
+
+    # The segment holding the purged blocks is rewritten
+    assert os.listdir(packs_path) == ["00000002.pack"]
+
+    ##########################################################################
+    # Migrate to a file per block
+    ##########################################################################
+
+    config["pack_blocks"] = False
+    with open(leech_conf_path, "w") as f:
+        json.dump(config, f, indent=2)
+
+    command = [bin_path, "--debug", f"--workdir={tmp_path}", "migrate"]
+    assert execute(command, True) == 0
+
+    assert len(os.listdir(blocks_path)) == 3
+    assert os.listdir(packs_path) == []
+
+    command = [bin_path, "--debug", f"--workdir={tmp_path}", "commit"]
+    assert execute(command, True) == 0
+
+    assert len(os.listdir(blocks_path)) == 4
+
+
+def test_leech_snapshot_log(tmp_path):
+    ##########################################################################
+    # Create config
+    ##########################################################################
+
+    bin_path = os.path.join("bin", "leech")
+    leech_conf_path = os.path.join(tmp_path, "leech.json")
+    table_src_path = os.path.join(tmp_path, "beatles.src.csv")
+    table_dst_path = os.path.join(tmp_path, "beatles.dst.csv")
+    snapshot_path = os.path.join(tmp_path, "snapshot", "BTL")
+    snapshot_log_path = os.path.join(tmp_path, "snapshot", "BTL.log")
+
+    config = {
+        "version": "0.1.0",
+        "snapshot_log": True,
+        "snapshot_log_limit": 100,
+        "tables": {
+            "BTL": {
+                "primary_fields": ["first_name", "last_name"],
+                "subsidiary_fields": ["born"],
+                "source": {
+                    "params": table_src_path,
+                    "schema": "leech",
+                    "table_name": "beatles",
+                    "callbacks": "lib/.libs/leech_csv.so",
+                },
+                "destination": {
+                    "params": table_dst_path,
+                    "schema": "leech",
+                    "table_name": "beatles",
+                    "callbacks": "lib/.libs/leech_csv.so",
+                },
+            }
+        },
+    }
+    with open(leech_conf_path, "w") as f:
+        json.dump(config, f, indent=2)
+    print(f"Created leech config '{leech_conf_path}' with content:")
+    with open(leech_conf_path, "r") as f:
+        print(f.read())
+
+    def commit(table):
+        with open(table_src_path, "w", newline="") as f:
+            writer = csv.writer(f)
+            writer.writerows(table)
+        command = [bin_path, "--debug", f"--workdir={tmp_path}", "commit"]
+        assert execute(command, True) == 0
+
+    ##########################################################################
+    # The first commit stores the complete snapshot
+    ##########################################################################
+
+    table = [
+        ["first_name", "last_name", "born"],
+        ["Paul", "McCartney", "1942"],
+        ["Ringo", "Starr", "1940"],
+        ["John", "Lennon", "1940"],
+        ["George", "Harrison", "1943"],
+    ]
+    commit(table)
+    assert os.path.isfile(snapshot_path)
+    assert not os.path.exists(snapshot_log_path)
+
+    ##########################################################################
+    # Following commits only append their changes to the log
+    ##########################################################################
+
+    snapshot_size = os.path.getsize(snapshot_path)
+    table[1][2] = "1943"
+    commit(table)
+    assert os.path.getsize(snapshot_path) == snapshot_size
+    log_size = os.path.getsize(snapshot_log_path)
+    assert log_size > 0
+
+    # The log is replayed onto the snapshot, hence nothing changed
+    commit(table)
+    assert os.path.getsize(snapshot_log_path) == log_size
+
+    ##########################################################################
+    # The log is compacted into a new snapshot once it grows too large
+    ##########################################################################
+
+    table = [
+        ["first_name", "last_name", "born"],
+        ["David", "Gilmour", "1946"],
+        ["Roger", "Waters", "1943"],
+        ["Nick", "Mason", "1944"],
+        ["Richard", "Wright", "1943"],
+    ]
+    commit(table)
+    assert not os.path.exists(snapshot_log_path)
+
+    with open(snapshot_path, "r") as f:
+        snapshot = json.load(f)
+    assert snapshot == {
+        "David,Gilmour": "1946",
+        "Roger,Waters": "1943",
+        "Nick,Mason": "1944",
+        "Richard,Wright": "1943",
+    }
+
+
 def test_leech_churn(tmp_path):
     ##########################################################################
     # Create config
@@ -1231,6 +1781,20 @@ def test_leech_history(tmp_path):
     assert len(history["history"]) == 3
     assert history["history"][1]["subsidiary"]["born"] == "1944"
 
+    # Headers missing from the chain file are indexed as the blocks are loaded
+    chain_path = os.path.join(tmp_path, "chain")
+    with open(chain_path, "r") as f:
+        assert len(f.readlines()) == 5
+    os.remove(chain_path)
+    assert execute(command, True) == 0
+
+    with open(history_path, "r") as f:
+        history = json.load(f)
+
+    assert len(history["history"]) == 3
+    with open(chain_path, "r") as f:
+        assert len(f.readlines()) == 5
+
 
 def test_disable_merging_blocks(tmp_path):
     ##########################################################################
@@ -1424,3 +1988,237 @@ def test_message_digest(tmp_path):
         f"--file={patchfile}",
     ]
     assert execute(command, True) == 1
+
+
+def request(socket_path, line, payload=b""):
+    print(f"Sending request '{line}' to '{socket_path}'")
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+        sock.connect(socket_path)
+        sock.sendall(line.encode() + b"\n" + payload)
+        sock.shutdown(socket.SHUT_WR)
+        response = b""
+        while True:
+            data = sock.recv(65536)
+            if not data:
+                break
+            response += data
+    status, _, result = response.partition(b"\n")
+    print(f"Request returned {status.decode()}")
+    return status == b"OK", result
+
+
+def test_leech_csv_serve(tmp_path):
+    ##########################################################################
+    # Create config and start server
+    ##########################################################################
+
+    bin_path = os.path.join("bin", "leech")
+    leech_conf_path = os.path.join(tmp_path, "leech.json")
+    table_src_path = os.path.join(tmp_path, "beatles.src.csv")
+    table_dst_path = os.path.join(tmp_path, "beatles.dst.csv")
+    socket_path = os.path.join(tmp_path, "leech.sock")
+
+    config = {
+        "version": "0.1.0",
+        "tables": {
+            "BTL": {
+                "primary_fields": ["first_name", "last_name"],
+                "subsidiary_fields": ["born"],
+                "source": {
+                    "params": table_src_path,
+                    "schema": "leech",
+                    "table_name": "beatles",
+                    "callbacks": "lib/.libs/leech_csv.so",
+                },
+                "destination": {
+                    "params": table_dst_path,
+                    "schema": "leech",
+                    "table_name": "beatles",
+                    "callbacks": "lib/.libs/leech_csv.so",
+                },
+            }
+        },
+    }
+    with open(leech_conf_path, "w") as f:
+        json.dump(config, f, indent=2)
+
+    # A socket left behind by a server that is no longer running is replaced
+    stale = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    stale.bind(socket_path)
+    stale.close()
+
+    server = subprocess.Popen(
+        [bin_path, "--debug", f"--workdir={tmp_path}", "serve"],
+    )
+    for _ in range(100):
+        with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+            if sock.connect_ex(socket_path) == 0:
+                break
+        time.sleep(0.05)
+    else:
+        assert False, "Server did not start listening"
+
+    try:
+        # The socket of a running server is not
+        command = [bin_path, "--debug", f"--workdir={tmp_path}", "serve"]
+        assert execute(command, False) != 0
+
+        # A client that stalls is dropped, rather than holding up others
+        with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as stalled:
+            stalled.connect(socket_path)
+            assert request(socket_path, "purge")[0]
+            assert stalled.recv(64) == b"ERROR\n"
+
+        ######################################################################
+        # Commit twice, such that the second commit uses the cached snapshot
+        ######################################################################
+
+        table = [
+            ["first_name", "last_name", "born"],
+            ["Paul", "McCartney", "1942"],
+            ["Ringo", "Starr", "1940"],
+            ["John", "Lennon", "1940"],
+        ]
+        with open(table_src_path, "w", newline="") as f:
+            csv.writer(f).writerows(table)
+        assert request(socket_path, "commit")[0]
+
+        table = [
+            ["first_name", "last_name", "born"],
+            ["Paul", "McCartney", "1942"],
+            ["John", "Lennon", "1940"],
+            ["George", "Harrison", "1943"],
+        ]
+        with open(table_src_path, "w", newline="") as f:
+            csv.writer(f).writerows(table)
+        assert request(socket_path, "commit")[0]
+
+        ######################################################################
+        # Diff and patch
+        ######################################################################
+
+        success, patch = request(socket_path, "diff")
+        assert success
+        assert request(socket_path, "patch host_id SHA=123", patch)[0]
+
+        with open(table_dst_path, "r", newline="") as f:
+            rows = list(csv.reader(f))
+        # The destination rows are prefixed with the host identifier
+        assert sorted(rows[1:]) == sorted(["SHA=123"] + row for row in table[1:])
+
+        with open(os.path.join(tmp_path, "SHA=123"), "r") as f:
+            lastknown = f.read().strip()
+
+        ######################################################################
+        # History and bad requests
+        ######################################################################
+
+        success, history = request(
+            socket_path, f"history BTL 0 {time.time() + 1}", b"Ringo,Starr"
+        )
+        assert success
+        operations = [e["operation"] for e in json.loads(history)["history"]]
+        assert operations == ["delete", "insert"]
+
+        # Histories of many records are fetched in a single walk of the chain
+        success, histories = request(
+            socket_path,
+            f"histories BTL 0 {time.time() + 1}",
+            b"Ringo,Starr\r\nGeorge,Harrison\r\nRingo,Starr\r\nPete,Best\r\n",
+        )
+        assert success
+        histories = json.loads(histories)["histories"]
+        assert [h["primary"]["first_name"] for h in histories] == [
+            "Ringo",
+            "George",
+            "Pete",
+        ]
+        operations = [[e["operation"] for e in h["history"]] for h in histories]
+        assert operations == [["delete", "insert"], ["insert"], []]
+
+        assert not request(socket_path, "history NOPE", b"Ringo,Starr")[0]
+        assert not request(socket_path, "bogus")[0]
+
+        ######################################################################
+        # Changing the config reloads the instance
+        ######################################################################
+
+        config["tables"]["BTL"]["subsidiary_fields"] = []
+        config["tables"]["BTL"]["primary_fields"] = ["first_name"]
+        with open(leech_conf_path, "w") as f:
+            json.dump(config, f, indent=2)
+        assert not request(socket_path, "history BTL", b"Ringo,Starr")[0]
+        assert request(socket_path, "purge")[0]
+    finally:
+        server.send_signal(signal.SIGTERM)
+        assert server.wait(timeout=10) == 0
+
+    assert not os.path.exists(socket_path)
+
+
+def test_leech_csv_serve_auto_purge(tmp_path):
+    ##########################################################################
+    # Create config and start server
+    ##########################################################################
+
+    bin_path = os.path.join("bin", "leech")
+    leech_conf_path = os.path.join(tmp_path, "leech.json")
+    table_src_path = os.path.join(tmp_path, "beatles.src.csv")
+    table_dst_path = os.path.join(tmp_path, "beatles.dst.csv")
+    socket_path = os.path.join(tmp_path, "leech.sock")
+    blocks_path = os.path.join(tmp_path, "blocks")
+
+    config = {
+        "version": "0.1.0",
+        "auto_purge": True,
+        "chain_length": 3,
+        "tables": {
+            "BTL": {
+                "primary_fields": ["first_name", "last_name"],
+                "subsidiary_fields": ["born"],
+                "source": {
+                    "params": table_src_path,
+                    "schema": "leech",
+                    "table_name": "beatles",
+                    "callbacks": "lib/.libs/leech_csv.so",
+                },
+                "destination": {
+                    "params": table_dst_path,
+                    "schema": "leech",
+                    "table_name": "beatles",
+                    "callbacks": "lib/.libs/leech_csv.so",
+                },
+            }
+        },
+    }
+    with open(leech_conf_path, "w") as f:
+        json.dump(config, f, indent=2)
+
+    with open(table_src_path, "w", newline="") as f:
+        csv.writer(f).writerows([["first_name", "last_name", "born"]])
+
+    server = subprocess.Popen(
+        [bin_path, "--debug", f"--workdir={tmp_path}", "serve"],
+    )
+    for _ in range(100):
+        if os.path.exists(socket_path):
+            break
+        time.sleep(0.05)
+    assert os.path.exists(socket_path)
+
+    try:
+        ######################################################################
+        # The purge is deferred until the server is idle
+        ######################################################################
+
+        for _ in range(5):
+            assert request(socket_path, "commit")[0]
+
+        for _ in range(100):
+            if len(os.listdir(blocks_path)) == 3:
+                break
+            time.sleep(0.05)
+        assert len(os.listdir(blocks_path)) == 3
+    finally:
+        server.send_signal(signal.SIGTERM)
+        assert server.wait(timeout=10) == 0
@@ -4,8 +4,11 @@
 #include <unistd.h>
 
 #include "../lib/block.h"
+#include "../lib/definitions.h"
 #include "../lib/files.h"
+#include "../lib/head.h"
 #include "../lib/logger.h"
+#include "../lib/string_lib.h"
 
 START_TEST(test_LCH_BlockCreate) {
   const char *const csv =
@@ -27,7 +30,7 @@ START_TEST(test_LCH_BlockCreate) {
   LCH_Json *const payload = LCH_JsonParse(csv, strlen(csv));
 
   const char *const head = "I'm the parent";
-  LCH_Json *const block = LCH_BlockCreate(head, payload);
+  LCH_Json *const block = LCH_BlockCreate(head, payload, LCH_ENCODING_JSON);
 
   {
     const LCH_Buffer key = LCH_BufferStaticFromString("timestamp");
@@ -41,8 +44,24 @@ START_TEST(test_LCH_BlockCreate) {
     const LCH_Buffer key = LCH_BufferStaticFromString("payload");
     ck_assert(LCH_JsonObjectHasKey(block, &key));
   }
+  {
+    size_t version;
+    ck_assert(LCH_BlockGetVersion(block, &version));
+    ck_assert_int_eq(version, LCH_BLOCK_VERSION_JSON);
+  }
 
   LCH_JsonDestroy(block);
+
+  LCH_Json *const empty = LCH_JsonArrayCreate();
+  ck_assert_ptr_nonnull(empty);
+  LCH_Json *const binary = LCH_BlockCreate(head, empty, LCH_ENCODING_BINARY);
+  ck_assert_ptr_nonnull(binary);
+  {
+    size_t version;
+    ck_assert(LCH_BlockGetVersion(binary, &version));
+    ck_assert_int_eq(version, LCH_BLOCK_VERSION);
+  }
+  LCH_JsonDestroy(binary);
 }
 END_TEST
 
@@ -76,50 +95,282 @@ START_TEST(test_LCH_BlockIdFromArgument) {
 
   LCH_BufferDestroy(buffer);
 
-  char *block_id = LCH_BlockIdFromArgument(work_dir, "0820ee7");
+  ck_assert(LCH_FilePathJoin(filename, PATH_MAX, 2, work_dir, "leech.json"));
+  LCH_Buffer *const config =
+      LCH_BufferFromString("{\"version\": \"0.1.0\", \"tables\": {}}");
+  ck_assert_ptr_nonnull(config);
+  ck_assert(LCH_BufferWriteFile(config, filename));
+  LCH_BufferDestroy(config);
+
+  LCH_Instance *const instance = LCH_InstanceLoad(work_dir);
+  ck_assert_ptr_nonnull(instance);
+
+  char *block_id = LCH_BlockIdFromArgument(instance, "0820ee7");
   ck_assert_str_eq(block_id, blocks[0]);
   free(block_id);
 
-  block_id = LCH_BlockIdFromArgument(work_dir, "0957d946");
+  block_id = LCH_BlockIdFromArgument(instance, "0957d946");
   ck_assert_str_eq(block_id, blocks[1]);
   free(block_id);
 
   /* Try with the entire hash */
   block_id = LCH_BlockIdFromArgument(
-      work_dir, "be3e991161dcde612b61be9562e08942e9a47903");
+      instance, "be3e991161dcde612b61be9562e08942e9a47903");
   ck_assert_str_eq(block_id, blocks[2]);
   free(block_id);
 
   /* Try with more than the entire hash */
   block_id = LCH_BlockIdFromArgument(
-      work_dir, "be3e991161dcde612b61be9562e08942e9a47903a");
+      instance, "be3e991161dcde612b61be9562e08942e9a47903a");
   ck_assert_ptr_null(block_id);
   free(block_id);
 
-  block_id = LCH_BlockIdFromArgument(work_dir, "957d94");
+  block_id = LCH_BlockIdFromArgument(instance, "957d94");
   ck_assert_ptr_null(block_id);
   free(block_id);
 
-  block_id = LCH_BlockIdFromArgument(work_dir, "f80cc0ac9");
+  block_id = LCH_BlockIdFromArgument(instance, "f80cc0ac9");
   ck_assert_ptr_null(block_id);
   free(block_id);
 
-  block_id = LCH_BlockIdFromArgument(work_dir, "8de90ff4c64c0");
+  block_id = LCH_BlockIdFromArgument(instance, "8de90ff4c64c0");
   ck_assert_ptr_null(block_id);
   free(block_id);
 
-  block_id = LCH_BlockIdFromArgument(work_dir, "invalid");
+  block_id = LCH_BlockIdFromArgument(instance, "invalid");
   ck_assert_ptr_null(block_id);
   free(block_id);
 
-  block_id = LCH_BlockIdFromArgument(work_dir, "3d28755d158b");
+  block_id = LCH_BlockIdFromArgument(instance, "3d28755d158b");
   ck_assert_ptr_null(block_id);
   free(block_id);
 
-  block_id = LCH_BlockIdFromArgument(work_dir, "3d28755d158b1");
+  block_id = LCH_BlockIdFromArgument(instance, "3d28755d158b1");
   ck_assert_str_eq(block_id, blocks[7]);
   free(block_id);
 
+  LCH_InstanceDestroy(instance);
+  ck_assert(LCH_FileDelete(work_dir));
+}
+END_TEST
+
+static LCH_Instance *LoadInstance(const char *const work_dir,
+                                  const char *const options) {
+  char filename[PATH_MAX];
+  ck_assert(LCH_FilePathJoin(filename, PATH_MAX, 2, work_dir, "leech.json"));
+  char *const json = LCH_StringFormat(
+      "{\"version\": \"0.1.0\", %s\"tables\": {}}", options);
+  ck_assert_ptr_nonnull(json);
+  LCH_Buffer *const config = LCH_BufferFromString(json);
+  free(json);
+  ck_assert_ptr_nonnull(config);
+  ck_assert(LCH_BufferWriteFile(config, filename));
+  LCH_BufferDestroy(config);
+
+  LCH_Instance *const instance = LCH_InstanceLoad(work_dir);
+  ck_assert_ptr_nonnull(instance);
+  return instance;
+}
+
+static char *StoreBlock(const LCH_Instance *const instance,
+                        const char *const parent_id) {
+  LCH_Json *const payload = LCH_JsonArrayCreate();
+  ck_assert_ptr_nonnull(payload);
+  LCH_Json *const block = LCH_BlockCreate(
+      parent_id, payload, LCH_InstanceGetEncoding(instance));
+  ck_assert_ptr_nonnull(block);
+  ck_assert(LCH_BlockStore(instance, block));
+  LCH_JsonDestroy(block);
+
+  char *const block_id =
+      LCH_HeadGet("HEAD", LCH_InstanceGetWorkDirectory(instance));
+  ck_assert_ptr_nonnull(block_id);
+  return block_id;
+}
+
+START_TEST(test_LCH_BlockFanOut) {
+  char tmpl[] = "tmp_XXXXXX";
+  const char *work_dir = mkdtemp(tmpl);
+  ck_assert_ptr_nonnull(work_dir);
+
+  /* Store a block in the fan-out layout */
+  LCH_Instance *instance = LoadInstance(work_dir, "\"fan_out_blocks\": true, ");
+  char *const block_id = StoreBlock(instance, LCH_GENISIS_BLOCK_ID);
+
+  char flat[PATH_MAX], fan_out[PATH_MAX];
+  ck_assert(LCH_FilePathJoin(flat, PATH_MAX, 3, work_dir, "blocks", block_id));
+  char prefix[3] = {block_id[0], block_id[1], '\0'};
+  ck_assert(LCH_FilePathJoin(fan_out, PATH_MAX, 4, work_dir, "blocks", prefix,
+                             block_id + 2));
+  ck_assert(!LCH_FileExists(flat));
+  ck_assert(LCH_FileIsRegular(fan_out));
+
+  ck_assert(LCH_BlockExists(instance, block_id));
+  LCH_Json *block = LCH_BlockLoad(instance, block_id);
+  ck_assert_ptr_nonnull(block);
+  LCH_JsonDestroy(block);
+
+  char *argument = LCH_BlockIdFromArgument(instance, prefix);
+  ck_assert_str_eq(argument, block_id);
+  free(argument);
+
+  LCH_List *block_ids = LCH_BlockList(instance);
+  ck_assert_ptr_nonnull(block_ids);
+  ck_assert_int_eq(LCH_ListLength(block_ids), 1);
+  ck_assert_str_eq((char *)LCH_ListGet(block_ids, 0), block_id);
+  LCH_ListDestroy(block_ids);
+  LCH_InstanceDestroy(instance);
+
+  /* Migrate to the flat layout */
+  instance = LoadInstance(work_dir, "");
+  ck_assert(LCH_BlockMigrate(instance));
+  ck_assert(LCH_FileIsRegular(flat));
+  ck_assert(!LCH_FileExists(fan_out));
+
+  block = LCH_BlockLoad(instance, block_id);
+  ck_assert_ptr_nonnull(block);
+  LCH_JsonDestroy(block);
+
+  block_ids = LCH_BlockList(instance);
+  ck_assert_ptr_nonnull(block_ids);
+  ck_assert_int_eq(LCH_ListLength(block_ids), 1);
+  LCH_ListDestroy(block_ids);
+
+  /* Migrating twice is a no-op */
+  ck_assert(LCH_BlockMigrate(instance));
+  ck_assert(LCH_FileIsRegular(flat));
+
+  LCH_Dict *const whitelist = LCH_DictCreate();
+  ck_assert_ptr_nonnull(whitelist);
+  ck_assert(LCH_BlockRetain(instance, whitelist));
+  ck_assert(!LCH_BlockExists(instance, block_id));
+  ck_assert(LCH_BlockRetain(instance, whitelist));
+  LCH_DictDestroy(whitelist);
+
+  free(block_id);
+  LCH_InstanceDestroy(instance);
+  ck_assert(LCH_FileDelete(work_dir));
+}
+END_TEST
+
+START_TEST(test_LCH_BlockPack) {
+  char tmpl[] = "tmp_XXXXXX";
+  const char *work_dir = mkdtemp(tmpl);
+  ck_assert_ptr_nonnull(work_dir);
+
+  /* Store two blocks in a pack */
+  LCH_Instance *instance = LoadInstance(work_dir, "\"pack_blocks\": true, ");
+  char *const first = StoreBlock(instance, LCH_GENISIS_BLOCK_ID);
+  char *const second = StoreBlock(instance, first);
+
+  char path[PATH_MAX];
+  ck_assert(
+      LCH_FilePathJoin(path, PATH_MAX, 3, work_dir, "packs", "00000001.pack"));
+  ck_assert(LCH_FileIsRegular(path));
+  ck_assert(LCH_FilePathJoin(path, PATH_MAX, 3, work_dir, "blocks", first));
+  ck_assert(!LCH_FileExists(path));
+
+  LCH_Json *block = LCH_BlockLoad(instance, second);
+  ck_assert_ptr_nonnull(block);
+  ck_assert_str_eq(LCH_BlockGetParentId(block), first);
+  LCH_JsonDestroy(block);
+
+  char *argument = LCH_BlockIdFromArgument(instance, second);
+  ck_assert_str_eq(argument, second);
+  free(argument);
+
+  LCH_List *block_ids = LCH_BlockList(instance);
+  ck_assert_ptr_nonnull(block_ids);
+  ck_assert_int_eq(LCH_ListLength(block_ids), 2);
+  LCH_ListDestroy(block_ids);
+
+  /* Delete the first block */
+  LCH_Dict *const whitelist = LCH_DictCreate();
+  ck_assert_ptr_nonnull(whitelist);
+  const LCH_Buffer key = LCH_BufferStaticFromString(second);
+  ck_assert(LCH_DictSet(whitelist, &key, NULL, NULL));
+  ck_assert(LCH_BlockRetain(instance, whitelist));
+  LCH_DictDestroy(whitelist);
+
+  ck_assert(!LCH_BlockExists(instance, first));
+  block = LCH_BlockLoad(instance, second);
+  ck_assert_ptr_nonnull(block);
+  LCH_JsonDestroy(block);
+  LCH_InstanceDestroy(instance);
+
+  /* Unpack the remaining block */
+  instance = LoadInstance(work_dir, "");
+  ck_assert(LCH_BlockMigrate(instance));
+  ck_assert(LCH_FilePathJoin(path, PATH_MAX, 3, work_dir, "blocks", second));
+  ck_assert(LCH_FileIsRegular(path));
+  block = LCH_BlockLoad(instance, second);
+  ck_assert_ptr_nonnull(block);
+  LCH_JsonDestroy(block);
+  LCH_InstanceDestroy(instance);
+
+  /* And pack it once more */
+  instance = LoadInstance(work_dir, "\"pack_blocks\": true, ");
+  ck_assert(LCH_BlockMigrate(instance));
+  ck_assert(!LCH_FileExists(path));
+  block_ids = LCH_BlockList(instance);
+  ck_assert_ptr_nonnull(block_ids);
+  ck_assert_int_eq(LCH_ListLength(block_ids), 1);
+  ck_assert_str_eq((char *)LCH_ListGet(block_ids, 0), second);
+  LCH_ListDestroy(block_ids);
+
+  free(second);
+  free(first);
+  LCH_InstanceDestroy(instance);
+  ck_assert(LCH_FileDelete(work_dir));
+}
+END_TEST
+
+START_TEST(test_LCH_BlockRetain) {
+  char tmpl[] = "tmp_XXXXXX";
+  const char *work_dir = mkdtemp(tmpl);
+  ck_assert_ptr_nonnull(work_dir);
+
+  /* Store blocks in both layouts, next to a file that is not a block */
+  LCH_Instance *instance = LoadInstance(work_dir, "\"fan_out_blocks\": true, ");
+  char *const first = StoreBlock(instance, LCH_GENISIS_BLOCK_ID);
+  char *const second = StoreBlock(instance, first);
+  LCH_InstanceDestroy(instance);
+
+  instance = LoadInstance(work_dir, "");
+  char *const third = StoreBlock(instance, second);
+
+  char path[PATH_MAX];
+  ck_assert(LCH_FilePathJoin(path, PATH_MAX, 3, work_dir, "blocks", "README"));
+  LCH_Buffer *const readme = LCH_BufferFromString("Not a block");
+  ck_assert_ptr_nonnull(readme);
+  ck_assert(LCH_BufferWriteFile(readme, path));
+  LCH_BufferDestroy(readme);
+
+  LCH_Dict *const whitelist = LCH_DictCreate();
+  ck_assert_ptr_nonnull(whitelist);
+  const LCH_Buffer key = LCH_BufferStaticFromString(second);
+  ck_assert(LCH_DictSet(whitelist, &key, NULL, NULL));
+  ck_assert(LCH_BlockRetain(instance, whitelist));
+  LCH_DictDestroy(whitelist);
+
+  ck_assert(!LCH_BlockExists(instance, first));
+  ck_assert(LCH_BlockExists(instance, second));
+  ck_assert(!LCH_BlockExists(instance, third));
+  ck_assert(LCH_FileIsRegular(path));
+
+  char *const argument = LCH_BlockIdFromArgument(instance, second);
+  ck_assert_str_eq(argument, second);
+  free(argument);
+
+  LCH_List *const block_ids = LCH_BlockList(instance);
+  ck_assert_ptr_nonnull(block_ids);
+  ck_assert_int_eq(LCH_ListLength(block_ids), 1);
+  LCH_ListDestroy(block_ids);
+
+  free(third);
+  free(second);
+  free(first);
+  LCH_InstanceDestroy(instance);
   ck_assert(LCH_FileDelete(work_dir));
 }
 END_TEST
@@ -136,5 +387,20 @@ Suite *BlockSuite(void) {
     tcase_add_test(tc, test_LCH_BlockIdFromArgument);
     suite_add_tcase(s, tc);
   }
+  {
+    TCase *tc = tcase_create("LCH_BlockFanOut");
+    tcase_add_test(tc, test_LCH_BlockFanOut);
+    suite_add_tcase(s, tc);
+  }
+  {
+    TCase *tc = tcase_create("LCH_BlockPack");
+    tcase_add_test(tc, test_LCH_BlockPack);
+    suite_add_tcase(s, tc);
+  }
+  {
+    TCase *tc = tcase_create("LCH_BlockRetain");
+    tcase_add_test(tc, test_LCH_BlockRetain);
+    suite_add_tcase(s, tc);
+  }
   return s;
 }
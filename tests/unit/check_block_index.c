@@ -0,0 +1,104 @@
+#include <check.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include "../lib/block_index.h"
+#include "../lib/files.h"
+#include "../lib/instance.h"
+
+static void CreateFile(const char *const blocks_dir, const char *const name) {
+  char path[PATH_MAX];
+  ck_assert(LCH_FilePathJoin(path, sizeof(path), 2, blocks_dir, name));
+  LCH_Buffer *const buffer = LCH_BufferCreate();
+  ck_assert_ptr_nonnull(buffer);
+  ck_assert(LCH_BufferWriteFile(buffer, path));
+  LCH_BufferDestroy(buffer);
+}
+
+START_TEST(test_LCH_BlockIndex) {
+  char work_dir[] = "/tmp/leech-check-XXXXXX";
+  ck_assert_ptr_nonnull(mkdtemp(work_dir));
+  char blocks_dir[PATH_MAX];
+  ck_assert(
+      LCH_FilePathJoin(blocks_dir, sizeof(blocks_dir), 2, work_dir, "blocks"));
+
+  const char *const first = "aa0e1d2c3b4a5968778695a4b3c2d1e0f0e1d2c3";
+  const char *const second = "ab0e1d2c3b4a5968778695a4b3c2d1e0f0e1d2c3";
+
+  char config_path[PATH_MAX];
+  ck_assert(LCH_FilePathJoin(config_path, sizeof(config_path), 2, work_dir,
+                             "leech.json"));
+  LCH_Buffer *const config =
+      LCH_BufferFromString("{\"version\": \"0.1.0\", \"tables\": {}}");
+  ck_assert_ptr_nonnull(config);
+  ck_assert(LCH_BufferWriteFile(config, config_path));
+  LCH_BufferDestroy(config);
+
+  LCH_Instance *const instance = LCH_InstanceLoad(work_dir);
+  ck_assert_ptr_nonnull(instance);
+
+  /* The blocks directory does not exist yet */
+  LCH_BlockIndex *const index = LCH_BlockIndexCreate(instance);
+  ck_assert_ptr_nonnull(index);
+
+  const char *block_id;
+  size_t num_matching;
+  ck_assert(LCH_BlockIndexFind(index, "", &block_id, &num_matching));
+  ck_assert_int_eq(num_matching, 1);
+  ck_assert_str_eq(block_id, "0000000000000000000000000000000000000000");
+
+  /* Blocks stored by the process itself */
+  LCH_BlockIndexPrepare(index);
+  CreateFile(blocks_dir, first);
+  CreateFile(blocks_dir, "not-a-block");
+  LCH_BlockIndexAdd(index, first);
+
+  ck_assert(LCH_BlockIndexFind(index, "aa", &block_id, &num_matching));
+  ck_assert_int_eq(num_matching, 1);
+  ck_assert_str_eq(block_id, first);
+  ck_assert(LCH_BlockIndexFind(index, "not", &block_id, &num_matching));
+  ck_assert_int_eq(num_matching, 0);
+  ck_assert_ptr_null(block_id);
+
+  /* Blocks stored by another process. The modification time of the directory
+   * is set explicitly, as the change may otherwise go unnoticed within the
+   * timestamp granularity of the file system. */
+  CreateFile(blocks_dir, second);
+  struct utimbuf times = {.actime = 1000000000, .modtime = 1000000000};
+  ck_assert_int_eq(utime(blocks_dir, &times), 0);
+
+  ck_assert(LCH_BlockIndexFind(index, "a", &block_id, &num_matching));
+  ck_assert_int_eq(num_matching, 2);
+  ck_assert_str_eq(block_id, first);
+  ck_assert(LCH_BlockIndexFind(index, "ab", &block_id, &num_matching));
+  ck_assert_int_eq(num_matching, 1);
+  ck_assert_str_eq(block_id, second);
+
+  /* Blocks deleted by the process itself */
+  char path[PATH_MAX];
+  ck_assert(LCH_FilePathJoin(path, sizeof(path), 2, blocks_dir, first));
+  LCH_BlockIndexPrepare(index);
+  ck_assert_int_eq(unlink(path), 0);
+  LCH_BlockIndexRemove(index, first);
+
+  ck_assert(LCH_BlockIndexFind(index, "a", &block_id, &num_matching));
+  ck_assert_int_eq(num_matching, 1);
+  ck_assert_str_eq(block_id, second);
+
+  LCH_BlockIndexDestroy(index);
+  LCH_InstanceDestroy(instance);
+  ck_assert(LCH_FileDelete(work_dir));
+}
+END_TEST
+
+Suite *BlockIndexSuite(void) {
+  Suite *s = suite_create("block_index.c");
+  {
+    TCase *tc = tcase_create("LCH_BlockIndex");
+    tcase_add_test(tc, test_LCH_BlockIndex);
+    suite_add_tcase(s, tc);
+  }
+  return s;
+}
@@ -1,4 +1,7 @@
 #include <check.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #ifdef _WIN32
 #include <winsock2.h>
@@ -230,6 +233,133 @@ START_TEST(test_LCH_BufferIsPrintable) {
 }
 END_TEST
 
+START_TEST(test_LCH_BufferAppendBytes) {
+  char chunk[LCH_BUFFER_SIZE * 2];
+  memset(chunk, 'x', sizeof(chunk) - 1);
+  chunk[sizeof(chunk) - 1] = '\0';
+
+  LCH_Buffer *const buffer = LCH_BufferCreate();
+  ck_assert_ptr_nonnull(buffer);
+
+  /* Exceeds the remaining capacity, hence the string is printed twice */
+  ck_assert(LCH_BufferPrintFormat(buffer, "<%s>", chunk));
+  ck_assert_int_eq(LCH_BufferLength(buffer), strlen(chunk) + 2);
+
+  ck_assert(LCH_BufferAppendBytes(buffer, "leech", strlen("leech")));
+  ck_assert(LCH_BufferAppendBytes(buffer, NULL, 0));
+  ck_assert(LCH_BufferAppendBytes(buffer, chunk, strlen(chunk)));
+  ck_assert_int_eq(LCH_BufferLength(buffer), (strlen(chunk) * 2) + 7);
+
+  const char *const data = LCH_BufferData(buffer);
+  ck_assert_int_eq(data[0], '<');
+  ck_assert_int_eq(strncmp(data + strlen(chunk) + 1, ">leech", 6), 0);
+  ck_assert_int_eq(data[LCH_BufferLength(buffer)], '\0');
+  LCH_BufferDestroy(buffer);
+
+  /* Views are copied before they are written to */
+  const char *const str = "foo";
+  LCH_Buffer *const view = LCH_BufferCreateView(str, strlen(str));
+  ck_assert_ptr_nonnull(view);
+  ck_assert(LCH_BufferPrintFormat(view, "%s", "bar"));
+  ck_assert_str_eq(LCH_BufferData(view), "foobar");
+  ck_assert_str_eq(str, "foo");
+  LCH_BufferDestroy(view);
+}
+END_TEST
+
+START_TEST(test_LCH_BufferMapFile) {
+  /* Small files and files ending at a page boundary are read, whereas other
+   * large files are memory mapped */
+  const size_t sizes[] = {0, 100, LCH_BUFFER_MMAP_THRESHOLD,
+                          LCH_BUFFER_MMAP_THRESHOLD + 100};
+
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); i++) {
+    char filename[] = "test_LCH_BufferMapFile_XXXXXX";
+    const int fd = mkstemp(filename);
+    ck_assert_int_ne(fd, -1);
+    close(fd);
+
+    LCH_Buffer *const expected = LCH_BufferCreate();
+    ck_assert_ptr_nonnull(expected);
+    for (size_t j = 0; j < sizes[i]; j++) {
+      ck_assert(LCH_BufferAppend(expected, 'a' + (char)(j % 26)));
+    }
+    ck_assert(LCH_BufferWriteFile(expected, filename));
+
+    LCH_Buffer *const actual = LCH_BufferMapFile(filename);
+    ck_assert_ptr_nonnull(actual);
+    ck_assert_int_eq(LCH_BufferLength(actual), sizes[i]);
+    ck_assert(LCH_BufferEqual(actual, expected));
+    ck_assert_int_eq(LCH_BufferData(actual)[sizes[i]], '\0');
+
+    /* Replacing the file keeps the mapped inode, hence the buffer is left intact */
+    LCH_Buffer *const empty = LCH_BufferCreate();
+    ck_assert_ptr_nonnull(empty);
+    ck_assert(LCH_BufferReplaceFile(empty, filename));
+    LCH_BufferDestroy(empty);
+    ck_assert(LCH_BufferEqual(actual, expected));
+    ck_assert(LCH_BufferReplaceFile(expected, filename));
+
+    /* Writing to the buffer must not modify the file */
+    LCH_BufferChop(actual, sizes[i] / 2);
+    ck_assert(LCH_BufferPrintFormat(actual, "leech"));
+    ck_assert_int_eq(LCH_BufferLength(actual), (sizes[i] / 2) + 5);
+    LCH_BufferDestroy(actual);
+
+    LCH_Buffer *const reread = LCH_BufferCreate();
+    ck_assert_ptr_nonnull(reread);
+    ck_assert(LCH_BufferReadFile(reread, filename));
+    ck_assert(LCH_BufferEqual(reread, expected));
+    LCH_BufferDestroy(reread);
+
+    LCH_BufferDestroy(expected);
+    ck_assert_int_eq(unlink(filename), 0);
+  }
+
+  ck_assert_ptr_null(LCH_BufferMapFile("test_LCH_BufferMapFile_missing"));
+}
+END_TEST
+
+START_TEST(test_LCH_BufferWriteFile) {
+  char filename[] = "test_LCH_BufferWriteFile_XXXXXX";
+  const int fd = mkstemp(filename);
+  ck_assert_int_ne(fd, -1);
+  close(fd);
+  ck_assert_int_eq(chmod(filename, 0644), 0);
+
+  char link_path[] = "test_LCH_BufferWriteFile_link";
+  ck_assert_int_eq(link(filename, link_path), 0);
+
+  struct stat before;
+  ck_assert_int_eq(stat(filename, &before), 0);
+
+  LCH_Buffer *const expected = LCH_BufferFromString("Hello leech!");
+  ck_assert_ptr_nonnull(expected);
+  ck_assert(LCH_BufferWriteFile(expected, filename));
+
+  /* Writing in place keeps the inode, the mode and the hard links */
+  struct stat after;
+  ck_assert_int_eq(stat(filename, &after), 0);
+  ck_assert_int_eq(after.st_ino, before.st_ino);
+  ck_assert_int_eq(after.st_mode & 0777, 0644);
+
+  LCH_Buffer *const actual = LCH_BufferCreate();
+  ck_assert_ptr_nonnull(actual);
+  ck_assert(LCH_BufferReadFile(actual, link_path));
+  ck_assert(LCH_BufferEqual(actual, expected));
+  LCH_BufferDestroy(actual);
+
+  /* Replacing the file creates a new inode */
+  ck_assert(LCH_BufferReplaceFile(expected, filename));
+  ck_assert_int_eq(stat(filename, &after), 0);
+  ck_assert_int_ne(after.st_ino, before.st_ino);
+
+  LCH_BufferDestroy(expected);
+  ck_assert_int_eq(unlink(link_path), 0);
+  ck_assert_int_eq(unlink(filename), 0);
+}
+END_TEST
+
 Suite *BufferSuite(void) {
   Suite *s = suite_create("buffer.c");
   {
@@ -262,5 +392,20 @@ Suite *BufferSuite(void) {
     tcase_add_test(tc, test_LCH_BufferIsPrintable);
     suite_add_tcase(s, tc);
   }
+  {
+    TCase *tc = tcase_create("LCH_BufferAppendBytes");
+    tcase_add_test(tc, test_LCH_BufferAppendBytes);
+    suite_add_tcase(s, tc);
+  }
+  {
+    TCase *tc = tcase_create("LCH_BufferMapFile");
+    tcase_add_test(tc, test_LCH_BufferMapFile);
+    suite_add_tcase(s, tc);
+  }
+  {
+    TCase *tc = tcase_create("LCH_BufferWriteFile");
+    tcase_add_test(tc, test_LCH_BufferWriteFile);
+    suite_add_tcase(s, tc);
+  }
   return s;
 }
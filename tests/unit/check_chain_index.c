@@ -0,0 +1,96 @@
+#include <check.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../lib/chain_index.h"
+#include "../lib/files.h"
+
+static void AssertIndexed(LCH_ChainIndex *const index,
+                          const char *const block_id,
+                          const char *const expected_parent_id,
+                          const double expected_timestamp) {
+  const char *parent_id;
+  double timestamp;
+  bool found;
+  ck_assert(LCH_ChainIndexGet(index, block_id, &parent_id, &timestamp, &found));
+  if (expected_parent_id == NULL) {
+    ck_assert(!found);
+  } else {
+    ck_assert(found);
+    ck_assert_str_eq(parent_id, expected_parent_id);
+    ck_assert_double_eq(timestamp, expected_timestamp);
+  }
+}
+
+START_TEST(test_LCH_ChainIndex) {
+  char work_dir[] = "/tmp/leech-check-XXXXXX";
+  ck_assert_ptr_nonnull(mkdtemp(work_dir));
+
+  const char *const genisis = "0000000000000000000000000000000000000000";
+  const char *const first = "aa0e1d2c3b4a5968778695a4b3c2d1e0f0e1d2c3";
+  const char *const second = "ab0e1d2c3b4a5968778695a4b3c2d1e0f0e1d2c3";
+  const char *const third = "ac0e1d2c3b4a5968778695a4b3c2d1e0f0e1d2c3";
+
+  /* The chain file does not exist yet */
+  LCH_ChainIndex *const index = LCH_ChainIndexCreate(work_dir);
+  ck_assert_ptr_nonnull(index);
+  AssertIndexed(index, first, NULL, 0);
+
+  ck_assert(LCH_ChainIndexAdd(index, first, genisis, 1700000000));
+  AssertIndexed(index, first, genisis, 1700000000);
+
+  /* Headers appended by another process */
+  LCH_ChainIndex *const other = LCH_ChainIndexCreate(work_dir);
+  ck_assert_ptr_nonnull(other);
+  AssertIndexed(other, first, genisis, 1700000000);
+  ck_assert(LCH_ChainIndexAdd(other, second, first, 1700000060));
+  AssertIndexed(index, second, first, 1700000060);
+
+  /* Malformed and incomplete records are ignored, and never appended to */
+  char path[PATH_MAX];
+  ck_assert(LCH_FilePathJoin(path, PATH_MAX, 2, work_dir, "chain"));
+  FILE *const file = fopen(path, "a");
+  ck_assert_ptr_nonnull(file);
+  ck_assert_int_ge(fputs("bogus\n", file), 0);
+  ck_assert_int_ge(fputs(third, file), 0);
+  ck_assert_int_eq(fclose(file), 0);
+
+  AssertIndexed(other, third, NULL, 0);
+  ck_assert(LCH_ChainIndexAdd(index, third, second, 1700000120));
+  AssertIndexed(other, third, second, 1700000120);
+
+  /* Dropping headers replaces the chain file, which is then read from the
+   * start by other processes */
+  LCH_Dict *const whitelist = LCH_DictCreate();
+  ck_assert_ptr_nonnull(whitelist);
+  const LCH_Buffer key = LCH_BufferStaticFromString(third);
+  ck_assert(LCH_DictSet(whitelist, &key, NULL, NULL));
+  ck_assert(LCH_ChainIndexRetain(index, whitelist));
+  LCH_DictDestroy(whitelist);
+
+  LCH_ChainIndex *const fresh = LCH_ChainIndexCreate(work_dir);
+  ck_assert_ptr_nonnull(fresh);
+  AssertIndexed(fresh, first, NULL, 0);
+  AssertIndexed(fresh, second, NULL, 0);
+  AssertIndexed(fresh, third, second, 1700000120);
+  AssertIndexed(other, third, second, 1700000120);
+  AssertIndexed(index, first, NULL, 0);
+
+  LCH_ChainIndexDestroy(fresh);
+  LCH_ChainIndexDestroy(other);
+  LCH_ChainIndexDestroy(index);
+  ck_assert(LCH_FileDelete(work_dir));
+}
+END_TEST
+
+Suite *ChainIndexSuite(void) {
+  Suite *s = suite_create("chain_index.c");
+  {
+    TCase *tc = tcase_create("LCH_ChainIndex");
+    tcase_add_test(tc, test_LCH_ChainIndex);
+    suite_add_tcase(s, tc);
+  }
+  return s;
+}
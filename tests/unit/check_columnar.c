@@ -0,0 +1,136 @@
+#include <check.h>
+
+#include "../lib/columnar.h"
+#include "../lib/csv.h"
+
+START_TEST(test_LCH_TableAppendField) {
+  LCH_Table *const table = LCH_TableCreate(2);
+  ck_assert_ptr_nonnull(table);
+  ck_assert(LCH_TableReserve(table, 4, 64));
+
+  ck_assert(LCH_TableAppendField(table, "name", strlen("name")));
+  ck_assert_int_eq(LCH_TableGetNumRows(table), 0);
+  ck_assert(LCH_TableAppendField(table, "born", strlen("born")));
+  ck_assert_int_eq(LCH_TableGetNumRows(table), 1);
+
+  /* Fill past the reserved capacity */
+  for (int i = 0; i < 100; i++) {
+    ck_assert(LCH_TableAppendField(table, "Paul", strlen("Paul")));
+    ck_assert(LCH_TableAppendField(table, "", 0));
+  }
+  ck_assert_int_eq(LCH_TableGetNumColumns(table), 2);
+  ck_assert_int_eq(LCH_TableGetNumRows(table), 101);
+
+  size_t length;
+  ck_assert_str_eq(LCH_TableGetField(table, 0, 1, &length), "born");
+  ck_assert_int_eq(length, 4);
+  ck_assert_str_eq(LCH_TableGetField(table, 100, 0, &length), "Paul");
+  ck_assert_int_eq(length, 4);
+  ck_assert_str_eq(LCH_TableGetField(table, 100, 1, &length), "");
+  ck_assert_int_eq(length, 0);
+
+  LCH_TableDestroy(table);
+}
+END_TEST
+
+START_TEST(test_LCH_TableSetField) {
+  const char *const csv =
+      "firstname,lastname,born\r\n"
+      "Paul,McCartney,1942\r\n"
+      "Ringo,Starr,1940\r\n"
+      "John,Lennon,1940\r\n";
+  LCH_Table *const table = LCH_CSVParseTableColumnar(csv, strlen(csv));
+  ck_assert_ptr_nonnull(table);
+  ck_assert_int_eq(LCH_TableGetNumRows(table), 4);
+  ck_assert_int_eq(LCH_TableGetNumColumns(table), 3);
+
+  const LCH_Buffer born = LCH_BufferStaticFromString("born");
+  const size_t index = LCH_TableGetColumnIndex(table, &born);
+  ck_assert_int_eq(index, 2);
+
+  const LCH_Buffer bogus = LCH_BufferStaticFromString("bogus");
+  ck_assert_int_eq(LCH_TableGetColumnIndex(table, &bogus), 3);
+
+  ck_assert(LCH_TableSetField(table, 2, index, "1941", strlen("1941")));
+  const LCH_Buffer year = LCH_BufferStaticFromString("1941");
+  ck_assert(LCH_TableFieldEqual(table, 2, index, &year));
+
+  LCH_TableRemoveRow(table, 1);
+  ck_assert(LCH_TableIsRowRemoved(table, 1));
+  ck_assert(!LCH_TableIsRowRemoved(table, 2));
+  ck_assert_int_eq(LCH_TableGetNumRows(table), 4);
+  LCH_TableCompact(table);
+  ck_assert(!LCH_TableIsRowRemoved(table, 1));
+  ck_assert_int_eq(LCH_TableGetNumRows(table), 3);
+  ck_assert_str_eq(LCH_TableGetField(table, 1, 0, NULL), "Ringo");
+  ck_assert_str_eq(LCH_TableGetField(table, 2, 1, NULL), "Lennon");
+
+  LCH_Buffer *buffer = NULL;
+  ck_assert(LCH_CSVComposeTableColumnar(&buffer, table));
+  ck_assert_str_eq(LCH_BufferData(buffer),
+                   "firstname,lastname,born\r\n"
+                   "Ringo,Starr,1941\r\n"
+                   "John,Lennon,1940");
+  LCH_BufferDestroy(buffer);
+
+  const size_t columns[] = {1, 0};
+  buffer = NULL;
+  ck_assert(LCH_CSVComposeRecordColumnar(&buffer, table, 2, columns, 2));
+  ck_assert_str_eq(LCH_BufferData(buffer), "Lennon,John");
+  LCH_BufferDestroy(buffer);
+
+  LCH_TableDestroy(table);
+}
+END_TEST
+
+START_TEST(test_LCH_TableFromList) {
+  const char *const csv =
+      "firstname,lastname\r\n"
+      "Paul,McCartney\r\n"
+      "\"Starr, Ringo\",\r\n";
+  LCH_List *const list = LCH_CSVParseTable(csv, strlen(csv));
+  ck_assert_ptr_nonnull(list);
+
+  LCH_Table *const table = LCH_TableFromList(list);
+  ck_assert_ptr_nonnull(table);
+  ck_assert_int_eq(LCH_TableGetNumRows(table), 3);
+  ck_assert_str_eq(LCH_TableGetField(table, 2, 0, NULL), "Starr, Ringo");
+  ck_assert_str_eq(LCH_TableGetField(table, 2, 1, NULL), "");
+
+  LCH_Buffer *buffer = NULL;
+  ck_assert(LCH_CSVComposeTableColumnar(&buffer, table));
+  ck_assert_str_eq(LCH_BufferData(buffer),
+                   "firstname,lastname\r\n"
+                   "Paul,McCartney\r\n"
+                   "\"Starr, Ringo\",");
+  LCH_BufferDestroy(buffer);
+  LCH_TableDestroy(table);
+
+  /* Records must have as many fields as the header */
+  LCH_List *const record = (LCH_List *)LCH_ListGet(list, 1);
+  LCH_BufferDestroy(LCH_ListRemove(record, 1));
+  ck_assert_ptr_null(LCH_TableFromList(list));
+
+  LCH_ListDestroy(list);
+}
+END_TEST
+
+Suite *ColumnarSuite(void) {
+  Suite *s = suite_create("columnar.c");
+  {
+    TCase *tc = tcase_create("LCH_TableAppendField");
+    tcase_add_test(tc, test_LCH_TableAppendField);
+    suite_add_tcase(s, tc);
+  }
+  {
+    TCase *tc = tcase_create("LCH_TableSetField");
+    tcase_add_test(tc, test_LCH_TableSetField);
+    suite_add_tcase(s, tc);
+  }
+  {
+    TCase *tc = tcase_create("LCH_TableFromList");
+    tcase_add_test(tc, test_LCH_TableFromList);
+    suite_add_tcase(s, tc);
+  }
+  return s;
+}
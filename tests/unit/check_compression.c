@@ -0,0 +1,108 @@
+#include <check.h>
+
+#include "../lib/compression.h"
+
+START_TEST(test_LCH_CompressionFromString) {
+  LCH_Compression method;
+  ck_assert(LCH_CompressionFromString("none", &method));
+  ck_assert_int_eq(method, LCH_COMPRESSION_NONE);
+  ck_assert_str_eq(LCH_CompressionToString(method), "none");
+
+#ifdef HAVE_ZLIB_H
+  ck_assert(LCH_CompressionFromString("zlib", &method));
+  ck_assert_int_eq(method, LCH_COMPRESSION_ZLIB);
+  ck_assert_str_eq(LCH_CompressionToString(method), "zlib");
+#else   // HAVE_ZLIB_H
+  ck_assert(!LCH_CompressionFromString("zlib", &method));
+#endif  // HAVE_ZLIB_H
+
+  ck_assert(!LCH_CompressionFromString("bogus", &method));
+  ck_assert_str_eq(LCH_CompressionToString((LCH_Compression)42), "unknown");
+}
+END_TEST
+
+START_TEST(test_LCH_CompressionEncode) {
+  const char *const data =
+      "{\"BTL\":{\"Paul,McCartney\":\"1942\",\"Ringo,Starr\":\"1940\","
+      "\"John,Lennon\":\"1940\",\"George,Harrison\":\"1943\"}}";
+  const size_t length = strlen(data);
+
+  {
+    LCH_Buffer *const encoded =
+        LCH_CompressionEncode(data, length, LCH_COMPRESSION_NONE);
+    ck_assert_ptr_nonnull(encoded);
+    ck_assert_str_eq(LCH_BufferData(encoded), data);
+
+    LCH_Buffer *const decoded = LCH_CompressionDecode(
+        LCH_BufferData(encoded), LCH_BufferLength(encoded));
+    ck_assert_ptr_nonnull(decoded);
+    ck_assert_str_eq(LCH_BufferData(decoded), data);
+
+    LCH_BufferDestroy(decoded);
+    LCH_BufferDestroy(encoded);
+  }
+
+#ifdef HAVE_ZLIB_H
+  {
+    LCH_Buffer *const encoded =
+        LCH_CompressionEncode(data, length, LCH_COMPRESSION_ZLIB);
+    ck_assert_ptr_nonnull(encoded);
+    ck_assert_int_eq(strncmp(LCH_BufferData(encoded), "#zlib\n", 6), 0);
+
+    LCH_Buffer *const decoded = LCH_CompressionDecode(
+        LCH_BufferData(encoded), LCH_BufferLength(encoded));
+    ck_assert_ptr_nonnull(decoded);
+    ck_assert_int_eq(LCH_BufferLength(decoded), length);
+    ck_assert_str_eq(LCH_BufferData(decoded), data);
+
+    LCH_BufferDestroy(decoded);
+    LCH_BufferDestroy(encoded);
+  }
+#endif  // HAVE_ZLIB_H
+}
+END_TEST
+
+START_TEST(test_LCH_CompressionDecode) {
+  {
+    const char *const data = "#none\n{}";
+    LCH_Buffer *const decoded = LCH_CompressionDecode(data, strlen(data));
+    ck_assert_ptr_nonnull(decoded);
+    ck_assert_str_eq(LCH_BufferData(decoded), "{}");
+    LCH_BufferDestroy(decoded);
+  }
+  {
+    const char *const data = "#bogus\n{}";
+    ck_assert_ptr_null(LCH_CompressionDecode(data, strlen(data)));
+  }
+  {
+    const char *const data = "#zlib";
+    ck_assert_ptr_null(LCH_CompressionDecode(data, strlen(data)));
+  }
+#ifdef HAVE_ZLIB_H
+  {
+    const char *const data = "#zlib\nnot a zlib stream";
+    ck_assert_ptr_null(LCH_CompressionDecode(data, strlen(data)));
+  }
+#endif  // HAVE_ZLIB_H
+}
+END_TEST
+
+Suite *CompressionSuite(void) {
+  Suite *s = suite_create("compression.c");
+  {
+    TCase *tc = tcase_create("LCH_CompressionFromString");
+    tcase_add_test(tc, test_LCH_CompressionFromString);
+    suite_add_tcase(s, tc);
+  }
+  {
+    TCase *tc = tcase_create("LCH_CompressionEncode");
+    tcase_add_test(tc, test_LCH_CompressionEncode);
+    suite_add_tcase(s, tc);
+  }
+  {
+    TCase *tc = tcase_create("LCH_CompressionDecode");
+    tcase_add_test(tc, test_LCH_CompressionDecode);
+    suite_add_tcase(s, tc);
+  }
+  return s;
+}
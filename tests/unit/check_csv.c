@@ -363,6 +363,63 @@ START_TEST(test_LCH_CSVParseRecord) {
 }
 END_TEST
 
+static bool AppendField(const char *const field, const size_t len,
+                        void *const data) {
+  LCH_List *const record = (LCH_List *)data;
+  LCH_Buffer *const buffer = LCH_BufferCreate();
+  ck_assert_ptr_nonnull(buffer);
+  ck_assert(LCH_BufferAppendBytes(buffer, field, len));
+  ck_assert(LCH_ListAppend(record, buffer, LCH_BufferDestroy));
+  return LCH_ListLength(record) < 4;
+}
+
+START_TEST(test_LCH_CSVForEachField) {
+  const char *const tests[] = {
+      "",
+      "leech",
+      " leech , 1.0.0 ",
+      "\"lee\"\"ch\",\"1,0,0\"",
+      ",,",
+  };
+
+  for (size_t i = 0; i < sizeof(tests) / sizeof(*tests); i++) {
+    const char *const csv = tests[i];
+    LCH_List *const expected = LCH_CSVParseRecord(csv, strlen(csv));
+    ck_assert_ptr_nonnull(expected);
+
+    LCH_List *const actual = LCH_ListCreate();
+    ck_assert_ptr_nonnull(actual);
+    ck_assert(LCH_CSVForEachField(csv, strlen(csv), AppendField, actual));
+
+    ck_assert_int_eq(LCH_ListLength(actual), LCH_ListLength(expected));
+    for (size_t j = 0; j < LCH_ListLength(expected); j++) {
+      ck_assert(LCH_BufferEqual((LCH_Buffer *)LCH_ListGet(actual, j),
+                                (LCH_Buffer *)LCH_ListGet(expected, j)));
+    }
+
+    LCH_ListDestroy(actual);
+    LCH_ListDestroy(expected);
+  }
+
+  {  // Stops when the function returns false
+    const char csv[] = "a,b,c,d,e";
+    LCH_List *const record = LCH_ListCreate();
+    ck_assert_ptr_nonnull(record);
+    ck_assert(!LCH_CSVForEachField(csv, strlen(csv), AppendField, record));
+    ck_assert_int_eq(LCH_ListLength(record), 4);
+    LCH_ListDestroy(record);
+  }
+
+  {  // Bad escaping
+    const char csv[] = "a,\"b";
+    LCH_List *const record = LCH_ListCreate();
+    ck_assert_ptr_nonnull(record);
+    ck_assert(!LCH_CSVForEachField(csv, strlen(csv), AppendField, record));
+    LCH_ListDestroy(record);
+  }
+}
+END_TEST
+
 START_TEST(test_LCH_CSVParseTable) {
   {  // Empty CSV
     const char *const csv = "";
@@ -562,6 +619,65 @@ START_TEST(test_LCH_CSVParseTable) {
 }
 END_TEST
 
+START_TEST(test_LCH_CSVParseLongField) {
+  /* The parser skips text data several bytes at a time. Hence, make sure
+   * special bytes are detected at any offset within longer fields. */
+  for (size_t i = 0; i < 24; i++) {
+    char csv[32];
+    memset(csv, 'a', sizeof(csv));
+    csv[sizeof(csv) - 1] = '\0';
+
+    {  // TAB is text data
+      csv[i] = '\t';
+      LCH_Buffer *const field = LCH_CSVParseField(csv, strlen(csv));
+      ck_assert_ptr_nonnull(field);
+      ck_assert_str_eq(LCH_BufferData(field), csv);
+      LCH_BufferDestroy(field);
+    }
+    {  // COMMA ends the field
+      csv[i] = ',';
+      LCH_List *const record = LCH_CSVParseRecord(csv, strlen(csv));
+      ck_assert_ptr_nonnull(record);
+      ck_assert_int_eq(LCH_ListLength(record), 2);
+      ck_assert_int_eq(LCH_BufferLength(LCH_ListGet(record, 0)), i);
+      LCH_ListDestroy(record);
+    }
+    {  // CRLF ends the record
+      csv[i] = '\r';
+      csv[i + 1] = '\n';
+      LCH_List *const table = LCH_CSVParseTable(csv, strlen(csv));
+      ck_assert_ptr_nonnull(table);
+      ck_assert_int_eq(LCH_ListLength(table), (i + 2 < strlen(csv)) ? 2 : 1);
+      LCH_ListDestroy(table);
+      csv[i + 1] = 'a';
+    }
+
+    const char invalid[] = {'\n', '\r', '"', '\x01', '\x7f', '\xc3'};
+    for (size_t j = 0; j < sizeof(invalid); j++) {
+      csv[i] = invalid[j];
+      ck_assert_ptr_null(LCH_CSVParseField(csv, strlen(csv)));
+      ck_assert_ptr_null(LCH_CSVParseTableColumnar(csv, strlen(csv)));
+    }
+  }
+
+  {  // Escaped double quotes at any offset
+    const char *const csv =
+        "\"\"\"a\"\"bc\"\"defghij\"\"klmnopqrstuvwxyz\"\"\"\"\"";
+    const char *const expected = "\"a\"bc\"defghij\"klmnopqrstuvwxyz\"\"";
+
+    LCH_Buffer *const field = LCH_CSVParseField(csv, strlen(csv));
+    ck_assert_ptr_nonnull(field);
+    ck_assert_str_eq(LCH_BufferData(field), expected);
+    LCH_BufferDestroy(field);
+
+    LCH_Table *const table = LCH_CSVParseTableColumnar(csv, strlen(csv));
+    ck_assert_ptr_nonnull(table);
+    ck_assert_str_eq(LCH_TableGetField(table, 0, 0, NULL), expected);
+    LCH_TableDestroy(table);
+  }
+}
+END_TEST
+
 START_TEST(test_LCH_CSVParseFile) {
   char filename[] = "test_LCH_CSVParseFile_XXXXXX";
   ck_assert_str_ne(mktemp(filename), "");
@@ -842,11 +958,21 @@ Suite *CSVSuite(void) {
     tcase_add_test(tc, test_LCH_CSVParseRecord);
     suite_add_tcase(s, tc);
   }
+  {
+    TCase *tc = tcase_create("LCH_CSVForEachField");
+    tcase_add_test(tc, test_LCH_CSVForEachField);
+    suite_add_tcase(s, tc);
+  }
   {
     TCase *tc = tcase_create("LCH_CSVParseTable");
     tcase_add_test(tc, test_LCH_CSVParseTable);
     suite_add_tcase(s, tc);
   }
+  {
+    TCase *tc = tcase_create("LCH_CSVParseLongField");
+    tcase_add_test(tc, test_LCH_CSVParseLongField);
+    suite_add_tcase(s, tc);
+  }
   {
     TCase *tc = tcase_create("LCH_CSVParseFile");
     tcase_add_test(tc, test_LCH_CSVParseFile);
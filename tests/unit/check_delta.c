@@ -2,6 +2,7 @@
 #include <limits.h>
 
 #include "../lib/csv.h"
+#include "../lib/definitions.h"
 #include "../lib/delta.c"
 #include "../lib/utils.h"
 
@@ -23,10 +24,10 @@ START_TEST(test_LCH_Delta) {
         "Paul,McCartney,1942\r\n"
         "Ringo,Starr,1941\r\n"
         "John,Lennon,1940\r\n";
-    LCH_List *table = LCH_CSVParseTable(csv, strlen(csv));
+    LCH_Table *table = LCH_CSVParseTableColumnar(csv, strlen(csv));
     ck_assert_ptr_nonnull(table);
     new_state = LCH_TableToJsonObject(table, primary_fields, subsidiary_fields);
-    LCH_ListDestroy(table);
+    LCH_TableDestroy(table);
   }
   ck_assert_ptr_nonnull(new_state);
 
@@ -37,10 +38,10 @@ START_TEST(test_LCH_Delta) {
         "Paul,McCartney,1942\r\n"
         "Ringo,Starr,1940\r\n"
         "George,Harrison,1943\r\n";
-    LCH_List *table = LCH_CSVParseTable(csv, strlen(csv));
+    LCH_Table *table = LCH_CSVParseTableColumnar(csv, strlen(csv));
     ck_assert_ptr_nonnull(table);
     old_state = LCH_TableToJsonObject(table, primary_fields, subsidiary_fields);
-    LCH_ListDestroy(table);
+    LCH_TableDestroy(table);
   }
   ck_assert_ptr_nonnull(old_state);
 
@@ -76,6 +77,210 @@ START_TEST(test_LCH_Delta) {
 }
 END_TEST
 
+START_TEST(test_LCH_DeltaNarrowUpdates) {
+  const char *const new_raw =
+      "{"
+      "  \"Paul,McCartney\": \"1942,bass,Liverpool\","
+      "  \"Ringo,Starr\": \"1940,drums,London\","
+      "  \"John,Lennon\": \"1941,piano,New York\""
+      "}";
+  LCH_Json *const new_state = LCH_JsonParse(new_raw, strlen(new_raw));
+  ck_assert_ptr_nonnull(new_state);
+
+  const char *const old_raw =
+      "{"
+      "  \"Paul,McCartney\": \"1942,bass,Liverpool\","
+      "  \"Ringo,Starr\": \"1940,drums,Liverpool\","
+      "  \"John,Lennon\": \"1940,guitar,Liverpool\""
+      "}";
+  LCH_Json *const old_state = LCH_JsonParse(old_raw, strlen(old_raw));
+  ck_assert_ptr_nonnull(old_state);
+
+  LCH_Json *const actual =
+      LCH_DeltaCreate("beatles", "delta", new_state, old_state);
+  ck_assert_ptr_nonnull(actual);
+  ck_assert(LCH_DeltaNarrowUpdates(actual, old_state));
+  LCH_JsonDestroy(new_state);
+  LCH_JsonDestroy(old_state);
+
+  /* Only Ringo gets a partial update, as all of John's fields changed */
+  const char *const expected_raw =
+      "{"
+      "  \"type\": \"delta\","
+      "  \"id\": \"beatles\","
+      "  \"inserts\": {},"
+      "  \"deletes\": {},"
+      "  \"updates\": {"
+      "    \"Ringo,Starr\": { \"2\": \"London\" },"
+      "    \"John,Lennon\": \"1941,piano,New York\""
+      "  }"
+      "}";
+  LCH_Json *const expected = LCH_JsonParse(expected_raw, strlen(expected_raw));
+  ck_assert_ptr_nonnull(expected);
+  ck_assert(LCH_JsonEqual(actual, expected));
+
+  LCH_List *const subsidiary_fields = LCH_ListCreate();
+  ck_assert_ptr_nonnull(subsidiary_fields);
+  const char *const names[] = {"born", "instrument", "city"};
+  for (size_t i = 0; i < LCH_LENGTH(names); i++) {
+    LCH_Buffer *const name = LCH_BufferFromString(names[i]);
+    ck_assert(LCH_ListAppend(subsidiary_fields, name, LCH_BufferDestroy));
+  }
+
+  const LCH_Json *const updates = LCH_DeltaGetUpdates(actual);
+  ck_assert_ptr_nonnull(updates);
+
+  {
+    const LCH_Buffer key = LCH_BufferStaticFromString("Ringo,Starr");
+    LCH_List *fields, *values;
+    ck_assert(LCH_DeltaGetUpdatedFields(LCH_JsonObjectGet(updates, &key),
+                                        subsidiary_fields, &fields, &values));
+    ck_assert_int_eq(LCH_ListLength(fields), 1);
+    ck_assert_int_eq(LCH_ListLength(values), 1);
+    ck_assert_str_eq(LCH_BufferData(LCH_ListGet(fields, 0)), "city");
+    ck_assert_str_eq(LCH_BufferData(LCH_ListGet(values, 0)), "London");
+    LCH_ListDestroy(values);
+    LCH_ListDestroy(fields);
+  }
+
+  {
+    const LCH_Buffer key = LCH_BufferStaticFromString("John,Lennon");
+    LCH_List *fields, *values;
+    ck_assert(LCH_DeltaGetUpdatedFields(LCH_JsonObjectGet(updates, &key),
+                                        subsidiary_fields, &fields, &values));
+    ck_assert_int_eq(LCH_ListLength(fields), 3);
+    ck_assert_int_eq(LCH_ListLength(values), 3);
+    ck_assert_str_eq(LCH_BufferData(LCH_ListGet(fields, 1)), "instrument");
+    ck_assert_str_eq(LCH_BufferData(LCH_ListGet(values, 1)), "piano");
+    LCH_ListDestroy(values);
+    LCH_ListDestroy(fields);
+  }
+
+  LCH_ListDestroy(subsidiary_fields);
+  LCH_JsonDestroy(expected);
+  LCH_JsonDestroy(actual);
+}
+END_TEST
+
+START_TEST(test_LCH_DeltaMerge) {
+  const char *const parent_raw =
+      "{"
+      "  \"type\": \"delta\","
+      "  \"id\": \"beatles\","
+      "  \"inserts\": { \"Paul,McCartney\": \"1942,bass,Liverpool\" },"
+      "  \"deletes\": {},"
+      "  \"updates\": {"
+      "    \"Ringo,Starr\": { \"1\": \"drums\" },"
+      "    \"John,Lennon\": \"1940,guitar,Liverpool\","
+      "    \"George,Harrison\": { \"2\": \"London\" }"
+      "  }"
+      "}";
+  LCH_Json *const parent = LCH_JsonParse(parent_raw, strlen(parent_raw));
+  ck_assert_ptr_nonnull(parent);
+
+  const char *const child_raw =
+      "{"
+      "  \"type\": \"delta\","
+      "  \"id\": \"beatles\","
+      "  \"inserts\": {},"
+      "  \"deletes\": { \"George,Harrison\": \"1943,guitar,London\" },"
+      "  \"updates\": {"
+      "    \"Paul,McCartney\": { \"2\": \"London\" },"
+      "    \"Ringo,Starr\": { \"2\": \"London\" },"
+      "    \"John,Lennon\": { \"0\": \"1941\", \"1\": \"piano\" }"
+      "  }"
+      "}";
+  LCH_Json *const child = LCH_JsonParse(child_raw, strlen(child_raw));
+  ck_assert_ptr_nonnull(child);
+
+  ck_assert(LCH_DeltaMerge(parent, child));
+  LCH_JsonDestroy(child);
+
+  const char *const expected_raw =
+      "{"
+      "  \"type\": \"delta\","
+      "  \"id\": \"beatles\","
+      "  \"inserts\": { \"Paul,McCartney\": \"1942,bass,London\" },"
+      "  \"deletes\": { \"George,Harrison\": null },"
+      "  \"updates\": {"
+      "    \"Ringo,Starr\": { \"1\": \"drums\", \"2\": \"London\" },"
+      "    \"John,Lennon\": \"1941,piano,Liverpool\""
+      "  }"
+      "}";
+  LCH_Json *const expected = LCH_JsonParse(expected_raw, strlen(expected_raw));
+  ck_assert_ptr_nonnull(expected);
+  ck_assert(LCH_JsonEqual(parent, expected));
+  LCH_JsonDestroy(expected);
+
+  /* A partial update followed by a delete with a different value must fail */
+  const char *const bad_raw =
+      "{"
+      "  \"type\": \"delta\","
+      "  \"id\": \"beatles\","
+      "  \"inserts\": {},"
+      "  \"deletes\": { \"Ringo,Starr\": \"1940,guitar,London\" },"
+      "  \"updates\": {}"
+      "}";
+  LCH_Json *const bad = LCH_JsonParse(bad_raw, strlen(bad_raw));
+  ck_assert_ptr_nonnull(bad);
+  ck_assert(!LCH_DeltaMerge(parent, bad));
+  LCH_JsonDestroy(bad);
+
+  LCH_JsonDestroy(parent);
+}
+END_TEST
+
+START_TEST(test_LCH_DeltaResolveDigests) {
+  const char *const new_raw =
+      "{"
+      "  \"Paul,McCartney\": \"1942\","
+      "  \"Ringo,Starr\": \"1941\""
+      "}";
+  LCH_Json *const new_state = LCH_JsonParse(new_raw, strlen(new_raw));
+  ck_assert_ptr_nonnull(new_state);
+
+  /* Digests stand in for the values of the old state */
+  const char *const old_raw =
+      "{"
+      "  \"Ringo,Starr\": \"c2a3\","
+      "  \"John,Lennon\": \"9f1e\""
+      "}";
+  LCH_Json *const old_state = LCH_JsonParse(old_raw, strlen(old_raw));
+  ck_assert_ptr_nonnull(old_state);
+
+  const char *const digests_raw =
+      "{"
+      "  \"Paul,McCartney\": \"44d0\","
+      "  \"Ringo,Starr\": \"0b7c\""
+      "}";
+  LCH_Json *const digests = LCH_JsonParse(digests_raw, strlen(digests_raw));
+  ck_assert_ptr_nonnull(digests);
+
+  LCH_Json *const actual =
+      LCH_DeltaCreate("beatles", "delta", digests, old_state);
+  ck_assert_ptr_nonnull(actual);
+  ck_assert(LCH_DeltaResolveDigests(actual, new_state));
+  LCH_JsonDestroy(digests);
+  LCH_JsonDestroy(old_state);
+  LCH_JsonDestroy(new_state);
+
+  const char *const expected_raw =
+      "{"
+      "  \"type\": \"delta\","
+      "  \"id\": \"beatles\","
+      "  \"inserts\": { \"Paul,McCartney\": \"1942\" },"
+      "  \"deletes\": { \"John,Lennon\": null },"
+      "  \"updates\": { \"Ringo,Starr\": \"1941\" }"
+      "}";
+  LCH_Json *const expected = LCH_JsonParse(expected_raw, strlen(expected_raw));
+  ck_assert_ptr_nonnull(expected);
+  ck_assert(LCH_JsonEqual(actual, expected));
+
+  LCH_JsonDestroy(expected);
+  LCH_JsonDestroy(actual);
+}
+END_TEST
+
 Suite *DeltaSuite(void) {
   Suite *s = suite_create("delta.c");
   {
@@ -83,5 +288,20 @@ Suite *DeltaSuite(void) {
     tcase_add_test(tc, test_LCH_Delta);
     suite_add_tcase(s, tc);
   }
+  {
+    TCase *tc = tcase_create("LCH_DeltaNarrowUpdates");
+    tcase_add_test(tc, test_LCH_DeltaNarrowUpdates);
+    suite_add_tcase(s, tc);
+  }
+  {
+    TCase *tc = tcase_create("LCH_DeltaMerge");
+    tcase_add_test(tc, test_LCH_DeltaMerge);
+    suite_add_tcase(s, tc);
+  }
+  {
+    TCase *tc = tcase_create("LCH_DeltaResolveDigests");
+    tcase_add_test(tc, test_LCH_DeltaResolveDigests);
+    suite_add_tcase(s, tc);
+  }
   return s;
 }
@@ -0,0 +1,147 @@
+#include <check.h>
+
+#include "../lib/encoding.h"
+
+START_TEST(test_LCH_EncodingFromString) {
+  LCH_Encoding encoding;
+  ck_assert(LCH_EncodingFromString("json", &encoding));
+  ck_assert_int_eq(encoding, LCH_ENCODING_JSON);
+  ck_assert(LCH_EncodingFromString("binary", &encoding));
+  ck_assert_int_eq(encoding, LCH_ENCODING_BINARY);
+  ck_assert_str_eq(LCH_EncodingToString(encoding), "binary");
+  ck_assert(!LCH_EncodingFromString("bogus", &encoding));
+}
+END_TEST
+
+START_TEST(test_LCH_EncodingCompose) {
+  const char *const raw =
+      "{"
+      "  \"version\": 2,"
+      "  \"timestamp\": 1712345678,"
+      "  \"parent\": \"0000000000000000000000000000000000000000\","
+      "  \"payload\": ["
+      "    {"
+      "      \"id\": \"BTL\","
+      "      \"type\": \"delta\","
+      "      \"inserts\": {"
+      "        \"Paul,McCartney\": \"1942\","
+      "        \"\\\"Starr, Ringo\\\",\": \"1940\""
+      "      },"
+      "      \"deletes\": { \"John,Lennon\": \"1940\" },"
+      "      \"updates\": { \"George,Harrison\": \"1943,\\\"\\\"\\\"\\\"\" }"
+      "    },"
+      "    { \"id\": \"XYZ\", \"extra\": [true, false, null, -1.5] }"
+      "  ]"
+      "}";
+
+  LCH_Json *const expected = LCH_JsonParse(raw, strlen(raw));
+  ck_assert_ptr_nonnull(expected);
+
+  LCH_Buffer *const buffer =
+      LCH_EncodingCompose(expected, LCH_ENCODING_BINARY, false);
+  ck_assert_ptr_nonnull(buffer);
+  ck_assert(LCH_EncodingIsBinary(LCH_BufferData(buffer),
+                                 LCH_BufferLength(buffer)));
+
+  LCH_Json *const actual =
+      LCH_EncodingParse(LCH_BufferData(buffer), LCH_BufferLength(buffer));
+  ck_assert_ptr_nonnull(actual);
+  ck_assert(LCH_JsonEqual(actual, expected));
+
+  /* Truncated input must be rejected */
+  for (size_t i = LCH_BINARY_MAGIC_LENGTH; i < LCH_BufferLength(buffer); i++) {
+    LCH_Json *const truncated = LCH_EncodingParse(LCH_BufferData(buffer), i);
+    ck_assert_ptr_null(truncated);
+  }
+
+  LCH_JsonDestroy(actual);
+  LCH_BufferDestroy(buffer);
+  LCH_JsonDestroy(expected);
+}
+END_TEST
+
+START_TEST(test_LCH_EncodingParse) {
+  const char *const raw = "{\"version\": 2}";
+  LCH_Json *const json = LCH_EncodingParse(raw, strlen(raw));
+  ck_assert_ptr_nonnull(json);
+  ck_assert(LCH_JsonIsObject(json));
+  LCH_JsonDestroy(json);
+
+  const char bogus[] = LCH_BINARY_MAGIC "\x42";
+  ck_assert_ptr_null(LCH_EncodingParse(bogus, sizeof(bogus) - 1));
+}
+END_TEST
+
+START_TEST(test_LCH_EncodingParseFields) {
+  const char *const raw =
+      "{"
+      "  \"id\": \"BTL\","
+      "  \"type\": \"delta\","
+      "  \"inserts\": { \"\\\"Starr, Ringo\\\",\": \"1940\" },"
+      "  \"deletes\": {},"
+      "  \"updates\": {}"
+      "}";
+
+  LCH_Json *const delta = LCH_JsonParse(raw, strlen(raw));
+  ck_assert_ptr_nonnull(delta);
+
+  /* JSON encoded records are left as they are */
+  LCH_Buffer *buffer = LCH_EncodingCompose(delta, LCH_ENCODING_JSON, false);
+  ck_assert_ptr_nonnull(buffer);
+  LCH_Json *actual =
+      LCH_EncodingParseFields(LCH_BufferData(buffer), LCH_BufferLength(buffer));
+  ck_assert_ptr_nonnull(actual);
+  ck_assert(LCH_JsonEqual(actual, delta));
+  LCH_JsonDestroy(actual);
+  LCH_BufferDestroy(buffer);
+
+  /* Binary encoded records are split into fields */
+  buffer = LCH_EncodingCompose(delta, LCH_ENCODING_BINARY, false);
+  ck_assert_ptr_nonnull(buffer);
+  actual =
+      LCH_EncodingParseFields(LCH_BufferData(buffer), LCH_BufferLength(buffer));
+  ck_assert_ptr_nonnull(actual);
+
+  const char *const split =
+      "{"
+      "  \"id\": \"BTL\","
+      "  \"type\": \"delta\","
+      "  \"inserts\": [ [ [\"Starr, Ringo\", \"\"], [\"1940\"] ] ],"
+      "  \"deletes\": [],"
+      "  \"updates\": []"
+      "}";
+  LCH_Json *const expected = LCH_JsonParse(split, strlen(split));
+  ck_assert_ptr_nonnull(expected);
+  ck_assert(LCH_JsonEqual(actual, expected));
+
+  LCH_JsonDestroy(expected);
+  LCH_JsonDestroy(actual);
+  LCH_BufferDestroy(buffer);
+  LCH_JsonDestroy(delta);
+}
+END_TEST
+
+Suite *EncodingSuite(void) {
+  Suite *s = suite_create("encoding.c");
+  {
+    TCase *tc = tcase_create("LCH_EncodingFromString");
+    tcase_add_test(tc, test_LCH_EncodingFromString);
+    suite_add_tcase(s, tc);
+  }
+  {
+    TCase *tc = tcase_create("LCH_EncodingCompose");
+    tcase_add_test(tc, test_LCH_EncodingCompose);
+    suite_add_tcase(s, tc);
+  }
+  {
+    TCase *tc = tcase_create("LCH_EncodingParse");
+    tcase_add_test(tc, test_LCH_EncodingParse);
+    suite_add_tcase(s, tc);
+  }
+  {
+    TCase *tc = tcase_create("LCH_EncodingParseFields");
+    tcase_add_test(tc, test_LCH_EncodingParseFields);
+    suite_add_tcase(s, tc);
+  }
+  return s;
+}
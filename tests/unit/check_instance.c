@@ -1,12 +1,57 @@
 #include <check.h>
+#include <limits.h>
+#include <stdlib.h>
 
+#include "../lib/files.h"
 #include "../lib/instance.h"
 
-START_TEST(test_LCH_InstanceLoad) { ck_assert(true); }
+START_TEST(test_LCH_InstanceLoad) {
+  char work_dir[] = "/tmp/leech-check-XXXXXX";
+  ck_assert_ptr_nonnull(mkdtemp(work_dir));
+
+  /* The module does not exist, which goes unnoticed until it is used */
+  const char *const config =
+      "{\"version\": \"0.1.0\", \"tables\": {\"FOO\": {"
+      "\"primary_fields\": [\"id\"], \"subsidiary_fields\": [\"value\"], "
+      "\"source\": {\"params\": \"src.csv\", \"schema\": \"leech\", "
+      "\"table_name\": \"foo\", \"callbacks\": \"/nonexistent/module.so\"}, "
+      "\"destination\": {\"params\": \"dst.csv\", \"schema\": \"leech\", "
+      "\"table_name\": \"foo\", \"callbacks\": \"/nonexistent/module.so\"}}}}";
+  LCH_Buffer *const buffer = LCH_BufferFromString(config);
+  ck_assert_ptr_nonnull(buffer);
+  char path[PATH_MAX];
+  ck_assert(LCH_FilePathJoin(path, sizeof(path), 2, work_dir, "leech.json"));
+  ck_assert(LCH_BufferWriteFile(buffer, path));
+  LCH_BufferDestroy(buffer);
+
+  LCH_Instance *const instance = LCH_InstanceLoad(work_dir);
+  ck_assert_ptr_nonnull(instance);
+  ck_assert(!LCH_InstanceIsStale(instance));
+
+  ck_assert(LCH_InstanceHasTable(instance, "FOO"));
+  ck_assert(!LCH_InstanceHasTable(instance, "BAR"));
+  ck_assert_ptr_null(LCH_InstanceGetTable(instance, "BAR"));
+
+  const LCH_TableInfo *const table = LCH_InstanceGetTable(instance, "FOO");
+  ck_assert_ptr_nonnull(table);
+  ck_assert_ptr_eq(LCH_InstanceGetTable(instance, "FOO"), table);
+  ck_assert_str_eq(LCH_TableInfoGetIdentifier(table), "FOO");
+
+  const LCH_List *const tables = LCH_InstanceGetTables(instance);
+  ck_assert_ptr_nonnull(tables);
+  ck_assert_int_eq(LCH_ListLength(tables), 1);
+  ck_assert_ptr_eq(LCH_ListGet(tables, 0), table);
+
+  /* Loading the module fails on first use */
+  ck_assert_ptr_null(LCH_TableInfoLoadNewState(table));
+
+  LCH_InstanceDestroy(instance);
+  ck_assert(LCH_FileDelete(work_dir));
+}
 END_TEST
 
 Suite *InstanceSuite(void) {
-  Suite *s = suite_create("table.c");
+  Suite *s = suite_create("instance.c");
   {
     TCase *tc = tcase_create("LCH_InstanceLoad");
     tcase_add_test(tc, test_LCH_InstanceLoad);
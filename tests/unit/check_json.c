@@ -732,6 +732,44 @@ START_TEST(test_LCH_JsonParse) {
 }
 END_TEST
 
+START_TEST(test_LCH_JsonParseBuffer) {
+  const char *const str =
+      "{"
+      "  \"one\": \"two,\\\"three\\\"\","
+      "  \"four\": { \"fi\\\"ve\": \"six\" },"
+      "  \"seven\": [\"eight\", 9]"
+      "}";
+  LCH_Buffer *const buffer = LCH_BufferFromString(str);
+  ck_assert_ptr_nonnull(buffer);
+
+  LCH_Json *const json = LCH_JsonParseBuffer(buffer);
+  ck_assert_ptr_nonnull(json);
+
+  LCH_Json *const expected = LCH_JsonParse(str, strlen(str));
+  ck_assert_ptr_nonnull(expected);
+  ck_assert(LCH_JsonEqual(json, expected));
+
+  /* Borrowed strings must outlive the element they were parsed into */
+  LCH_Buffer key = LCH_BufferStaticFromString("four");
+  LCH_Json *const four = LCH_JsonObjectRemoveObject(json, &key);
+  ck_assert_ptr_nonnull(four);
+  LCH_JsonDestroy(json);
+
+  key = LCH_BufferStaticFromString("fi\"ve");
+  const LCH_Buffer *const six = LCH_JsonObjectGetString(four, &key);
+  ck_assert_ptr_nonnull(six);
+  ck_assert_str_eq(LCH_BufferData(six), "six");
+
+  LCH_JsonDestroy(four);
+  LCH_JsonDestroy(expected);
+
+  /* The buffer is consumed, also in case of failure */
+  LCH_Buffer *const invalid = LCH_BufferFromString("{\"one\": \"two}");
+  ck_assert_ptr_nonnull(invalid);
+  ck_assert_ptr_null(LCH_JsonParseBuffer(invalid));
+}
+END_TEST
+
 START_TEST(test_LCH_JsonParseFile) {
   // TODO: Implement
 }
@@ -839,6 +877,35 @@ START_TEST(test_LCH_JsonComposeNumber) {
     }
     LCH_JsonDestroy(json);
   }
+  {  // Shortest representation
+    const double numbers[] = {0.0, -42.0, 1712345678.0, 0.1, -2.5, 1.0 / 3.0,
+                              1e-7, 1e300, 9007199254740993.0};
+    const char *const expected[] = {
+        "0",     "-42",    "1712345678",
+        "0.1",   "-2.5",   NULL, /* Only checked by round-trip */
+        "1e-07", "1e+300", "9007199254740992",
+    };
+    for (size_t i = 0; i < sizeof(numbers) / sizeof(*numbers); i++) {
+      LCH_Json *const json = LCH_JsonNumberCreate(numbers[i]);
+      ck_assert_ptr_nonnull(json);
+
+      LCH_Buffer *const actual = LCH_JsonCompose(json, false);
+      ck_assert_ptr_nonnull(actual);
+      if (expected[i] != NULL) {
+        ck_assert_str_eq(LCH_BufferData(actual), expected[i]);
+      }
+
+      /* Numbers must survive a round-trip */
+      LCH_Json *const parsed =
+          LCH_JsonParse(LCH_BufferData(actual), LCH_BufferLength(actual));
+      ck_assert_ptr_nonnull(parsed);
+      ck_assert(LCH_JsonNumberGet(parsed) == numbers[i]);
+
+      LCH_JsonDestroy(parsed);
+      LCH_BufferDestroy(actual);
+      LCH_JsonDestroy(json);
+    }
+  }
 }
 END_TEST
 
@@ -889,6 +956,20 @@ START_TEST(test_LCH_JsonComposeString) {
       LCH_BufferDestroy(actual);
     }
 
+    LCH_JsonDestroy(json);
+  }
+  {
+    LCH_Buffer *const str = LCH_BufferFromString("a\\\"b\"\\c\\");
+    ck_assert_ptr_nonnull(str);
+
+    LCH_Json *const json = LCH_JsonStringCreate(str);
+    ck_assert_ptr_nonnull(json);
+
+    LCH_Buffer *const actual = LCH_JsonCompose(json, false);
+    ck_assert_ptr_nonnull(actual);
+    ck_assert_str_eq(LCH_BufferData(actual), "\"a\\\\\\\"b\\\"\\\\c\\\\\"");
+    LCH_BufferDestroy(actual);
+
     LCH_JsonDestroy(json);
   }
 }
@@ -1299,6 +1380,11 @@ Suite *JSONSuite(void) {
     tcase_add_test(tc, test_LCH_JsonParse);
     suite_add_tcase(s, tc);
   }
+  {
+    TCase *tc = tcase_create("LCH_JsonParseBuffer");
+    tcase_add_test(tc, test_LCH_JsonParseBuffer);
+    suite_add_tcase(s, tc);
+  }
   {
     TCase *tc = tcase_create("LCH_JsonParseFile");
     tcase_add_test(tc, test_LCH_JsonParseFile);
@@ -114,6 +114,43 @@ START_TEST(test_LCH_ListReverse) {
 }
 END_TEST
 
+START_TEST(test_LCH_ListMixedDestroy) {
+  LCH_List *list = LCH_ListCreate();
+  ck_assert_ptr_nonnull(list);
+  ck_assert(LCH_ListReserve(list, 4));
+
+  const char *strs[] = {"one", "two", "three", "four"};
+  for (size_t i = 0; i < LCH_LENGTH(strs); i++) {
+    if (i % 2 == 0) {
+      ck_assert(LCH_ListAppend(list, (void *)strs[i], NULL));
+    } else {
+      char *const dup = strdup(strs[i]);
+      ck_assert_ptr_nonnull(dup);
+      ck_assert(LCH_ListAppend(list, dup, free));
+    }
+  }
+
+  /* Destroy functions must follow their elements around */
+  LCH_ListReverse(list);
+  char *const removed = (char *)LCH_ListRemove(list, 0);
+  ck_assert_str_eq(removed, "four");
+  free(removed);
+
+  char *const dup = strdup("five");
+  ck_assert_ptr_nonnull(dup);
+  ck_assert(LCH_ListInsert(list, 1, dup, free));
+  LCH_ListSet(list, 0, (void *)strs[0], NULL);
+
+  ck_assert_int_eq(LCH_ListLength(list), 4);
+  ck_assert_str_eq((char *)LCH_ListGet(list, 0), "one");
+  ck_assert_str_eq((char *)LCH_ListGet(list, 1), "five");
+  ck_assert_str_eq((char *)LCH_ListGet(list, 2), "two");
+  ck_assert_str_eq((char *)LCH_ListGet(list, 3), "one");
+
+  LCH_ListDestroy(list);
+}
+END_TEST
+
 Suite *ListSuite(void) {
   Suite *s = suite_create("list.c");
   {
@@ -141,5 +178,10 @@ Suite *ListSuite(void) {
     tcase_add_test(tc, test_LCH_ListReverse);
     suite_add_tcase(s, tc);
   }
+  {
+    TCase *tc = tcase_create("LCH_ListMixedDestroy");
+    tcase_add_test(tc, test_LCH_ListMixedDestroy);
+    suite_add_tcase(s, tc);
+  }
   return s;
 }
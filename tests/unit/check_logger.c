@@ -0,0 +1,71 @@
+#include <check.h>
+#include <string.h>
+
+#include "../lib/logger.h"
+
+static char MESSAGES[8][64];
+static unsigned char SEVERITIES[8];
+static size_t NUM_MESSAGES;
+
+static void Callback(unsigned char severity, const char *message) {
+  ck_assert_int_lt(NUM_MESSAGES, 8);
+  SEVERITIES[NUM_MESSAGES] = severity;
+  strncpy(MESSAGES[NUM_MESSAGES], message, sizeof(MESSAGES[0]) - 1);
+  NUM_MESSAGES += 1;
+}
+
+START_TEST(test_LCH_LoggerRingBuffer) {
+  NUM_MESSAGES = 0;
+  LCH_LoggerCallbackSet(Callback);
+  LCH_LoggerSeveritySet(LCH_LOGGER_MESSAGE_TYPE_ERROR_BIT);
+  ck_assert(!LCH_LOG_ENABLED(LCH_LOGGER_MESSAGE_TYPE_DEBUG_BIT));
+
+  ck_assert(LCH_LoggerRingBufferSet(2, LCH_LOGGER_MESSAGE_TYPE_DEBUG_BIT));
+  ck_assert(LCH_LOG_ENABLED(LCH_LOGGER_MESSAGE_TYPE_DEBUG_BIT));
+  ck_assert(!LCH_LOG_ENABLED(LCH_LOGGER_MESSAGE_TYPE_INFO_BIT));
+
+  /* Debug messages are kept, and the oldest is overwritten */
+  for (int i = 1; i <= 3; i++) {
+    LCH_LOG_DEBUG("debug %d", i);
+  }
+  LCH_LOG_INFO("info");
+  ck_assert_int_eq(NUM_MESSAGES, 0);
+
+  /* An error flushes the ring buffer ahead of itself */
+  LCH_LOG_ERROR("error");
+  ck_assert_int_eq(NUM_MESSAGES, 3);
+  ck_assert_str_eq(MESSAGES[0], "debug 2");
+  ck_assert_int_eq(SEVERITIES[0], LCH_LOGGER_MESSAGE_TYPE_DEBUG_BIT);
+  ck_assert_str_eq(MESSAGES[1], "debug 3");
+  ck_assert_str_eq(MESSAGES[2], "error");
+  ck_assert_int_eq(SEVERITIES[2], LCH_LOGGER_MESSAGE_TYPE_ERROR_BIT);
+
+  /* The ring buffer is empty after a flush */
+  LCH_LoggerRingBufferFlush();
+  ck_assert_int_eq(NUM_MESSAGES, 3);
+
+  LCH_LOG_DEBUG("debug 4");
+  LCH_LoggerRingBufferFlush();
+  ck_assert_int_eq(NUM_MESSAGES, 4);
+  ck_assert_str_eq(MESSAGES[3], "debug 4");
+
+  ck_assert(LCH_LoggerRingBufferSet(0, 0));
+  ck_assert(!LCH_LOG_ENABLED(LCH_LOGGER_MESSAGE_TYPE_DEBUG_BIT));
+  LCH_LOG_DEBUG("debug 5");
+  LCH_LoggerRingBufferFlush();
+  ck_assert_int_eq(NUM_MESSAGES, 4);
+
+  LCH_LoggerSeveritySet(LCH_LOGGER_MESSAGE_TYPE_ERROR_BIT |
+                        LCH_LOGGER_MESSAGE_TYPE_WARNING_BIT);
+}
+END_TEST
+
+Suite *LoggerSuite(void) {
+  Suite *s = suite_create("logger.c");
+  {
+    TCase *tc = tcase_create("LCH_LoggerRingBuffer");
+    tcase_add_test(tc, test_LCH_LoggerRingBuffer);
+    suite_add_tcase(s, tc);
+  }
+  return s;
+}
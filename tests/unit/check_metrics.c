@@ -0,0 +1,80 @@
+#include <check.h>
+#include <unistd.h>
+
+#include "../lib/buffer.h"
+#include "../lib/metrics.h"
+
+START_TEST(test_LCH_MetricsCounters) {
+  LCH_MetricsReset();
+
+  LCH_Metrics metrics;
+  LCH_MetricsGet(&metrics);
+  ck_assert_int_eq(metrics.bytes_read, 0);
+  ck_assert_int_eq(metrics.bytes_written, 0);
+  ck_assert_int_eq(metrics.allocations, 0);
+
+  char filename[] = "test_LCH_MetricsCounters_XXXXXX";
+  const int fd = mkstemp(filename);
+  ck_assert_int_ne(fd, -1);
+  close(fd);
+
+  LCH_Buffer *const buffer = LCH_BufferFromString("Paul,McCartney,1942");
+  ck_assert_ptr_nonnull(buffer);
+  ck_assert(LCH_BufferWriteFile(buffer, filename));
+  LCH_BufferDestroy(buffer);
+
+  LCH_Buffer *const content = LCH_BufferMapFile(filename);
+  ck_assert_ptr_nonnull(content);
+  LCH_BufferDestroy(content);
+  ck_assert_int_eq(unlink(filename), 0);
+
+  LCH_MetricsCountStatement();
+  LCH_MetricsCountRowsLoaded(3);
+  LCH_MetricsCountRowsPatched(2);
+
+  LCH_MetricsGet(&metrics);
+  ck_assert_int_eq(metrics.bytes_written, strlen("Paul,McCartney,1942"));
+  ck_assert_int_eq(metrics.bytes_read, strlen("Paul,McCartney,1942"));
+  ck_assert_int_gt(metrics.allocations, 0);
+  ck_assert_int_eq(metrics.statements, 1);
+  ck_assert_int_eq(metrics.rows_loaded, 3);
+  ck_assert_int_eq(metrics.rows_patched, 2);
+
+  LCH_MetricsReset();
+  LCH_MetricsGet(&metrics);
+  ck_assert_int_eq(metrics.bytes_read, 0);
+  ck_assert_int_eq(metrics.statements, 0);
+}
+END_TEST
+
+START_TEST(test_LCH_MetricsPhases) {
+  LCH_MetricsReset();
+
+  const double start = LCH_MetricsStart();
+  LCH_MetricsStop(LCH_METRICS_PHASE_DELTA, start);
+
+  LCH_Metrics metrics;
+  LCH_MetricsGet(&metrics);
+  ck_assert(metrics.seconds[LCH_METRICS_PHASE_DELTA] >= 0.0);
+  ck_assert(metrics.seconds[LCH_METRICS_PHASE_HASH] == 0.0);
+
+  ck_assert_str_eq(LCH_MetricsPhaseToString(LCH_METRICS_PHASE_LOAD_NEW_STATE),
+                   "load_new_state");
+  ck_assert_str_eq(LCH_MetricsPhaseToString(LCH_METRICS_PHASE_PURGE), "purge");
+}
+END_TEST
+
+Suite *MetricsSuite(void) {
+  Suite *s = suite_create("metrics.c");
+  {
+    TCase *tc = tcase_create("LCH_MetricsCounters");
+    tcase_add_test(tc, test_LCH_MetricsCounters);
+    suite_add_tcase(s, tc);
+  }
+  {
+    TCase *tc = tcase_create("LCH_MetricsPhases");
+    tcase_add_test(tc, test_LCH_MetricsPhases);
+    suite_add_tcase(s, tc);
+  }
+  return s;
+}
@@ -0,0 +1,120 @@
+#include <check.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../lib/files.h"
+#include "../lib/pack.h"
+
+static void AssertPacked(LCH_Pack *const pack, const char *const block_id,
+                         const char *const expected) {
+  LCH_Buffer *buffer;
+  ck_assert(LCH_PackRead(pack, block_id, &buffer));
+  if (expected == NULL) {
+    ck_assert_ptr_null(buffer);
+  } else {
+    ck_assert_ptr_nonnull(buffer);
+    ck_assert_str_eq(LCH_BufferData(buffer), expected);
+    LCH_BufferDestroy(buffer);
+  }
+}
+
+static void Append(LCH_Pack *const pack, const char *const block_id,
+                   const char *const data) {
+  LCH_Buffer *const buffer = LCH_BufferFromString(data);
+  ck_assert_ptr_nonnull(buffer);
+  ck_assert(LCH_PackAppend(pack, block_id, buffer));
+  LCH_BufferDestroy(buffer);
+}
+
+START_TEST(test_LCH_Pack) {
+  char work_dir[] = "/tmp/leech-check-XXXXXX";
+  ck_assert_ptr_nonnull(mkdtemp(work_dir));
+
+  const char *const first = "aa0e1d2c3b4a5968778695a4b3c2d1e0f0e1d2c3";
+  const char *const second = "ab0e1d2c3b4a5968778695a4b3c2d1e0f0e1d2c3";
+  const char *const third = "ac0e1d2c3b4a5968778695a4b3c2d1e0f0e1d2c3";
+
+  /* The packs directory does not exist yet */
+  LCH_Pack *const pack = LCH_PackCreate(work_dir);
+  ck_assert_ptr_nonnull(pack);
+  AssertPacked(pack, first, NULL);
+
+  Append(pack, first, "{\"first\": 1}");
+  Append(pack, first, "{\"first\": 1}");
+  AssertPacked(pack, first, "{\"first\": 1}");
+
+  /* Blocks appended by another process */
+  LCH_Pack *const other = LCH_PackCreate(work_dir);
+  ck_assert_ptr_nonnull(other);
+  AssertPacked(other, first, "{\"first\": 1}");
+  Append(other, second, "{\"second\": 2}");
+  AssertPacked(pack, second, "{\"second\": 2}");
+
+  bool found;
+  ck_assert(LCH_PackContains(pack, second, &found));
+  ck_assert(found);
+  ck_assert(LCH_PackContains(pack, third, &found));
+  ck_assert(!found);
+
+  LCH_List *block_ids = LCH_PackList(pack);
+  ck_assert_ptr_nonnull(block_ids);
+  ck_assert_int_eq(LCH_ListLength(block_ids), 2);
+  LCH_ListDestroy(block_ids);
+
+  /* An incomplete record at the end of the segment is ignored, and never
+   * appended to */
+  char path[PATH_MAX];
+  ck_assert(
+      LCH_FilePathJoin(path, PATH_MAX, 3, work_dir, "packs", "00000001.pack"));
+  FILE *const file = fopen(path, "a");
+  ck_assert_ptr_nonnull(file);
+  ck_assert_int_ge(fputs(third, file), 0);
+  ck_assert_int_eq(fclose(file), 0);
+
+  Append(pack, third, "{\"third\": 3}");
+  ck_assert(
+      LCH_FilePathJoin(path, PATH_MAX, 3, work_dir, "packs", "00000002.pack"));
+  ck_assert(LCH_FileIsRegular(path));
+  AssertPacked(other, third, "{\"third\": 3}");
+
+  /* Deleting blocks rewrites the segments containing them, while other
+   * processes can still read the blocks that are kept */
+  LCH_Dict *const whitelist = LCH_DictCreate();
+  ck_assert_ptr_nonnull(whitelist);
+  const LCH_Buffer key = LCH_BufferStaticFromString(second);
+  ck_assert(LCH_DictSet(whitelist, &key, NULL, NULL));
+  ck_assert(LCH_PackRetain(pack, whitelist));
+  LCH_DictDestroy(whitelist);
+
+  AssertPacked(pack, first, NULL);
+  AssertPacked(pack, third, NULL);
+  AssertPacked(other, second, "{\"second\": 2}");
+
+  block_ids = LCH_PackList(other);
+  ck_assert_ptr_nonnull(block_ids);
+  ck_assert_int_eq(LCH_ListLength(block_ids), 1);
+  ck_assert_str_eq((char *)LCH_ListGet(block_ids, 0), second);
+  LCH_ListDestroy(block_ids);
+
+  ck_assert(!LCH_FileExists(path));
+  ck_assert(
+      LCH_FilePathJoin(path, PATH_MAX, 3, work_dir, "packs", "00000003.pack"));
+  ck_assert(LCH_FileIsRegular(path));
+
+  LCH_PackDestroy(other);
+  LCH_PackDestroy(pack);
+  ck_assert(LCH_FileDelete(work_dir));
+}
+END_TEST
+
+Suite *PackSuite(void) {
+  Suite *s = suite_create("pack.c");
+  {
+    TCase *tc = tcase_create("LCH_Pack");
+    tcase_add_test(tc, test_LCH_Pack);
+    suite_add_tcase(s, tc);
+  }
+  return s;
+}
@@ -1,10 +1,131 @@
 #include <check.h>
+#include <stdlib.h>
 
 #include "../lib/table.c"
 
 START_TEST(test_LCH_TableInfoLoad) { ck_assert(true); }
 END_TEST
 
+START_TEST(test_LCH_TableStateDigest) {
+  const char *const raw =
+      "{"
+      "  \"Paul,McCartney\": \"1942\","
+      "  \"Ringo,Starr\": \"1940\","
+      "  \"John,Lennon\": \"1940\""
+      "}";
+  LCH_Json *const state = LCH_JsonParse(raw, strlen(raw));
+  ck_assert_ptr_nonnull(state);
+
+  LCH_Json *const digests = LCH_TableStateDigest(state);
+  ck_assert_ptr_nonnull(digests);
+  ck_assert_int_eq(LCH_JsonObjectLength(digests), 3);
+
+  const LCH_Buffer paul = LCH_BufferStaticFromString("Paul,McCartney");
+  const LCH_Buffer ringo = LCH_BufferStaticFromString("Ringo,Starr");
+  const LCH_Buffer john = LCH_BufferStaticFromString("John,Lennon");
+
+  const LCH_Buffer *const digest = LCH_JsonObjectGetString(digests, &paul);
+  ck_assert_ptr_nonnull(digest);
+  ck_assert_int_eq(LCH_BufferLength(digest), LCH_ROW_DIGEST_LENGTH);
+
+  /* Equal values give equal digests */
+  ck_assert(LCH_BufferEqual(LCH_JsonObjectGetString(digests, &ringo),
+                            LCH_JsonObjectGetString(digests, &john)));
+  ck_assert(!LCH_BufferEqual(LCH_JsonObjectGetString(digests, &ringo),
+                             LCH_JsonObjectGetString(digests, &paul)));
+
+  LCH_JsonDestroy(digests);
+  LCH_JsonDestroy(state);
+}
+END_TEST
+
+static void AppendNewState(const LCH_TableInfo *const table_info,
+                           const char *const work_dir, const size_t log_limit,
+                           const LCH_Json *const old_state,
+                           const LCH_Json *const new_state,
+                           const bool expected) {
+  LCH_Json *const delta =
+      LCH_DeltaCreate(table_info->identifier, "delta", new_state, old_state);
+  ck_assert_ptr_nonnull(delta);
+  bool appended;
+  ck_assert(LCH_TableAppendNewState(table_info, work_dir, log_limit, delta,
+                                    new_state, &appended));
+  ck_assert(appended == expected);
+  LCH_JsonDestroy(delta);
+}
+
+static void AssertOldState(const LCH_TableInfo *const table_info,
+                           const char *const work_dir,
+                           const LCH_Json *const expected) {
+  LCH_Json *const state = LCH_TableInfoLoadOldState(table_info, work_dir);
+  ck_assert_ptr_nonnull(state);
+  ck_assert(LCH_JsonEqual(state, expected));
+  LCH_JsonDestroy(state);
+}
+
+START_TEST(test_LCH_TableAppendNewState) {
+  char work_dir[] = "/tmp/leech-check-XXXXXX";
+  ck_assert_ptr_nonnull(mkdtemp(work_dir));
+
+  char identifier[] = "beatles";
+  const LCH_TableInfo table_info = {.identifier = identifier};
+
+  const char *const raw[] = {
+      "{\"Paul,McCartney\": \"1942\", \"Ringo,Starr\": \"1940\"}",
+      "{\"Paul,McCartney\": \"1942\", \"John,Lennon\": \"1940\"}",
+      "{\"Paul,McCartney\": \"1943\", \"John,Lennon\": \"1940\"}",
+      "{\"Paul,McCartney\": \"1943\"}",
+  };
+  LCH_Json *states[LCH_LENGTH(raw)];
+  for (size_t i = 0; i < LCH_LENGTH(raw); i++) {
+    states[i] = LCH_JsonParse(raw[i], strlen(raw[i]));
+    ck_assert_ptr_nonnull(states[i]);
+  }
+
+  /* Nothing is appended without a snapshot */
+  LCH_Json *const empty = LCH_JsonObjectCreate();
+  ck_assert_ptr_nonnull(empty);
+  AppendNewState(&table_info, work_dir, 1000, empty, states[0], false);
+  LCH_JsonDestroy(empty);
+  ck_assert(LCH_TableStoreNewState(&table_info, work_dir, false,
+                                   LCH_COMPRESSION_NONE, states[0]));
+
+  /* The log is replayed onto the snapshot */
+  AppendNewState(&table_info, work_dir, 1000, states[0], states[1], true);
+  AssertOldState(&table_info, work_dir, states[1]);
+  AppendNewState(&table_info, work_dir, 1000, states[1], states[2], true);
+  AssertOldState(&table_info, work_dir, states[2]);
+
+  char path[PATH_MAX];
+  ck_assert(LCH_TableSnapshotLogPath(path, sizeof(path), work_dir, identifier));
+  ck_assert(LCH_FileIsRegular(path));
+
+  /* An incomplete record at the end of the log is ignored, and never appended
+   * to */
+  FILE *const file = fopen(path, "a");
+  ck_assert_ptr_nonnull(file);
+  ck_assert_int_ge(fputs("{\"Paul,McCartney\": ", file), 0);
+  ck_assert_int_eq(fclose(file), 0);
+  AssertOldState(&table_info, work_dir, states[2]);
+  AppendNewState(&table_info, work_dir, 1000, states[2], states[3], false);
+
+  /* Storing the complete state removes the log */
+  ck_assert(LCH_TableStoreNewState(&table_info, work_dir, false,
+                                   LCH_COMPRESSION_NONE, states[3]));
+  ck_assert(!LCH_FileExists(path));
+  AssertOldState(&table_info, work_dir, states[3]);
+
+  /* Nothing is appended once the log would grow beyond the limit */
+  AppendNewState(&table_info, work_dir, 50, states[3], states[2], false);
+  ck_assert(!LCH_FileExists(path));
+
+  for (size_t i = 0; i < LCH_LENGTH(raw); i++) {
+    LCH_JsonDestroy(states[i]);
+  }
+  ck_assert(LCH_FileDelete(work_dir));
+}
+END_TEST
+
 Suite *TableSuite(void) {
   Suite *s = suite_create("table.c");
   {
@@ -12,5 +133,15 @@ Suite *TableSuite(void) {
     tcase_add_test(tc, test_LCH_TableInfoLoad);
     suite_add_tcase(s, tc);
   }
+  {
+    TCase *tc = tcase_create("LCH_TableStateDigest");
+    tcase_add_test(tc, test_LCH_TableStateDigest);
+    suite_add_tcase(s, tc);
+  }
+  {
+    TCase *tc = tcase_create("LCH_TableAppendNewState");
+    tcase_add_test(tc, test_LCH_TableAppendNewState);
+    suite_add_tcase(s, tc);
+  }
   return s;
 }
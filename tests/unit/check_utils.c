@@ -31,7 +31,7 @@ START_TEST(test_LCH_MessageDigest) {
 END_TEST
 
 START_TEST(test_LCH_TableToJsonObject) {
-  LCH_List *table = NULL;
+  LCH_Table *table = NULL;
   {
     const char *const csv =
         "firstname, lastname,  born\r\n"
@@ -39,7 +39,7 @@ START_TEST(test_LCH_TableToJsonObject) {
         "Ringo,     Starr,     1940\r\n"
         "John,      Lennon,    1940\r\n"
         "George,    Harrison,  1943\r\n";
-    table = LCH_CSVParseTable(csv, strlen(csv));
+    table = LCH_CSVParseTableColumnar(csv, strlen(csv));
   }
   ck_assert_ptr_nonnull(table);
 
@@ -63,7 +63,7 @@ START_TEST(test_LCH_TableToJsonObject) {
 
   LCH_ListDestroy(subsidiary);
   LCH_ListDestroy(primary);
-  LCH_ListDestroy(table);
+  LCH_TableDestroy(table);
 
   {
     const LCH_Buffer key = LCH_BufferStaticFromString("Paul,McCartney");
@@ -92,7 +92,7 @@ START_TEST(test_LCH_TableToJsonObject) {
 END_TEST
 
 START_TEST(test_LCH_TableToJsonObjectNoSubsidiary) {
-  LCH_List *table = NULL;
+  LCH_Table *table = NULL;
   {
     const char *const csv =
         "firstname, lastname,  born\r\n"
@@ -100,7 +100,7 @@ START_TEST(test_LCH_TableToJsonObjectNoSubsidiary) {
         "Ringo,     Starr,     1940\r\n"
         "John,      Lennon,    1940\r\n"
         "George,    Harrison,  1943\r\n";
-    table = LCH_CSVParseTable(csv, strlen(csv));
+    table = LCH_CSVParseTableColumnar(csv, strlen(csv));
   }
   ck_assert_ptr_nonnull(table);
 
@@ -120,7 +120,7 @@ START_TEST(test_LCH_TableToJsonObjectNoSubsidiary) {
 
   LCH_ListDestroy(subsidiary);
   LCH_ListDestroy(primary);
-  LCH_ListDestroy(table);
+  LCH_TableDestroy(table);
 
   {
     const LCH_Buffer key = LCH_BufferStaticFromString("Paul,McCartney,1942");
@@ -5,8 +5,12 @@
 #include "../lib/leech.h"
 
 Suite *BlockSuite(void);
+Suite *BlockIndexSuite(void);
+Suite *PackSuite(void);
+Suite *ChainIndexSuite(void);
 Suite *BufferSuite(void);
 Suite *CSVSuite(void);
+Suite *ColumnarSuite(void);
 Suite *JSONSuite(void);
 Suite *DeltaSuite(void);
 Suite *DictSuite(void);
@@ -18,19 +22,31 @@ Suite *InstanceSuite(void);
 Suite *FilesSuite(void);
 Suite *StringLibSuite(void);
 Suite *PatchSuite(void);
+Suite *CompressionSuite(void);
+Suite *EncodingSuite(void);
+Suite *MetricsSuite(void);
+Suite *LoggerSuite(void);
 
 int main(int argc, char *argv[]) {
   SRunner *sr = srunner_create(BufferSuite());
   srunner_add_suite(sr, DictSuite());
   srunner_add_suite(sr, ListSuite());
   srunner_add_suite(sr, CSVSuite());
+  srunner_add_suite(sr, ColumnarSuite());
   srunner_add_suite(sr, JSONSuite());
   srunner_add_suite(sr, UtilsSuite());
   srunner_add_suite(sr, DeltaSuite());
   srunner_add_suite(sr, BlockSuite());
+  srunner_add_suite(sr, BlockIndexSuite());
+  srunner_add_suite(sr, PackSuite());
+  srunner_add_suite(sr, ChainIndexSuite());
   srunner_add_suite(sr, TableSuite());
   srunner_add_suite(sr, InstanceSuite());
   srunner_add_suite(sr, PatchSuite());
+  srunner_add_suite(sr, CompressionSuite());
+  srunner_add_suite(sr, EncodingSuite());
+  srunner_add_suite(sr, MetricsSuite());
+  srunner_add_suite(sr, LoggerSuite());
 
   if (argc > 1 && strcmp(argv[1], "no-fork") == 0) {
     srunner_set_fork_status(sr, CK_NOFORK);